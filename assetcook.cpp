@@ -0,0 +1,302 @@
+// Offline cooker: turns every mesh, texture and environment under the given
+// source directories into the GPU-ready files the runtime loads from
+// COOKED_DIR. A manifest of content hashes makes reruns incremental: sources
+// whose bytes did not change are skipped even if their timestamps did.
+//
+//     assetcook [--force] [--compress-meshes] [--lightmap-uvs [texels/unit]] [--pack out.pak] [source dirs...]   (default: res)
+//
+// --pack bundles the cooked outputs, plus every file under the source
+// directories that is not itself cooked (shaders, say), into one pack the
+// runtime can mount with --pack. --compress-meshes writes meshes through
+// mesh_codec, trading GlCompactVert precision and a decode on load for a
+// fraction of the size. --lightmap-uvs gives every mesh a lightmap UV set at
+// the given density, DEFAULT_LIGHTMAP_UV_PARAMS otherwise; only turning it on
+// or off is recorded, so a new density needs --force.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "cooked_file.hpp"
+#include "mapped_file.hpp"
+#include "mesh_cook.hpp"
+#include "pack_file.hpp"
+#include "texture_cook.hpp"
+
+enum AssetKind {
+    ASSET_MESH,
+    ASSET_TEXTURE,
+    ASSET_ENVIRONMENT,
+};
+
+static const char* const ASSET_KIND_NAMES[] = { "mesh", "texture", "environment" };
+
+struct ManifestEntry {
+    uint64_t    hash;
+    SourceStamp stamp;
+    std::string kind;
+    uint32_t    version;
+};
+
+struct CookJob {
+    std::string   sourcePath;
+    std::string   cookedPath;
+    AssetKind     kind;
+    SourceStamp   stamp;
+    ManifestEntry result;
+    enum { UP_TO_DATE, RESTAMPED, COOKED, FAILED } outcome;
+};
+
+static std::string ManifestPath() {
+    return std::string(COOKED_DIR) + "/manifest.txt";
+}
+
+static bool ClassifySource(const std::filesystem::path& path, AssetKind* kind) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char) tolower(c); });
+    if (ext == ".fbx" || ext == ".obj" || ext == ".gltf" || ext == ".glb" || ext == ".dae" || ext == ".3ds") {
+        *kind = ASSET_MESH;
+    } else if (ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".tga" || ext == ".bmp") {
+        *kind = ASSET_TEXTURE;
+    } else if (ext == ".hdr") {
+        *kind = ASSET_ENVIRONMENT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Compressed meshes are recorded with the top bit set, and meshes with
+// lightmap UVs with the next, so switching --compress-meshes or
+// --lightmap-uvs on or off recooks every mesh.
+static const uint32_t COMPRESSED_MESH_BIT = 0x80000000u;
+static const uint32_t LIGHTMAP_MESH_BIT   = 0x40000000u;
+
+static uint32_t CookerVersion(AssetKind kind, bool compressMeshes, const LightmapUvParams* lightmap) {
+    if (kind == ASSET_MESH) {
+        return COOKED_MESH_VERSION | (compressMeshes ? COMPRESSED_MESH_BIT : 0) | (lightmap ? LIGHTMAP_MESH_BIT : 0);
+    }
+    return COOKED_TEXTURE_VERSION;
+}
+
+static uint32_t CookedMagic(AssetKind kind) {
+    return kind == ASSET_MESH ? COOKED_MESH_MAGIC : COOKED_TEXTURE_MAGIC;
+}
+
+// One line per source: hash, size, write time, kind, cooker version, path.
+static std::unordered_map<std::string, ManifestEntry> ReadManifest(const char* path) {
+    std::unordered_map<std::string, ManifestEntry> manifest;
+    FILE* file = fopen(path, "r");
+    if (!file) return manifest;
+    char line[4096];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long long hash, size;
+        long long time;
+        char kind[32];
+        unsigned version;
+        int pathStart = 0;
+        if (sscanf(line, "%llx %llu %lld %31s %u %n", &hash, &size, &time, kind, &version, &pathStart) != 5 || !pathStart) continue;
+        std::string source = line + pathStart;
+        while (!source.empty() && (source.back() == '\n' || source.back() == '\r')) source.pop_back();
+        manifest[source] = ManifestEntry { hash, { size, time }, kind, version };
+    }
+    fclose(file);
+    return manifest;
+}
+
+static bool WriteManifest(const char* path, const std::unordered_map<std::string, ManifestEntry>& manifest) {
+    std::vector<const std::pair<const std::string, ManifestEntry>*> sorted;
+    for (auto& entry : manifest) sorted.push_back(&entry);
+    std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) { return a->first < b->first; });
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    std::string tmpPath = std::string(path) + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "w");
+    if (!file) return false;
+    bool ok = true;
+    for (auto entry : sorted) {
+        const ManifestEntry& e = entry->second;
+        ok = fprintf(file, "%016llx %llu %lld %s %u %s\n", (unsigned long long) e.hash, (unsigned long long) e.stamp.size,
+                     (long long) e.stamp.time, e.kind.c_str(), e.version, entry->first.c_str()) > 0 && ok;
+    }
+    ok = (fclose(file) == 0) && ok;
+    if (ok) std::filesystem::rename(tmpPath, path, ec);
+    if (!ok || ec) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+static bool HashSource(const char* path, uint64_t* hash) {
+    MappedFile file;
+    if (!MappedFile_Open(&file, path)) return false;
+    MappedFile_Prefetch(&file, 0, file.size, true);
+    *hash = Cooked_HashBytes(file.data, file.size);
+    MappedFile_Close(&file);
+    return true;
+}
+
+static bool Cook(const CookJob& job, bool compressMeshes, const LightmapUvParams* lightmap) {
+    switch (job.kind) {
+        case ASSET_MESH: {
+            StaticMesh mesh;
+            return CookStaticMesh(&mesh, job.sourcePath.c_str(), nullptr, lightmap)
+                && CookedMesh_Write(mesh, job.cookedPath.c_str(), job.sourcePath.c_str(), compressMeshes);
+        }
+        case ASSET_TEXTURE:
+            return CookTexture(job.sourcePath.c_str(), job.cookedPath.c_str(), TEXTURE_COOK_COLOR);
+        case ASSET_ENVIRONMENT:
+            return CookTexture(job.sourcePath.c_str(), job.cookedPath.c_str(), TEXTURE_COOK_ENVIRONMENT);
+    }
+    return false;
+}
+
+static void RunJob(CookJob* job, const std::unordered_map<std::string, ManifestEntry>& manifest, bool force, bool compressMeshes,
+                   const LightmapUvParams* lightmap) {
+    job->result.kind = ASSET_KIND_NAMES[job->kind];
+    job->result.version = CookerVersion(job->kind, compressMeshes, lightmap);
+    job->result.stamp = job->stamp;
+
+    auto it = manifest.find(job->sourcePath);
+    std::error_code ec;
+    bool known = !force && it != manifest.end()
+              && it->second.kind == job->result.kind
+              && it->second.version == job->result.version
+              && std::filesystem::exists(job->cookedPath, ec);
+    if (known && it->second.stamp.size == job->stamp.size && it->second.stamp.time == job->stamp.time) {
+        job->result.hash = it->second.hash;
+        job->outcome = CookJob::UP_TO_DATE;
+        return;
+    }
+
+    if (!HashSource(job->sourcePath.c_str(), &job->result.hash)) {
+        printf("%s: could not read\n", job->sourcePath.c_str());
+        job->outcome = CookJob::FAILED;
+        return;
+    }
+
+    // Touched but unchanged, e.g. by a checkout: only the stamp the runtime
+    // checks needs to move.
+    if (known && it->second.hash == job->result.hash
+        && Cooked_Restamp(job->cookedPath.c_str(), CookedMagic(job->kind), job->stamp)) {
+        job->outcome = CookJob::RESTAMPED;
+        return;
+    }
+
+    job->outcome = Cook(*job, compressMeshes, lightmap) ? CookJob::COOKED : CookJob::FAILED;
+    if (job->outcome == CookJob::FAILED) printf("%s: cook failed\n", job->sourcePath.c_str());
+}
+
+int main(int argc, char** argv) {
+    bool force = false;
+    bool compressMeshes = false;
+    bool lightmapUvs = false;
+    LightmapUvParams lightmapParams = DEFAULT_LIGHTMAP_UV_PARAMS;
+    const char* packPath = nullptr;
+    std::vector<std::string> roots;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--force") force = true;
+        else if (arg == "--compress-meshes") compressMeshes = true;
+        else if (arg == "--lightmap-uvs") {
+            lightmapUvs = true;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) lightmapParams.texelsPerUnit = (float) atof(argv[++i]);
+        }
+        else if (arg == "--pack" && i + 1 < argc) packPath = argv[++i];
+        else roots.push_back(arg);
+    }
+    if (roots.empty()) roots.push_back("res");
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<CookJob> jobs;
+    std::vector<std::string> rawFiles;
+    for (const std::string& root : roots) {
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(root, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            if (!it->is_regular_file(ec)) continue;
+            CookJob job {};
+            if (!ClassifySource(it->path(), &job.kind)) {
+                rawFiles.push_back(it->path().generic_string());
+                continue;
+            }
+            job.sourcePath = it->path().generic_string();
+            if (!GetSourceStamp(job.sourcePath.c_str(), &job.stamp)) continue;
+            job.cookedPath = job.kind == ASSET_MESH ? CookedMesh_PathFor(job.sourcePath.c_str()) : CookedTexture_PathFor(job.sourcePath.c_str());
+            jobs.push_back(std::move(job));
+        }
+        if (ec) printf("%s: %s\n", root.c_str(), ec.message().c_str());
+    }
+
+    // Largest sources first, pulled one at a time by each worker, so a single
+    // huge mesh does not end up queued behind a run of small textures.
+    std::sort(jobs.begin(), jobs.end(), [](const CookJob& a, const CookJob& b) { return a.stamp.size > b.stamp.size; });
+
+    std::string manifestPath = ManifestPath();
+    std::unordered_map<std::string, ManifestEntry> manifest = ReadManifest(manifestPath.c_str());
+
+    std::atomic<size_t> next { 0 };
+    auto worker = [&] {
+        for (size_t i = next++; i < jobs.size(); i = next++) RunJob(&jobs[i], manifest, force, compressMeshes, lightmapUvs ? &lightmapParams : nullptr);
+    };
+    size_t numWorkers = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), jobs.size()));
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < numWorkers; ++i) workers.emplace_back(worker);
+    worker();
+    for (auto& t : workers) t.join();
+
+    size_t counts[4] = {};
+    for (const CookJob& job : jobs) {
+        counts[job.outcome]++;
+        if (job.outcome != CookJob::FAILED) manifest[job.sourcePath] = job.result;
+        else manifest.erase(job.sourcePath);
+    }
+
+    // Drop entries, and their outputs, for sources that no longer exist.
+    for (auto it = manifest.begin(); it != manifest.end();) {
+        std::error_code ec;
+        if (std::filesystem::exists(it->first, ec)) {
+            ++it;
+            continue;
+        }
+        std::string cookedPath = it->second.kind == ASSET_KIND_NAMES[ASSET_MESH] ? CookedMesh_PathFor(it->first.c_str())
+                                                                                 : CookedTexture_PathFor(it->first.c_str());
+        std::filesystem::remove(cookedPath, ec);
+        printf("%s: source removed, dropped %s\n", it->first.c_str(), cookedPath.c_str());
+        it = manifest.erase(it);
+    }
+
+    if (!WriteManifest(manifestPath.c_str(), manifest)) {
+        printf("could not write %s\n", manifestPath.c_str());
+        return 1;
+    }
+
+    if (packPath) {
+        std::vector<const char*> packed;
+        for (const CookJob& job : jobs) {
+            if (job.outcome != CookJob::FAILED) packed.push_back(job.cookedPath.c_str());
+        }
+        for (const std::string& raw : rawFiles) packed.push_back(raw.c_str());
+        if (!PackFile_Write(packPath, packed.data(), packed.size())) {
+            printf("could not write %s\n", packPath);
+            return 1;
+        }
+        std::error_code ec;
+        printf("%s: %zu files, %.1f MB\n", packPath, packed.size(), std::filesystem::file_size(packPath, ec) / (1024.0 * 1024.0));
+    }
+
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    printf("%zu assets: %zu cooked, %zu restamped, %zu up to date, %zu failed in %.2f ms on %zu workers\n", jobs.size(),
+           counts[CookJob::COOKED], counts[CookJob::RESTAMPED], counts[CookJob::UP_TO_DATE], counts[CookJob::FAILED], dur.count(), numWorkers);
+    return counts[CookJob::FAILED] ? 1 : 0;
+}
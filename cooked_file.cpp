@@ -0,0 +1,172 @@
+#include "cooked_file.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+bool GetSourceStamp(const char* path, SourceStamp* stamp) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    stamp->size = (uint64_t) size;
+    stamp->time = (int64_t) time.time_since_epoch().count();
+    return true;
+}
+
+static inline uint64_t Rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t HashRound(uint64_t acc, uint64_t word) {
+    acc += word * 0xc2b2ae3d27d4eb4full;
+    return Rotl64(acc, 31) * 0x9e3779b185ebca87ull;
+}
+
+static inline uint64_t HashMix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t Cooked_HashBytes(const void* data, size_t size) {
+    // Four independent lanes over 32-byte blocks keep the multiplies from
+    // serializing, so multi-gigabyte sources hash at memory speed.
+    auto p = (const uint8_t*) data;
+    uint64_t lanes[4] = { 0x9e3779b185ebca87ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull, 0x27d4eb2f165667c5ull };
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        uint64_t words[4];
+        memcpy(words, p + i, sizeof(words));
+        for (int k = 0; k < 4; ++k) lanes[k] = HashRound(lanes[k], words[k]);
+    }
+    uint64_t h = Rotl64(lanes[0], 1) + Rotl64(lanes[1], 7) + Rotl64(lanes[2], 12) + Rotl64(lanes[3], 18);
+    h ^= (uint64_t) size;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        h = HashRound(h, word);
+    }
+    uint64_t tail = 0;
+    if (i < size) memcpy(&tail, p + i, size - i);
+    return HashMix(HashRound(h, tail));
+}
+
+std::string Cooked_PathFor(const char* sourcePath, const char* extension) {
+    std::string path = sourcePath;
+    std::replace(path.begin(), path.end(), '\\', '/');
+    if (path.compare(0, 2, "./") == 0) path.erase(0, 2);
+    return std::string(COOKED_DIR) + "/" + path + extension;
+}
+
+static inline uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static bool WritePadding(FILE* file, uint64_t from, uint64_t to) {
+    static const char zeros[COOKED_ALIGNMENT] = {};
+    while (from < to) {
+        size_t n = (size_t) std::min<uint64_t>(to - from, sizeof(zeros));
+        if (fwrite(zeros, 1, n, file) != n) return false;
+        from += n;
+    }
+    return true;
+}
+
+bool Cooked_Write(const char* path, uint32_t magic, uint32_t version, const SourceStamp& stamp,
+                  const CookedPayload* payloads, uint32_t numPayloads) {
+    CookedFileHeader header {};
+    header.magic = magic;
+    header.version = version;
+    header.sourceSize = stamp.size;
+    header.sourceTime = stamp.time;
+    header.numChunks = numPayloads;
+
+    std::vector<CookedChunk> chunks(numPayloads);
+    uint64_t offset = AlignUp(sizeof(header) + chunks.size() * sizeof(CookedChunk), COOKED_ALIGNMENT);
+    for (uint32_t i = 0; i < numPayloads; ++i) {
+        chunks[i] = CookedChunk { payloads[i].id, payloads[i].stride, offset, payloads[i].size };
+        offset = AlignUp(offset + payloads[i].size, COOKED_ALIGNMENT);
+    }
+
+    std::error_code ec;
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+
+    std::string tmpPath = std::string(path) + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if (!file) return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && (chunks.empty() || fwrite(chunks.data(), chunks.size() * sizeof(CookedChunk), 1, file) == 1);
+    uint64_t written = sizeof(header) + chunks.size() * sizeof(CookedChunk);
+    for (uint32_t i = 0; ok && i < numPayloads; ++i) {
+        ok = WritePadding(file, written, chunks[i].offset)
+          && (payloads[i].size == 0 || fwrite(payloads[i].data, (size_t) payloads[i].size, 1, file) == 1);
+        written = chunks[i].offset + chunks[i].size;
+    }
+    ok = ok && WritePadding(file, written, AlignUp(written, COOKED_ALIGNMENT));
+    ok = (fclose(file) == 0) && ok;
+
+    if (ok) std::filesystem::rename(tmpPath, path, ec);
+    if (!ok || ec) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool Cooked_Validate(const void* data, size_t size, uint32_t magic, uint32_t version) {
+    auto header = (const CookedFileHeader*) data;
+    return data
+        && size >= sizeof(CookedFileHeader)
+        && header->magic == magic
+        && header->version == version
+        && header->numChunks <= (size - sizeof(CookedFileHeader)) / sizeof(CookedChunk);
+}
+
+bool Cooked_Open(MappedFile* file, const char* path, uint32_t magic, uint32_t version, const char* sourcePath) {
+    SourceStamp stamp;
+    if (!GetSourceStamp(sourcePath, &stamp)) return false;
+    if (!MappedFile_Open(file, path)) return false;
+
+    auto header = (const CookedFileHeader*) file->data;
+    bool fresh = Cooked_Validate(file->data, file->size, magic, version)
+              && header->sourceSize == stamp.size
+              && header->sourceTime == stamp.time;
+    if (!fresh) MappedFile_Close(file);
+    return fresh;
+}
+
+const CookedChunk* Cooked_FindChunk(const void* data, size_t size, uint32_t id, uint32_t stride) {
+    auto header = (const CookedFileHeader*) data;
+    auto chunks = (const CookedChunk*) (header + 1);
+    for (uint32_t i = 0; i < header->numChunks; ++i) {
+        const CookedChunk& chunk = chunks[i];
+        if (chunk.id != id) continue;
+        if (chunk.stride != stride || chunk.size % stride != 0) return nullptr;
+        if (chunk.offset > size || chunk.size > size - chunk.offset) return nullptr;
+        return &chunk;
+    }
+    return nullptr;
+}
+
+bool Cooked_Restamp(const char* path, uint32_t magic, const SourceStamp& stamp) {
+    FILE* file = fopen(path, "r+b");
+    if (!file) return false;
+    CookedFileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == magic;
+    if (ok) {
+        header.sourceSize = stamp.size;
+        header.sourceTime = stamp.time;
+        ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+    return (fclose(file) == 0) && ok;
+}
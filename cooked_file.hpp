@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "mapped_file.hpp"
+
+// Every cooked artifact is a header, a chunk directory and page-aligned chunk
+// payloads. The header records the size and write time of the source it was
+// cooked from, so a reader can tell a stale file from a fresh one with a
+// single stat. Cooked files live under COOKED_DIR, mirroring the source tree.
+
+static constexpr const char* COOKED_DIR       = "cooked";
+static constexpr uint64_t    COOKED_ALIGNMENT = 4096;
+
+struct CookedFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t  sourceTime;
+    uint32_t numChunks;
+    uint32_t reserved;
+};
+
+struct CookedChunk {
+    uint32_t id;
+    uint32_t stride;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct CookedPayload {
+    uint32_t    id;
+    uint32_t    stride;
+    const void* data;
+    uint64_t    size;
+};
+
+struct SourceStamp {
+    uint64_t size;
+    int64_t  time;
+};
+
+bool GetSourceStamp(const char* path, SourceStamp* stamp);
+
+// 64-bit content hash of a whole buffer, used to key cooked artifacts on what
+// the source contains rather than when it was last touched.
+uint64_t Cooked_HashBytes(const void* data, size_t size);
+
+// COOKED_DIR/<sourcePath><extension>
+std::string Cooked_PathFor(const char* sourcePath, const char* extension);
+
+// Writes next to the destination and renames over it, so a crash mid-cook
+// never leaves a truncated file that looks fresh. Creates missing parent
+// directories.
+bool Cooked_Write(const char* path, uint32_t magic, uint32_t version, const SourceStamp& stamp,
+                  const CookedPayload* payloads, uint32_t numPayloads);
+
+// Checks the magic, version and chunk directory of a cooked file in memory.
+// Says nothing about staleness; cooked files in a pack have no source to
+// compare against.
+bool Cooked_Validate(const void* data, size_t size, uint32_t magic, uint32_t version);
+
+// Maps path and checks that it is valid and was cooked from sourcePath as it
+// is now. The file is closed on failure.
+bool Cooked_Open(MappedFile* file, const char* path, uint32_t magic, uint32_t version, const char* sourcePath);
+
+// Returns the chunk with the given id of a validated cooked file if its
+// stride matches and it lies within the file, else nullptr.
+const CookedChunk* Cooked_FindChunk(const void* data, size_t size, uint32_t id, uint32_t stride);
+
+// Rewrites the source stamp of an existing cooked file in place, for sources
+// that were touched without their content changing.
+bool Cooked_Restamp(const char* path, uint32_t magic, const SourceStamp& stamp);
@@ -0,0 +1,411 @@
+#include "geometry_heap.hpp"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+bool GeometryHeap_Create(GeometryHeap* heap, size_t maxVertices, size_t maxIndices, uint32_t maxMeshes, bool positions) {
+    if (maxVertices == 0 || maxIndices == 0 || maxVertices >= 1u << 31 || maxIndices >= 1u << 31) {
+        printf("geometry heap: %zu vertices and %zu indices do not fit\n", maxVertices, maxIndices);
+        return false;
+    }
+    GlStaticMesh& mesh = heap->mesh;
+    mesh = GlStaticMesh {};
+    glCreateVertexArrays(1, &mesh.vao);
+    glCreateBuffers(1, &mesh.vbo);
+    glCreateBuffers(1, &mesh.ibo);
+    mesh.indexType = GL_UNSIGNED_INT;
+    mesh.format = GlStaticMesh::F_FULL;
+    mesh.posOffset = glm::vec3 { 0.0f };
+    mesh.posScale = glm::vec3 { 1.0f };
+    heap->skinVbo = 0;
+
+    glNamedBufferStorage(mesh.vbo, maxVertices * sizeof(GlStaticMeshVert), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glNamedBufferStorage(mesh.ibo, maxIndices * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    GL_SetupVertexLayout(mesh.vao, 0, mesh.vbo, FULL_VERT_LAYOUT);
+    glVertexArrayElementBuffer(mesh.vao, mesh.ibo);
+    if (positions) {
+        glCreateVertexArrays(1, &mesh.posVao);
+        glCreateBuffers(1, &mesh.posVbo);
+        glNamedBufferStorage(mesh.posVbo, maxVertices * sizeof(GlPositionVert), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        GL_SetupVertexLayout(mesh.posVao, 0, mesh.posVbo, POSITION_VERT_LAYOUT);
+        glVertexArrayElementBuffer(mesh.posVao, mesh.ibo);
+    }
+
+    OffsetAllocator_Init(&heap->vertices, (uint32_t) maxVertices, maxMeshes);
+    OffsetAllocator_Init(&heap->indices, (uint32_t) maxIndices, maxMeshes);
+    heap->meshes.clear();
+    heap->freeHandles.clear();
+    return true;
+}
+
+void GeometryHeap_Destroy(GeometryHeap* heap) {
+    GlStaticMesh& mesh = heap->mesh;
+    GLuint vaos[] = { mesh.vao, mesh.posVao };
+    GLuint buffers[] = { mesh.vbo, mesh.ibo, mesh.posVbo, mesh.lightmapVbo, heap->skinVbo };
+    glDeleteVertexArrays(2, vaos);
+    glDeleteBuffers(5, buffers);
+    mesh = GlStaticMesh {};
+    heap->skinVbo = 0;
+    heap->meshes.clear();
+    heap->freeHandles.clear();
+}
+
+GeometryHandle GeometryHeap_Add(GeometryHeap* heap, const GlStaticMeshVert* verts, size_t numverts,
+                                const void* indices, size_t numindices, GLenum indextype) {
+    OffsetAllocation v = OffsetAllocator_Alloc(&heap->vertices, (uint32_t) numverts);
+    if (v.node == OFFSET_ALLOC_NONE) return GEOMETRY_HANDLE_NONE;
+    OffsetAllocation i = OffsetAllocator_Alloc(&heap->indices, (uint32_t) numindices);
+    if (i.node == OFFSET_ALLOC_NONE) {
+        OffsetAllocator_Free(&heap->vertices, v.node);
+        return GEOMETRY_HANDLE_NONE;
+    }
+
+    glNamedBufferSubData(heap->mesh.vbo, v.offset * sizeof(GlStaticMeshVert), numverts * sizeof(GlStaticMeshVert), verts);
+    if (heap->mesh.posVbo) {
+        std::vector<GlPositionVert> pos(numverts);
+        for (size_t k = 0; k < numverts; ++k) pos[k].pos = verts[k].pos;
+        glNamedBufferSubData(heap->mesh.posVbo, v.offset * sizeof(GlPositionVert), numverts * sizeof(GlPositionVert), pos.data());
+    }
+    if (indextype == GL_UNSIGNED_INT) {
+        glNamedBufferSubData(heap->mesh.ibo, i.offset * sizeof(GLuint), numindices * sizeof(GLuint), indices);
+    } else {
+        std::vector<GLuint> wide((const GLushort*) indices, (const GLushort*) indices + numindices);
+        glNamedBufferSubData(heap->mesh.ibo, i.offset * sizeof(GLuint), numindices * sizeof(GLuint), wide.data());
+    }
+
+    GeometryHandle handle;
+    if (!heap->freeHandles.empty()) {
+        handle = heap->freeHandles.back();
+        heap->freeHandles.pop_back();
+    } else {
+        handle = (GeometryHandle) heap->meshes.size();
+        heap->meshes.emplace_back();
+    }
+    heap->meshes[handle] = GeometryHeapMesh { v.node, i.node, (GLint) v.offset, i.offset, (GLuint) numverts, (GLuint) numindices };
+    return handle;
+}
+
+void GeometryHeap_Remove(GeometryHeap* heap, GeometryHandle handle) {
+    GeometryHeapMesh& m = heap->meshes[handle];
+    if (m.vertexNode == OFFSET_ALLOC_NONE) {
+        printf("geometry heap: removing mesh %u twice\n", handle);
+        return;
+    }
+    OffsetAllocator_Free(&heap->vertices, m.vertexNode);
+    OffsetAllocator_Free(&heap->indices, m.indexNode);
+    m.vertexNode = m.indexNode = OFFSET_ALLOC_NONE;
+    heap->freeHandles.push_back(handle);
+}
+
+// Creates the per-vertex stream *buffer of layout on first use, zeroed and
+// read through the heap's VAO at binding, and writes the values of handle
+// into it.
+template <size_t N>
+static void SetVertexStream(GeometryHeap* heap, GeometryHandle handle, GLuint* buffer, const void* values, GLuint binding,
+                            const VertexLayout<N>& layout) {
+    size_t size = layout.stride;
+    if (!*buffer) {
+        glCreateBuffers(1, buffer);
+        glNamedBufferStorage(*buffer, heap->vertices.size * size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glClearNamedBufferData(*buffer, GL_R8UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+        GL_SetupVertexLayout(heap->mesh.vao, binding, *buffer, layout);
+    }
+    const GeometryHeapMesh& m = heap->meshes[handle];
+    glNamedBufferSubData(*buffer, m.baseVertex * size, m.numVertices * size, values);
+}
+
+void GeometryHeap_SetLightmapCoords(GeometryHeap* heap, GeometryHandle handle, const glm::vec2* coords) {
+    SetVertexStream(heap, handle, &heap->mesh.lightmapVbo, coords, LIGHTMAP_BINDING, LIGHTMAP_LAYOUT);
+}
+
+void GeometryHeap_SetSkinWeights(GeometryHeap* heap, GeometryHandle handle, const SkinWeights* weights) {
+    SetVertexStream(heap, handle, &heap->skinVbo, weights, SKIN_BINDING, SKIN_LAYOUT);
+}
+
+void GeometryHeap_Draw(const GeometryHeap& heap, GeometryHandle handle, const StaticSubmesh* submeshes, size_t numsubmeshes,
+                       GLsizei instanceCount, GLuint baseInstance) {
+    const GeometryHeapMesh& m = heap.meshes[handle];
+    for (size_t i = 0; i < numsubmeshes; ++i) {
+        const StaticSubmesh& sub = submeshes[i];
+        glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, (GLsizei) sub.numIndices, GL_UNSIGNED_INT,
+                                                      (void*) ((m.firstIndex + sub.firstIndex) * sizeof(GLuint)), instanceCount,
+                                                      m.baseVertex + sub.baseVertex, baseInstance);
+    }
+}
+
+void GeometryHeap_AppendCommands(const GeometryHeap& heap, GeometryHandle handle, const StaticSubmesh* submeshes,
+                                 size_t numsubmeshes, GLuint instanceCount, GLuint baseInstance,
+                                 std::vector<GlDrawElementsIndirect>* commands) {
+    const GeometryHeapMesh& m = heap.meshes[handle];
+    for (size_t i = 0; i < numsubmeshes; ++i) {
+        const StaticSubmesh& sub = submeshes[i];
+        commands->push_back(GlDrawElementsIndirect { sub.numIndices, instanceCount, m.firstIndex + sub.firstIndex,
+                                                     m.baseVertex + sub.baseVertex, baseInstance });
+    }
+}
+
+// Applies moves, which OffsetAllocator_Compact lists in ascending order, to
+// buffer. A copy may not overlap itself, so a mesh moving by less than its
+// size goes through scratch.
+static size_t ApplyMoves(GLuint buffer, const std::vector<OffsetAllocMove>& moves, size_t unit, GLuint* scratch, size_t* scratchSize) {
+    size_t bytes = 0;
+    for (const OffsetAllocMove& m : moves) {
+        GLintptr from = m.from * unit, to = m.to * unit;
+        GLsizeiptr size = m.size * unit;
+        if (m.from - m.to >= m.size) {
+            glCopyNamedBufferSubData(buffer, buffer, from, to, size);
+        } else {
+            if ((size_t) size > *scratchSize) {
+                glDeleteBuffers(1, scratch);
+                glCreateBuffers(1, scratch);
+                glNamedBufferStorage(*scratch, size, nullptr, 0);
+                *scratchSize = size;
+            }
+            glCopyNamedBufferSubData(buffer, *scratch, from, 0, size);
+            glCopyNamedBufferSubData(*scratch, buffer, 0, to, size);
+        }
+        bytes += size;
+    }
+    return bytes;
+}
+
+size_t GeometryHeap_Defragment(GeometryHeap* heap) {
+    std::vector<OffsetAllocMove> moves;
+    GLuint scratch = 0;
+    size_t scratchSize = 0;
+    OffsetAllocator_Compact(&heap->vertices, &moves);
+    size_t bytes = ApplyMoves(heap->mesh.vbo, moves, sizeof(GlStaticMeshVert), &scratch, &scratchSize);
+    const GLuint streams[] = { heap->mesh.posVbo, heap->mesh.lightmapVbo, heap->skinVbo };
+    const size_t streamSizes[] = { sizeof(GlPositionVert), sizeof(GlLightmapVert), sizeof(SkinWeights) };
+    for (int k = 0; k < 3; ++k) {
+        if (streams[k]) bytes += ApplyMoves(streams[k], moves, streamSizes[k], &scratch, &scratchSize);
+    }
+    OffsetAllocator_Compact(&heap->indices, &moves);
+    bytes += ApplyMoves(heap->mesh.ibo, moves, sizeof(GLuint), &scratch, &scratchSize);
+    if (scratch) glDeleteBuffers(1, &scratch);
+
+    for (GeometryHeapMesh& m : heap->meshes) {
+        if (m.vertexNode == OFFSET_ALLOC_NONE) continue;
+        m.baseVertex = (GLint) OffsetAllocator_Offset(heap->vertices, m.vertexNode);
+        m.firstIndex = OffsetAllocator_Offset(heap->indices, m.indexNode);
+    }
+    return bytes;
+}
+
+bool GeometryHeap_Validate(const GeometryHeap& heap) {
+    if (!OffsetAllocator_Validate(heap.vertices) || !OffsetAllocator_Validate(heap.indices)) return false;
+    size_t live = 0;
+    for (size_t h = 0; h < heap.meshes.size(); ++h) {
+        const GeometryHeapMesh& m = heap.meshes[h];
+        if (m.vertexNode == OFFSET_ALLOC_NONE) continue;
+        live++;
+        if ((GLuint) m.baseVertex != OffsetAllocator_Offset(heap.vertices, m.vertexNode)
+            || m.firstIndex != OffsetAllocator_Offset(heap.indices, m.indexNode)
+            || m.numVertices != OffsetAllocator_Size(heap.vertices, m.vertexNode)
+            || m.numIndices != OffsetAllocator_Size(heap.indices, m.indexNode)) {
+            printf("geometry heap: mesh %zu disagrees with its allocations\n", h);
+            return false;
+        }
+    }
+    if (live != heap.vertices.numAllocs || live != heap.indices.numAllocs || live + heap.freeHandles.size() != heap.meshes.size()) {
+        printf("geometry heap: %zu meshes, but %u vertex and %u index allocations\n", live, heap.vertices.numAllocs,
+               heap.indices.numAllocs);
+        return false;
+    }
+    return true;
+}
+
+void GeometryHeap_PrintStats(const GeometryHeap& heap) {
+    const char* names[] = { "vertices", "indices" };
+    const OffsetAllocator* allocs[] = { &heap.vertices, &heap.indices };
+    for (int k = 0; k < 2; ++k) {
+        OffsetAllocatorStats s = OffsetAllocator_Stats(*allocs[k]);
+        printf("  %-8s %u meshes, %u of %u used, %u free ranges, largest %u, %.1f%% fragmented\n", names[k],
+               s.numAllocs, s.usedStorage, allocs[k]->size, s.numFreeRanges, s.largestFree, s.fragmentation * 100.0f);
+    }
+}
+
+// CPU milliseconds to submit a pass and GPU milliseconds to draw it, averaged
+// over passes, after one untimed pass.
+static void TimeDraws(const std::function<void()>& draw, int passes, double* cpuMs, double* gpuMs) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    draw();
+    glFinish();
+
+    GLuint query;
+    glCreateQueries(GL_TIME_ELAPSED, 1, &query);
+    auto start = std::chrono::high_resolution_clock::now();
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    for (int i = 0; i < passes; ++i) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        draw();
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    std::chrono::duration<double, std::milli> cpu = std::chrono::high_resolution_clock::now() - start;
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+    glDeleteQueries(1, &query);
+    *cpuMs = cpu.count() / passes;
+    *gpuMs = ns * 1e-6 / passes;
+}
+
+static std::vector<float> ReadDepth(const std::function<void()>& draw, int width, int height) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    draw();
+    std::vector<float> depth(width * height);
+    glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+    return depth;
+}
+
+void BenchmarkGeometryHeap(const GlStaticMeshVert* verts, const void* indices, GLenum indextype,
+                           const StaticSubmesh* submeshes, size_t numsubmeshes, GLuint program, size_t copies, int passes) {
+    // Mesh k is submesh k % numsubmeshes on its own, as an asset of one
+    // submesh would be.
+    size_t count = copies * numsubmeshes, indexsize = GlIndexSize(indextype);
+    size_t totalverts = 0, totalindices = 0;
+    for (size_t i = 0; i < numsubmeshes; ++i) {
+        totalverts += submeshes[i].numVertices;
+        totalindices += submeshes[i].numIndices;
+    }
+    auto source = [&](size_t k, const GlStaticMeshVert** v, const void** idx) {
+        const StaticSubmesh& sub = submeshes[k % numsubmeshes];
+        *v = verts + sub.baseVertex;
+        *idx = (const char*) indices + sub.firstIndex * indexsize;
+    };
+    auto whole = [&](size_t k) {
+        const StaticSubmesh& sub = submeshes[k % numsubmeshes];
+        return StaticSubmesh { 0, sub.numVertices, 0, sub.numIndices, sub.material };
+    };
+
+    std::vector<GlStaticMesh> own(count);
+    for (size_t k = 0; k < count; ++k) {
+        const GlStaticMeshVert* v;
+        const void* idx;
+        source(k, &v, &idx);
+        StaticSubmesh sub = whole(k);
+        LoadStaticMesh(&own[k], v, sub.numVertices, idx, sub.numIndices, indextype);
+    }
+
+    // Slack for the churn below, which adds meshes back into a fragmented heap.
+    GeometryHeap heap;
+    if (!GeometryHeap_Create(&heap, copies * totalverts * 5 / 4, copies * totalindices * 5 / 4, (uint32_t) count)) return;
+    std::vector<GeometryHandle> handles(count);
+    for (size_t k = 0; k < count; ++k) {
+        const GlStaticMeshVert* v;
+        const void* idx;
+        source(k, &v, &idx);
+        StaticSubmesh sub = whole(k);
+        handles[k] = GeometryHeap_Add(&heap, v, sub.numVertices, idx, sub.numIndices, indextype);
+    }
+
+    GLuint commandbuffer;
+    glCreateBuffers(1, &commandbuffer);
+    std::vector<GlDrawElementsIndirect> commands;
+    auto buildcommands = [&]() {
+        commands.clear();
+        for (size_t k = 0; k < count; ++k) {
+            StaticSubmesh sub = whole(k);
+            GeometryHeap_AppendCommands(heap, handles[k], &sub, 1, 1, 0, &commands);
+        }
+        glNamedBufferData(commandbuffer, commands.size() * sizeof(GlDrawElementsIndirect), commands.data(), GL_STATIC_DRAW);
+    };
+    buildcommands();
+
+    auto drawown = [&]() {
+        for (size_t k = 0; k < count; ++k) {
+            glBindVertexArray(own[k].vao);
+            glDrawElements(GL_TRIANGLES, (GLsizei) submeshes[k % numsubmeshes].numIndices, indextype, nullptr);
+        }
+    };
+    auto drawheap = [&]() {
+        glBindVertexArray(heap.mesh.vao);
+        for (size_t k = 0; k < count; ++k) {
+            StaticSubmesh sub = whole(k);
+            GeometryHeap_Draw(heap, handles[k], &sub, 1);
+        }
+    };
+    auto drawindirect = [&]() {
+        glBindVertexArray(heap.mesh.vao);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandbuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei) commands.size(), 0);
+    };
+
+    const int WIDTH = 64, HEIGHT = 36;
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glViewport(0, 0, WIDTH, HEIGHT);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glUseProgram(program);
+
+    struct Run {
+        const char*           name;
+        std::function<void()> draw;
+    };
+    const Run runs[] = {
+        { "a VAO per mesh", drawown },
+        { "heap, a draw per mesh", drawheap },
+        { "heap, one multi-draw", drawindirect },
+    };
+    printf("geometry heap: %zu meshes, %zu verts, %zu indices, %d passes\n", count, copies * totalverts, copies * totalindices, passes);
+    std::vector<float> reference = ReadDepth(drawown, WIDTH, HEIGHT);
+    for (const Run& run : runs) {
+        double cpu, gpu;
+        TimeDraws(run.draw, passes, &cpu, &gpu);
+        bool same = ReadDepth(run.draw, WIDTH, HEIGHT) == reference;
+        printf("  %-22s cpu %.3f ms/pass, gpu %.3f ms/pass, %s depth\n", run.name, cpu, gpu, same ? "same" : "DIFFERENT");
+    }
+
+    // Every third mesh out, then back in reverse order, so they land in
+    // whatever holes fit rather than where they were.
+    std::vector<size_t> removed;
+    for (size_t k = 0; k < count; k += 3) {
+        GeometryHeap_Remove(&heap, handles[k]);
+        removed.push_back(k);
+    }
+    auto add = [&](size_t k) {
+        const GlStaticMeshVert* v;
+        const void* idx;
+        source(k, &v, &idx);
+        StaticSubmesh sub = whole(k);
+        handles[k] = GeometryHeap_Add(&heap, v, sub.numVertices, idx, sub.numIndices, indextype);
+        return handles[k] != GEOMETRY_HANDLE_NONE;
+    };
+    std::vector<size_t> lost;
+    for (auto it = removed.rbegin(); it != removed.rend(); ++it) {
+        if (!add(*it)) lost.push_back(*it);
+    }
+    printf("after removing every third mesh and adding them back, %zu did not fit:\n", lost.size());
+    GeometryHeap_PrintStats(heap);
+
+    // What did not fit goes in after compaction, into the free space at the end.
+    glFinish();
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t bytes = GeometryHeap_Defragment(&heap);
+    glFinish();
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    size_t stilllost = 0;
+    for (size_t k : lost) stilllost += !add(k);
+    bool valid = GeometryHeap_Validate(heap);
+    printf("defragmented: %.2f MB moved in %.3f ms, %s, %zu still did not fit\n", bytes / (1024.0 * 1024.0), dur.count(),
+           valid ? "valid" : "INVALID", stilllost);
+    GeometryHeap_PrintStats(heap);
+    if (stilllost == 0) {
+        buildcommands();
+        bool same = ReadDepth(drawindirect, WIDTH, HEIGHT) == reference && ReadDepth(drawheap, WIDTH, HEIGHT) == reference;
+        printf("  heap draws %s depth as before\n", same ? "the same" : "a DIFFERENT");
+    }
+
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glDeleteBuffers(1, &commandbuffer);
+    GeometryHeap_Destroy(&heap);
+    for (GlStaticMesh& m : own) {
+        glDeleteVertexArrays(1, &m.vao);
+        glDeleteBuffers(1, &m.vbo);
+        glDeleteBuffers(1, &m.ibo);
+    }
+}
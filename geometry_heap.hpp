@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <GL/glew.h>
+
+#include "gl_mesh.hpp"
+#include "offset_allocator.hpp"
+#include "static_mesh.hpp"
+
+// Many meshes in one vertex buffer and one index buffer, each suballocated
+// with an OffsetAllocator, so everything in the heap draws from the same
+// VAO: binding it once covers every mesh, and a whole set of meshes can go
+// out as one glMultiDrawElementsIndirect. A mesh is a handle to where its
+// vertices and indices landed; its indices stay relative to its first
+// vertex and are drawn with a base vertex.
+//
+// Vertices are F_FULL and indices always 32-bit, so 16-bit meshes are
+// widened on the way in. The optional streams beside the vertices, positions
+// for depth passes, lightmap coordinates and skin weights, are laid out
+// vertex for vertex like them, so the same base vertex finds a mesh in each.
+
+typedef uint32_t GeometryHandle;
+static constexpr GeometryHandle GEOMETRY_HANDLE_NONE = 0xffffffff;
+
+struct GeometryHeapMesh {
+    uint32_t vertexNode;    // OFFSET_ALLOC_NONE when the handle is free
+    uint32_t indexNode;
+    GLint    baseVertex;
+    GLuint   firstIndex;
+    GLuint   numVertices;
+    GLuint   numIndices;
+};
+
+struct GeometryHeap {
+    GlStaticMesh                  mesh;         // the shared VAO and buffers, for GlStaticMesh_Bind
+    GLuint                        skinVbo;      // SkinWeights, 0 until GeometryHeap_SetSkinWeights
+    OffsetAllocator               vertices;     // in GlStaticMeshVert
+    OffsetAllocator               indices;      // in GLuint
+    std::vector<GeometryHeapMesh> meshes;       // by handle
+    std::vector<GeometryHandle>   freeHandles;
+};
+
+// Room for maxVertices vertices and maxIndices indices over at most
+// maxMeshes meshes. Both stay below 2^31. With positions, mesh.posVao
+// draws the same meshes from a GlPositionVert stream.
+bool GeometryHeap_Create(GeometryHeap* heap, size_t maxVertices, size_t maxIndices, uint32_t maxMeshes, bool positions = false);
+void GeometryHeap_Destroy(GeometryHeap* heap);
+
+// Uploads a mesh whose indices are relative to its first vertex, or returns
+// GEOMETRY_HANDLE_NONE if either buffer has no range large enough left.
+GeometryHandle GeometryHeap_Add(GeometryHeap* heap, const GlStaticMeshVert* verts, size_t numverts,
+                                const void* indices, size_t numindices, GLenum indextype);
+void GeometryHeap_Remove(GeometryHeap* heap, GeometryHandle handle);
+
+// One value per vertex of handle, read by the LIGHTMAP_COORDS and SKINNED
+// variants of vert.glsl through mesh.vao. The first call creates the stream
+// for the whole heap, zeroed, so meshes without values read zeros.
+void GeometryHeap_SetLightmapCoords(GeometryHeap* heap, GeometryHandle handle, const glm::vec2* coords);
+void GeometryHeap_SetSkinWeights(GeometryHeap* heap, GeometryHandle handle, const SkinWeights* weights);
+
+// Draws instanceCount instances from baseInstance of the submeshes of
+// handle, whose firstIndex and baseVertex are relative to the mesh, with
+// mesh.vao or mesh.posVao bound.
+void GeometryHeap_Draw(const GeometryHeap& heap, GeometryHandle handle, const StaticSubmesh* submeshes, size_t numsubmeshes,
+                       GLsizei instanceCount = 1, GLuint baseInstance = 0);
+
+// The same draws as indirect commands of instanceCount instances from
+// baseInstance, appended to commands for one glMultiDrawElementsIndirect.
+void GeometryHeap_AppendCommands(const GeometryHeap& heap, GeometryHandle handle, const StaticSubmesh* submeshes,
+                                 size_t numsubmeshes, GLuint instanceCount, GLuint baseInstance,
+                                 std::vector<GlDrawElementsIndirect>* commands);
+
+// Compacts the index buffer and every vertex stream in place on the GPU,
+// with glCopyNamedBufferSubData through a scratch buffer where a mesh
+// overlaps its own destination, and updates every mesh. Handles stay valid; indirect commands built before
+// have to be built again. Returns the bytes moved.
+size_t GeometryHeap_Defragment(GeometryHeap* heap);
+
+bool GeometryHeap_Validate(const GeometryHeap& heap);
+void GeometryHeap_PrintStats(const GeometryHeap& heap);
+
+// Uploads copies of each submesh as meshes of their own, once with a VAO
+// and buffers per mesh and once into a heap, draws them all passes times
+// with program, which has to be the full-format vert.glsl with its
+// uniforms set, and prints CPU and GPU time per pass for: binding each
+// mesh's VAO, drawing each mesh from the heap's VAO, and one multi-draw
+// for the heap. Then removes a third of the meshes, adds them back in
+// another order, defragments, and checks that the heap still draws the
+// same depth buffer.
+void BenchmarkGeometryHeap(const GlStaticMeshVert* verts, const void* indices, GLenum indextype,
+                           const StaticSubmesh* submeshes, size_t numsubmeshes, GLuint program, size_t copies, int passes);
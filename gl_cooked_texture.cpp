@@ -0,0 +1,17 @@
+#include "gl_cooked_texture.hpp"
+
+GLuint GL_CreateCookedTexture(const CookedTexture& texture) {
+    GLenum internalFormat = texture.format == COOKED_TEXTURE_RGBA16F ? GL_RGBA16F : GL_SRGB8_ALPHA8;
+    GLenum type = texture.format == COOKED_TEXTURE_RGBA16F ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE;
+
+    GLuint tex;
+    glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+    glTextureStorage2D(tex, (GLsizei) texture.numLevels, internalFormat, texture.levels[0].width, texture.levels[0].height);
+    for (size_t i = 0; i < texture.numLevels; ++i) {
+        const CookedTextureLevel& level = texture.levels[i];
+        glTextureSubImage2D(tex, (GLint) i, 0, 0, level.width, level.height, GL_RGBA, type, texture.data + level.offset);
+    }
+    glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return tex;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "texture_cook.hpp"
+
+// Creates an immutable texture holding every level of a cooked texture,
+// uploaded straight from the mapped file, with trilinear filtering.
+GLuint GL_CreateCookedTexture(const CookedTexture& texture);
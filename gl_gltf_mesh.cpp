@@ -0,0 +1,109 @@
+#include "gl_gltf_mesh.hpp"
+
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+
+// Attribute locations of the full format in vert.glsl; each accessor gets
+// the binding of the same number.
+static const GLuint GLTF_POSITION_LOCATION = 0;
+static const GLuint GLTF_NORMAL_LOCATION   = 1;
+static const GLuint GLTF_TANGENT_LOCATION  = 2;
+static const GLuint GLTF_COORD_LOCATION    = 4;
+
+static void AttachAccessor(GLuint vao, GLuint location, GLuint buffer, const GltfAccessor& a) {
+    glEnableVertexArrayAttrib(vao, location);
+    glVertexArrayAttribFormat(vao, location, a.components, a.componentType, a.normalized, 0);
+    glVertexArrayAttribBinding(vao, location, location);
+    glVertexArrayVertexBuffer(vao, location, buffer, (GLintptr) a.offset, (GLsizei) a.stride);
+}
+
+bool GlGltfMesh_Create(GlGltfMesh* mesh, const GltfAsset& asset, TextureCache* cache) {
+    mesh->primitives.clear();
+    mesh->materials.clear();
+    mesh->tangents = 0;
+    glCreateBuffers(1, &mesh->buffer);
+    glNamedBufferStorage(mesh->buffer, std::max<size_t>(asset.binSize, 1), asset.bin, 0);
+    if (!asset.generatedTangents.empty()) {
+        glCreateBuffers(1, &mesh->tangents);
+        glNamedBufferStorage(mesh->tangents, asset.generatedTangents.size() * sizeof(glm::vec4), asset.generatedTangents.data(), 0);
+    }
+
+    for (const GltfPrimitive& prim : asset.primitives) {
+        GlGltfPrimitive p {};
+        glCreateVertexArrays(1, &p.vao);
+        AttachAccessor(p.vao, GLTF_POSITION_LOCATION, mesh->buffer, prim.position);
+        AttachAccessor(p.vao, GLTF_NORMAL_LOCATION, mesh->buffer, prim.normal);
+        AttachAccessor(p.vao, GLTF_TANGENT_LOCATION, prim.generated ? mesh->tangents : mesh->buffer, prim.tangent);
+        if (prim.coord.count > 0) AttachAccessor(p.vao, GLTF_COORD_LOCATION, mesh->buffer, prim.coord);
+        if (prim.indices.count > 0) glVertexArrayElementBuffer(p.vao, mesh->buffer);
+        p.indexType = prim.indices.count > 0 ? prim.indices.componentType : 0;
+        p.count = (GLsizei) (prim.indices.count > 0 ? prim.indices.count : prim.position.count);
+        p.indexOffset = prim.indices.offset;
+        p.hasCoord = prim.coord.count > 0;
+        p.material = prim.material >= 0 ? (size_t) prim.material : asset.materials.size();
+        p.transform = prim.transform;
+        mesh->primitives.push_back(p);
+    }
+
+    // Images go through the cache like any other texture, in one batch, so
+    // they decode in parallel and an image shared with another asset is
+    // only decoded once.
+    std::vector<TextureRequest> requests(asset.images.size());
+    for (size_t i = 0; i < asset.images.size(); ++i) {
+        if (asset.images[i].size == 0) continue;
+        requests[i].data = asset.bin + asset.images[i].offset;
+        requests[i].size = asset.images[i].size;
+    }
+    std::vector<GLuint> imageTextures(asset.images.size(), 0);
+    TextureCache_Load(cache, imageTextures.data(), requests.data(), requests.size());
+
+    // glTF keeps roughness in G and metalness in B, as frag.glsl reads them.
+    GltfMaterial fallback {};
+    std::fill(fallback.images, fallback.images + MATERIAL_SLOTS, -1);
+    fallback.baseColor = glm::vec4(1.0f);
+    fallback.metallic = fallback.roughness = fallback.occlusion = 1.0f;
+    for (size_t m = 0; m <= asset.materials.size(); ++m) {
+        const GltfMaterial& mat = m < asset.materials.size() ? asset.materials[m] : fallback;
+        glm::vec4 flat[MATERIAL_SLOTS] = {
+            mat.baseColor,
+            glm::vec4(0.0f, mat.roughness, mat.metallic, 1.0f),
+            glm::vec4(0.0f, 0.0f, 1.0f, 1.0f),
+            glm::vec4(1.0f),
+            glm::vec4(mat.emissive, 1.0f),
+        };
+        GlMaterial gm;
+        for (int slot = 0; slot < MATERIAL_SLOTS; ++slot) {
+            int image = mat.images[slot];
+            gm.textures[slot] = image >= 0 ? imageTextures[image] : 0;
+            if (!gm.textures[slot]) gm.textures[slot] = TextureCache_Flat(cache, flat[slot]);
+        }
+        mesh->materials.push_back(gm);
+    }
+    return true;
+}
+
+void GlGltfMesh_Destroy(GlGltfMesh* mesh) {
+    for (const GlGltfPrimitive& p : mesh->primitives) glDeleteVertexArrays(1, &p.vao);
+    glDeleteBuffers(1, &mesh->buffer);
+    if (mesh->tangents) glDeleteBuffers(1, &mesh->tangents);
+    mesh->primitives.clear();
+    mesh->materials.clear();
+    mesh->buffer = mesh->tangents = 0;
+}
+
+void GlGltfMesh_Draw(const GlGltfMesh& mesh, GLuint program, const glm::mat4& mvp, const glm::mat4& model) {
+    GLint umvp = glGetUniformLocation(program, "u_mvp");
+    GLint um = glGetUniformLocation(program, "u_m");
+    for (const GlGltfPrimitive& p : mesh.primitives) {
+        BindGlMaterial(mesh.materials[p.material], 1);
+        glm::mat4 m = model * p.transform;
+        glm::mat4 pvm = mvp * p.transform;
+        glUniformMatrix4fv(umvp, 1, GL_FALSE, glm::value_ptr(pvm));
+        glUniformMatrix4fv(um, 1, GL_FALSE, glm::value_ptr(m));
+        // Without TEXCOORD_0 the coord location reads its current value.
+        if (!p.hasCoord) glVertexAttrib2f(GLTF_COORD_LOCATION, 0.0f, 0.0f);
+        glBindVertexArray(p.vao);
+        if (p.indexType) glDrawElements(GL_TRIANGLES, p.count, p.indexType, (void*) p.indexOffset);
+        else glDrawArrays(GL_TRIANGLES, 0, p.count);
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/mat4x4.hpp>
+
+#include "gltf_mesh.hpp"
+#include "texture_cache.hpp"
+
+struct GlGltfPrimitive {
+    GLuint    vao;
+    GLenum    indexType;    // 0: non-indexed
+    GLsizei   count;
+    size_t    indexOffset;  // bytes into GlGltfMesh::buffer
+    bool      hasCoord;
+    size_t    material;     // into GlGltfMesh::materials
+    glm::mat4 transform;
+};
+
+// A GltfAsset on the GPU. The whole BIN chunk is one immutable buffer,
+// uploaded from the mapping as it is stored; every accessor gets its own
+// vertex buffer binding into it, with the accessor's own component type, and
+// indices are drawn out of the same buffer. Only generated tangents live in
+// a buffer of their own.
+struct GlGltfMesh {
+    GLuint                       buffer;
+    GLuint                       tangents;      // 0 if the file had them all
+    std::vector<GlGltfPrimitive> primitives;
+    std::vector<GlMaterial>      materials;     // the last one stands in for material -1
+};
+
+// Uploads asset, and its embedded images through cache, which owns the
+// textures and must outlive the mesh. Slots without a texture get a flat
+// texture holding the material's factors, or, for the normal map, a flat
+// normal as frag.glsl reads it. Factors of textured slots are not applied;
+// frag.glsl has no uniforms for them.
+bool GlGltfMesh_Create(GlGltfMesh* mesh, const GltfAsset& asset, TextureCache* cache);
+void GlGltfMesh_Destroy(GlGltfMesh* mesh);
+
+// Draws every primitive with program, which must be the full-format
+// vert.glsl and frag.glsl, binding each material's textures to units 1 to 5
+// in MaterialSlot order and passing u_mvp and u_m with the primitive's
+// node transform applied.
+void GlGltfMesh_Draw(const GlGltfMesh& mesh, GLuint program, const glm::mat4& mvp, const glm::mat4& model);
@@ -0,0 +1,53 @@
+#include "gl_impostor.hpp"
+
+#include <algorithm>
+
+static GLuint UploadAtlas(const void* texels, GLenum internalFormat, GLenum format, GLenum type, GLsizei side, GLsizei levels) {
+    GLuint tex;
+    glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+    glTextureStorage2D(tex, levels, internalFormat, side, side);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTextureSubImage2D(tex, 0, 0, 0, side, side, format, type, texels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateTextureMipmap(tex);
+    glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(tex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return tex;
+}
+
+void GlImpostor_Create(GlImpostor* impostor, const ImpostorAtlas& atlas) {
+    GLsizei side = (GLsizei) (atlas.info.gridSize * atlas.info.frameSize);
+    GLsizei levels = 1;
+    while ((atlas.info.frameSize >> levels) >= 8) levels++;
+    impostor->info = atlas.info;
+    impostor->albedo = UploadAtlas(atlas.albedo, GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, side, levels);
+    impostor->normal = UploadAtlas(atlas.normal, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, side, levels);
+    impostor->material = UploadAtlas(atlas.material, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, side, levels);
+    impostor->depth = UploadAtlas(atlas.depth, GL_R16, GL_RED, GL_UNSIGNED_SHORT, side, levels);
+}
+
+void GlImpostor_Destroy(GlImpostor* impostor) {
+    GLuint textures[] = { impostor->albedo, impostor->normal, impostor->material, impostor->depth };
+    glDeleteTextures(4, textures);
+    *impostor = GlImpostor {};
+}
+
+void GlImpostor_Bind(const GlImpostor& impostor, GLuint program) {
+    GLuint textures[] = { impostor.albedo, impostor.normal, impostor.material, impostor.depth };
+    glBindTextures(1, 4, textures);
+    glUniform1i(glGetUniformLocation(program, "u_impostor_albedo"), 1);
+    glUniform1i(glGetUniformLocation(program, "u_impostor_normal"), 2);
+    glUniform1i(glGetUniformLocation(program, "u_impostor_material"), 3);
+    glUniform1i(glGetUniformLocation(program, "u_impostor_depth"), 4);
+    glUniform1i(glGetUniformLocation(program, "u_impostor_grid"), (GLint) impostor.info.gridSize);
+    glUniform3fv(glGetUniformLocation(program, "u_impostor_center"), 1, &impostor.info.center.x);
+    glUniform1f(glGetUniformLocation(program, "u_impostor_radius"), impostor.info.radius);
+}
+
+void GlImpostor_Draw(GLuint vao, GLuint first, GLuint count) {
+    if (count == 0) return;
+    glBindVertexArray(vao);
+    glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, (GLsizei) count, first);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "impostor.hpp"
+
+// An ImpostorAtlas on the GPU, drawn as one camera-facing quad per instance
+// by impostorvert.glsl and impostorfrag.glsl. The quads have no vertex
+// attributes, only the per-instance matrices at INSTANCE_LOCATION, so they
+// draw from the mesh's own VAO, with the same instance buffer and base
+// instances.
+struct GlImpostor {
+    GLuint       albedo;
+    GLuint       normal;
+    GLuint       material;
+    GLuint       depth;
+    ImpostorInfo info;
+};
+
+// Uploads the atlases with mips down to frames of 8 texels; below that,
+// neighbouring frames would bleed into each other.
+void GlImpostor_Create(GlImpostor* impostor, const ImpostorAtlas& atlas);
+void GlImpostor_Destroy(GlImpostor* impostor);
+
+// Binds the atlases to texture units 1 to 4 and sets the impostor uniforms
+// of program, which must be in use and built from impostorvert.glsl and
+// impostorfrag.glsl. u_vp and u_env are left to the caller. Draw then binds
+// vao, which needs nothing but the instance buffer, and takes count
+// instances from first.
+void GlImpostor_Bind(const GlImpostor& impostor, GLuint program);
+void GlImpostor_Draw(GLuint vao, GLuint first, GLuint count);
@@ -0,0 +1,270 @@
+#include "gl_mesh.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+#include "vertex_compact.hpp"
+#include "vertex_pull.hpp"
+
+static void UploadPositions(GlStaticMesh* mesh, const GlStaticMeshVert* verts, size_t numverts) {
+    std::vector<GlPositionVert> pos(numverts);
+    for (size_t i = 0; i < numverts; ++i) pos[i].pos = verts[i].pos;
+    GL_SetupVertexLayout(mesh->posVao, 0, mesh->posVbo, POSITION_VERT_LAYOUT);
+    glNamedBufferData(mesh->posVbo, numverts * sizeof(GlPositionVert), pos.data(), GL_STATIC_DRAW);
+}
+
+void LoadStaticMesh(
+        GlStaticMesh*           mesh,
+        const GlStaticMeshVert* verts,
+        size_t                  numverts,
+        const void*             indices,
+        size_t                  numindices,
+        GLenum                  indextype,
+        GlStaticMesh::Format    format,
+        bool                    positions) {
+    glCreateVertexArrays(1, &mesh->vao);
+    glCreateBuffers(1, &mesh->vbo);
+    glCreateBuffers(1, &mesh->ibo);
+    mesh->indexType = indextype;
+    mesh->format = format;
+    mesh->posOffset = glm::vec3 { 0.0f };
+    mesh->posScale = glm::vec3 { 1.0f };
+    mesh->posVao = 0;
+    mesh->posVbo = 0;
+    mesh->pullPositions = 0;
+    mesh->lightmapVbo = 0;
+    if (positions) {
+        glCreateVertexArrays(1, &mesh->posVao);
+        glCreateBuffers(1, &mesh->posVbo);
+        glVertexArrayElementBuffer(mesh->posVao, mesh->ibo);
+    }
+
+    switch (format) {
+        case GlStaticMesh::F_FULL: {
+            GL_SetupVertexLayout(mesh->vao, 0, mesh->vbo, FULL_VERT_LAYOUT);
+            glNamedBufferData(mesh->vbo, numverts * sizeof(GlStaticMeshVert), verts, GL_STATIC_DRAW);
+            if (positions) UploadPositions(mesh, verts, numverts);
+            break;
+        }
+        case GlStaticMesh::F_COMPACT: {
+            GL_SetupVertexLayout(mesh->vao, 0, mesh->vbo, COMPACT_VERT_LAYOUT);
+            CompactVertBounds bounds = ComputeCompactBounds(verts, numverts);
+            std::vector<GlCompactVert> packed(numverts);
+            PackCompactVerts(packed.data(), verts, numverts, bounds);
+            glNamedBufferData(mesh->vbo, numverts * sizeof(GlCompactVert), packed.data(), GL_STATIC_DRAW);
+            mesh->posOffset = bounds.offset;
+            mesh->posScale = bounds.scale;
+            if (positions) {
+                // The same quantized values, so both streams produce
+                // bit-identical depth.
+                std::vector<GlCompactPositionVert> pos(numverts);
+                for (size_t i = 0; i < numverts; ++i) memcpy(pos[i].pos, packed[i].pos, sizeof(packed[i].pos));
+                GL_SetupVertexLayout(mesh->posVao, 0, mesh->posVbo, COMPACT_POSITION_VERT_LAYOUT);
+                glNamedBufferData(mesh->posVbo, numverts * sizeof(GlCompactPositionVert), pos.data(), GL_STATIC_DRAW);
+            }
+            break;
+        }
+        case GlStaticMesh::F_PULLED: {
+            // Positions come out of the buffer exactly, so the position
+            // stream is the same as for F_FULL.
+            PulledVertices packed;
+            PackPulledVertices(&packed, verts, numverts);
+            size_t vertbytes = packed.verts.size() * sizeof(GlPulledVert);
+            size_t posbytes = packed.positions.size() * sizeof(glm::vec3);
+            glNamedBufferStorage(mesh->vbo, vertbytes + posbytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+            glNamedBufferSubData(mesh->vbo, 0, vertbytes, packed.verts.data());
+            glNamedBufferSubData(mesh->vbo, vertbytes, posbytes, packed.positions.data());
+            mesh->pullPositions = (GLuint) (vertbytes / sizeof(uint32_t));
+            if (positions) UploadPositions(mesh, verts, numverts);
+            break;
+        }
+    }
+
+    glNamedBufferData(mesh->ibo, numindices * GlIndexSize(indextype), indices, GL_STATIC_DRAW);
+    glVertexArrayElementBuffer(mesh->vao, mesh->ibo);
+}
+
+void GlStaticMesh_Bind(const GlStaticMesh& mesh, GLuint program) {
+    glBindVertexArray(mesh.vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+    glProgramUniform3fv(program, glGetUniformLocation(program, "u_pos_offset"), 1, &mesh.posOffset.x);
+    glProgramUniform3fv(program, glGetUniformLocation(program, "u_pos_scale"), 1, &mesh.posScale.x);
+    if (mesh.format == GlStaticMesh::F_PULLED) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PULLED_VERTS_BINDING, mesh.vbo);
+        glProgramUniform1ui(program, glGetUniformLocation(program, "u_pull_positions"), mesh.pullPositions);
+    }
+}
+
+size_t GlStaticMesh_VertexSize(const GlStaticMesh& mesh) {
+    switch (mesh.format) {
+        case GlStaticMesh::F_COMPACT: return sizeof(GlCompactVert);
+        case GlStaticMesh::F_PULLED:  return sizeof(GlPulledVert);
+        default:                      return sizeof(GlStaticMeshVert);
+    }
+}
+
+size_t GlStaticMesh_PositionSize(const GlStaticMesh& mesh) {
+    return mesh.format == GlStaticMesh::F_COMPACT ? sizeof(GlCompactPositionVert) : sizeof(GlPositionVert);
+}
+
+std::string GlStaticMesh_VertexInputs(GlStaticMesh::Format format) {
+    switch (format) {
+        case GlStaticMesh::F_COMPACT: return VertexLayoutGlsl(COMPACT_VERT_LAYOUT);
+        case GlStaticMesh::F_PULLED:  return std::string();
+        default:                      return VertexLayoutGlsl(FULL_VERT_LAYOUT);
+    }
+}
+
+std::string GlStaticMesh_PositionInputs(GlStaticMesh::Format format) {
+    return VertexLayoutGlsl(format == GlStaticMesh::F_COMPACT ? COMPACT_POSITION_VERT_LAYOUT : POSITION_VERT_LAYOUT);
+}
+
+void GL_SetInstanceBuffer(GLuint vao, GLuint buffer) {
+    for (GLuint c = 0; c < 4; ++c) {
+        glEnableVertexArrayAttrib(vao, INSTANCE_LOCATION + c);
+        glVertexArrayAttribFormat(vao, INSTANCE_LOCATION + c, 4, GL_FLOAT, GL_FALSE, c * sizeof(glm::vec4));
+        glVertexArrayAttribBinding(vao, INSTANCE_LOCATION + c, INSTANCE_BINDING);
+    }
+    glVertexArrayVertexBuffer(vao, INSTANCE_BINDING, buffer, 0, sizeof(glm::mat4));
+    glVertexArrayBindingDivisor(vao, INSTANCE_BINDING, 1);
+}
+
+void GlStaticMesh_SetInstanceBuffer(GlStaticMesh* mesh, GLuint buffer) {
+    GL_SetInstanceBuffer(mesh->vao, buffer);
+    if (mesh->posVao) GL_SetInstanceBuffer(mesh->posVao, buffer);
+}
+
+void* GlStaticMesh_CreateStreamPool(GlStaticMesh* mesh, size_t size) {
+    glCreateVertexArrays(1, &mesh->vao);
+    glCreateBuffers(1, &mesh->vbo);
+    mesh->ibo = mesh->vbo;
+    mesh->indexType = GL_UNSIGNED_SHORT;
+    mesh->format = GlStaticMesh::F_FULL;
+    mesh->posOffset = glm::vec3 { 0.0f };
+    mesh->posScale = glm::vec3 { 1.0f };
+    mesh->posVao = 0;
+    mesh->posVbo = 0;
+    mesh->pullPositions = 0;
+    mesh->lightmapVbo = 0;
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glNamedBufferStorage(mesh->vbo, size, nullptr, flags);
+    GL_SetupVertexLayout(mesh->vao, 0, mesh->vbo, FULL_VERT_LAYOUT);
+    glVertexArrayElementBuffer(mesh->vao, mesh->vbo);
+    return glMapNamedBufferRange(mesh->vbo, 0, size, flags);
+}
+
+void GlStaticMesh_SetLightmapCoords(GlStaticMesh* mesh, const glm::vec2* coords, size_t numverts) {
+    if (!mesh->lightmapVbo) glCreateBuffers(1, &mesh->lightmapVbo);
+    glNamedBufferData(mesh->lightmapVbo, numverts * sizeof(GlLightmapVert), coords, GL_STATIC_DRAW);
+    GL_SetupVertexLayout(mesh->vao, LIGHTMAP_BINDING, mesh->lightmapVbo, LIGHTMAP_LAYOUT);
+}
+
+GlStaticMeshVert* GlStaticMesh_CreateMapped(GlStaticMesh* mesh, size_t numverts, const GLuint* indices, size_t numindices) {
+    glCreateVertexArrays(1, &mesh->vao);
+    glCreateBuffers(1, &mesh->vbo);
+    glCreateBuffers(1, &mesh->ibo);
+    mesh->indexType = GL_UNSIGNED_INT;
+    mesh->format = GlStaticMesh::F_FULL;
+    mesh->posOffset = glm::vec3 { 0.0f };
+    mesh->posScale = glm::vec3 { 1.0f };
+    mesh->posVao = 0;
+    mesh->posVbo = 0;
+    mesh->pullPositions = 0;
+    mesh->lightmapVbo = 0;
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    size_t size = numverts * sizeof(GlStaticMeshVert);
+    glNamedBufferStorage(mesh->vbo, size, nullptr, flags);
+    GL_SetupVertexLayout(mesh->vao, 0, mesh->vbo, FULL_VERT_LAYOUT);
+    glNamedBufferData(mesh->ibo, numindices * sizeof(GLuint), indices, GL_STATIC_DRAW);
+    glVertexArrayElementBuffer(mesh->vao, mesh->ibo);
+    return (GlStaticMeshVert*) glMapNamedBufferRange(mesh->vbo, 0, size, flags);
+}
+
+static void DrawSubmeshes(const GlStaticMesh& mesh, const StaticSubmesh* submeshes, size_t numsubmeshes) {
+    size_t indexsize = GlIndexSize(mesh.indexType);
+    for (size_t i = 0; i < numsubmeshes; ++i) {
+        const StaticSubmesh& sub = submeshes[i];
+        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei) sub.numIndices, mesh.indexType,
+                                 (void*) (sub.firstIndex * indexsize), sub.baseVertex);
+    }
+}
+
+// GPU milliseconds per pass of drawing every submesh, with whatever VAO,
+// program and buffers are bound, after one untimed pass so nothing pays
+// for first use.
+static double TimePasses(const GlStaticMesh& mesh, const StaticSubmesh* submeshes, size_t numsubmeshes, int passes) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    DrawSubmeshes(mesh, submeshes, numsubmeshes);
+    glFinish();
+
+    GLuint query;
+    glCreateQueries(GL_TIME_ELAPSED, 1, &query);
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    for (int i = 0; i < passes; ++i) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        DrawSubmeshes(mesh, submeshes, numsubmeshes);
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+    glDeleteQueries(1, &query);
+    return ns * 1e-6 / passes;
+}
+
+void BenchmarkDepthPass(const GlStaticMesh& mesh, const StaticSubmesh* submeshes, size_t numsubmeshes, size_t numverts,
+                        GLuint program, int passes) {
+    if (!mesh.posVao || mesh.format == GlStaticMesh::F_PULLED) {
+        printf("depth pass benchmark: needs a vertex attribute format with a position stream\n");
+        return;
+    }
+    glUseProgram(program);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    const GLuint vaos[] = { mesh.vao, mesh.posVao };
+    const size_t strides[] = { GlStaticMesh_VertexSize(mesh), GlStaticMesh_PositionSize(mesh) };
+    const char* names[] = { "full", "position-only" };
+    double ms[2];
+    for (int v = 0; v < 2; ++v) {
+        glBindVertexArray(vaos[v]);
+        ms[v] = TimePasses(mesh, submeshes, numsubmeshes, passes);
+        printf("depth pass, %s stream: %zu bytes/vert, %.2f MB fetched, %.3f ms/pass\n",
+               names[v], strides[v], numverts * strides[v] / (1024.0 * 1024.0), ms[v]);
+    }
+    size_t tris = 0;
+    for (size_t i = 0; i < numsubmeshes; ++i) tris += submeshes[i].numIndices / 3;
+    printf("depth pass: %.2fx less vertex data, %.2fx faster over %d passes of %zu tris\n",
+           (double) strides[0] / strides[1], ms[0] / ms[1], passes, tris);
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glBindVertexArray(0);
+}
+
+void BenchmarkVertexFormats(const GlStaticMesh* meshes, const GLuint* programs, size_t count, const StaticSubmesh* submeshes,
+                            size_t numsubmeshes, int passes) {
+    static const char* FORMAT_NAMES[] = { "full", "compact", "pulled" };
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glViewport(0, 0, 64, 36);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+
+    size_t tris = 0;
+    for (size_t i = 0; i < numsubmeshes; ++i) tris += submeshes[i].numIndices / 3;
+    double first = 0.0;
+    for (size_t m = 0; m < count; ++m) {
+        glUseProgram(programs[m]);
+        GlStaticMesh_Bind(meshes[m], programs[m]);
+        double ms = TimePasses(meshes[m], submeshes, numsubmeshes, passes);
+        if (m == 0) first = ms;
+        printf("%s vertices: %zu bytes/vert, %.3f ms/pass, %.1f Mtris/s, %.2fx the first\n", FORMAT_NAMES[meshes[m].format],
+               GlStaticMesh_VertexSize(meshes[m]), ms, tris / (ms * 1e3), ms / first);
+    }
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <GL/glew.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "skeletal_mesh.hpp"
+#include "static_mesh.hpp"
+#include "vertex_compact.hpp"
+#include "vertex_layout.hpp"
+
+struct GlStaticMesh {
+    enum Format {
+        F_FULL,     // GlStaticMeshVert, 48 bytes
+        F_COMPACT,  // GlCompactVert, 16 bytes; needs COMPACT_VERTS in vert.glsl
+        F_PULLED,   // GlPulledVert, 16 bytes + shared positions; needs PULLED_VERTS
+    };
+
+    GLuint vao;
+    GLuint vbo;
+    GLuint ibo;
+
+    // Optional position-only stream for depth-only passes, 0 unless loaded
+    // with positions: GlPositionVert (12 bytes) for F_FULL and F_PULLED,
+    // GlCompactPositionVert (8 bytes) for F_COMPACT, at location 0 like the
+    // full stream and drawn with the same ibo, which posVao already has bound.
+    GLuint posVao;
+    GLuint posVbo;
+
+    GLenum indexType;   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    Format format;
+
+    // F_COMPACT positions are unorm16 in the mesh bounds; pass these as
+    // u_pos_offset/u_pos_scale to undo the quantization.
+    glm::vec3 posOffset;
+    glm::vec3 posScale;
+
+    // F_PULLED keeps vbo as a shader storage buffer: the GlPulledVert
+    // records, then the float xyz position stream starting this many uints
+    // in. vao has no vertex attributes, only the instance matrix if set.
+    GLuint pullPositions;
+
+    // Optional lightmap coordinates, 0 unless set with
+    // GlStaticMesh_SetLightmapCoords; any format, read through vao only.
+    GLuint lightmapVbo;
+};
+
+void LoadStaticMesh(
+        GlStaticMesh*           mesh,
+        const GlStaticMeshVert* verts,
+        size_t                  numverts,
+        const void*             indices,
+        size_t                  numindices,
+        GLenum                  indextype,
+        GlStaticMesh::Format    format = GlStaticMesh::F_FULL,
+        bool                    positions = false);
+
+// Binds mesh for drawing with program: its VAO and index buffer, the
+// storage buffer of an F_PULLED mesh, and the uniforms vert.glsl needs to
+// decode the format.
+static constexpr GLuint PULLED_VERTS_BINDING = 1;
+void GlStaticMesh_Bind(const GlStaticMesh& mesh, GLuint program);
+
+// Bytes per vertex of mesh's full and position-only streams.
+size_t GlStaticMesh_VertexSize(const GlStaticMesh& mesh);
+size_t GlStaticMesh_PositionSize(const GlStaticMesh& mesh);
+
+// Per-instance model matrix read by the INSTANCED variant of vert.glsl. The
+// mat4 takes four locations starting at INSTANCE_LOCATION and advances once
+// per instance, so instanced draws pick their range with a base instance.
+static constexpr GLuint INSTANCE_LOCATION = 5;
+static constexpr GLuint INSTANCE_BINDING  = 5;
+void GlStaticMesh_SetInstanceBuffer(GlStaticMesh* mesh, GLuint buffer);
+// The same for any VAO, e.g. one whose vertices come from gl_VertexID.
+void GL_SetInstanceBuffer(GLuint vao, GLuint buffer);
+
+// One persistently mapped, coherent buffer of size bytes serving as both the
+// vertex (F_FULL) and the element buffer of mesh, for MeshStreamer slots.
+// Returns the mapping, which loader threads may write at any time; draws pick
+// their slot with byte offsets and base vertices.
+void* GlStaticMesh_CreateStreamPool(GlStaticMesh* mesh, size_t size);
+
+// SkinWeights read by the SKINNED variant of vert.glsl, after the instance
+// matrix's locations, and the shader storage binding of its bone palette.
+static constexpr GLuint SKIN_JOINTS_LOCATION  = 9;
+static constexpr GLuint SKIN_WEIGHTS_LOCATION = 10;
+static constexpr GLuint SKIN_BINDING          = 6;
+static constexpr GLuint SKIN_PALETTE_BINDING  = 0;
+
+// Lightmap coordinates read by the LIGHTMAP_COORDS variant of vert.glsl, in
+// a stream of their own so the vertex formats stay as they are, one per
+// vertex of the mesh.
+static constexpr GLuint LIGHTMAP_LOCATION = 3;
+static constexpr GLuint LIGHTMAP_BINDING  = 7;
+struct GlLightmapVert {
+    glm::vec2 lightmapCoord;
+};
+void GlStaticMesh_SetLightmapCoords(GlStaticMesh* mesh, const glm::vec2* coords, size_t numverts);
+
+// Vertex layouts of the formats above. Locations are shared between
+// formats so frag.glsl and the instance and skin streams stay the same.
+// Location 3 used to hold the bitangent; vert.glsl now derives it from the
+// tangent sign, and the lightmap stream has it.
+static constexpr auto FULL_VERT_LAYOUT = MakeVertexLayout<GlStaticMeshVert>(
+    VERTEX_ATTRIB(GlStaticMeshVert, pos,   0, VA_FLOAT),
+    VERTEX_ATTRIB(GlStaticMeshVert, norm,  1, VA_FLOAT),
+    VERTEX_ATTRIB(GlStaticMeshVert, tang,  2, VA_FLOAT),  // w: bitangent sign
+    VERTEX_ATTRIB(GlStaticMeshVert, coord, 4, VA_FLOAT));
+// vert.glsl derives normal, tangent and bitangent from the packed frame.
+// Every member is read as something other than its C++ type: pos leaves
+// its padding w out, frame is a bit field and coord holds half floats.
+static constexpr auto COMPACT_VERT_LAYOUT = MakeVertexLayout<GlCompactVert>(
+    VERTEX_ATTRIB_AS(GlCompactVert, pos,   0, 3, GL_UNSIGNED_SHORT, VA_NORMALIZED),
+    VERTEX_ATTRIB_AS(GlCompactVert, frame, 1, 1, GL_UNSIGNED_INT,   VA_INTEGER),
+    VERTEX_ATTRIB_AS(GlCompactVert, coord, 4, 2, GL_HALF_FLOAT,     VA_FLOAT));
+
+// The posVao streams, read by depthvert.glsl.
+struct GlPositionVert {
+    glm::vec3 pos;
+};
+struct GlCompactPositionVert {
+    uint16_t pos[4];    // GlCompactVert::pos
+};
+static constexpr auto POSITION_VERT_LAYOUT = MakeVertexLayout<GlPositionVert>(
+    VERTEX_ATTRIB(GlPositionVert, pos, 0, VA_FLOAT));
+static constexpr auto COMPACT_POSITION_VERT_LAYOUT = MakeVertexLayout<GlCompactPositionVert>(
+    VERTEX_ATTRIB_AS(GlCompactPositionVert, pos, 0, 3, GL_UNSIGNED_SHORT, VA_NORMALIZED));
+
+static constexpr auto LIGHTMAP_LAYOUT = MakeVertexLayout<GlLightmapVert>(
+    VERTEX_ATTRIB(GlLightmapVert, lightmapCoord, LIGHTMAP_LOCATION, VA_FLOAT));
+
+static constexpr auto SKIN_LAYOUT = MakeVertexLayout<SkinWeights>(
+    VERTEX_ATTRIB(SkinWeights, joints,  SKIN_JOINTS_LOCATION,  VA_INTEGER),
+    VERTEX_ATTRIB(SkinWeights, weights, SKIN_WEIGHTS_LOCATION, VA_NORMALIZED));
+
+static_assert(VertexLayoutValid(FULL_VERT_LAYOUT), "FULL_VERT_LAYOUT does not fit GlStaticMeshVert");
+static_assert(VertexLayoutValid(COMPACT_VERT_LAYOUT), "COMPACT_VERT_LAYOUT does not fit GlCompactVert");
+static_assert(VertexLayoutValid(POSITION_VERT_LAYOUT), "POSITION_VERT_LAYOUT does not fit GlPositionVert");
+static_assert(VertexLayoutValid(COMPACT_POSITION_VERT_LAYOUT), "COMPACT_POSITION_VERT_LAYOUT does not fit GlCompactPositionVert");
+static_assert(VertexLayoutValid(SKIN_LAYOUT), "SKIN_LAYOUT does not fit SkinWeights");
+static_assert(VertexLayoutValid(LIGHTMAP_LAYOUT), "LIGHTMAP_LAYOUT does not fit GlLightmapVert");
+// A member added to a vertex struct has to be read, or dropped again.
+static_assert(VertexLayoutBytesRead(FULL_VERT_LAYOUT) == sizeof(GlStaticMeshVert), "GlStaticMeshVert has unread members");
+static_assert(VertexLayoutBytesRead(COMPACT_VERT_LAYOUT) == sizeof(GlCompactVert) - sizeof(uint16_t),
+              "GlCompactVert has unread members besides the position's w");
+static_assert(VertexLayoutBytesRead(SKIN_LAYOUT) == sizeof(SkinWeights), "SkinWeights has unread members");
+static_assert(VertexLayoutBytesRead(LIGHTMAP_LAYOUT) == sizeof(GlLightmapVert) && sizeof(GlLightmapVert) == sizeof(glm::vec2),
+              "GlLightmapVert must be a bare vec2, the layout of StaticMesh::lightmapCoords");
+// Depth-only passes must see the same positions as the full formats.
+static_assert(sizeof(GlCompactPositionVert::pos) == sizeof(GlCompactVert::pos), "compact position streams disagree");
+static_assert(FULL_VERT_LAYOUT.attribs[0].location == POSITION_VERT_LAYOUT.attribs[0].location
+              && COMPACT_VERT_LAYOUT.attribs[0].location == COMPACT_POSITION_VERT_LAYOUT.attribs[0].location,
+              "position streams must keep the position's location");
+static_assert(!VertexLayoutUsesLocations(FULL_VERT_LAYOUT, INSTANCE_LOCATION, 4)
+              && !VertexLayoutUsesLocations(COMPACT_VERT_LAYOUT, INSTANCE_LOCATION, 4)
+              && !VertexLayoutUsesLocations(SKIN_LAYOUT, INSTANCE_LOCATION, 4)
+              && !VertexLayoutUsesLocations(FULL_VERT_LAYOUT, SKIN_JOINTS_LOCATION, 1)
+              && !VertexLayoutUsesLocations(FULL_VERT_LAYOUT, SKIN_WEIGHTS_LOCATION, 1)
+              && !VertexLayoutUsesLocations(FULL_VERT_LAYOUT, LIGHTMAP_LOCATION, 1)
+              && !VertexLayoutUsesLocations(COMPACT_VERT_LAYOUT, LIGHTMAP_LOCATION, 1)
+              && !VertexLayoutUsesLocations(SKIN_LAYOUT, LIGHTMAP_LOCATION, 1)
+              && !VertexLayoutUsesLocations(LIGHTMAP_LAYOUT, INSTANCE_LOCATION, 4),
+              "vertex, instance, skin and lightmap locations overlap");
+
+// The vert.glsl and depthvert.glsl input declarations for format, generated
+// from the layouts above; empty for F_PULLED, which has no attributes.
+std::string GlStaticMesh_VertexInputs(GlStaticMesh::Format format);
+std::string GlStaticMesh_PositionInputs(GlStaticMesh::Format format);
+
+// An F_FULL mesh whose vertex buffer is persistently mapped and coherent, for
+// vertices the CPU rewrites every frame, with 32-bit indices uploaded once.
+// Returns the mapping of numverts vertices.
+GlStaticMeshVert* GlStaticMesh_CreateMapped(GlStaticMesh* mesh, size_t numverts, const GLuint* indices, size_t numindices);
+
+// Draws every submesh of mesh depth-only with program, which has to read
+// nothing but location 0 (shaders/depthvert.glsl) and have its uniforms
+// set, passes times through the full VAO and then through posVao, and
+// prints GPU time and vertex bytes fetched for each. Only the vertex stream
+// differs between the two, so the difference is what fetching the rest of
+// the vertex costs.
+void BenchmarkDepthPass(const GlStaticMesh& mesh, const StaticSubmesh* submeshes, size_t numsubmeshes, size_t numverts,
+                        GLuint program, int passes);
+
+// Draws every submesh of each of meshes[i] with programs[i], passes times,
+// into a small viewport so vertex work dominates, and prints GPU time per
+// pass for each, for comparing vertex formats on the same geometry.
+void BenchmarkVertexFormats(const GlStaticMesh* meshes, const GLuint* programs, size_t count, const StaticSubmesh* submeshes,
+                            size_t numsubmeshes, int passes);
+
+// Layout of one glMultiDrawElementsIndirect command.
+struct GlDrawElementsIndirect {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+static inline size_t GlIndexSize(GLenum type) {
+    return type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
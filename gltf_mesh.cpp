@@ -0,0 +1,638 @@
+#include "gltf_mesh.hpp"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+#include <glm/geometric.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "pack_file.hpp"
+#include "static_mesh.hpp"
+
+// Just enough JSON for glTF: a DOM of the whole chunk. Strings are views
+// into the chunk with escapes left in; glTF keys never have any, and the
+// only other strings read here are compared against plain ASCII.
+struct JsonValue {
+    enum Type : uint8_t { J_NULL, J_BOOL, J_NUMBER, J_STRING, J_ARRAY, J_OBJECT };
+
+    Type                          type = J_NULL;
+    double                        number = 0.0;
+    std::string_view              string;
+    std::vector<JsonValue>        items;    // array elements or object values
+    std::vector<std::string_view> keys;     // object keys, one per item
+};
+
+static const int JSON_MAX_DEPTH = 64;
+
+struct JsonParser {
+    const char* p;
+    const char* end;
+};
+
+static void SkipSpace(JsonParser* js) {
+    while (js->p < js->end && (*js->p == ' ' || *js->p == '\t' || *js->p == '\n' || *js->p == '\r')) js->p++;
+}
+
+static bool ParseString(JsonParser* js, std::string_view* out) {
+    const char* begin = ++js->p;
+    while (js->p < js->end && *js->p != '"') {
+        if (*js->p == '\\') js->p++;
+        js->p++;
+    }
+    if (js->p >= js->end) return false;
+    *out = std::string_view(begin, js->p - begin);
+    js->p++;
+    return true;
+}
+
+static bool ParseValue(JsonParser* js, JsonValue* v, int depth) {
+    SkipSpace(js);
+    if (js->p >= js->end || depth > JSON_MAX_DEPTH) return false;
+    char c = *js->p;
+    if (c == '{' || c == '[') {
+        bool object = c == '{';
+        char close = object ? '}' : ']';
+        v->type = object ? JsonValue::J_OBJECT : JsonValue::J_ARRAY;
+        js->p++;
+        SkipSpace(js);
+        if (js->p < js->end && *js->p == close) {
+            js->p++;
+            return true;
+        }
+        for (;;) {
+            if (object) {
+                SkipSpace(js);
+                std::string_view key;
+                if (js->p >= js->end || *js->p != '"' || !ParseString(js, &key)) return false;
+                SkipSpace(js);
+                if (js->p >= js->end || *js->p != ':') return false;
+                js->p++;
+                v->keys.push_back(key);
+            }
+            v->items.emplace_back();
+            if (!ParseValue(js, &v->items.back(), depth + 1)) return false;
+            SkipSpace(js);
+            if (js->p >= js->end) return false;
+            if (*js->p == close) {
+                js->p++;
+                return true;
+            }
+            if (*js->p != ',') return false;
+            js->p++;
+        }
+    }
+    if (c == '"') {
+        v->type = JsonValue::J_STRING;
+        return ParseString(js, &v->string);
+    }
+    static const struct { const char* word; JsonValue::Type type; double number; } words[] = {
+        { "true", JsonValue::J_BOOL, 1.0 }, { "false", JsonValue::J_BOOL, 0.0 }, { "null", JsonValue::J_NULL, 0.0 },
+    };
+    for (const auto& w : words) {
+        size_t len = strlen(w.word);
+        if ((size_t) (js->end - js->p) >= len && memcmp(js->p, w.word, len) == 0) {
+            v->type = w.type;
+            v->number = w.number;
+            js->p += len;
+            return true;
+        }
+    }
+
+    // The chunk is not NUL-terminated, so numbers are copied out for strtod.
+    char buf[64];
+    size_t len = 0;
+    while (js->p + len < js->end && len < sizeof(buf) - 1 && strchr("+-0123456789.eE", js->p[len])) len++;
+    if (len == 0) return false;
+    memcpy(buf, js->p, len);
+    buf[len] = 0;
+    char* stop;
+    v->type = JsonValue::J_NUMBER;
+    v->number = strtod(buf, &stop);
+    js->p += len;
+    return stop == buf + len;
+}
+
+static const JsonValue* Json_Member(const JsonValue* v, std::string_view key) {
+    if (!v || v->type != JsonValue::J_OBJECT) return nullptr;
+    for (size_t i = 0; i < v->keys.size(); ++i) {
+        if (v->keys[i] == key) return &v->items[i];
+    }
+    return nullptr;
+}
+
+static const JsonValue* Json_Item(const JsonValue* v, size_t i) {
+    if (!v || v->type != JsonValue::J_ARRAY || i >= v->items.size()) return nullptr;
+    return &v->items[i];
+}
+
+static size_t Json_Size(const JsonValue* v) {
+    return v && v->type == JsonValue::J_ARRAY ? v->items.size() : 0;
+}
+
+static double Json_Number(const JsonValue* v, double fallback) {
+    return v && (v->type == JsonValue::J_NUMBER || v->type == JsonValue::J_BOOL) ? v->number : fallback;
+}
+
+// Out-of-range values, which would be undefined to convert, give fallback.
+static int Json_Int(const JsonValue* v, int fallback) {
+    double d = Json_Number(v, fallback);
+    return d >= INT_MIN && d <= INT_MAX ? (int) d : fallback;
+}
+
+// A count, offset or length: fallback if v is absent, false unless it is a
+// non-negative integer that a size_t holds exactly.
+static bool Json_Unsigned(const JsonValue* v, size_t fallback, size_t* out) {
+    if (!v) {
+        *out = fallback;
+        return true;
+    }
+    if (v->type != JsonValue::J_NUMBER) return false;
+    double d = v->number;
+    if (!(d >= 0.0 && d <= 9007199254740992.0 && d <= (double) SIZE_MAX && d == floor(d))) return false;
+    *out = (size_t) d;
+    return true;
+}
+
+// Reads up to n numbers of an array into out, leaving the rest untouched.
+static void Json_Floats(const JsonValue* v, float* out, size_t n) {
+    for (size_t i = 0; i < std::min(n, Json_Size(v)); ++i) out[i] = (float) Json_Number(&v->items[i], out[i]);
+}
+
+static size_t ComponentSize(GLenum type) {
+    switch (type) {
+        case GL_BYTE: case GL_UNSIGNED_BYTE:   return 1;
+        case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT: case GL_FLOAT:   return 4;
+    }
+    return 0;
+}
+
+static GLint ComponentCount(std::string_view type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    return 0;
+}
+
+struct GltfDocument {
+    JsonValue        root;
+    const JsonValue* accessors;
+    const JsonValue* bufferViews;
+    const char*      path;
+    size_t           binSize;
+};
+
+// glTF componentType values are the GL enums, so they go to
+// glVertexArrayAttribFormat unchanged.
+static bool ResolveAccessor(GltfAccessor* out, const GltfDocument& doc, int index) {
+    const JsonValue* acc = Json_Item(doc.accessors, index);
+    if (!acc) {
+        printf("%s: no accessor %d\n", doc.path, index);
+        return false;
+    }
+    if (Json_Member(acc, "sparse")) {
+        printf("%s: accessor %d is sparse, which is not supported\n", doc.path, index);
+        return false;
+    }
+    const JsonValue* view = Json_Item(doc.bufferViews, Json_Int(Json_Member(acc, "bufferView"), -1));
+    if (!view || Json_Int(Json_Member(view, "buffer"), -1) != 0) {
+        printf("%s: accessor %d is not in the BIN chunk\n", doc.path, index);
+        return false;
+    }
+    const JsonValue* type = Json_Member(acc, "type");
+    out->componentType = (GLenum) Json_Int(Json_Member(acc, "componentType"), 0);
+    out->components = type ? ComponentCount(type->string) : 0;
+    out->normalized = Json_Number(Json_Member(acc, "normalized"), 0.0) != 0.0 ? GL_TRUE : GL_FALSE;
+    size_t element = ComponentSize(out->componentType) * out->components;
+    size_t viewOffset = 0, viewLength = 0, offset = 0;
+    // Every bound is checked by subtracting from what is known to fit, so
+    // no sum or product of file values can wrap.
+    bool ok = Json_Unsigned(Json_Member(acc, "count"), 0, &out->count)
+           && Json_Unsigned(Json_Member(view, "byteOffset"), 0, &viewOffset)
+           && Json_Unsigned(Json_Member(view, "byteLength"), 0, &viewLength)
+           && Json_Unsigned(Json_Member(acc, "byteOffset"), 0, &offset)
+           && Json_Unsigned(Json_Member(view, "byteStride"), element, &out->stride)
+           && element > 0 && out->stride >= element
+           && viewOffset <= doc.binSize && viewLength <= doc.binSize - viewOffset;
+    if (ok && out->count > 0) {
+        ok = offset <= viewLength && element <= viewLength - offset
+          && out->count - 1 <= (viewLength - offset - element) / out->stride;
+    }
+    if (!ok) {
+        printf("%s: accessor %d is malformed or out of bounds\n", doc.path, index);
+        return false;
+    }
+    out->offset = viewOffset + offset;
+    return true;
+}
+
+static glm::vec4 ReadAccessor(const uint8_t* bin, const GltfAccessor& a, size_t i) {
+    glm::vec4 v { 0.0f, 0.0f, 0.0f, 1.0f };
+    const uint8_t* p = bin + a.offset + i * a.stride;
+    for (GLint c = 0; c < a.components; ++c) {
+        switch (a.componentType) {
+            case GL_FLOAT:          { float f; memcpy(&f, p + c * 4, 4); v[c] = f; break; }
+            case GL_UNSIGNED_INT:   { uint32_t u; memcpy(&u, p + c * 4, 4); v[c] = (float) u; break; }
+            case GL_UNSIGNED_SHORT: { uint16_t u; memcpy(&u, p + c * 2, 2); v[c] = a.normalized ? u / 65535.0f : u; break; }
+            case GL_SHORT:          { int16_t s; memcpy(&s, p + c * 2, 2); v[c] = a.normalized ? std::max(s / 32767.0f, -1.0f) : s; break; }
+            case GL_UNSIGNED_BYTE:  { uint8_t u = p[c]; v[c] = a.normalized ? u / 255.0f : u; break; }
+            case GL_BYTE:           { int8_t s = (int8_t) p[c]; v[c] = a.normalized ? std::max(s / 127.0f, -1.0f) : s; break; }
+        }
+    }
+    return v;
+}
+
+static GLuint ReadIndex(const uint8_t* bin, const GltfAccessor& a, size_t i) {
+    if (a.count == 0) return (GLuint) i;
+    const uint8_t* p = bin + a.offset + i * a.stride;
+    switch (a.componentType) {
+        case GL_UNSIGNED_BYTE:  return *p;
+        case GL_UNSIGNED_SHORT: { uint16_t u; memcpy(&u, p, 2); return u; }
+        default:                { uint32_t u; memcpy(&u, p, 4); return u; }
+    }
+}
+
+static inline bool NotZero(float v) {
+    return fabsf(v) > FLT_MIN;
+}
+
+// Per-triangle tangents from the uv derivatives, projected into each
+// corner's normal plane and summed weighted by the corner angle, as
+// GenerateTangents does. Each vertex takes the bitangent sign most of its
+// area agrees on; without welding or splitting there is nothing better to do
+// with vertices on mirrored seams.
+static void GeneratePrimitiveTangents(glm::vec4* out, const uint8_t* bin, const GltfPrimitive& prim) {
+    size_t numverts = prim.position.count;
+    size_t numindices = prim.indices.count ? prim.indices.count : numverts;
+    std::vector<glm::vec3> sums(numverts, glm::vec3(0.0f));
+    std::vector<float> signs(numverts, 0.0f);
+    for (size_t t = 0; t + 2 < numindices; t += 3) {
+        GLuint i[3] = { ReadIndex(bin, prim.indices, t), ReadIndex(bin, prim.indices, t + 1), ReadIndex(bin, prim.indices, t + 2) };
+        if (i[0] >= numverts || i[1] >= numverts || i[2] >= numverts) continue;
+        glm::vec3 p[3];
+        glm::vec2 uv[3];
+        for (int k = 0; k < 3; ++k) {
+            p[k] = glm::vec3(ReadAccessor(bin, prim.position, i[k]));
+            uv[k] = glm::vec2(ReadAccessor(bin, prim.coord, i[k]));
+        }
+        glm::vec3 d1 = p[1] - p[0], d2 = p[2] - p[0];
+        glm::vec2 t21 = uv[1] - uv[0], t31 = uv[2] - uv[0];
+        float area = t21.x * t31.y - t21.y * t31.x;
+        glm::vec3 os = t31.y * d1 - t21.y * d2;
+        if (!NotZero(area) || !NotZero(glm::length(os))) continue;
+        os = glm::normalize(os) * (area > 0.0f ? 1.0f : -1.0f);
+        for (int k = 0; k < 3; ++k) {
+            glm::vec3 n = glm::vec3(ReadAccessor(bin, prim.normal, i[k]));
+            glm::vec3 e1 = p[(k + 1) % 3] - p[k], e2 = p[(k + 2) % 3] - p[k];
+            float l1 = glm::length(e1), l2 = glm::length(e2);
+            if (!NotZero(l1) || !NotZero(l2)) continue;
+            float angle = acosf(glm::clamp(glm::dot(e1, e2) / (l1 * l2), -1.0f, 1.0f));
+            glm::vec3 proj = os - n * glm::dot(n, os);
+            float len = glm::length(proj);
+            if (NotZero(len)) sums[i[k]] += proj * (angle / len);
+            signs[i[k]] += area > 0.0f ? angle : -angle;
+        }
+    }
+    for (size_t v = 0; v < numverts; ++v) {
+        glm::vec3 n = glm::vec3(ReadAccessor(bin, prim.normal, v));
+        glm::vec3 t = sums[v];
+        if (!NotZero(glm::length(t))) {
+            // No usable uv around this vertex: any tangent in its plane.
+            glm::vec3 axis = fabsf(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            t = axis - n * glm::dot(n, axis);
+        }
+        out[v] = glm::vec4(glm::normalize(t), signs[v] < 0.0f ? -1.0f : 1.0f);
+    }
+}
+
+static glm::mat4 NodeTransform(const JsonValue* node) {
+    const JsonValue* matrix = Json_Member(node, "matrix");
+    if (Json_Size(matrix) == 16) {
+        glm::mat4 m(1.0f);
+        Json_Floats(matrix, glm::value_ptr(m), 16);
+        return m;
+    }
+    float t[3] = { 0.0f, 0.0f, 0.0f }, r[4] = { 0.0f, 0.0f, 0.0f, 1.0f }, s[3] = { 1.0f, 1.0f, 1.0f };
+    Json_Floats(Json_Member(node, "translation"), t, 3);
+    Json_Floats(Json_Member(node, "rotation"), r, 4);
+    Json_Floats(Json_Member(node, "scale"), s, 3);
+    glm::mat4 m = glm::mat4_cast(glm::quat(r[3], r[0], r[1], r[2]));
+    m[0] *= s[0];
+    m[1] *= s[1];
+    m[2] *= s[2];
+    m[3] = glm::vec4(t[0], t[1], t[2], 1.0f);
+    return m;
+}
+
+static bool AddMesh(GltfAsset* asset, const GltfDocument& doc, const JsonValue* mesh, const glm::mat4& transform) {
+    const JsonValue* prims = Json_Member(mesh, "primitives");
+    for (size_t i = 0; i < Json_Size(prims); ++i) {
+        const JsonValue* p = &prims->items[i];
+        const JsonValue* attrs = Json_Member(p, "attributes");
+        if (Json_Int(Json_Member(p, "mode"), 4) != 4) {
+            printf("%s: skipping a primitive that is not GL_TRIANGLES\n", doc.path);
+            continue;
+        }
+        if (!Json_Member(attrs, "POSITION") || !Json_Member(attrs, "NORMAL")) {
+            printf("%s: skipping a primitive without POSITION or NORMAL\n", doc.path);
+            continue;
+        }
+
+        GltfPrimitive prim {};
+        prim.transform = transform;
+        prim.material = Json_Int(Json_Member(p, "material"), -1);
+        struct { const char* name; GltfAccessor* accessor; } streams[] = {
+            { "POSITION", &prim.position }, { "NORMAL", &prim.normal },
+            { "TANGENT", &prim.tangent }, { "TEXCOORD_0", &prim.coord },
+        };
+        for (const auto& s : streams) {
+            const JsonValue* index = Json_Member(attrs, s.name);
+            if (index && !ResolveAccessor(s.accessor, doc, Json_Int(index, -1))) return false;
+        }
+        for (const auto& s : streams) {
+            if (s.accessor->count != 0 && s.accessor->count != prim.position.count) {
+                printf("%s: %s has %zu elements for %zu positions\n", doc.path, s.name, s.accessor->count, prim.position.count);
+                return false;
+            }
+        }
+        const JsonValue* indices = Json_Member(p, "indices");
+        if (indices && !ResolveAccessor(&prim.indices, doc, Json_Int(indices, -1))) return false;
+        // Element buffers have no stride, and their offset has to be a
+        // multiple of the index size.
+        size_t indexSize = ComponentSize(prim.indices.componentType);
+        if (indices && (prim.indices.components != 1 || prim.indices.componentType == GL_BYTE || prim.indices.componentType == GL_SHORT
+                        || prim.indices.stride != indexSize || prim.indices.offset % indexSize != 0)) {
+            printf("%s: unsupported index accessor\n", doc.path);
+            return false;
+        }
+        if (prim.material >= (int) asset->materials.size()) prim.material = -1;
+
+        // POSITION must carry min and max; fall back to reading it if not.
+        const JsonValue* acc = Json_Item(doc.accessors, Json_Int(Json_Member(attrs, "POSITION"), -1));
+        prim.min = glm::vec3(INFINITY);
+        prim.max = glm::vec3(-INFINITY);
+        if (Json_Size(Json_Member(acc, "min")) >= 3 && Json_Size(Json_Member(acc, "max")) >= 3) {
+            Json_Floats(Json_Member(acc, "min"), &prim.min.x, 3);
+            Json_Floats(Json_Member(acc, "max"), &prim.max.x, 3);
+        } else {
+            for (size_t v = 0; v < prim.position.count; ++v) {
+                glm::vec3 pos = glm::vec3(ReadAccessor(asset->bin, prim.position, v));
+                prim.min = glm::min(prim.min, pos);
+                prim.max = glm::max(prim.max, pos);
+            }
+        }
+        for (int c = 0; c < 8; ++c) {
+            glm::vec3 corner { c & 1 ? prim.max.x : prim.min.x, c & 2 ? prim.max.y : prim.min.y, c & 4 ? prim.max.z : prim.min.z };
+            glm::vec3 world = glm::vec3(transform * glm::vec4(corner, 1.0f));
+            asset->min = glm::min(asset->min, world);
+            asset->max = glm::max(asset->max, world);
+        }
+        asset->primitives.push_back(prim);
+    }
+    return true;
+}
+
+static bool AddNode(GltfAsset* asset, const GltfDocument& doc, int index, const glm::mat4& parent, int depth) {
+    const JsonValue* node = Json_Item(Json_Member(&doc.root, "nodes"), index);
+    if (!node || depth > JSON_MAX_DEPTH) {
+        printf("%s: bad node %d\n", doc.path, index);
+        return false;
+    }
+    glm::mat4 transform = parent * NodeTransform(node);
+    const JsonValue* mesh = Json_Member(node, "mesh");
+    if (mesh && !AddMesh(asset, doc, Json_Item(Json_Member(&doc.root, "meshes"), Json_Int(mesh, -1)), transform)) return false;
+    const JsonValue* children = Json_Member(node, "children");
+    for (size_t i = 0; i < Json_Size(children); ++i) {
+        if (!AddNode(asset, doc, Json_Int(&children->items[i], -1), transform, depth + 1)) return false;
+    }
+    return true;
+}
+
+static void ReadMaterials(GltfAsset* asset, const GltfDocument& doc) {
+    const JsonValue* textures = Json_Member(&doc.root, "textures");
+    const JsonValue* materials = Json_Member(&doc.root, "materials");
+    auto image = [&](const JsonValue* info) {
+        if (!info) return -1;
+        int source = Json_Int(Json_Member(Json_Item(textures, Json_Int(Json_Member(info, "index"), -1)), "source"), -1);
+        return source < (int) asset->images.size() && asset->images[source].size > 0 ? source : -1;
+    };
+    for (size_t i = 0; i < Json_Size(materials); ++i) {
+        const JsonValue* m = &materials->items[i];
+        const JsonValue* pbr = Json_Member(m, "pbrMetallicRoughness");
+        GltfMaterial mat;
+        mat.images[MATERIAL_SLOT_COLOR] = image(Json_Member(pbr, "baseColorTexture"));
+        mat.images[MATERIAL_SLOT_ROUGHNESS_METALNESS] = image(Json_Member(pbr, "metallicRoughnessTexture"));
+        mat.images[MATERIAL_SLOT_NORMAL] = image(Json_Member(m, "normalTexture"));
+        mat.images[MATERIAL_SLOT_AO] = image(Json_Member(m, "occlusionTexture"));
+        mat.images[MATERIAL_SLOT_EMISSIVE] = image(Json_Member(m, "emissiveTexture"));
+        mat.baseColor = glm::vec4(1.0f);
+        mat.emissive = glm::vec3(0.0f);
+        Json_Floats(Json_Member(pbr, "baseColorFactor"), &mat.baseColor.x, 4);
+        Json_Floats(Json_Member(m, "emissiveFactor"), &mat.emissive.x, 3);
+        mat.metallic = (float) Json_Number(Json_Member(pbr, "metallicFactor"), 1.0);
+        mat.roughness = (float) Json_Number(Json_Member(pbr, "roughnessFactor"), 1.0);
+        mat.occlusion = (float) Json_Number(Json_Member(Json_Member(m, "occlusionTexture"), "strength"), 1.0);
+        asset->materials.push_back(mat);
+    }
+}
+
+static bool ParseGltf(GltfAsset* asset, const uint8_t* data, size_t size, const char* path) {
+    uint32_t header[5];
+    if (size < sizeof(header)) {
+        printf("%s: not a GLB file\n", path);
+        return false;
+    }
+    memcpy(header, data, sizeof(header));
+    if (header[0] != GLB_MAGIC || header[1] != GLB_VERSION || header[2] > size || header[2] < sizeof(header) || header[4] != GLB_CHUNK_JSON
+            || header[3] > header[2] - sizeof(header)) {
+        printf("%s: not a version 2 GLB file\n", path);
+        return false;
+    }
+    size_t length = header[2];
+    const char* json = (const char*) data + sizeof(header);
+    size_t binChunk = (sizeof(header) + header[3] + 3) & ~(size_t) 3;
+    asset->bin = nullptr;
+    asset->binSize = 0;
+    if (binChunk + 8 <= length) {
+        uint32_t chunk[2];
+        memcpy(chunk, data + binChunk, sizeof(chunk));
+        if (chunk[1] == GLB_CHUNK_BIN && chunk[0] <= length - binChunk - 8) {
+            asset->bin = data + binChunk + 8;
+            asset->binSize = chunk[0];
+        }
+    }
+
+    GltfDocument doc;
+    doc.path = path;
+    doc.binSize = asset->binSize;
+    JsonParser js { json, json + header[3] };
+    if (!ParseValue(&js, &doc.root, 0) || doc.root.type != JsonValue::J_OBJECT) {
+        printf("%s: malformed JSON chunk\n", path);
+        return false;
+    }
+    doc.accessors = Json_Member(&doc.root, "accessors");
+    doc.bufferViews = Json_Member(&doc.root, "bufferViews");
+    const JsonValue* buffers = Json_Member(&doc.root, "buffers");
+    if (Json_Size(buffers) > 1 || Json_Member(Json_Item(buffers, 0), "uri")) {
+        printf("%s: external buffers are not supported\n", path);
+        return false;
+    }
+
+    // Images outside the BIN chunk get size 0 and are treated as missing.
+    const JsonValue* images = Json_Member(&doc.root, "images");
+    for (size_t i = 0; i < Json_Size(images); ++i) {
+        GltfImage image { 0, 0 };
+        const JsonValue* view = Json_Item(doc.bufferViews, Json_Int(Json_Member(&images->items[i], "bufferView"), -1));
+        size_t offset = 0, bytes = 0;
+        if (view && Json_Int(Json_Member(view, "buffer"), -1) == 0 && Json_Unsigned(Json_Member(view, "byteOffset"), 0, &offset)
+                && Json_Unsigned(Json_Member(view, "byteLength"), 0, &bytes) && offset <= asset->binSize && bytes <= asset->binSize - offset) {
+            image = { offset, bytes };
+        } else {
+            printf("%s: image %zu is not in the BIN chunk, using a flat texture\n", path, i);
+        }
+        asset->images.push_back(image);
+    }
+    ReadMaterials(asset, doc);
+
+    // The default scene's roots, or with no scenes every node nobody
+    // parents.
+    asset->min = glm::vec3(INFINITY);
+    asset->max = glm::vec3(-INFINITY);
+    const JsonValue* nodes = Json_Member(&doc.root, "nodes");
+    const JsonValue* scene = Json_Item(Json_Member(&doc.root, "scenes"), Json_Int(Json_Member(&doc.root, "scene"), 0));
+    std::vector<int> roots;
+    if (scene) {
+        const JsonValue* sceneNodes = Json_Member(scene, "nodes");
+        for (size_t i = 0; i < Json_Size(sceneNodes); ++i) roots.push_back(Json_Int(&sceneNodes->items[i], -1));
+    } else {
+        std::vector<bool> parented(Json_Size(nodes), false);
+        for (size_t i = 0; i < Json_Size(nodes); ++i) {
+            const JsonValue* children = Json_Member(&nodes->items[i], "children");
+            for (size_t c = 0; c < Json_Size(children); ++c) {
+                int child = Json_Int(&children->items[c], -1);
+                if (child >= 0 && child < (int) parented.size()) parented[child] = true;
+            }
+        }
+        for (size_t i = 0; i < parented.size(); ++i) {
+            if (!parented[i]) roots.push_back((int) i);
+        }
+    }
+    for (int root : roots) {
+        if (!AddNode(asset, doc, root, glm::mat4(1.0f), 0)) return false;
+    }
+
+    size_t needed = 0;
+    for (GltfPrimitive& prim : asset->primitives) {
+        if (prim.tangent.count == 0) needed += prim.position.count;
+    }
+    asset->generatedTangents.resize(needed);
+    size_t next = 0;
+    for (GltfPrimitive& prim : asset->primitives) {
+        if (prim.tangent.count > 0) continue;
+        if (prim.coord.count > 0) {
+            GeneratePrimitiveTangents(&asset->generatedTangents[next], asset->bin, prim);
+        } else {
+            for (size_t v = 0; v < prim.position.count; ++v) {
+                glm::vec3 n = glm::vec3(ReadAccessor(asset->bin, prim.normal, v));
+                glm::vec3 axis = fabsf(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                asset->generatedTangents[next + v] = glm::vec4(glm::normalize(axis - n * glm::dot(n, axis)), 1.0f);
+            }
+        }
+        prim.tangent = GltfAccessor { next * sizeof(glm::vec4), sizeof(glm::vec4), prim.position.count, GL_FLOAT, 4, GL_FALSE };
+        prim.generated = true;
+        next += prim.position.count;
+    }
+    return true;
+}
+
+bool GltfAsset_Open(GltfAsset* asset, const char* path, const PackFile* pack) {
+    asset->file = MappedFile {};
+    asset->primitives.clear();
+    asset->materials.clear();
+    asset->images.clear();
+    asset->generatedTangents.clear();
+
+    std::string_view packed = PackFile_View(pack, path);
+    const uint8_t* data = (const uint8_t*) packed.data();
+    size_t size = packed.size();
+    if (!data) {
+        if (!MappedFile_Open(&asset->file, path)) {
+            printf("%s: cannot open\n", path);
+            return false;
+        }
+        data = (const uint8_t*) asset->file.data;
+        size = asset->file.size;
+    }
+    if (!ParseGltf(asset, data, size, path)) {
+        GltfAsset_Close(asset);
+        return false;
+    }
+    return true;
+}
+
+void GltfAsset_Close(GltfAsset* asset) {
+    MappedFile_Close(&asset->file);
+    asset->bin = nullptr;
+    asset->binSize = 0;
+    asset->primitives.clear();
+    asset->materials.clear();
+    asset->images.clear();
+    asset->generatedTangents.clear();
+}
+
+size_t GltfAsset_NumTriangles(const GltfAsset& asset) {
+    size_t tris = 0;
+    for (const GltfPrimitive& prim : asset.primitives) tris += (prim.indices.count ? prim.indices.count : prim.position.count) / 3;
+    return tris;
+}
+
+void BenchmarkGltfLoad(const char* path, const PackFile* pack) {
+    const int RUNS = 5;
+    double assimpms = INFINITY, nativems = INFINITY;
+    size_t assimpverts = 0, assimptris = 0, assimpbytes = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        StaticMesh mesh;
+        auto start = std::chrono::high_resolution_clock::now();
+        bool ok = LoadStaticMesh(&mesh, path, pack);
+        std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+        if (!ok) break;
+        assimpms = std::min(assimpms, dur.count());
+        assimpverts = mesh.vertices.size();
+        assimptris = mesh.indices.size() / 3;
+        assimpbytes = mesh.vertices.capacity() * sizeof(GlStaticMeshVert) + mesh.indices.capacity() * sizeof(GLuint)
+                    + mesh.submeshes.capacity() * sizeof(StaticSubmesh);
+    }
+
+    size_t nativeverts = 0, nativetris = 0, nativebytes = 0, binbytes = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        GltfAsset asset;
+        auto start = std::chrono::high_resolution_clock::now();
+        bool ok = GltfAsset_Open(&asset, path, pack);
+        std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+        if (!ok) return;
+        nativems = std::min(nativems, dur.count());
+        nativeverts = 0;
+        for (const GltfPrimitive& prim : asset.primitives) nativeverts += prim.position.count;
+        nativetris = GltfAsset_NumTriangles(asset);
+        nativebytes = asset.primitives.capacity() * sizeof(GltfPrimitive) + asset.materials.capacity() * sizeof(GltfMaterial)
+                    + asset.images.capacity() * sizeof(GltfImage) + asset.generatedTangents.capacity() * sizeof(glm::vec4);
+        binbytes = asset.binSize;
+        GltfAsset_Close(&asset);
+    }
+
+    printf("%s: best of %d\n", path, RUNS);
+    if (assimpms < INFINITY) {
+        printf("  assimp: %8.2f ms, %zu verts, %zu tris, %zu KB on the heap\n", assimpms, assimpverts, assimptris, assimpbytes / 1024);
+    }
+    printf("  native: %8.2f ms, %zu verts, %zu tris, %zu KB on the heap, %zu KB of BIN chunk uploaded from the mapping\n",
+           nativems, nativeverts, nativetris, nativebytes / 1024, binbytes / 1024);
+    if (assimpms < INFINITY) printf("  %.1fx faster\n", assimpms / nativems);
+}
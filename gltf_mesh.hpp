@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "mapped_file.hpp"
+#include "material.hpp"
+
+struct PackFile;
+
+// Binary glTF 2.0 (.glb) read without Assimp. The JSON chunk is parsed once
+// and thrown away; what is kept are typed views into the BIN chunk, which
+// stays in the mapping (of the file, or of the pack holding it) so the GL
+// side can upload it as is. Vertex data is never converted to
+// GlStaticMeshVert, welded or reindexed.
+
+static constexpr uint32_t GLB_MAGIC      = 0x46546c67; // "glTF"
+static constexpr uint32_t GLB_VERSION    = 2;
+static constexpr uint32_t GLB_CHUNK_JSON = 0x4e4f534a; // "JSON"
+static constexpr uint32_t GLB_CHUNK_BIN  = 0x004e4942; // "BIN\0"
+
+// An accessor resolved against its bufferView: element i starts at
+// offset + i * stride bytes into the BIN chunk. count is 0 when the
+// primitive does not have the attribute.
+struct GltfAccessor {
+    size_t    offset;
+    size_t    stride;
+    size_t    count;
+    GLenum    componentType;
+    GLint     components;
+    GLboolean normalized;
+};
+
+struct GltfPrimitive {
+    GltfAccessor position;
+    GltfAccessor normal;
+    GltfAccessor tangent;
+    GltfAccessor coord;         // TEXCOORD_0
+    GltfAccessor indices;       // count 0: draw non-indexed
+    int          material;      // -1: default material
+    glm::mat4    transform;     // global transform of the node drawing it
+    glm::vec3    min, max;      // POSITION bounds, object space
+
+    // Tangents generated at load when the file has none; tangent then
+    // refers to these, at offset into GltfAsset::generatedTangents.
+    bool         generated;
+};
+
+struct GltfMaterial {
+    int       images[MATERIAL_SLOTS];        // -1: no texture
+    glm::vec4 baseColor;
+    glm::vec3 emissive;
+    float     metallic, roughness;
+    float     occlusion;                     // occlusionTexture.strength
+};
+
+// An image stored in a bufferView, still in its file format.
+struct GltfImage {
+    size_t offset;
+    size_t size;
+};
+
+struct GltfAsset {
+    MappedFile                 file;        // closed when the asset came from a pack
+    const uint8_t*             bin;
+    size_t                     binSize;
+    std::vector<GltfPrimitive> primitives;
+    std::vector<GltfMaterial>  materials;
+    std::vector<GltfImage>     images;
+    std::vector<glm::vec4>     generatedTangents;
+    glm::vec3                  min, max;     // world-space bounds of all primitives
+};
+
+// Opens path, out of pack if it contains it, and resolves every triangle
+// primitive the default scene draws. Primitives without TANGENT get tangents
+// from the uv derivatives, angle-weighted per vertex like
+// GenerateTangents, but without splitting vertices on mirrored uv seams.
+// Sparse accessors, external buffers and non-triangle modes are not
+// supported; the first two fail the load, the last is skipped.
+bool GltfAsset_Open(GltfAsset* asset, const char* path, const PackFile* pack = nullptr);
+void GltfAsset_Close(GltfAsset* asset);
+
+size_t GltfAsset_NumTriangles(const GltfAsset& asset);
+
+// Times loading path through LoadStaticMesh against GltfAsset_Open, best of
+// several runs each, and prints what each keeps on the heap.
+void BenchmarkGltfLoad(const char* path, const PackFile* pack);
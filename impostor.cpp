@@ -0,0 +1,478 @@
+#include "impostor.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+#include <unordered_map>
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "mesh_cook.hpp"
+#include "pack_file.hpp"
+#include "parallel.hpp"
+#include "stb_image.h"
+#include "texture_cook.hpp"
+
+static constexpr uint32_t NO_TRIANGLE = 0xffffffff;
+
+// Atlases past this would not fit a GL texture anywhere.
+static constexpr uint32_t IMPOSTOR_MAX_ATLAS = 16384;
+
+glm::vec3 Impostor_FrameDirection(uint32_t x, uint32_t y, uint32_t gridSize) {
+    glm::vec2 p = (glm::vec2((float) x, (float) y) + 0.5f) / (float) gridSize * 2.0f - 1.0f;
+    glm::vec3 n { p.x, p.y, 1.0f - fabsf(p.x) - fabsf(p.y) };
+    if (n.z < 0.0f) {
+        n.x = (1.0f - fabsf(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f);
+        n.y = (1.0f - fabsf(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return glm::normalize(n);
+}
+
+void Impostor_FrameBasis(glm::vec3 dir, glm::vec3* right, glm::vec3* up) {
+    glm::vec3 ref = fabsf(dir.y) < 0.999f ? glm::vec3 { 0.0f, 1.0f, 0.0f } : glm::vec3 { 0.0f, 0.0f, 1.0f };
+    *right = glm::normalize(glm::cross(ref, dir));
+    *up = glm::cross(dir, *right);
+}
+
+std::string Impostor_PathFor(const char* sourcePath) {
+    return Cooked_PathFor(sourcePath, ".impostor");
+}
+
+// RGBA8 as the texture cache would upload it.
+struct BakeImage {
+    int                  width = 0, height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// Cooked first, from pack then disk, then the source, like ReadPending in
+// texture_cache.cpp; only the top level of a cooked texture is used.
+static bool ReadBakeImage(BakeImage* image, const MaterialTexture& tex, const PackFile* pack) {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    MappedFile file {};
+    if (!tex.embedded.empty() && tex.width) {
+        if (tex.embedded.size() < (size_t) tex.width * tex.height * 4) return false;
+        image->width = (int) tex.width;
+        image->height = (int) tex.height;
+        image->pixels.assign(tex.embedded.begin(), tex.embedded.begin() + (size_t) tex.width * tex.height * 4);
+        return true;
+    } else if (!tex.embedded.empty()) {
+        data = tex.embedded.data();
+        size = tex.embedded.size();
+    } else if (!tex.path.empty()) {
+        std::string cookedPath = CookedTexture_PathFor(tex.path.c_str());
+        std::string_view packed = PackFile_View(pack, cookedPath);
+        CookedTexture cooked {};
+        if ((packed.data() && CookedTexture_OpenMemory(&cooked, packed.data(), packed.size()))
+            || CookedTexture_Open(&cooked, cookedPath.c_str(), tex.path.c_str())) {
+            bool ok = cooked.format == COOKED_TEXTURE_SRGB8_ALPHA8 && cooked.numLevels > 0
+                   && cooked.levels[0].size >= (uint64_t) cooked.levels[0].width * cooked.levels[0].height * 4;
+            if (ok) {
+                const CookedTextureLevel& level = cooked.levels[0];
+                const uint8_t* texels = cooked.data + level.offset;
+                image->width = (int) level.width;
+                image->height = (int) level.height;
+                image->pixels.assign(texels, texels + (size_t) level.width * level.height * 4);
+            }
+            CookedTexture_Close(&cooked);
+            if (ok) return true;
+        }
+        std::string_view source = PackFile_View(pack, tex.path);
+        if (source.data()) {
+            data = (const uint8_t*) source.data();
+            size = source.size();
+        } else if (MappedFile_Open(&file, tex.path.c_str())) {
+            data = (const uint8_t*) file.data;
+            size = file.size;
+        } else {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    int channels;
+    stbi_uc* pixels = stbi_load_from_memory(data, (int) size, &image->width, &image->height, &channels, 4);
+    MappedFile_Close(&file);
+    if (!pixels) return false;
+    image->pixels.assign(pixels, pixels + (size_t) image->width * image->height * 4);
+    stbi_image_free(pixels);
+    return true;
+}
+
+static float SrgbToLinear(float c) {
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t LinearToSrgb8(float c) {
+    c = std::min(std::max(c, 0.0f), 1.0f);
+    c = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+    return (uint8_t) (c * 255.0f + 0.5f);
+}
+
+static uint8_t Unorm8(float c) {
+    return (uint8_t) (std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// Bilinear with repeat wrapping, decoding sRGB colour like GL_SRGB8_ALPHA8.
+static glm::vec4 SampleBakeImage(const BakeImage& image, glm::vec2 uv, const float* linear) {
+    float x = uv.x * image.width - 0.5f, y = uv.y * image.height - 0.5f;
+    float fx = floorf(x), fy = floorf(y);
+    float tx = x - fx, ty = y - fy;
+    auto wrap = [](float v, int n) {
+        int i = (int) fmodf(v, (float) n);
+        return i < 0 ? i + n : i;
+    };
+    int x0 = wrap(fx, image.width), x1 = (x0 + 1) % image.width;
+    int y0 = wrap(fy, image.height), y1 = (y0 + 1) % image.height;
+    auto fetch = [&](int tx, int ty) {
+        const uint8_t* p = &image.pixels[((size_t) ty * image.width + tx) * 4];
+        return glm::vec4 { linear[p[0]], linear[p[1]], linear[p[2]], p[3] / 255.0f };
+    };
+    glm::vec4 top = fetch(x0, y0) * (1.0f - tx) + fetch(x1, y0) * tx;
+    glm::vec4 bottom = fetch(x0, y1) * (1.0f - tx) + fetch(x1, y1) * tx;
+    return top * (1.0f - ty) + bottom * ty;
+}
+
+struct BakeTriangle {
+    uint32_t v[3];
+    uint32_t material;
+};
+
+// What one atlas texel holds, in linear values.
+struct BakeTexel {
+    glm::vec3 albedo;
+    glm::vec3 normal;
+    glm::vec3 material;
+    float     depth;
+};
+
+static inline float Edge(const glm::vec3& a, const glm::vec3& b, float px, float py) {
+    return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+}
+
+static glm::vec3 NormalizeOr(glm::vec3 v, glm::vec3 fallback) {
+    float len = glm::length(v);
+    return len > 1e-8f ? v / len : fallback;
+}
+
+bool BakeImpostor(ImpostorAtlas* atlas, const CookedMesh& mesh, const MaterialDesc& defaults, const PackFile* pack,
+                  uint32_t gridSize, uint32_t frameSize) {
+    auto start = std::chrono::high_resolution_clock::now();
+    ImpostorAtlas_Close(atlas);
+    if (gridSize == 0 || frameSize == 0 || (uint64_t) gridSize * frameSize > IMPOSTOR_MAX_ATLAS || mesh.numVertices == 0) {
+        printf("impostor: cannot bake %u x %u frames of %u texels for %zu vertices\n", gridSize, gridSize, frameSize,
+               mesh.numVertices);
+        return false;
+    }
+
+    glm::vec3 lo { INFINITY }, hi { -INFINITY };
+    for (size_t i = 0; i < mesh.numVertices; ++i) {
+        lo = glm::min(lo, mesh.vertices[i].pos);
+        hi = glm::max(hi, mesh.vertices[i].pos);
+    }
+    ImpostorInfo info { gridSize, frameSize, (lo + hi) * 0.5f, std::max(glm::length(hi - lo) * 0.5f, 1e-6f) };
+
+    // Every distinct texture is read once, all in parallel; materials past
+    // the end of the table use defaults, which is last.
+    size_t numMaterials = mesh.materials.size() + 1;
+    auto slotTexture = [&](size_t m, int slot) -> const MaterialTexture& {
+        return m < mesh.materials.size() ? mesh.materials[m].textures[slot] : defaults.textures[slot];
+    };
+    std::vector<const MaterialTexture*> sources;
+    std::vector<int> slotImage(numMaterials * MATERIAL_SLOTS, -1);
+    std::unordered_map<std::string, int> byPath;
+    for (size_t m = 0; m < numMaterials; ++m) {
+        for (int slot = 0; slot < MATERIAL_SLOTS; ++slot) {
+            const MaterialTexture& tex = slotTexture(m, slot);
+            if (tex.embedded.empty() && tex.path.empty()) continue;
+            if (tex.embedded.empty()) {
+                auto known = byPath.find(tex.path);
+                if (known != byPath.end()) {
+                    slotImage[m * MATERIAL_SLOTS + slot] = known->second;
+                    continue;
+                }
+                byPath[tex.path] = (int) sources.size();
+            }
+            slotImage[m * MATERIAL_SLOTS + slot] = (int) sources.size();
+            sources.push_back(&tex);
+        }
+    }
+    std::vector<BakeImage> images(sources.size());
+    std::vector<uint8_t> readable(sources.size(), 0);
+    ParallelFor(sources.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) readable[i] = ReadBakeImage(&images[i], *sources[i], pack);
+    });
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (!readable[i]) printf("%s: cannot read texture for impostor\n", sources[i]->path.empty() ? "embedded" : sources[i]->path.c_str());
+    }
+    // An unreadable slot falls back to the default's, then to a constant.
+    std::vector<const BakeImage*> slots(numMaterials * MATERIAL_SLOTS, nullptr);
+    for (size_t m = 0; m < numMaterials; ++m) {
+        for (int slot = 0; slot < MATERIAL_SLOTS; ++slot) {
+            int own = slotImage[m * MATERIAL_SLOTS + slot];
+            int fallback = slotImage[(numMaterials - 1) * MATERIAL_SLOTS + slot];
+            if (own >= 0 && readable[own]) slots[m * MATERIAL_SLOTS + slot] = &images[own];
+            else if (fallback >= 0 && readable[fallback]) slots[m * MATERIAL_SLOTS + slot] = &images[fallback];
+        }
+    }
+    std::chrono::duration<double, std::milli> readdur = std::chrono::high_resolution_clock::now() - start;
+
+    float linear[256];
+    for (int i = 0; i < 256; ++i) linear[i] = SrgbToLinear(i / 255.0f);
+
+    std::vector<BakeTriangle> triangles;
+    triangles.reserve(mesh.numIndices / 3);
+    for (size_t s = 0; s < mesh.numSubmeshes; ++s) {
+        const StaticSubmesh& sub = mesh.submeshes[s];
+        uint32_t material = (uint32_t) std::min<size_t>(sub.material, numMaterials - 1);
+        for (GLuint i = 0; i + 2 < sub.numIndices; i += 3) {
+            BakeTriangle t;
+            for (int k = 0; k < 3; ++k) {
+                size_t at = sub.firstIndex + i + k;
+                GLuint index = mesh.indexType == GL_UNSIGNED_SHORT ? ((const uint16_t*) mesh.indices)[at]
+                                                                   : ((const uint32_t*) mesh.indices)[at];
+                t.v[k] = (uint32_t) (sub.baseVertex + index);
+            }
+            t.material = material;
+            if (t.v[0] < mesh.numVertices && t.v[1] < mesh.numVertices && t.v[2] < mesh.numVertices) triangles.push_back(t);
+        }
+    }
+
+    size_t side = (size_t) gridSize * frameSize;
+    atlas->bakedAlbedo.assign(side * side * 4, 0);
+    atlas->bakedNormal.assign(side * side * 4, 0);
+    atlas->bakedMaterial.assign(side * side * 4, 0);
+    atlas->bakedDepth.assign(side * side, 0);
+
+    int F = (int) frameSize;
+    ParallelFor((size_t) gridSize * gridSize, 1, [&](size_t begin, size_t end) {
+        std::vector<glm::vec3> screen(mesh.numVertices);     // texel x and y, depth
+        std::vector<float> depth((size_t) F * F);
+        std::vector<uint32_t> covering((size_t) F * F);
+        std::vector<BakeTexel> texels((size_t) F * F), spread;
+        std::vector<uint8_t> filled((size_t) F * F), grown;
+        for (size_t frame = begin; frame < end; ++frame) {
+            uint32_t fx = (uint32_t) (frame % gridSize), fy = (uint32_t) (frame / gridSize);
+            glm::vec3 dir = Impostor_FrameDirection(fx, fy, gridSize), right, up;
+            Impostor_FrameBasis(dir, &right, &up);
+            float toTexels = F * 0.5f / info.radius;
+            for (size_t v = 0; v < mesh.numVertices; ++v) {
+                glm::vec3 rel = mesh.vertices[v].pos - info.center;
+                screen[v] = glm::vec3 { glm::dot(rel, right) * toTexels + F * 0.5f, glm::dot(rel, up) * toTexels + F * 0.5f,
+                                        (info.radius - glm::dot(rel, dir)) / (2.0f * info.radius) };
+            }
+
+            // Visibility pass: nearest triangle per texel centre. right x up
+            // points at the viewer, so counter-clockwise here is front
+            // facing, and back faces are culled as main draws them.
+            std::fill(depth.begin(), depth.end(), INFINITY);
+            std::fill(covering.begin(), covering.end(), NO_TRIANGLE);
+            for (size_t t = 0; t < triangles.size(); ++t) {
+                const glm::vec3& a = screen[triangles[t].v[0]];
+                const glm::vec3& b = screen[triangles[t].v[1]];
+                const glm::vec3& c = screen[triangles[t].v[2]];
+                float area = Edge(a, b, c.x, c.y);
+                if (!(area > 1e-12f)) continue;
+                int x0 = std::max((int) floorf(std::min({ a.x, b.x, c.x }) - 0.5f), 0);
+                int x1 = std::min((int) ceilf(std::max({ a.x, b.x, c.x }) - 0.5f), F - 1);
+                int y0 = std::max((int) floorf(std::min({ a.y, b.y, c.y }) - 0.5f), 0);
+                int y1 = std::min((int) ceilf(std::max({ a.y, b.y, c.y }) - 0.5f), F - 1);
+                float inv = 1.0f / area;
+                for (int y = y0; y <= y1; ++y) {
+                    for (int x = x0; x <= x1; ++x) {
+                        float px = x + 0.5f, py = y + 0.5f;
+                        float w0 = Edge(b, c, px, py) * inv;
+                        float w1 = Edge(c, a, px, py) * inv;
+                        float w2 = Edge(a, b, px, py) * inv;
+                        if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+                        float z = w0 * a.z + w1 * b.z + w2 * c.z;
+                        size_t i = (size_t) y * F + x;
+                        if (z < depth[i]) {
+                            depth[i] = z;
+                            covering[i] = (uint32_t) t;
+                        }
+                    }
+                }
+            }
+
+            // Shade each covered texel once, with frag.glsl's inputs.
+            for (int y = 0; y < F; ++y) {
+                for (int x = 0; x < F; ++x) {
+                    size_t i = (size_t) y * F + x;
+                    filled[i] = covering[i] != NO_TRIANGLE;
+                    if (!filled[i]) continue;
+                    const BakeTriangle& t = triangles[covering[i]];
+                    const glm::vec3& a = screen[t.v[0]];
+                    const glm::vec3& b = screen[t.v[1]];
+                    const glm::vec3& c = screen[t.v[2]];
+                    float inv = 1.0f / Edge(a, b, c.x, c.y);
+                    float px = x + 0.5f, py = y + 0.5f;
+                    float w[3] = { Edge(b, c, px, py) * inv, Edge(c, a, px, py) * inv, 0.0f };
+                    w[2] = 1.0f - w[0] - w[1];
+                    glm::vec3 norm { 0.0f }, tang { 0.0f };
+                    glm::vec2 coord { 0.0f };
+                    for (int k = 0; k < 3; ++k) {
+                        const GlStaticMeshVert& v = mesh.vertices[t.v[k]];
+                        norm += v.norm * w[k];
+                        tang += glm::vec3(v.tang) * w[k];
+                        coord += v.coord * w[k];
+                    }
+                    norm = NormalizeOr(norm, -dir);
+                    tang = NormalizeOr(tang, right);
+                    glm::vec3 bitang = NormalizeOr(glm::cross(norm, tang) * mesh.vertices[t.v[0]].tang.w, up);
+
+                    const BakeImage* const* m = &slots[t.material * MATERIAL_SLOTS];
+                    auto sample = [&](int slot, glm::vec4 constant) {
+                        return m[slot] ? SampleBakeImage(*m[slot], coord, linear) : constant;
+                    };
+                    glm::vec4 color = sample(MATERIAL_SLOT_COLOR, glm::vec4 { 1.0f });
+                    glm::vec4 rm = sample(MATERIAL_SLOT_ROUGHNESS_METALNESS, glm::vec4 { 0.0f, 1.0f, 0.0f, 1.0f });
+                    glm::vec4 normal = sample(MATERIAL_SLOT_NORMAL, glm::vec4 { 0.0f, 0.0f, 1.0f, 1.0f });
+                    glm::vec4 ao = sample(MATERIAL_SLOT_AO, glm::vec4 { 1.0f });
+
+                    BakeTexel& texel = texels[i];
+                    texel.albedo = glm::vec3(color);
+                    texel.normal = NormalizeOr(tang * normal.x + bitang * normal.y + norm * normal.z, norm);
+                    texel.material = glm::vec3 { ao.r, rm.g, rm.b };
+                    texel.depth = std::min(std::max(depth[i], 0.0f), 1.0f);
+                }
+            }
+
+            // Grow coverage outwards a ring at a time, each new texel the
+            // average of its filled 4-neighbours, until the frame is full.
+            bool any = std::find(filled.begin(), filled.end(), 1) != filled.end();
+            for (bool growing = any; growing;) {
+                growing = false;
+                spread = texels;
+                grown = filled;
+                for (int y = 0; y < F; ++y) {
+                    for (int x = 0; x < F; ++x) {
+                        size_t i = (size_t) y * F + x;
+                        if (filled[i]) continue;
+                        BakeTexel sum {};
+                        int n = 0;
+                        auto add = [&](int nx, int ny) {
+                            if (nx < 0 || ny < 0 || nx >= F || ny >= F) return;
+                            const BakeTexel& o = texels[(size_t) ny * F + nx];
+                            if (!filled[(size_t) ny * F + nx]) return;
+                            sum.albedo += o.albedo;
+                            sum.normal += o.normal;
+                            sum.material += o.material;
+                            sum.depth += o.depth;
+                            n++;
+                        };
+                        add(x - 1, y);
+                        add(x + 1, y);
+                        add(x, y - 1);
+                        add(x, y + 1);
+                        if (n == 0) continue;
+                        float s = 1.0f / n;
+                        spread[i] = BakeTexel { sum.albedo * s, NormalizeOr(sum.normal, dir), sum.material * s, sum.depth * s };
+                        grown[i] = 2;
+                        growing = true;
+                    }
+                }
+                std::swap(texels, spread);
+                std::swap(filled, grown);
+            }
+
+            for (int y = 0; y < F; ++y) {
+                size_t row = ((size_t) fy * F + y) * side + (size_t) fx * F;
+                for (int x = 0; x < F; ++x) {
+                    size_t i = (size_t) y * F + x, o = row + x;
+                    const BakeTexel& texel = texels[i];
+                    uint8_t* albedo = &atlas->bakedAlbedo[o * 4];
+                    uint8_t* normal = &atlas->bakedNormal[o * 4];
+                    uint8_t* material = &atlas->bakedMaterial[o * 4];
+                    if (!any) {
+                        normal[0] = normal[1] = 128;
+                        normal[2] = normal[3] = 255;
+                        atlas->bakedDepth[o] = 0xffff;
+                        continue;
+                    }
+                    for (int k = 0; k < 3; ++k) {
+                        albedo[k] = LinearToSrgb8(texel.albedo[k]);
+                        normal[k] = Unorm8(texel.normal[k] * 0.5f + 0.5f);
+                        material[k] = Unorm8(texel.material[k]);
+                    }
+                    albedo[3] = filled[i] == 1 ? 255 : 0;
+                    normal[3] = material[3] = 255;
+                    atlas->bakedDepth[o] = (uint16_t) (texel.depth * 65535.0f + 0.5f);
+                }
+            }
+        }
+    });
+
+    atlas->info = info;
+    atlas->albedo = atlas->bakedAlbedo.data();
+    atlas->normal = atlas->bakedNormal.data();
+    atlas->material = atlas->bakedMaterial.data();
+    atlas->depth = atlas->bakedDepth.data();
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    printf("impostor: %u x %u frames of %u texels, %zu tris, %zu textures read in %.2f ms, baked in %.2f ms, %.1f%% covered\n",
+           gridSize, gridSize, frameSize, triangles.size(), sources.size(), readdur.count(), dur.count(),
+           100.0f * ImpostorAtlas_Coverage(*atlas));
+    return true;
+}
+
+static size_t AtlasTexels(const ImpostorInfo& info) {
+    size_t side = (size_t) info.gridSize * info.frameSize;
+    return side * side;
+}
+
+bool ImpostorAtlas_Write(const ImpostorAtlas& atlas, const char* path, const SourceStamp& stamp) {
+    size_t texels = AtlasTexels(atlas.info);
+    const CookedPayload payloads[] = {
+        { COOKED_CHUNK_IMPOSTOR_INFO,     sizeof(ImpostorInfo), &atlas.info,    sizeof(ImpostorInfo) },
+        { COOKED_CHUNK_IMPOSTOR_ALBEDO,   4,                    atlas.albedo,   texels * 4 },
+        { COOKED_CHUNK_IMPOSTOR_NORMAL,   4,                    atlas.normal,   texels * 4 },
+        { COOKED_CHUNK_IMPOSTOR_MATERIAL, 4,                    atlas.material, texels * 4 },
+        { COOKED_CHUNK_IMPOSTOR_DEPTH,    sizeof(uint16_t),     atlas.depth,    texels * sizeof(uint16_t) },
+    };
+    return Cooked_Write(path, IMPOSTOR_MAGIC, IMPOSTOR_VERSION, stamp, payloads, sizeof(payloads) / sizeof(payloads[0]));
+}
+
+bool ImpostorAtlas_Open(ImpostorAtlas* atlas, const char* path, const char* sourcePath) {
+    ImpostorAtlas_Close(atlas);
+    if (!Cooked_Open(&atlas->file, path, IMPOSTOR_MAGIC, IMPOSTOR_VERSION, sourcePath)) return false;
+    const void* data = atlas->file.data;
+    size_t size = atlas->file.size;
+    const CookedChunk* info = Cooked_FindChunk(data, size, COOKED_CHUNK_IMPOSTOR_INFO, sizeof(ImpostorInfo));
+    const CookedChunk* albedo = Cooked_FindChunk(data, size, COOKED_CHUNK_IMPOSTOR_ALBEDO, 4);
+    const CookedChunk* normal = Cooked_FindChunk(data, size, COOKED_CHUNK_IMPOSTOR_NORMAL, 4);
+    const CookedChunk* material = Cooked_FindChunk(data, size, COOKED_CHUNK_IMPOSTOR_MATERIAL, 4);
+    const CookedChunk* depth = Cooked_FindChunk(data, size, COOKED_CHUNK_IMPOSTOR_DEPTH, sizeof(uint16_t));
+    bool ok = info && albedo && normal && material && depth && info->size == sizeof(ImpostorInfo);
+    if (ok) {
+        auto base = (const char*) data;
+        memcpy(&atlas->info, base + info->offset, sizeof(ImpostorInfo));
+        const ImpostorInfo& i = atlas->info;
+        size_t texels = AtlasTexels(i);
+        ok = i.gridSize > 0 && i.frameSize > 0 && (uint64_t) i.gridSize * i.frameSize <= IMPOSTOR_MAX_ATLAS
+          && albedo->size == texels * 4 && normal->size == texels * 4 && material->size == texels * 4
+          && depth->size == texels * sizeof(uint16_t);
+        atlas->albedo = (const uint8_t*) (base + albedo->offset);
+        atlas->normal = (const uint8_t*) (base + normal->offset);
+        atlas->material = (const uint8_t*) (base + material->offset);
+        atlas->depth = (const uint16_t*) (base + depth->offset);
+    }
+    if (!ok) ImpostorAtlas_Close(atlas);
+    return ok;
+}
+
+void ImpostorAtlas_Close(ImpostorAtlas* atlas) {
+    MappedFile_Close(&atlas->file);
+    *atlas = ImpostorAtlas {};
+}
+
+float ImpostorAtlas_Coverage(const ImpostorAtlas& atlas) {
+    size_t texels = AtlasTexels(atlas.info), covered = 0;
+    if (!atlas.albedo || texels == 0) return 0.0f;
+    for (size_t i = 0; i < texels; ++i) covered += atlas.albedo[i * 4 + 3] >= 128;
+    return (float) covered / texels;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <glm/vec3.hpp>
+
+#include "cooked_file.hpp"
+#include "mapped_file.hpp"
+#include "material.hpp"
+
+struct CookedMesh;
+struct PackFile;
+
+// Octahedral impostors: a mesh rendered from gridSize x gridSize directions
+// around it, the centres of the cells of an octahedral map of the sphere, so
+// neighbouring frames are neighbouring views and any direction falls inside
+// a triangle of three frames to blend. Each frame is an orthographic view of
+// the mesh's bounding sphere along its direction, frameSize texels square.
+//
+// Baking is a plain software rasterizer on the CPU, needing no GL context,
+// so it runs offline and in tests the same as at load time. It shades what
+// frag.glsl would read from the material textures: every slot sampled as
+// the sRGB textures the texture cache creates, the normal map applied as
+// tbn * texel, and unset slots taken from a default material. Emissive is
+// not baked.
+//
+// Four atlases, gridSize * frameSize texels square, frame (x, y) starting
+// at texel (x, y) * frameSize, rows bottom up:
+//   albedo    RGBA8, sRGB colour, alpha coverage
+//   normal    RGBA8, unit object-space normal as xyz * 0.5 + 0.5
+//   material  RGBA8, AO, roughness and metalness in r, g and b
+//   depth     R16, distance in from the sphere's near side over its diameter
+// Texels no triangle covers take their neighbours' values, so filtering and
+// mips near a silhouette fade coverage without pulling in black.
+
+static constexpr uint32_t IMPOSTOR_MAGIC   = 0x49524250; // "PBRI"
+static constexpr uint32_t IMPOSTOR_VERSION = 1;
+
+enum ImpostorChunkId : uint32_t {
+    COOKED_CHUNK_IMPOSTOR_INFO     = 1,
+    COOKED_CHUNK_IMPOSTOR_ALBEDO   = 2,
+    COOKED_CHUNK_IMPOSTOR_NORMAL   = 3,
+    COOKED_CHUNK_IMPOSTOR_MATERIAL = 4,
+    COOKED_CHUNK_IMPOSTOR_DEPTH    = 5,
+};
+
+struct ImpostorInfo {
+    uint32_t  gridSize;
+    uint32_t  frameSize;
+    glm::vec3 center;       // object-space bounding sphere, as main computes it
+    float     radius;
+};
+
+struct ImpostorAtlas {
+    MappedFile      file;
+    ImpostorInfo    info;
+    const uint8_t*  albedo;
+    const uint8_t*  normal;
+    const uint8_t*  material;
+    const uint16_t* depth;
+
+    // Set by BakeImpostor; the pointers above then refer to these.
+    std::vector<uint8_t>  bakedAlbedo;
+    std::vector<uint8_t>  bakedNormal;
+    std::vector<uint8_t>  bakedMaterial;
+    std::vector<uint16_t> bakedDepth;
+};
+
+// The direction frame (x, y) is seen from, pointing from the mesh towards
+// the viewer, and the axes its texels' x and y run along. Must match
+// frameDirection and frameBasis in impostorvert.glsl.
+glm::vec3 Impostor_FrameDirection(uint32_t x, uint32_t y, uint32_t gridSize);
+void Impostor_FrameBasis(glm::vec3 dir, glm::vec3* right, glm::vec3* up);
+
+// COOKED_DIR/<sourcePath>.impostor
+std::string Impostor_PathFor(const char* sourcePath);
+
+// Renders every frame of mesh at full detail, in parallel over frames. Slots
+// a material leaves unset, or whose texture cannot be read, come from
+// defaults; textures are read like the texture cache does, cooked first and
+// out of pack when it has them.
+bool BakeImpostor(ImpostorAtlas* atlas, const CookedMesh& mesh, const MaterialDesc& defaults, const PackFile* pack,
+                  uint32_t gridSize, uint32_t frameSize);
+
+bool ImpostorAtlas_Write(const ImpostorAtlas& atlas, const char* path, const SourceStamp& stamp);
+// Opens an impostor baked from sourcePath as it is now.
+bool ImpostorAtlas_Open(ImpostorAtlas* atlas, const char* path, const char* sourcePath);
+void ImpostorAtlas_Close(ImpostorAtlas* atlas);
+
+// Fraction of atlas texels some triangle covers.
+float ImpostorAtlas_Coverage(const ImpostorAtlas& atlas);
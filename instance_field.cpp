@@ -0,0 +1,80 @@
+#include "instance_field.hpp"
+
+#include <math.h>
+#include <algorithm>
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "mesh_lod.hpp"
+#include "parallel.hpp"
+
+static const size_t INSTANCE_GRAIN = 1024;
+
+void MakeInstanceField(InstanceField* field, size_t count, float spacing, float fovy, float aspect) {
+    size_t cols = (size_t) ceil(sqrt((double) count));
+    size_t rows = cols ? (count + cols - 1) / cols : 0;
+    field->positions.resize(count);
+    field->phases.resize(count);
+    field->lods.assign(count, 0);
+    field->models.resize(count);
+
+    float halfw = cols * spacing * 0.5f;
+    float halfh = rows * spacing * 0.5f;
+    float t = tanf(fovy * 0.5f);
+    field->distance = std::max(4.0f, std::max(halfh / t, halfw / (t * aspect)) + spacing);
+    for (size_t i = 0; i < count; ++i) {
+        size_t x = i % cols, y = i / cols;
+        field->positions[i] = glm::vec3((x + 0.5f) * spacing - halfw, (y + 0.5f) * spacing - halfh, -field->distance);
+        // Golden-ratio phases so neighbours never spin in lockstep.
+        field->phases[i] = fmodf(i * 0.618034f, 1.0f) * 6.2831853f;
+    }
+}
+
+void FillInstanceField(
+        glm::mat4*               dst,
+        GLuint*                  levelfirst,
+        InstanceField*           field,
+        const glm::mat4&         view,
+        const glm::mat4&         local,
+        float                    time,
+        const InstanceLodParams& lod) {
+    size_t count = field->positions.size();
+    float scale = glm::length(glm::vec3(local[0]));
+    int levels = std::max(lod.levels, 1);
+    ParallelFor(count, INSTANCE_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            glm::mat4 spin = glm::rotate(glm::mat4(1.0f), time + field->phases[i], glm::vec3(0.0f, 1.0f, 0.0f));
+            glm::mat4 model = view * glm::translate(glm::mat4(1.0f), field->positions[i]) * spin * local;
+            field->models[i] = model;
+
+            // The camera sits at the view-space origin; measure in object
+            // units like the errors are.
+            glm::vec3 center = glm::vec3(model * glm::vec4(lod.center, 1.0f));
+            float neardist = std::max(glm::length(center) / scale - lod.radius, 1e-3f);
+            int level = lod.levels > 0
+                ? SelectLod(lod.errors, lod.levels, lod.pxperunit / neardist, field->lods[i], lod.threshold, 0.2f)
+                : 0;
+            // Same hysteresis as SelectLod: going to the impostor takes 20%
+            // less than the switch size, coming back takes all of it.
+            if (lod.impostorPixels > 0.0f) {
+                float diameter = 2.0f * lod.radius * lod.pxperunit / std::max(glm::length(center) / scale, 1e-3f);
+                if (diameter <= lod.impostorPixels * (field->lods[i] == levels ? 1.0f : 0.8f)) level = levels;
+            }
+            field->lods[i] = level;
+        }
+    });
+
+    // Counting sort by level. The bookkeeping is a few integer ops per copy;
+    // the matrix copy that follows is the part worth spreading out.
+    if (lod.impostorPixels > 0.0f) levels++;
+    std::fill(levelfirst, levelfirst + levels + 1, 0);
+    for (size_t i = 0; i < count; ++i) levelfirst[field->lods[i] + 1]++;
+    for (int l = 0; l < levels; ++l) levelfirst[l + 1] += levelfirst[l];
+
+    std::vector<GLuint> cursor(levelfirst, levelfirst + levels);
+    std::vector<GLuint> order(count);
+    for (size_t i = 0; i < count; ++i) order[cursor[field->lods[i]]++] = (GLuint) i;
+    ParallelFor(count, INSTANCE_GRAIN * 8, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) dst[i] = field->models[order[i]];
+    });
+}
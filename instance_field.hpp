@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+// Copies of one mesh on a wall facing the camera, as drawn by the
+// --instances stress mode. Every copy spins at its own phase so the
+// transforms change each frame.
+struct InstanceField {
+    std::vector<glm::vec3> positions;   // view space
+    std::vector<float>     phases;
+    std::vector<int>       lods;        // current level per copy, for hysteresis
+    std::vector<glm::mat4> models;      // scratch, in instance order
+    float                  distance;    // depth of the wall
+};
+
+// Shared LOD inputs; see SelectLod.
+struct InstanceLodParams {
+    const float* errors;
+    int          levels;
+    float        pxperunit;     // projection scale in pixels at unit distance
+    float        threshold;
+    glm::vec3    center;        // object-space bounding sphere of the mesh
+    float        radius;
+    float        impostorPixels;    // projected diameter below which copies become impostors, 0 for never
+};
+
+// Lays count copies out on a square grid spacing apart, at the depth where
+// the whole grid fits a view with the given vertical fov and aspect.
+void MakeInstanceField(InstanceField* field, size_t count, float spacing, float fovy, float aspect);
+
+// Computes view * translate(position) * spin * local for every copy and
+// picks its LOD level, in parallel, then writes the matrices to dst grouped
+// by level: level l occupies dst[levelfirst[l], levelfirst[l + 1]), so each
+// level draws with one instanced call using levelfirst[l] as base instance.
+// With lod.impostorPixels set, copies whose bounding sphere projects smaller
+// than that go to one more level past the coarsest, so levelfirst needs
+// max(lod.levels, 1) + 2 entries instead of + 1. dst may point into a
+// mapped GL buffer.
+void FillInstanceField(
+        glm::mat4*               dst,
+        GLuint*                  levelfirst,
+        InstanceField*           field,
+        const glm::mat4&         view,
+        const glm::mat4&         local,
+        float                    time,
+        const InstanceLodParams& lod);
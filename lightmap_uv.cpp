@@ -0,0 +1,819 @@
+#include "lightmap_uv.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <glm/geometric.hpp>
+
+#include "mesh_weld.hpp"
+#include "parallel.hpp"
+
+static const uint32_t NONE = 0xffffffffu;
+
+// Triangles facing further than this from their chart's final normal would
+// project too thin, or flipped, and are moved to charts of their own.
+static const float MIN_PROJECTED_COS = 0.05f;
+
+// Atlas widths the packer tries, as multiples of the square root of the
+// total rectangle area; one per thread on most machines.
+static const float PACK_WIDTH_FACTORS[] = { 0.7f, 0.8f, 0.9f, 1.0f, 1.1f, 1.25f, 1.4f, 1.6f };
+static const size_t NUM_PACK_WIDTHS = sizeof(PACK_WIDTH_FACTORS) / sizeof(PACK_WIDTH_FACTORS[0]);
+
+// Times the density may drop before a too large atlas is accepted anyway.
+static const int MAX_SHRINK_STEPS = 16;
+
+// Charts filling less of their rectangle than this, a ring or an arc say,
+// are cut in two across the rectangle's long side, at most this many times
+// over.
+static const float MIN_CHART_FILL = 0.5f;
+static const int MAX_CHART_CUTS = 8;
+
+struct LightmapChart {
+    uint32_t  submesh;
+    uint32_t  first;        // into the submesh's SubmeshCharts::tris
+    uint32_t  count;
+    glm::vec3 normal;
+    glm::vec3 axisU;        // object space to chart space, in object units
+    glm::vec3 axisV;
+    glm::vec2 origin;       // chart-space minimum over the chart's corners
+    glm::vec2 extent;
+    float     area;         // of the surface, in square object units
+};
+
+// Charts of one submesh; triangles are submesh-local. Segmentation numbers
+// charts from 0 within the submesh, BuildCharts renumbers triChart across
+// the whole mesh once charts have been cut.
+struct SubmeshCharts {
+    std::vector<uint32_t>      triChart;    // chart of each triangle
+    std::vector<uint32_t>      tris;        // triangles grouped by chart
+    std::vector<LightmapChart> charts;
+};
+
+struct PackRect {
+    uint32_t w, h;
+};
+
+struct PackPlacement {
+    uint32_t x, y;
+    bool     rotated;       // placed turned 90 degrees counterclockwise
+};
+
+struct PackResult {
+    uint32_t                   width;
+    uint32_t                   height;
+    std::vector<PackPlacement> places;
+};
+
+struct SkylineNode {
+    uint32_t x, y, w;
+};
+
+static void ChartBasis(glm::vec3 normal, glm::vec3* right, glm::vec3* up) {
+    glm::vec3 ref = fabsf(normal.y) < 0.999f ? glm::vec3 { 0.0f, 1.0f, 0.0f } : glm::vec3 { 0.0f, 0.0f, 1.0f };
+    *right = glm::normalize(glm::cross(ref, normal));
+    *up = glm::cross(normal, *right);
+}
+
+// Ids shared by every vertex of the submesh whose position quantizes to the
+// same cell of the grid welding uses, WELD_EPSILON of the submesh's bounds
+// on a side, so corners split by seams count as one.
+static void PositionIds(std::vector<uint32_t>* ids, const GlStaticMeshVert* verts, size_t numverts) {
+    struct Key {
+        int64_t  q[3];
+        uint32_t vert;
+    };
+    glm::vec3 lo { INFINITY }, hi { -INFINITY };
+    for (size_t v = 0; v < numverts; ++v) {
+        lo = glm::min(lo, verts[v].pos);
+        hi = glm::max(hi, verts[v].pos);
+    }
+    glm::dvec3 inv { 0.0 };
+    for (int c = 0; c < 3; ++c) {
+        double range = (double) hi[c] - lo[c];
+        if (range > 0.0) inv[c] = 1.0 / (range * WELD_EPSILON);
+    }
+    std::vector<Key> keys(numverts);
+    for (size_t v = 0; v < numverts; ++v) {
+        glm::dvec3 q = (glm::dvec3 { verts[v].pos } - glm::dvec3 { lo }) * inv;
+        keys[v] = Key { { llround(q.x), llround(q.y), llround(q.z) }, (uint32_t) v };
+    }
+    std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) {
+        return std::lexicographical_compare(a.q, a.q + 3, b.q, b.q + 3);
+    });
+    ids->resize(numverts);
+    uint32_t next = 0;
+    for (size_t i = 0; i < numverts; ++i) {
+        if (i > 0 && !std::equal(keys[i].q, keys[i].q + 3, keys[i - 1].q)) next++;
+        (*ids)[keys[i].vert] = next;
+    }
+}
+
+// adj[t * 3 + k] is the triangle across edge k (corners k and k + 1) of
+// triangle t, or NONE for open and non-manifold edges.
+static void EdgeAdjacency(std::vector<uint32_t>* adj, const GLuint* indices, size_t numtris, const std::vector<uint32_t>& posid) {
+    struct Edge {
+        uint64_t key;
+        uint32_t corner;
+    };
+    std::vector<Edge> edges;
+    edges.reserve(numtris * 3);
+    for (size_t c = 0; c < numtris * 3; ++c) {
+        uint32_t a = posid[indices[c]], b = posid[indices[c % 3 == 2 ? c - 2 : c + 1]];
+        if (a == b) continue;
+        edges.push_back(Edge { (uint64_t) std::min(a, b) << 32 | std::max(a, b), (uint32_t) c });
+    }
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+        return a.key < b.key || (a.key == b.key && a.corner < b.corner);
+    });
+    adj->assign(numtris * 3, NONE);
+    for (size_t i = 0; i < edges.size();) {
+        size_t j = i + 1;
+        while (j < edges.size() && edges[j].key == edges[i].key) j++;
+        if (j - i == 2) {
+            (*adj)[edges[i].corner] = edges[i + 1].corner / 3;
+            (*adj)[edges[i + 1].corner] = edges[i].corner / 3;
+        }
+        i = j;
+    }
+}
+
+// Grows charts from seeds in triangle order, breadth first over adj, taking
+// neighbours within cosangle of the chart's running average normal.
+static void SegmentSubmesh(SubmeshCharts* out, const StaticMesh& mesh, uint32_t s, float cosangle) {
+    const StaticSubmesh& sub = mesh.submeshes[s];
+    const GlStaticMeshVert* verts = mesh.vertices.data() + sub.baseVertex;
+    const GLuint* indices = mesh.indices.data() + sub.firstIndex;
+    size_t numtris = sub.numIndices / 3;
+
+    std::vector<uint32_t> posid, adj;
+    PositionIds(&posid, verts, sub.numVertices);
+    EdgeAdjacency(&adj, indices, numtris, posid);
+
+    // Twice the area, along the normal.
+    std::vector<glm::vec3> normals(numtris);
+    for (size_t t = 0; t < numtris; ++t) {
+        glm::vec3 a = verts[indices[t * 3 + 0]].pos;
+        normals[t] = glm::cross(verts[indices[t * 3 + 1]].pos - a, verts[indices[t * 3 + 2]].pos - a);
+    }
+
+    out->triChart.assign(numtris, NONE);
+    out->tris.clear();
+    out->tris.reserve(numtris);
+    out->charts.clear();
+    std::vector<uint32_t> reseed;
+    auto direction = [](glm::vec3 sum) {
+        float len = glm::length(sum);
+        return len > 0.0f ? sum / len : glm::vec3 { 0.0f };
+    };
+    auto grow = [&](uint32_t seed) {
+        uint32_t chart = (uint32_t) out->charts.size();
+        size_t first = out->tris.size();
+        out->triChart[seed] = chart;
+        out->tris.push_back(seed);
+        glm::vec3 sum = normals[seed];
+        // tris doubles as the queue.
+        for (size_t q = first; q < out->tris.size(); ++q) {
+            uint32_t t = out->tris[q];
+            glm::vec3 dir = direction(sum);
+            for (int k = 0; k < 3; ++k) {
+                uint32_t u = adj[t * 3 + k];
+                if (u == NONE || out->triChart[u] != NONE) continue;
+                float len = glm::length(normals[u]);
+                if (len > 0.0f && dir != glm::vec3 { 0.0f } && glm::dot(normals[u], dir) < cosangle * len) continue;
+                out->triChart[u] = chart;
+                out->tris.push_back(u);
+                sum += normals[u];
+            }
+        }
+
+        glm::vec3 dir = direction(sum);
+        size_t kept = first;
+        for (size_t q = first; q < out->tris.size(); ++q) {
+            uint32_t t = out->tris[q];
+            float len = glm::length(normals[t]);
+            if (len > 0.0f && glm::dot(normals[t], dir) < MIN_PROJECTED_COS * len) {
+                out->triChart[t] = NONE;
+                reseed.push_back(t);
+            } else {
+                out->tris[kept++] = t;
+            }
+        }
+        if (kept == first) {
+            // Nothing faces the average; the seed alone always faces itself.
+            out->triChart[seed] = chart;
+            out->tris[kept++] = seed;
+            dir = direction(normals[seed]);
+        }
+        out->tris.resize(kept);
+        LightmapChart c {};
+        c.submesh = s;
+        c.first = (uint32_t) first;
+        c.count = (uint32_t) (kept - first);
+        c.normal = dir;
+        out->charts.push_back(c);
+    };
+
+    for (uint32_t t = 0; t < numtris; ++t) {
+        if (out->triChart[t] == NONE) grow(t);
+    }
+    while (!reseed.empty()) {
+        uint32_t t = reseed.back();
+        reseed.pop_back();
+        if (out->triChart[t] == NONE) grow(t);
+    }
+}
+
+static float Cross2(glm::vec2 a, glm::vec2 b) {
+    return a.x * b.y - a.y * b.x;
+}
+
+// Andrew's monotone chain; counterclockwise, without collinear points.
+static void ConvexHull(std::vector<glm::vec2>* hull, std::vector<glm::vec2>& points) {
+    std::sort(points.begin(), points.end(), [](glm::vec2 a, glm::vec2 b) {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    hull->clear();
+    if (points.size() < 3) {
+        *hull = points;
+        return;
+    }
+    hull->resize(points.size() * 2);
+    size_t k = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        while (k >= 2 && Cross2((*hull)[k - 1] - (*hull)[k - 2], points[i] - (*hull)[k - 2]) <= 0.0f) k--;
+        (*hull)[k++] = points[i];
+    }
+    for (size_t i = points.size() - 1, lower = k + 1; i-- > 0;) {
+        while (k >= lower && Cross2((*hull)[k - 1] - (*hull)[k - 2], points[i] - (*hull)[k - 2]) <= 0.0f) k--;
+        (*hull)[k++] = points[i];
+    }
+    hull->resize(k - 1);
+}
+
+// Projects the chart onto the plane of its normal, turned so the chart's
+// smallest bounding rectangle is axis aligned; one of its sides always lies
+// along a hull edge. The scale keeps the chart's area that of the surface,
+// so density comes out right on average even for tilted triangles.
+static void ParameterizeChart(LightmapChart* chart, const StaticMesh& mesh, const uint32_t* tris,
+                              std::vector<glm::vec2>* points, std::vector<glm::vec2>* hull) {
+    const StaticSubmesh& sub = mesh.submeshes[chart->submesh];
+    const GlStaticMeshVert* verts = mesh.vertices.data() + sub.baseVertex;
+    const GLuint* indices = mesh.indices.data() + sub.firstIndex;
+
+    glm::vec3 right { 1.0f, 0.0f, 0.0f }, up { 0.0f, 1.0f, 0.0f };
+    if (chart->normal != glm::vec3 { 0.0f }) ChartBasis(chart->normal, &right, &up);
+
+    float area3 = 0.0f, area2 = 0.0f;
+    points->clear();
+    for (uint32_t i = 0; i < chart->count; ++i) {
+        const GLuint* tri = indices + tris[i] * 3;
+        glm::vec3 p[3];
+        glm::vec2 q[3];
+        for (int k = 0; k < 3; ++k) {
+            p[k] = verts[tri[k]].pos;
+            q[k] = glm::vec2 { glm::dot(p[k], right), glm::dot(p[k], up) };
+            points->push_back(q[k]);
+        }
+        area3 += glm::length(glm::cross(p[1] - p[0], p[2] - p[0])) * 0.5f;
+        area2 += Cross2(q[1] - q[0], q[2] - q[0]) * 0.5f;
+    }
+    chart->area = area3;
+    float scale = area2 > 0.0f && area3 > 0.0f ? sqrtf(area3 / area2) : 1.0f;
+
+    ConvexHull(hull, *points);
+    glm::vec2 best { 1.0f, 0.0f };
+    float bestarea = INFINITY;
+    size_t edges = hull->size() > 2 ? hull->size() : hull->size() == 2 ? 1 : 0;
+    for (size_t i = 0; i < edges; ++i) {
+        glm::vec2 edge = (*hull)[(i + 1) % hull->size()] - (*hull)[i];
+        float len = glm::length(edge);
+        if (len <= 0.0f) continue;
+        glm::vec2 d = edge / len;
+        glm::vec2 lo { INFINITY }, hi { -INFINITY };
+        for (glm::vec2 h : *hull) {
+            glm::vec2 r { glm::dot(h, d), Cross2(d, h) };
+            lo = glm::min(lo, r);
+            hi = glm::max(hi, r);
+        }
+        float area = (hi.x - lo.x) * (hi.y - lo.y);
+        if (area < bestarea) {
+            bestarea = area;
+            best = d;
+        }
+    }
+
+    // (d, perp d) is a rotation of (right, up), so triangles keep their
+    // winding as seen from the chart's normal.
+    chart->axisU = (right * best.x + up * best.y) * scale;
+    chart->axisV = (up * best.x - right * best.y) * scale;
+    glm::vec2 lo { INFINITY }, hi { -INFINITY };
+    for (uint32_t i = 0; i < chart->count; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            glm::vec3 p = verts[indices[tris[i] * 3 + k]].pos;
+            glm::vec2 r { glm::dot(p, chart->axisU), glm::dot(p, chart->axisV) };
+            lo = glm::min(lo, r);
+            hi = glm::max(hi, r);
+        }
+    }
+    chart->origin = lo;
+    chart->extent = hi - lo;
+}
+
+// Whether triangles a and b, counterclockwise, overlap by more than eps:
+// no edge of either separates them. Triangles that only touch do not.
+static bool TrianglesOverlap(const glm::vec2* a, const glm::vec2* b, float eps) {
+    for (int pass = 0; pass < 2; ++pass) {
+        const glm::vec2* t = pass ? b : a;
+        const glm::vec2* o = pass ? a : b;
+        for (int k = 0; k < 3; ++k) {
+            glm::vec2 edge = t[(k + 1) % 3] - t[k];
+            float len = glm::length(edge);
+            if (len <= 0.0f) return false;
+            float inner = -INFINITY;
+            for (int j = 0; j < 3; ++j) inner = std::max(inner, Cross2(edge, o[j] - t[k]) / len);
+            if (inner < eps) return false;
+        }
+    }
+    return true;
+}
+
+// Whether any two triangles of a parameterized chart overlap, which a
+// planar projection allows where the surface folds over itself within the
+// chart's cone. Triangles are bucketed into a grid of about one cell per
+// triangle, and each pair is tested in the first cell both cover.
+static bool ChartOverlaps(const LightmapChart& chart, const StaticMesh& mesh, const uint32_t* tris,
+                          std::vector<glm::vec2>* corners, std::vector<uint32_t>* cells) {
+    const StaticSubmesh& sub = mesh.submeshes[chart.submesh];
+    const GlStaticMeshVert* verts = mesh.vertices.data() + sub.baseVertex;
+    const GLuint* indices = mesh.indices.data() + sub.firstIndex;
+    corners->resize(chart.count * 3);
+    for (uint32_t i = 0; i < chart.count; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            glm::vec3 p = verts[indices[tris[i] * 3 + k]].pos;
+            (*corners)[i * 3 + k] = glm::vec2 { glm::dot(p, chart.axisU), glm::dot(p, chart.axisV) } - chart.origin;
+        }
+    }
+
+    uint32_t side = std::max<uint32_t>(1, (uint32_t) sqrtf((float) chart.count));
+    glm::vec2 scale = glm::vec2 { (float) side } / glm::max(chart.extent, glm::vec2 { 1e-30f });
+    auto cellrange = [&](uint32_t i, glm::uvec2* lo, glm::uvec2* hi) {
+        const glm::vec2* q = corners->data() + i * 3;
+        glm::vec2 a = glm::min(q[0], glm::min(q[1], q[2])) * scale, b = glm::max(q[0], glm::max(q[1], q[2])) * scale;
+        *lo = glm::min(glm::uvec2 { glm::max(a, glm::vec2 { 0.0f }) }, glm::uvec2 { side - 1 });
+        *hi = glm::min(glm::uvec2 { glm::max(b, glm::vec2 { 0.0f }) }, glm::uvec2 { side - 1 });
+    };
+
+    // Counting sort of triangles into cells; cells[c] to cells[c + 1] index
+    // the triangles of cell c in bucket.
+    std::vector<uint32_t> count((size_t) side * side + 1, 0), bucket;
+    for (uint32_t i = 0; i < chart.count; ++i) {
+        glm::uvec2 lo, hi;
+        cellrange(i, &lo, &hi);
+        for (uint32_t y = lo.y; y <= hi.y; ++y) {
+            for (uint32_t x = lo.x; x <= hi.x; ++x) count[(size_t) y * side + x + 1]++;
+        }
+    }
+    for (size_t c = 1; c < count.size(); ++c) count[c] += count[c - 1];
+    cells->assign(count.begin(), count.end());
+    bucket.resize(count.back());
+    for (uint32_t i = 0; i < chart.count; ++i) {
+        glm::uvec2 lo, hi;
+        cellrange(i, &lo, &hi);
+        for (uint32_t y = lo.y; y <= hi.y; ++y) {
+            for (uint32_t x = lo.x; x <= hi.x; ++x) bucket[count[(size_t) y * side + x]++] = i;
+        }
+    }
+
+    float eps = 1e-5f * std::max(chart.extent.x, chart.extent.y);
+    for (uint32_t y = 0; y < side; ++y) {
+        for (uint32_t x = 0; x < side; ++x) {
+            size_t cell = (size_t) y * side + x;
+            for (uint32_t a = (*cells)[cell]; a < (*cells)[cell + 1]; ++a) {
+                glm::uvec2 alo, ahi;
+                cellrange(bucket[a], &alo, &ahi);
+                for (uint32_t b = a + 1; b < (*cells)[cell + 1]; ++b) {
+                    glm::uvec2 blo, bhi;
+                    cellrange(bucket[b], &blo, &bhi);
+                    if (glm::max(alo, blo) != glm::uvec2 { x, y }) continue;
+                    if (TrianglesOverlap(corners->data() + bucket[a] * 3, corners->data() + bucket[b] * 3, eps)) return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// Parameterizes chart and appends it to out, or cuts it in two at the
+// median triangle along its rectangle's long side, reordering its part of
+// subtris, and goes on with each half: always if its triangles overlap,
+// and up to MAX_CHART_CUTS times if it fills too little of its rectangle.
+// Halves keep the chart's normal, which every triangle faces.
+static void ParameterizeAndCut(const LightmapChart& chart, const StaticMesh& mesh, uint32_t* subtris, int cuts,
+                               std::vector<LightmapChart>* out, std::vector<glm::vec2>* points, std::vector<glm::vec2>* hull,
+                               std::vector<std::pair<float, uint32_t>>* keys, std::vector<uint32_t>* cells) {
+    LightmapChart c = chart;
+    uint32_t* tris = subtris + c.first;
+    ParameterizeChart(&c, mesh, tris, points, hull);
+    float rect = c.extent.x * c.extent.y;
+    bool sparse = cuts < MAX_CHART_CUTS && rect > 0.0f && c.area < MIN_CHART_FILL * rect;
+    if (c.count < 2 || (!sparse && !ChartOverlaps(c, mesh, tris, points, cells))) {
+        out->push_back(c);
+        return;
+    }
+
+    const StaticSubmesh& sub = mesh.submeshes[c.submesh];
+    const GlStaticMeshVert* verts = mesh.vertices.data() + sub.baseVertex;
+    const GLuint* indices = mesh.indices.data() + sub.firstIndex;
+    glm::vec3 axis = c.extent.x >= c.extent.y ? c.axisU : c.axisV;
+    keys->resize(c.count);
+    for (uint32_t i = 0; i < c.count; ++i) {
+        const GLuint* tri = indices + tris[i] * 3;
+        (*keys)[i] = std::make_pair(glm::dot(verts[tri[0]].pos + verts[tri[1]].pos + verts[tri[2]].pos, axis), tris[i]);
+    }
+    uint32_t half = c.count / 2;
+    std::nth_element(keys->begin(), keys->begin() + half, keys->end());
+    for (uint32_t i = 0; i < c.count; ++i) tris[i] = (*keys)[i].second;
+
+    LightmapChart lo = chart, hi = chart;
+    lo.count = half;
+    hi.first = chart.first + half;
+    hi.count = chart.count - half;
+    ParameterizeAndCut(lo, mesh, subtris, cuts + 1, out, points, hull, keys, cells);
+    ParameterizeAndCut(hi, mesh, subtris, cuts + 1, out, points, hull, keys, cells);
+}
+
+// Texels a chart extent long touches at any integer offset.
+static inline uint32_t ChartTexels(float extent, float texelsPerUnit) {
+    return (uint32_t) ceilf(extent * texelsPerUnit) + 1;
+}
+
+// Height a w wide rectangle would rest at with its left edge on node i, or
+// NONE if it would run past right.
+static uint32_t SkylineFit(const std::vector<SkylineNode>& sky, size_t i, uint32_t w, uint32_t right) {
+    if (sky[i].x + w > right) return NONE;
+    uint32_t y = 0;
+    for (size_t j = i; j < sky.size() && sky[j].x < sky[i].x + w; ++j) y = std::max(y, sky[j].y);
+    return y;
+}
+
+static void SkylineAdd(std::vector<SkylineNode>* sky, size_t i, uint32_t x, uint32_t top, uint32_t w) {
+    sky->insert(sky->begin() + i, SkylineNode { x, top, w });
+    uint32_t end = x + w;
+    for (size_t j = i + 1; j < sky->size();) {
+        SkylineNode& n = (*sky)[j];
+        if (n.x >= end) break;
+        if (n.x + n.w <= end) {
+            sky->erase(sky->begin() + j);
+            continue;
+        }
+        n.w -= end - n.x;
+        n.x = end;
+        break;
+    }
+    for (size_t j = 0; j + 1 < sky->size();) {
+        if ((*sky)[j].y == (*sky)[j + 1].y) {
+            (*sky)[j].w += (*sky)[j + 1].w;
+            sky->erase(sky->begin() + j + 1);
+        } else {
+            j++;
+        }
+    }
+}
+
+// Bottom-left skyline packing of rects, in order, into an atlas at most
+// width texels wide with a padding border at the left and bottom; every rect
+// carries its own padding on the right and top.
+static void PackSkyline(PackResult* out, const std::vector<PackRect>& rects, const std::vector<uint32_t>& order,
+                        uint32_t width, uint32_t padding) {
+    std::vector<SkylineNode> sky { SkylineNode { padding, padding, width - padding } };
+    out->width = padding;
+    out->height = padding;
+    out->places.assign(rects.size(), PackPlacement {});
+    for (uint32_t r : order) {
+        uint32_t besttop = NONE;
+        size_t bestnode = 0;
+        bool bestrot = false;
+        for (size_t i = 0; i < sky.size(); ++i) {
+            for (int rot = 0; rot < 2; ++rot) {
+                uint32_t w = rot ? rects[r].h : rects[r].w, h = rot ? rects[r].w : rects[r].h;
+                if (rot && w == h) continue;
+                uint32_t y = SkylineFit(sky, i, w, width);
+                if (y == NONE || y + h >= besttop) continue;
+                besttop = y + h;
+                bestnode = i;
+                bestrot = rot != 0;
+            }
+        }
+        // Every rect fits across the atlas one way or the other.
+        uint32_t w = bestrot ? rects[r].h : rects[r].w;
+        uint32_t x = sky[bestnode].x;
+        out->places[r] = PackPlacement { x, besttop - (bestrot ? rects[r].w : rects[r].h), bestrot };
+        SkylineAdd(&sky, bestnode, x, besttop, w);
+        out->width = std::max(out->width, x + w);
+        out->height = std::max(out->height, besttop);
+    }
+}
+
+// Packs rects at every width of PACK_WIDTH_FACTORS, in parallel or one
+// after another, and keeps the smallest atlas.
+static void PackCharts(PackResult* best, const std::vector<PackRect>& rects, uint32_t padding, bool parallel) {
+    double total = 0.0;
+    uint32_t narrowest = 1;
+    for (const PackRect& r : rects) {
+        total += (double) r.w * r.h;
+        narrowest = std::max(narrowest, std::min(r.w, r.h));
+    }
+    std::vector<uint32_t> order(rects.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        uint32_t amax = std::max(rects[a].w, rects[a].h), bmax = std::max(rects[b].w, rects[b].h);
+        if (amax != bmax) return amax > bmax;
+        return std::min(rects[a].w, rects[a].h) > std::min(rects[b].w, rects[b].h);
+    });
+
+    PackResult results[NUM_PACK_WIDTHS];
+    auto pack = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t width = std::max(narrowest, (uint32_t) ceil(sqrt(total) * PACK_WIDTH_FACTORS[i])) + padding;
+            PackSkyline(&results[i], rects, order, width, padding);
+        }
+    };
+    if (parallel) ParallelFor(NUM_PACK_WIDTHS, 1, pack);
+    else pack(0, NUM_PACK_WIDTHS);
+
+    size_t pick = 0;
+    for (size_t i = 1; i < NUM_PACK_WIDTHS; ++i) {
+        uint64_t area = (uint64_t) results[i].width * results[i].height;
+        uint64_t pickarea = (uint64_t) results[pick].width * results[pick].height;
+        if (area < pickarea || (area == pickarea && std::max(results[i].width, results[i].height)
+                                                  < std::max(results[pick].width, results[pick].height))) {
+            pick = i;
+        }
+    }
+    *best = std::move(results[pick]);
+}
+
+static void MakeRects(std::vector<PackRect>* rects, const std::vector<LightmapChart>& charts, float texelsPerUnit, uint32_t padding) {
+    rects->resize(charts.size());
+    for (size_t c = 0; c < charts.size(); ++c) {
+        (*rects)[c] = PackRect { ChartTexels(charts[c].extent.x, texelsPerUnit) + padding,
+                                 ChartTexels(charts[c].extent.y, texelsPerUnit) + padding };
+    }
+}
+
+// Segments and parameterizes every submesh; triChart then numbers charts
+// across the whole mesh.
+static void BuildCharts(std::vector<SubmeshCharts>* subs, std::vector<LightmapChart>* charts,
+                        const StaticMesh& mesh, const LightmapUvParams& params, LightmapUvStats* stats) {
+    auto start = std::chrono::high_resolution_clock::now();
+    subs->resize(mesh.submeshes.size());
+    float cosangle = cosf(params.maxChartAngle);
+    ParallelFor(mesh.submeshes.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t s = begin; s < end; ++s) SegmentSubmesh(&(*subs)[s], mesh, (uint32_t) s, cosangle);
+    });
+    std::vector<LightmapChart> segmented;
+    for (const SubmeshCharts& sub : *subs) segmented.insert(segmented.end(), sub.charts.begin(), sub.charts.end());
+    auto segmentend = std::chrono::high_resolution_clock::now();
+
+    // Cutting only reorders triangles within a chart's own range, so charts
+    // go in parallel; the pieces are gathered in order afterwards.
+    std::vector<std::vector<LightmapChart>> pieces(segmented.size());
+    ParallelFor(segmented.size(), 1, [&](size_t begin, size_t end) {
+        std::vector<glm::vec2> points, hull;
+        std::vector<std::pair<float, uint32_t>> keys;
+        std::vector<uint32_t> cells;
+        for (size_t c = begin; c < end; ++c) {
+            const LightmapChart& chart = segmented[c];
+            ParameterizeAndCut(chart, mesh, (*subs)[chart.submesh].tris.data(), 0, &pieces[c], &points, &hull, &keys, &cells);
+        }
+    });
+    charts->clear();
+    for (const std::vector<LightmapChart>& p : pieces) charts->insert(charts->end(), p.begin(), p.end());
+    ParallelFor(charts->size(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            const LightmapChart& chart = (*charts)[c];
+            SubmeshCharts& sub = (*subs)[chart.submesh];
+            for (uint32_t i = 0; i < chart.count; ++i) sub.triChart[sub.tris[chart.first + i]] = (uint32_t) c;
+        }
+    });
+    auto parameterized = std::chrono::high_resolution_clock::now();
+    stats->segmentMs = std::chrono::duration<double, std::milli>(segmentend - start).count();
+    stats->parameterizeMs = std::chrono::duration<double, std::milli>(parameterized - segmentend).count();
+}
+
+void GenerateLightmapUvs(StaticMesh* mesh, const LightmapUvParams& params, LightmapUvStats* stats) {
+    LightmapUvStats local {};
+    if (!stats) stats = &local;
+    *stats = LightmapUvStats {};
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<SubmeshCharts> subs;
+    std::vector<LightmapChart> charts;
+    BuildCharts(&subs, &charts, *mesh, params, stats);
+
+    // Padding does not shrink with the density, so each step goes a little
+    // further than the ratio alone asks for.
+    auto packstart = std::chrono::high_resolution_clock::now();
+    float texelsPerUnit = params.texelsPerUnit;
+    std::vector<PackRect> rects;
+    PackResult packed;
+    for (int step = 0;; ++step) {
+        MakeRects(&rects, charts, texelsPerUnit, params.padding);
+        PackCharts(&packed, rects, params.padding, true);
+        uint32_t side = std::max(packed.width, packed.height);
+        if (side <= params.maxAtlasSize) break;
+        if (step == MAX_SHRINK_STEPS) {
+            printf("lightmap uvs: %zu charts still need %ux%u texels at %.3g texels/unit, over the limit of %u\n",
+                   charts.size(), packed.width, packed.height, texelsPerUnit, params.maxAtlasSize);
+            break;
+        }
+        texelsPerUnit *= 0.97f * (float) params.maxAtlasSize / (float) side;
+    }
+    auto packend = std::chrono::high_resolution_clock::now();
+    stats->packMs = std::chrono::duration<double, std::milli>(packend - packstart).count();
+
+    // One vertex per (vertex, chart) pair, in first-use order per submesh;
+    // the indices keep their places.
+    glm::vec2 atlas { (float) packed.width, (float) packed.height };
+    std::vector<std::vector<GlStaticMeshVert>> subverts(mesh->submeshes.size());
+    std::vector<std::vector<glm::vec2>> subcoords(mesh->submeshes.size());
+    ParallelFor(mesh->submeshes.size(), 1, [&](size_t begin, size_t end) {
+        std::vector<uint32_t> head, next, chartof;
+        for (size_t s = begin; s < end; ++s) {
+            const StaticSubmesh& sub = mesh->submeshes[s];
+            const GlStaticMeshVert* verts = mesh->vertices.data() + sub.baseVertex;
+            GLuint* indices = mesh->indices.data() + sub.firstIndex;
+            head.assign(sub.numVertices, NONE);
+            next.clear();
+            chartof.clear();
+            for (GLuint i = 0; i < sub.numIndices; ++i) {
+                uint32_t c = subs[s].triChart[i / 3];
+                GLuint v = indices[i];
+                uint32_t r = head[v];
+                while (r != NONE && chartof[r] != c) r = next[r];
+                if (r == NONE) {
+                    const LightmapChart& chart = charts[c];
+                    const PackPlacement& place = packed.places[c];
+                    glm::vec3 p = verts[v].pos;
+                    glm::vec2 uv = (glm::vec2 { glm::dot(p, chart.axisU), glm::dot(p, chart.axisV) } - chart.origin) * texelsPerUnit;
+                    if (place.rotated) uv = glm::vec2 { chart.extent.y * texelsPerUnit - uv.y, uv.x };
+                    r = (uint32_t) subverts[s].size();
+                    subverts[s].push_back(verts[v]);
+                    subcoords[s].push_back((glm::vec2 { (float) place.x, (float) place.y } + uv) / atlas);
+                    chartof.push_back(c);
+                    next.push_back(head[v]);
+                    head[v] = r;
+                }
+                indices[i] = r;
+            }
+        }
+    });
+
+    stats->vertsBefore = mesh->vertices.size();
+    mesh->vertices.clear();
+    mesh->lightmapCoords.clear();
+    for (size_t s = 0; s < mesh->submeshes.size(); ++s) {
+        StaticSubmesh& sub = mesh->submeshes[s];
+        sub.baseVertex = (GLint) mesh->vertices.size();
+        sub.numVertices = (GLuint) subverts[s].size();
+        mesh->vertices.insert(mesh->vertices.end(), subverts[s].begin(), subverts[s].end());
+        mesh->lightmapCoords.insert(mesh->lightmapCoords.end(), subcoords[s].begin(), subcoords[s].end());
+    }
+    mesh->lightmap = LightmapInfo { packed.width, packed.height, texelsPerUnit, (uint32_t) charts.size() };
+
+    double rectarea = 0.0, surface = 0.0;
+    for (size_t c = 0; c < charts.size(); ++c) {
+        rectarea += (double) rects[c].w * rects[c].h;
+        surface += charts[c].area;
+    }
+    double atlasarea = std::max(1.0, (double) packed.width * packed.height);
+    stats->charts = charts.size();
+    stats->vertsAfter = mesh->vertices.size();
+    stats->width = packed.width;
+    stats->height = packed.height;
+    stats->texelsPerUnit = texelsPerUnit;
+    stats->rectEfficiency = (float) (rectarea / atlasarea);
+    stats->areaEfficiency = (float) (surface * texelsPerUnit * texelsPerUnit / atlasarea);
+    stats->totalMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    printf("lightmap uvs: %zu charts, %zu -> %zu verts, %ux%u atlas at %.3g texels/unit, %.1f%% covered, %.1f%% in chart rects, "
+           "in %.2f ms (segment %.2f, parameterize %.2f, pack %.2f)\n",
+           stats->charts, stats->vertsBefore, stats->vertsAfter, stats->width, stats->height, stats->texelsPerUnit,
+           stats->areaEfficiency * 100.0f, stats->rectEfficiency * 100.0f,
+           stats->totalMs, stats->segmentMs, stats->parameterizeMs, stats->packMs);
+}
+
+bool ValidateLightmapUvs(const StaticMesh& mesh) {
+    if (mesh.lightmapCoords.size() != mesh.vertices.size()) {
+        printf("lightmap uvs: %zu coordinates for %zu verts\n", mesh.lightmapCoords.size(), mesh.vertices.size());
+        return false;
+    }
+    uint32_t W = mesh.lightmap.width, H = mesh.lightmap.height;
+    if (W == 0 || H == 0) {
+        printf("lightmap uvs: empty atlas\n");
+        return false;
+    }
+    for (size_t v = 0; v < mesh.lightmapCoords.size(); ++v) {
+        glm::vec2 uv = mesh.lightmapCoords[v];
+        if (!(uv.x >= 0.0f && uv.x <= 1.0f && uv.y >= 0.0f && uv.y <= 1.0f)) {
+            printf("lightmap uvs: vert %zu at (%g, %g), outside the atlas\n", v, uv.x, uv.y);
+            return false;
+        }
+    }
+
+    // Centres closer than this to an edge count for neither side, so the
+    // two triangles of a shared edge never both claim one.
+    const float EDGE_MARGIN = 0.01f;
+    glm::vec2 atlas { (float) W, (float) H };
+    std::vector<uint32_t> owner((size_t) W * H, NONE);
+    uint32_t tri = 0;
+    for (size_t s = 0; s < mesh.submeshes.size(); ++s) {
+        const StaticSubmesh& sub = mesh.submeshes[s];
+        for (GLuint i = 0; i < sub.numIndices; i += 3, ++tri) {
+            const GLuint* corner = mesh.indices.data() + sub.firstIndex + i;
+            glm::vec3 p[3];
+            glm::vec2 q[3];
+            for (int k = 0; k < 3; ++k) {
+                p[k] = mesh.vertices[sub.baseVertex + corner[k]].pos;
+                q[k] = mesh.lightmapCoords[sub.baseVertex + corner[k]] * atlas;
+            }
+            float area3 = glm::length(glm::cross(p[1] - p[0], p[2] - p[0]));
+            float area2 = Cross2(q[1] - q[0], q[2] - q[0]);
+            if (area3 > 0.0f && area2 < 0.0f) {
+                printf("lightmap uvs: triangle %u of submesh %zu flipped\n", i / 3, s);
+                return false;
+            }
+            if (area2 <= 0.0f) continue;
+
+            glm::vec2 lo = glm::min(q[0], glm::min(q[1], q[2])), hi = glm::max(q[0], glm::max(q[1], q[2]));
+            int x0 = std::max(0, (int) floorf(lo.x - 0.5f)), x1 = std::min((int) W - 1, (int) ceilf(hi.x - 0.5f));
+            int y0 = std::max(0, (int) floorf(lo.y - 0.5f)), y1 = std::min((int) H - 1, (int) ceilf(hi.y - 0.5f));
+            float len[3];
+            for (int k = 0; k < 3; ++k) len[k] = glm::length(q[(k + 1) % 3] - q[k]);
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    glm::vec2 c { x + 0.5f, y + 0.5f };
+                    bool inside = true;
+                    for (int k = 0; k < 3 && inside; ++k) {
+                        inside = Cross2(q[(k + 1) % 3] - q[k], c - q[k]) > EDGE_MARGIN * len[k];
+                    }
+                    if (!inside) continue;
+                    uint32_t& o = owner[(size_t) y * W + x];
+                    if (o != NONE) {
+                        printf("lightmap uvs: triangles %u and %u overlap at texel (%d, %d)\n", o, tri, x, y);
+                        return false;
+                    }
+                    o = tri;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void BenchmarkLightmapUvs(const StaticMesh& mesh, const char* name, float texelsPerUnit) {
+    static const float DENSITIES[] = { 0.25f, 0.5f, 1.0f, 2.0f, 4.0f };
+    LightmapUvStats results[sizeof(DENSITIES) / sizeof(DENSITIES[0])];
+    bool valid[sizeof(DENSITIES) / sizeof(DENSITIES[0])];
+    for (size_t d = 0; d < sizeof(DENSITIES) / sizeof(DENSITIES[0]); ++d) {
+        StaticMesh copy;
+        copy.vertices = mesh.vertices;
+        copy.indices = mesh.indices;
+        copy.submeshes = mesh.submeshes;
+        LightmapUvParams params = DEFAULT_LIGHTMAP_UV_PARAMS;
+        params.texelsPerUnit = texelsPerUnit * DENSITIES[d];
+        params.maxAtlasSize = NONE;
+        GenerateLightmapUvs(&copy, params, &results[d]);
+        valid[d] = ValidateLightmapUvs(copy);
+    }
+
+    printf("%s: %zu tris, %zu submeshes, lightmap uvs\n", name, mesh.indices.size() / 3, mesh.submeshes.size());
+    printf("  texels/unit  charts     verts        atlas  covered  rects  segment ms  param ms  pack ms  total ms  valid\n");
+    for (size_t d = 0; d < sizeof(DENSITIES) / sizeof(DENSITIES[0]); ++d) {
+        const LightmapUvStats& r = results[d];
+        printf("  %11.3g  %6zu  %8zu  %5ux%-5u  %6.1f%%  %4.1f%%  %10.2f  %8.2f  %7.2f  %8.2f  %s\n",
+               r.texelsPerUnit, r.charts, r.vertsAfter, r.width, r.height, r.areaEfficiency * 100.0f, r.rectEfficiency * 100.0f,
+               r.segmentMs, r.parameterizeMs, r.packMs, r.totalMs, valid[d] ? "yes" : "NO");
+    }
+
+    // The width search alone, at the requested density, one width after
+    // another and one per thread.
+    std::vector<SubmeshCharts> subs;
+    std::vector<LightmapChart> charts;
+    LightmapUvStats stats {};
+    BuildCharts(&subs, &charts, mesh, DEFAULT_LIGHTMAP_UV_PARAMS, &stats);
+    std::vector<PackRect> rects;
+    MakeRects(&rects, charts, texelsPerUnit, DEFAULT_LIGHTMAP_UV_PARAMS.padding);
+    const int REPEATS = 5;
+    double ms[2];
+    PackResult packed;
+    for (int parallel = 0; parallel < 2; ++parallel) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < REPEATS; ++i) PackCharts(&packed, rects, DEFAULT_LIGHTMAP_UV_PARAMS.padding, parallel != 0);
+        ms[parallel] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / REPEATS;
+    }
+    printf("  packing %zu charts over %zu widths: %.2f ms serial, %.2f ms parallel (%.1fx), %ux%u atlas\n",
+           charts.size(), NUM_PACK_WIDTHS, ms[0], ms[1], ms[0] / std::max(ms[1], 1e-6), packed.width, packed.height);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "static_mesh.hpp"
+
+// Lightmap UVs: a second texture coordinate per vertex that gives every
+// triangle of a mesh texels of its own in one atlas, so lighting can be
+// baked into it instead of being estimated every frame.
+//
+// Segmentation grows charts over edges shared by position, so seams of the
+// first UV set and of the normals do not cut charts, while each triangle
+// stays within maxChartAngle of its chart's average normal. Parameterization
+// projects each chart onto the plane of that normal, turns it to the
+// smallest bounding rectangle of its convex hull and scales it so its area
+// matches the surface's. A chart whose triangles overlap in that plane, where
+// the surface folds over itself within the cone, is cut in two at its median
+// triangle until none do, and one filling under half its rectangle, a ring
+// say, is cut the same way a few times. Packing places the chart rectangles
+// with a bottom-left skyline packer, trying several atlas widths in parallel
+// and keeping the smallest atlas. Vertices used by more than one chart are
+// duplicated.
+//
+// A planar projection cannot flip a triangle facing less than 90 degrees
+// from the chart's normal, and triangles that end up further out leave for
+// charts of their own.
+
+struct LightmapUvParams {
+    float    texelsPerUnit;     // target density, texels per object-space unit
+    uint32_t padding;           // texels kept clear between charts and at the atlas border
+    float    maxChartAngle;     // radians a triangle's normal may be from its chart's
+    uint32_t maxAtlasSize;      // the density drops until the atlas fits this on both sides
+};
+
+static constexpr LightmapUvParams DEFAULT_LIGHTMAP_UV_PARAMS = { 32.0f, 2, 0.785398f, 1024 };
+
+struct LightmapUvStats {
+    size_t   charts;
+    size_t   vertsBefore;
+    size_t   vertsAfter;
+    uint32_t width;
+    uint32_t height;
+    float    texelsPerUnit;     // as packed, below the target when the atlas had to shrink
+    float    rectEfficiency;    // chart rectangles, padding included, over the atlas
+    float    areaEfficiency;    // texels covered by triangles over the atlas
+    double   segmentMs;
+    double   parameterizeMs;
+    double   packMs;
+    double   totalMs;
+};
+
+// Fills mesh->lightmapCoords and mesh->lightmap, rewriting vertices and
+// indices to split vertices along chart borders; submeshes keep their
+// index ranges. Must run before SplitStaticMesh, OptimizeStaticMesh,
+// meshlets and LODs, which carry the coordinates along. Segmentation and
+// the vertex split run in parallel over submeshes, parameterization over
+// charts and packing over candidate atlas widths.
+void GenerateLightmapUvs(StaticMesh* mesh, const LightmapUvParams& params, LightmapUvStats* stats = nullptr);
+
+// Checks that every lightmap coordinate lies inside the atlas, that no
+// triangle with area is flipped in it, and that no texel centre lies inside
+// two triangles. Centres within 1/100 texel of an edge are not counted, so
+// neighbours that meet along an edge pass. Prints the first problem.
+bool ValidateLightmapUvs(const StaticMesh& mesh);
+
+// Generates lightmap UVs for copies of mesh at a range of densities around
+// texelsPerUnit, with no atlas size limit, validates them and prints charts,
+// atlas size, packing efficiency and time per phase for each, then times
+// the search over atlas widths run one width after another against one
+// width per thread.
+void BenchmarkLightmapUvs(const StaticMesh& mesh, const char* name, float texelsPerUnit);
@@ -1,4 +1,7 @@
+#include <cctype>
+#include <cmath>
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -13,114 +16,282 @@
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/matrix_access.hpp>
 #include <glm/gtx/transform.hpp>
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 
 #include "gfx-boilerplate/fileio.hpp"
 #include "gfx-boilerplate/gl_shader.hpp"
 #include "gfx-boilerplate/gl_texture.hpp"
 #include "gfx-boilerplate/image.hpp"
 
-struct GlStaticMesh {
-    GLuint vao;
-    GLuint vbo;
-    GLuint ibo;
-};
-
-struct GlStaticMeshVert {
-    glm::vec3 pos;
-    glm::vec3 norm;
-    glm::vec3 tang;
-    glm::vec3 bitang;
-    glm::vec2 coord;
-};
-
-void LoadStaticMesh(
-        GlStaticMesh*           mesh,
-        const GlStaticMeshVert* verts,
-        size_t                  numverts,
-        const GLuint*           indices,
-        size_t                  numindices) {
-    glCreateVertexArrays(1, &mesh->vao);
-    glCreateBuffers(1, &mesh->vbo);
-    glCreateBuffers(1, &mesh->ibo);
-
-    for (int i = 0; i < 5; ++i) glEnableVertexArrayAttrib(mesh->vao, i);
-    glVertexArrayAttribFormat(mesh->vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(GlStaticMeshVert, pos));  // position
-    glVertexArrayAttribFormat(mesh->vao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(GlStaticMeshVert, norm)); // normal
-    glVertexArrayAttribFormat(mesh->vao, 2, 3, GL_FLOAT, GL_FALSE, offsetof(GlStaticMeshVert, tang)); // tangent
-    glVertexArrayAttribFormat(mesh->vao, 3, 3, GL_FLOAT, GL_FALSE, offsetof(GlStaticMeshVert, bitang)); // bitangent
-    glVertexArrayAttribFormat(mesh->vao, 4, 2, GL_FLOAT, GL_FALSE, offsetof(GlStaticMeshVert, coord)); // coord
-
-    GLuint buffers[] = { mesh->vbo, mesh->vbo, mesh->vbo, mesh->vbo, mesh->vbo };
-    GLintptr offsets[] = { 0, 0, 0, 0, 0 };
-    GLsizei strides[] = { sizeof(GlStaticMeshVert), sizeof(GlStaticMeshVert), sizeof(GlStaticMeshVert), sizeof(GlStaticMeshVert), sizeof(GlStaticMeshVert) };
-    glVertexArrayVertexBuffers(mesh->vao, 0, 5, buffers, offsets, strides);
-
-    glNamedBufferData(mesh->vbo, numverts * sizeof(GlStaticMeshVert), verts, GL_STATIC_DRAW);
-    glNamedBufferData(mesh->ibo, numindices * sizeof(GLuint), indices, GL_STATIC_DRAW);
+#include "geometry_heap.hpp"
+#include "gl_cooked_texture.hpp"
+#include "gl_gltf_mesh.hpp"
+#include "gl_impostor.hpp"
+#include "gl_mesh.hpp"
+#include "gltf_mesh.hpp"
+#include "impostor.hpp"
+#include "instance_field.hpp"
+#include "lightmap_uv.hpp"
+#include "material.hpp"
+#include "mesh_bvh.hpp"
+#include "mesh_codec.hpp"
+#include "mesh_cook.hpp"
+#include "mesh_lod.hpp"
+#include "mesh_optimize.hpp"
+#include "mesh_stream.hpp"
+#include "mesh_weld.hpp"
+#include "offset_allocator.hpp"
+#include "pack_file.hpp"
+#include "skeletal_mesh.hpp"
+#include "skinning.hpp"
+#include "texture_cache.hpp"
+#include "texture_cook.hpp"
+#include "vertex_convert.hpp"
+
+// Shader variants are selected with #defines, which have to go after the
+// #version line that starts every shader.
+static std::string InjectDefines(std::string src, const char* defines) {
+    if (!defines || !*defines) return src;
+    size_t eol = src.find('\n');
+    src.insert(eol == std::string::npos ? src.size() : eol + 1, defines);
+    return src;
 }
 
-struct StaticMesh {
-    std::vector<GlStaticMeshVert>   vertices;
-    std::vector<GLuint>             indices;
-};
+// Mounted with --pack. A pack that was never opened has no entries, so every
+// lookup falls through to the filesystem.
+static PackFile assetpack;
 
-static inline glm::vec3 ToGLMV3(aiVector3D vector) {
-    return glm::vec3 { vector.x, vector.y, vector.z };
+static std::string ReadAsset(const char* path) {
+    std::string_view packed = PackFile_View(&assetpack, path);
+    if (packed.data()) return std::string(packed);
+    return ReadEntireFile(path);
 }
 
-static inline glm::vec2 ToGLMV2(aiVector3D vector) {
-    return glm::vec2 { vector.x, vector.y };
+// The animated mesh of --skinned and --bench-skin: the given file, which must
+// carry an animation, or else the generated stress tube.
+static bool LoadSkinningMesh(SkeletalMesh* mesh, const char* path) {
+    if (!path) {
+        MakeSkinStressMesh(mesh, 32, 16, 8);
+        return true;
+    }
+    if (!LoadSkeletalMesh(mesh, path, &assetpack)) return false;
+    if (mesh->animations.empty()) {
+        printf("%s: no animations\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Whatever a material leaves unset, or every slot when the mesh has no
+// materials, comes from the Default_* set.
+static MaterialDesc DefaultMaterial() {
+    const char* paths[MATERIAL_SLOTS] = {
+        "res/Default_albedo.jpg",
+        "res/Default_metalRoughness.jpg",
+        "res/Default_normal.jpg",
+        "res/Default_AO.jpg",
+        "res/Default_emissive.jpg"
+    };
+    MaterialDesc material;
+    for (int slot = 0; slot < MATERIAL_SLOTS; ++slot) material.textures[slot].path = paths[slot];
+    return material;
 }
 
-void LoadStaticMesh(StaticMesh* mesh, const char *path) {
-    using namespace Assimp;
-    Importer imp {};
-
-    const aiScene* as = imp.ReadFile(path, aiProcess_CalcTangentSpace | aiProcess_Triangulate);
-    if (!as) exit(-1);
-    const aiMesh* m = as->mMeshes[0];
-    if (!m) exit(-1);
-
-    mesh->vertices.clear();
-    mesh->vertices.reserve(m->mNumVertices);
-    printf("%s: %u verts\n", path, m->mNumVertices);
-    for (size_t i = 0; i < m->mNumVertices; ++i) {
-        mesh->vertices.push_back(GlStaticMeshVert {
-            ToGLMV3(m->mVertices[i]),
-            ToGLMV3(m->mNormals[i]),
-            ToGLMV3(m->mTangents[i]),
-            ToGLMV3(m->mBitangents[i]),
-            ToGLMV2(m->mTextureCoords[0][i])
-        });
-    }
-
-    mesh->indices.clear();
-    mesh->indices.reserve(m->mNumFaces * 3);
-    for (size_t i = 0; i < m->mNumFaces; ++i) {
-        const aiFace& face = m->mFaces[i];
-        mesh->indices.push_back((GLuint) face.mIndices[0]);
-        mesh->indices.push_back((GLuint) face.mIndices[1]);
-        mesh->indices.push_back((GLuint) face.mIndices[2]);
+// The impostor of --impostors and --bake-impostor: read back if it was baked
+// from meshpath as it is now, at this resolution, else baked on the CPU and
+// written next to the cooked mesh.
+static const uint32_t IMPOSTOR_GRID = 12, IMPOSTOR_FRAME = 64;
+static bool LoadImpostor(ImpostorAtlas* atlas, const CookedMesh& mesh, const char* meshpath, bool rebake) {
+    std::string path = Impostor_PathFor(meshpath);
+    if (!rebake && ImpostorAtlas_Open(atlas, path.c_str(), meshpath)
+        && atlas->info.gridSize == IMPOSTOR_GRID && atlas->info.frameSize == IMPOSTOR_FRAME) {
+        return true;
     }
+    if (!BakeImpostor(atlas, mesh, DefaultMaterial(), &assetpack, IMPOSTOR_GRID, IMPOSTOR_FRAME)) return false;
+    SourceStamp stamp;
+    if (!GetSourceStamp(meshpath, &stamp) || !ImpostorAtlas_Write(*atlas, path.c_str(), stamp)) {
+        printf("%s: could not write %s, using baked impostor\n", meshpath, path.c_str());
+    }
+    return true;
 }
 
-GLuint CompilePair(const char* vpath, const char* fpath) {
-    auto vsrc = ReadEntireFile(vpath);
-    auto fsrc = ReadEntireFile(fpath);
+// inputs, the generated vertex input declarations, go to the vertex shader
+// only, after the defines.
+GLuint CompilePair(const char* vpath, const char* fpath, const char* defines = nullptr, const char* inputs = nullptr) {
+    auto vsrc = InjectDefines(InjectDefines(ReadAsset(vpath), inputs), defines);
+    auto fsrc = InjectDefines(ReadAsset(fpath), defines);
     return GL_CreateProgram(vsrc.c_str(), fsrc.c_str());
 }
 
 int main(int argc, char** argv) {
+    const char* meshpath = "res/DamagedHelmet.fbx";
+    GlStaticMesh::Format meshformat = GlStaticMesh::F_FULL;
+    bool cullmeshlets = true;
+    float lodthreshold = 1.0f;
+    size_t numinstances = 0;
+    bool instancing = true;
+    bool benchbvh = false;
+    size_t benchbvhtris = 0;
+    const char* packpath = nullptr;
+    bool stream = false;
+    size_t streamstress = 0;
+    size_t streambudget = 64;
+    size_t numskinned = 0;
+    bool gpuskinning = false;
+    const char* skinpath = nullptr;
+    size_t benchskin = 0;
+    size_t benchcodec = 0;
+    size_t benchmeshlets = 0;
+    const char* gltfpath = nullptr;
+    const char* benchgltf = nullptr;
+    bool depthprepass = false;
+    int benchdepth = 0;
+    int benchpull = 0;
+    size_t benchheap = 0;
+    float impostorpixels = 0.0f;
+    bool bakeimpostor = false;
+    bool lightmapuvs = false;
+    LightmapUvParams lightmapparams = DEFAULT_LIGHTMAP_UV_PARAMS;
+    float benchlightmap = 0.0f;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--compact") meshformat = GlStaticMesh::F_COMPACT;
+        else if (arg == "--pulled") meshformat = GlStaticMesh::F_PULLED;
+        else if (arg == "--mesh" && i + 1 < argc) meshpath = argv[++i];
+        else if (arg == "--no-cull") cullmeshlets = false;
+        else if (arg == "--lod-threshold" && i + 1 < argc) lodthreshold = (float) atof(argv[++i]);
+        else if (arg == "--instances" && i + 1 < argc) numinstances = (size_t) atoll(argv[++i]);
+        else if (arg == "--no-instancing") instancing = false;
+        else if (arg == "--impostors") {
+            impostorpixels = 48.0f;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) impostorpixels = (float) atof(argv[++i]);
+        }
+        else if (arg == "--bake-impostor") bakeimpostor = true;
+        else if (arg == "--lightmap-uvs") {
+            lightmapuvs = true;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) lightmapparams.texelsPerUnit = (float) atof(argv[++i]);
+        }
+        else if (arg == "--bench-lightmap") {
+            benchlightmap = DEFAULT_LIGHTMAP_UV_PARAMS.texelsPerUnit;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) benchlightmap = (float) atof(argv[++i]);
+        }
+        else if (arg == "--pack" && i + 1 < argc) packpath = argv[++i];
+        else if (arg == "--stream") stream = true;
+        else if (arg == "--stream-stress" && i + 1 < argc) streamstress = (size_t) atoll(argv[++i]);
+        else if (arg == "--stream-budget" && i + 1 < argc) streambudget = (size_t) atoll(argv[++i]);
+        else if (arg == "--skinned" && i + 1 < argc) numskinned = (size_t) atoll(argv[++i]);
+        else if (arg == "--gpu-skinning") gpuskinning = true;
+        else if (arg == "--skin-mesh" && i + 1 < argc) skinpath = argv[++i];
+        else if (arg == "--bench-skin") {
+            benchskin = 1000;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) benchskin = (size_t) atoll(argv[++i]);
+        }
+        else if (arg == "--bench-codec") {
+            benchcodec = 1024;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) benchcodec = (size_t) atoll(argv[++i]);
+        }
+        else if (arg == "--bench-meshlets") {
+            benchmeshlets = 1000;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) benchmeshlets = (size_t) atoll(argv[++i]);
+        }
+        else if (arg == "--gltf" && i + 1 < argc) gltfpath = argv[++i];
+        else if (arg == "--bench-gltf" && i + 1 < argc) benchgltf = argv[++i];
+        else if (arg == "--depth-prepass") depthprepass = true;
+        else if (arg == "--bench-depth") {
+            benchdepth = 100;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) benchdepth = atoi(argv[++i]);
+        }
+        else if (arg == "--bench-pull") {
+            benchpull = 100;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) benchpull = atoi(argv[++i]);
+        }
+        else if (arg == "--bench-heap") {
+            benchheap = 64;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) benchheap = (size_t) atoll(argv[++i]);
+        }
+        else if (arg == "--bench-alloc") {
+            size_t ops = 1000000;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) ops = (size_t) atoll(argv[++i]);
+            BenchmarkOffsetAllocator(ops);
+            return 0;
+        }
+        else if (arg == "--bench-bvh") benchbvh = true;
+        else if (arg == "--bench-bvh-synthetic" && i + 1 < argc) benchbvhtris = (size_t) atoll(argv[++i]);
+        else if (arg == "--bench-convert") {
+            size_t count = 10000000;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) count = (size_t) atoll(argv[++i]);
+            BenchmarkVertexConversion(count);
+            return 0;
+        }
+        else printf("unknown argument %s\n", argv[i]);
+    }
+
+    if (packpath && !PackFile_Open(&assetpack, packpath)) return -1;
+
+    if (benchskin > 0) {
+        SkeletalMesh skinmesh;
+        if (!LoadSkinningMesh(&skinmesh, skinpath)) return -1;
+        BenchmarkSkinning(skinmesh, benchskin);
+        return 0;
+    }
+    if (benchcodec > 0) {
+        // The synthetic heightfield goes through the optimizer like cooked
+        // content, so the codec sees the vertex order it will get on disk.
+        StaticMesh codecmesh;
+        if (!CookStaticMesh(&codecmesh, meshpath, &assetpack)) return -1;
+        BenchmarkMeshCodec(codecmesh, meshpath);
+        MakeStreamStressMesh(&codecmesh, benchcodec);
+        SplitStaticMesh(&codecmesh);
+        OptimizeStaticMesh(&codecmesh);
+        BenchmarkMeshCodec(codecmesh, "heightfield");
+        return 0;
+    }
+    if (benchmeshlets > 0) {
+        // The meshlets are rebuilt from the cooked mesh, as cooking does.
+        StaticMesh meshletmesh;
+        if (!CookStaticMesh(&meshletmesh, meshpath, &assetpack)) return -1;
+        BenchmarkMeshlets(meshletmesh, meshpath, benchmeshlets);
+        return 0;
+    }
+    if (benchgltf) {
+        BenchmarkGltfLoad(benchgltf, &assetpack);
+        return 0;
+    }
+    if (benchbvhtris > 0) {
+        BenchmarkBvhSynthetic(benchbvhtris, 1000000);
+        return 0;
+    }
+    if (benchlightmap > 0.0f) {
+        // The imported mesh, as CookStaticMesh hands it to
+        // GenerateLightmapUvs before splitting and optimizing.
+        StaticMesh lightmapmesh;
+        if (!LoadStaticMesh(&lightmapmesh, meshpath, &assetpack)) return -1;
+        BenchmarkLightmapUvs(lightmapmesh, meshpath, benchlightmap);
+        return 0;
+    }
+    if (bakeimpostor) {
+        // Offline and without a window: the bake never touches GL.
+        CookedMesh mesh {};
+        ImpostorAtlas atlas {};
+        if (!LoadCookedStaticMesh(&mesh, meshpath, &assetpack) || !LoadImpostor(&atlas, mesh, meshpath, true)) return -1;
+        ImpostorAtlas_Close(&atlas);
+        CookedMesh_Close(&mesh);
+        return 0;
+    }
+    if (benchbvh) {
+        CookedMesh mesh {};
+        if (!LoadCookedStaticMesh(&mesh, meshpath, &assetpack)) return -1;
+        BenchmarkBvh(mesh, 1000000);
+        CookedMesh_Close(&mesh);
+        return 0;
+    }
+
     SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
     SDL_Window* window = 
         SDL_CreateWindow("gl", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 
-                         1280, 720, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
+                         1280, 720, SDL_WINDOW_OPENGL | (benchdepth > 0 || benchpull > 0 || benchheap > 0 ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN));
     SDL_GLContext context = SDL_GL_CreateContext(window);
     SDL_GL_MakeCurrent(window, context);
     SDL_GL_SetSwapInterval(1);
@@ -128,13 +299,248 @@ int main(int argc, char** argv) {
 
     SDL_SetRelativeMouseMode(SDL_TRUE);
 
-    StaticMesh mesh;
-    LoadStaticMesh(&mesh, "res/DamagedHelmet.fbx");
+    // --gltf replaces the cooked mesh: it is drawn on its own, with its own
+    // materials, and the cooked mesh stays empty.
+    //
+    // Every F_FULL mesh goes into one geometry heap and draws from its VAO:
+    // the cooked mesh and the --gpu-skinning mesh. The rest keep VAOs of
+    // their own because their vertices are laid out differently: --compact
+    // and --pulled, glTF primitives read in their stored formats, and the
+    // persistently mapped buffers that --skinned on the CPU and streaming
+    // rewrite while drawing. So does the mesh under --bench-depth, which
+    // compares its two VAOs.
+    SkeletalMesh skinmesh;
+    if (numskinned > 0 && !LoadSkinningMesh(&skinmesh, skinpath)) return -1;
+    auto meshstart = std::chrono::high_resolution_clock::now();
+    bool meshinheap = !gltfpath && meshformat == GlStaticMesh::F_FULL && benchdepth == 0;
+    CookedMesh mesh {};
+    GeometryHeap heap;
+    GeometryHandle meshhandle = GEOMETRY_HANDLE_NONE, skinhandle = GEOMETRY_HANDLE_NONE;
+    GlStaticMesh ownmesh {};
+    GlStaticMesh& glmesh = meshinheap ? heap.mesh : ownmesh;
+    GltfAsset gltf;
+    GlGltfMesh glgltf {};
+    TextureCache texcache;
+    texcache.pack = &assetpack;
+    if (gltfpath) {
+        if (!GltfAsset_Open(&gltf, gltfpath, &assetpack)) return -1;
+        GlGltfMesh_Create(&glgltf, gltf, &texcache);
+        std::chrono::duration<double, std::milli> meshdur = std::chrono::high_resolution_clock::now() - meshstart;
+        printf("%s: %zu primitives, %zu tris, %zu materials, %zu images ready in %.2f ms\n", gltfpath, gltf.primitives.size(),
+               GltfAsset_NumTriangles(gltf), gltf.materials.size(), gltf.images.size(), meshdur.count());
+    } else {
+        if (!LoadCookedStaticMesh(&mesh, meshpath, &assetpack, lightmapuvs ? &lightmapparams : nullptr)) return -1;
+        if (!meshinheap) {
+            LoadStaticMesh(&glmesh, mesh.vertices, mesh.numVertices, mesh.indices, mesh.numIndices, mesh.indexType, meshformat,
+                           depthprepass || benchdepth > 0);
+            if (lightmapuvs && mesh.lightmapCoords) GlStaticMesh_SetLightmapCoords(&glmesh, mesh.lightmapCoords, mesh.numVertices);
+        }
+    }
 
-    GlStaticMesh glmesh;
-    LoadStaticMesh(&glmesh, mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size());
+    // Sized for exactly the meshes that go in; the impostors draw from its
+    // VAO even when it holds none.
+    bool skininheap = numskinned > 0 && gpuskinning;
+    const StaticMesh& sm = skinmesh.mesh;
+    size_t heapverts = (meshinheap ? mesh.numVertices : 0) + (skininheap ? sm.vertices.size() : 0);
+    size_t heapindices = (meshinheap ? mesh.numIndices : 0) + (skininheap ? sm.indices.size() : 0);
+    if (!GeometryHeap_Create(&heap, std::max<size_t>(heapverts, 1), std::max<size_t>(heapindices, 1), 2,
+                             meshinheap && depthprepass)) {
+        return -1;
+    }
+    if (meshinheap) {
+        meshhandle = GeometryHeap_Add(&heap, mesh.vertices, mesh.numVertices, mesh.indices, mesh.numIndices, mesh.indexType);
+        if (lightmapuvs && mesh.lightmapCoords) GeometryHeap_SetLightmapCoords(&heap, meshhandle, mesh.lightmapCoords);
+    }
+    if (skininheap) {
+        skinhandle = GeometryHeap_Add(&heap, sm.vertices.data(), sm.vertices.size(), sm.indices.data(), sm.indices.size(), GL_UNSIGNED_INT);
+        GeometryHeap_SetSkinWeights(&heap, skinhandle, skinmesh.skin.data());
+    }
+    if (!gltfpath) {
+        std::chrono::duration<double, std::milli> meshdur = std::chrono::high_resolution_clock::now() - meshstart;
+        printf("%s: %zu submeshes, %zu verts, %zu %s indices ready in %.2f ms\n", meshpath, mesh.numSubmeshes, mesh.numVertices, mesh.numIndices,
+               mesh.indexType == GL_UNSIGNED_SHORT ? "16-bit" : "32-bit", meshdur.count());
+    }
 
-    GLuint program = CompilePair("shaders/vert.glsl", "shaders/frag.glsl");
+    // LOD selection works on the whole asset: the worst error of any
+    // submesh per level, against a sphere around all vertices.
+    int lodlevels = mesh.numSubmeshes ? (int) (mesh.numLods / mesh.numSubmeshes) : 0;
+    std::vector<float> loderrors(lodlevels, 0.0f);
+    for (int level = 0; level < lodlevels; ++level) {
+        for (size_t i = 0; i < mesh.numSubmeshes; ++i) {
+            loderrors[level] = std::max(loderrors[level], mesh.lods[level * mesh.numSubmeshes + i].error);
+        }
+    }
+    glm::vec3 meshmin { INFINITY }, meshmax { -INFINITY };
+    if (gltfpath) {
+        meshmin = gltf.min;
+        meshmax = gltf.max;
+    }
+    for (size_t i = 0; i < mesh.numVertices; ++i) {
+        meshmin = glm::min(meshmin, mesh.vertices[i].pos);
+        meshmax = glm::max(meshmax, mesh.vertices[i].pos);
+    }
+    glm::vec3 meshcenter = (meshmin + meshmax) * 0.5f;
+    float meshradius = glm::length(meshmax - meshmin) * 0.5f;
+
+    // Stress mode: a wall of copies, drawn either with one instanced call per
+    // LOD level and submesh or, with --no-instancing, one call per copy.
+    // With --impostors, copies smaller on screen than the given diameter in
+    // pixels are drawn as impostor quads, all in one more instanced call.
+    const float meshscale = 1.75f;
+    InstanceField field;
+    GLuint instancebuffer = 0;
+    std::vector<glm::mat4> instancemodels;
+    bool impostors = impostorpixels > 0.0f && numinstances > 0 && instancing && !gltfpath;
+    if (impostorpixels > 0.0f && !impostors) printf("--impostors needs --instances with instancing and a cooked mesh\n");
+    std::vector<GLuint> levelfirst(std::max(lodlevels, 1) + (impostors ? 2 : 1), 0);
+    if (numinstances > 0) {
+        MakeInstanceField(&field, numinstances, meshradius * meshscale * 2.2f, glm::radians(60.0f), 1280.0f / 720.0f);
+        if (instancing) {
+            glCreateBuffers(1, &instancebuffer);
+            glNamedBufferData(instancebuffer, numinstances * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+            GlStaticMesh_SetInstanceBuffer(&glmesh, instancebuffer);
+        } else {
+            instancemodels.resize(numinstances);
+        }
+    }
+    bool instanced = numinstances > 0 && instancing;
+
+    // Skinning mode: --skinned copies of an animated mesh on a wall like the
+    // one --instances builds, each playing the clip at its own phase. The CPU
+    // path skins every copy into one of SKIN_FRAMES regions of a persistently
+    // mapped vertex buffer and draws them all with one indirect call;
+    // --gpu-skinning writes only the palettes and skins in vert.glsl, drawing
+    // the mesh out of the geometry heap.
+    const size_t SKIN_FRAMES = 3;
+    InstanceField skinfield;
+    GlStaticMesh glskin {};
+    GLuint skinpalettes = 0, skininstances = 0, skincommands = 0;
+    GlStaticMeshVert* skinverts = nullptr;
+    glm::mat4* skinmapped = nullptr;
+    std::vector<glm::mat4> skincpupalettes;
+    std::vector<float> skintimes(numskinned);
+    size_t skinregion = 0, skinjoints = 0, skinframe = 0;
+    GLsync skinfences[SKIN_FRAMES] = {};
+    GLuint skinqueries[SKIN_FRAMES] = {};
+    glm::mat4 skinlocal { 1.0f };
+    float skinradius = 1.0f;
+    if (numskinned > 0) {
+        skinjoints = skinmesh.skeleton.parents.size();
+        glm::vec3 lo { INFINITY }, hi { -INFINITY };
+        for (const GlStaticMeshVert& v : sm.vertices) {
+            lo = glm::min(lo, v.pos);
+            hi = glm::max(hi, v.pos);
+        }
+        skinradius = glm::length(hi - lo) * 0.5f;
+        skinlocal = glm::translate(glm::mat4(1.0f), -(lo + hi) * 0.5f);
+        MakeInstanceField(&skinfield, numskinned, skinradius * 2.2f, glm::radians(60.0f), 1280.0f / 720.0f);
+
+        glCreateBuffers(1, &skininstances);
+        glNamedBufferData(skininstances, numskinned * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        if (gpuskinning) {
+            // The heap's VAO has room for one instance buffer, which is
+            // --instances' when it is given; skinned copies are only drawn
+            // without it.
+            if (numinstances == 0) GlStaticMesh_SetInstanceBuffer(&heap.mesh, skininstances);
+
+            // Regions start on the storage buffer offset alignment.
+            GLint align = 256;
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &align);
+            size_t bytes = numskinned * skinjoints * sizeof(glm::mat4);
+            skinregion = (bytes + align - 1) / align * align;
+            glCreateBuffers(1, &skinpalettes);
+            glNamedBufferStorage(skinpalettes, skinregion * SKIN_FRAMES, nullptr, flags);
+            skinmapped = (glm::mat4*) glMapNamedBufferRange(skinpalettes, 0, skinregion * SKIN_FRAMES, flags);
+        } else {
+            skinregion = numskinned * sm.vertices.size();
+            skinverts = GlStaticMesh_CreateMapped(&glskin, skinregion * SKIN_FRAMES, sm.indices.data(), sm.indices.size());
+            skincpupalettes.resize(numskinned * skinjoints);
+
+            // Copy i of region r sits at vertex (r * numskinned + i) * numVertices
+            // and reads instance matrix i.
+            std::vector<GlDrawElementsIndirect> commands;
+            for (size_t r = 0; r < SKIN_FRAMES; ++r) {
+                for (size_t i = 0; i < numskinned; ++i) {
+                    for (const StaticSubmesh& sub : sm.submeshes) {
+                        commands.push_back(GlDrawElementsIndirect { sub.numIndices, 1, sub.firstIndex,
+                                                                    (GLint) ((r * numskinned + i) * sm.vertices.size()) + sub.baseVertex,
+                                                                    (GLuint) i });
+                    }
+                }
+            }
+            glCreateBuffers(1, &skincommands);
+            glNamedBufferData(skincommands, commands.size() * sizeof(GlDrawElementsIndirect), commands.data(), GL_STATIC_DRAW);
+            GlStaticMesh_SetInstanceBuffer(&glskin, skininstances);
+        }
+        glCreateQueries(GL_TIME_ELAPSED, SKIN_FRAMES, skinqueries);
+    }
+
+    // Streaming mode draws the mesh, or with --stream-stress a generated
+    // terrain, out of a fixed pool of --stream-budget MB instead of one
+    // resident buffer. The stress run flies over the terrain for
+    // STREAM_STRESS_SECONDS and then reports residency and bandwidth.
+    const double STREAM_STRESS_SECONDS = 30.0;
+    bool streaming = stream || streamstress > 0;
+    StreamedMesh streamed {};
+    MeshStreamer streamer;
+    GlStaticMesh streampool {};
+    StreamDrawList streamdraws;
+    GLsync streamfences[4] = {};
+    uint64_t streamframe = 1, streamretired = 0;
+    if (streaming) {
+        bool ok;
+        if (streamstress > 0) {
+            std::string name = "stream_stress_" + std::to_string(streamstress);
+            std::string path = Cooked_PathFor(name.c_str(), ".stream");
+            ok = StreamedMesh_Open(&streamed, path.c_str(), nullptr);
+            if (!ok) {
+                StaticMesh terrain;
+                MakeStreamStressMesh(&terrain, streamstress);
+                SourceStamp stamp { streamstress, 0 };
+                ok = StreamedMesh_Write(path.c_str(), stamp, terrain.vertices.data(), terrain.indices.data(), GL_UNSIGNED_INT,
+                                        terrain.submeshes.data(), terrain.submeshes.size())
+                  && StreamedMesh_Open(&streamed, path.c_str(), nullptr);
+            }
+        } else {
+            std::string path = StreamedMesh_PathFor(meshpath);
+            ok = StreamedMesh_Open(&streamed, path.c_str(), meshpath);
+            SourceStamp stamp;
+            if (!ok && GetSourceStamp(meshpath, &stamp)) {
+                ok = StreamedMesh_Write(path.c_str(), stamp, mesh.vertices, mesh.indices, mesh.indexType, mesh.submeshes, mesh.numSubmeshes)
+                  && StreamedMesh_Open(&streamed, path.c_str(), meshpath);
+            }
+        }
+        if (!ok) return -1;
+        size_t slotsize = StreamedMesh_SlotSize(streamed);
+        size_t poolsize = std::max<size_t>(streambudget * 1024 * 1024 / slotsize, 1) * slotsize;
+        void* pool = GlStaticMesh_CreateStreamPool(&streampool, poolsize);
+        MeshStreamer_Init(&streamer, &streamed, pool, poolsize, 2);
+    }
+
+    std::string defines;
+    if (glmesh.format == GlStaticMesh::F_COMPACT) defines += "#define COMPACT_VERTS\n";
+    if (glmesh.format == GlStaticMesh::F_PULLED) defines += "#define PULLED_VERTS\n";
+    if (instanced || numskinned > 0) defines += "#define INSTANCED\n";
+    if (numskinned > 0 && gpuskinning) defines += "#define SKINNED\n";
+    if (glmesh.lightmapVbo) defines += "#define LIGHTMAP_COORDS\n";
+    std::string inputs = GlStaticMesh_VertexInputs(glmesh.format);
+    if (numskinned > 0 && gpuskinning) inputs += VertexLayoutGlsl(SKIN_LAYOUT);
+    if (glmesh.lightmapVbo) inputs += VertexLayoutGlsl(LIGHTMAP_LAYOUT);
+    GLuint program = CompilePair("shaders/vert.glsl", "shaders/frag.glsl", defines.c_str(), inputs.c_str());
+    if (glmesh.lightmapVbo) {
+        glProgramUniform2f(program, glGetUniformLocation(program, "u_lightmap_size"),
+                           (float) mesh.lightmap.width, (float) mesh.lightmap.height);
+    } else if (lightmapuvs) {
+        printf("--lightmap-uvs needs a cooked mesh, not --gltf\n");
+    }
+    // The prepass covers the single mesh only, so it never needs INSTANCED.
+    GLuint depthprogram = 0;
+    if (glmesh.posVao) {
+        const char* depthdefines = glmesh.format == GlStaticMesh::F_COMPACT ? "#define COMPACT_VERTS\n" : "";
+        depthprogram = CompilePair("shaders/depthvert.glsl", "shaders/depthfrag.glsl", depthdefines,
+                                   GlStaticMesh_PositionInputs(glmesh.format).c_str());
+    }
     GLuint bdprogram = CompilePair("shaders/bdvert.glsl", "shaders/bdfrag.glsl");
     GLuint fbprogram = CompilePair("shaders/fbvert.glsl", "shaders/fbfrag.glsl");
     
@@ -204,40 +610,143 @@ int main(int argc, char** argv) {
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    std::vector<std::future<Image>> imageFutures;
-    std::vector<Image> images;
-    for (auto path : {
-        "res/bush_restaurant_4k.hdr",
-        "res/Default_albedo.jpg",
-        "res/Default_metalRoughness.jpg",
-        "res/Default_normal.jpg",
-        "res/Default_AO.jpg",
-        "res/Default_emissive.jpg"
-    }) {
-        std::cout << path << '\n';
-        imageFutures.push_back(std::async(std::launch::async, Image_Load, path, 4, Image::F_F32));
-    }
-    for (auto& fut : imageFutures) images.push_back(fut.get());
-
-    GLuint texture = GL_CreateTexture(images[0]);
-    GL_TextureFilter(texture, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
-    GLuint color = GL_CreateTexture(images[1]);
-    GL_TextureFilter(color, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
-    GLuint rough_metal = GL_CreateTexture(images[2]);
-    GL_TextureFilter(rough_metal, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
-    GLuint normal = GL_CreateTexture(images[3]);
-    GL_TextureFilter(normal, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
-    GLuint ao = GL_CreateTexture(images[4]); 
-    GL_TextureFilter(ao, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
-    GLuint emissive = GL_CreateTexture(images[5]); 
-    GL_TextureFilter(emissive, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
-    glGenerateTextureMipmap(texture);
-    glGenerateTextureMipmap(color);
-    glGenerateTextureMipmap(rough_metal);
-    glGenerateTextureMipmap(normal);
-    glGenerateTextureMipmap(ao);
-    glGenerateTextureMipmap(emissive);
-    for (auto& image : images) Image_Free(image);
+    // Runs in the hidden window, so with LIBGL_ALWAYS_SOFTWARE=1 (and Xvfb
+    // where there is no display) it measures a software rasterizer headless.
+    if (benchdepth > 0) {
+        if (!depthprogram) {
+            printf("--bench-depth needs a cooked mesh, not --gltf\n");
+            return -1;
+        }
+        glViewport(0, 0, 1280, 720);
+        glm::mat4 benchmvp = glm::perspective(glm::radians(60.0f), 1280.0f / 720.0f, 0.01f, 100.0f)
+                           * glm::translate(glm::mat4(1.0f), glm::vec3 { 0.0f, 0.0f, -4.0f }) * glm::scale(glm::mat4(1.0f), glm::vec3(1.75f));
+        glUseProgram(depthprogram);
+        GL_PassUniform(glGetUniformLocation(depthprogram, "u_mvp"), benchmvp);
+        glUniform3fv(glGetUniformLocation(depthprogram, "u_pos_offset"), 1, &glmesh.posOffset.x);
+        glUniform3fv(glGetUniformLocation(depthprogram, "u_pos_scale"), 1, &glmesh.posScale.x);
+        BenchmarkDepthPass(glmesh, mesh.submeshes, mesh.numSubmeshes, mesh.numVertices, depthprogram, benchdepth);
+        // GL objects go with the context.
+        CookedMesh_Close(&mesh);
+        PackFile_Close(&assetpack);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 0;
+    }
+    // The mesh in every format, each through its own vert.glsl variant and
+    // the full frag.glsl, in the hidden window like --bench-depth.
+    if (benchpull > 0) {
+        if (gltfpath) {
+            printf("--bench-pull needs a cooked mesh, not --gltf\n");
+            return -1;
+        }
+        const GlStaticMesh::Format formats[] = { GlStaticMesh::F_FULL, GlStaticMesh::F_COMPACT, GlStaticMesh::F_PULLED };
+        const char* formatdefines[] = { "", "#define COMPACT_VERTS\n", "#define PULLED_VERTS\n" };
+        GlStaticMesh benchmeshes[3] {};
+        GLuint benchprograms[3];
+        glm::mat4 benchmodel = glm::translate(glm::mat4(1.0f), glm::vec3 { 0.0f, 0.0f, -4.0f }) * glm::scale(glm::mat4(1.0f), glm::vec3(1.75f));
+        glm::mat4 benchmvp = glm::perspective(glm::radians(60.0f), 1280.0f / 720.0f, 0.01f, 100.0f) * benchmodel;
+        for (int f = 0; f < 3; ++f) {
+            LoadStaticMesh(&benchmeshes[f], mesh.vertices, mesh.numVertices, mesh.indices, mesh.numIndices, mesh.indexType, formats[f]);
+            benchprograms[f] = CompilePair("shaders/vert.glsl", "shaders/frag.glsl", formatdefines[f],
+                                           GlStaticMesh_VertexInputs(formats[f]).c_str());
+            glUseProgram(benchprograms[f]);
+            GL_PassUniform(glGetUniformLocation(benchprograms[f], "u_mvp"), benchmvp);
+            GL_PassUniform(glGetUniformLocation(benchprograms[f], "u_m"), benchmodel);
+            GL_PassUniform(glGetUniformLocation(benchprograms[f], "u_rot"), glm::mat4(1.0f));
+        }
+        BenchmarkVertexFormats(benchmeshes, benchprograms, 3, mesh.submeshes, mesh.numSubmeshes, benchpull);
+        CookedMesh_Close(&mesh);
+        PackFile_Close(&assetpack);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 0;
+    }
+    // Copies of every submesh as meshes of their own, drawn from their own
+    // buffers and from one geometry heap, in the hidden window like
+    // --bench-depth.
+    if (benchheap > 0) {
+        if (gltfpath) {
+            printf("--bench-heap needs a cooked mesh, not --gltf\n");
+            return -1;
+        }
+        glm::mat4 benchmodel = glm::translate(glm::mat4(1.0f), glm::vec3 { 0.0f, 0.0f, -4.0f }) * glm::scale(glm::mat4(1.0f), glm::vec3(1.75f));
+        glm::mat4 benchmvp = glm::perspective(glm::radians(60.0f), 1280.0f / 720.0f, 0.01f, 100.0f) * benchmodel;
+        GLuint heapprogram = CompilePair("shaders/vert.glsl", "shaders/frag.glsl", "",
+                                         GlStaticMesh_VertexInputs(GlStaticMesh::F_FULL).c_str());
+        glUseProgram(heapprogram);
+        GL_PassUniform(glGetUniformLocation(heapprogram, "u_mvp"), benchmvp);
+        GL_PassUniform(glGetUniformLocation(heapprogram, "u_m"), benchmodel);
+        GL_PassUniform(glGetUniformLocation(heapprogram, "u_rot"), glm::mat4(1.0f));
+        BenchmarkGeometryHeap(mesh.vertices, mesh.indices, mesh.indexType, mesh.submeshes, mesh.numSubmeshes, heapprogram,
+                              benchheap, 20);
+        CookedMesh_Close(&mesh);
+        PackFile_Close(&assetpack);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 0;
+    }
+
+    // Cooked textures go straight from the mounted pack or the mapped file to
+    // the GPU with their mip chain. The environment, if not cooked, is
+    // decoded to floats in the background and mipmapped by the driver, as
+    // before assetcook existed; material textures go through texcache, which
+    // decodes everything uncooked on all threads and each file only once.
+    // Packs carry textures only in cooked form.
+    const char* envpath = "res/bush_restaurant_4k.hdr";
+    auto texstart = std::chrono::high_resolution_clock::now();
+    CookedTexture cookedenv {};
+    std::string cookedenvpath = CookedTexture_PathFor(envpath);
+    std::string_view packedenv = PackFile_View(&assetpack, cookedenvpath);
+    bool envcooked = (packedenv.data() && CookedTexture_OpenMemory(&cookedenv, packedenv.data(), packedenv.size()))
+                  || CookedTexture_Open(&cookedenv, cookedenvpath.c_str(), envpath);
+    std::cout << envpath << (envcooked ? " (cooked)" : "") << '\n';
+    std::future<Image> envfuture;
+    if (!envcooked) envfuture = std::async(std::launch::async, Image_Load, envpath, 4, Image::F_F32);
+
+    std::vector<GlMaterial> materials;
+    LoadGlMaterials(&materials, &texcache, mesh.materials, DefaultMaterial());
+
+    GLuint texture;
+    if (envcooked) {
+        texture = GL_CreateCookedTexture(cookedenv);
+        CookedTexture_Close(&cookedenv);
+    } else {
+        Image image = envfuture.get();
+        texture = GL_CreateTexture(image);
+        GL_TextureFilter(texture, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
+        glGenerateTextureMipmap(texture);
+        Image_Free(image);
+    }
+    std::chrono::duration<double, std::milli> texdur = std::chrono::high_resolution_clock::now() - texstart;
+    printf("%zu materials, environment and textures ready in %.2f ms\n", materials.size(), texdur.count());
+    TextureCache_PrintStats(texcache);
+
+    // The atlases are only needed until they are uploaded.
+    GlImpostor glimpostor {};
+    GLuint impostorprogram = 0;
+    if (impostors) {
+        ImpostorAtlas atlas {};
+        impostors = LoadImpostor(&atlas, mesh, meshpath, false);
+        if (impostors) {
+            GlImpostor_Create(&glimpostor, atlas);
+            GlStaticMesh_SetInstanceBuffer(&heap.mesh, instancebuffer);
+            impostorprogram = CompilePair("shaders/impostorvert.glsl", "shaders/impostorfrag.glsl");
+        }
+        ImpostorAtlas_Close(&atlas);
+    }
+
+    // Submeshes whose material is past the end of the table draw with the
+    // default, which is last.
+    const GlMaterial* boundmaterial = nullptr;
+    auto bindmaterial = [&](GLuint submesh) {
+        const GlMaterial* m = &materials[std::min<size_t>(mesh.submeshes[submesh].material, materials.size() - 1)];
+        if (m != boundmaterial) BindGlMaterial(*m, 1);
+        boundmaterial = m;
+    };
+    auto samematerial = [&](GLuint a, GLuint b) {
+        size_t last = materials.size() - 1;
+        return std::min<size_t>(mesh.submeshes[a].material, last) == std::min<size_t>(mesh.submeshes[b].material, last);
+    };
 
     float mousex = 0.0f, mousey = 0.0f;
 
@@ -245,7 +754,10 @@ int main(int argc, char** argv) {
     float metalness = 0.0f;
     float opacity = 0.0f;
     
-    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 1280.0f / 720.0f, 0.01f, 10.0f);
+    float farplane = numinstances > 0 ? field.distance + meshradius * meshscale * 4.0f : 10.0f;
+    if (numskinned > 0) farplane = skinfield.distance + skinradius * 4.0f;
+    if (streamstress > 0) farplane = 0.6f;
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 1280.0f / 720.0f, streamstress > 0 ? 0.002f : 0.01f, farplane);
     bool running = true;
     double elapsed = 0.0;
     double delta = 0.0;
@@ -257,6 +769,18 @@ int main(int argc, char** argv) {
     float mousey_t = 0.0f;
     bool up = false, left = false, right = false, down = false;
 
+    MeshletDrawList drawlist;
+    int lod = 0;
+    size_t lodframes[MAX_LOD_LEVELS] = {};
+    size_t frames = 0;
+    double culltime = 0.0;
+    size_t culledback = 0, culledout = 0, drawranges = 0;
+    double filltime = 0.0, submittime = 0.0;
+    size_t instanceframes = 0, instancedraws = 0;
+    size_t instancelevels[MAX_LOD_LEVELS] = {}, instanceimpostors = 0;
+    double animatetime = 0.0, skintime = 0.0, skingputime = 0.0;
+    size_t skingpuframes = 0;
+
     while (running) {
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
@@ -317,8 +841,17 @@ int main(int argc, char** argv) {
             glm::rotate(glm::mat4(1.0f), (float) glm::radians(mousex * 0.0f), glm::vec3{ 0.0f, 1.0f, 0.0f })
             * glm::rotate(glm::mat4(1.0f), (float) glm::radians(mousey * 0.0f), glm::vec3{ 1.0f, 0.0f, 0.0f });
         glm::mat4 mattrans = glm::translate(glm::mat4(1.0f), glm::vec3 { 0.00f, 0.0f, -4.0f });
-        glm::mat4 matscale = glm::scale(glm::mat4(1.0f), glm::vec3(1.75f));
+        glm::mat4 matscale = glm::scale(glm::mat4(1.0f), glm::vec3(meshscale));
         glm::mat4 model = cammatrot * mattrans * matrot * matscale;
+        if (streamstress > 0) {
+            // Low, winding flight over the terrain, which spans [-1, 1]^2.
+            float t = (float) elapsed;
+            glm::vec3 eye { 0.8f * sinf(0.21f * t), 0.12f, 0.8f * sinf(0.13f * t + 1.0f) };
+            glm::vec3 ahead { 0.8f * sinf(0.21f * t + 0.2f), 0.0f, 0.8f * sinf(0.13f * t + 1.13f) };
+            model = glm::lookAt(eye, ahead, glm::vec3 { 0.0f, 1.0f, 0.0f });
+            matrot = glm::mat4(glm::mat3(model));
+            running = running && elapsed < STREAM_STRESS_SECONDS;
+        }
         glm::mat4 mvp = proj * model;
         glm::vec4 viewdir = glm::column(cammatrot, 2);
         glm::vec4 viewright = glm::column(cammatrot, 1);
@@ -352,29 +885,237 @@ int main(int argc, char** argv) {
         glBindTexture(GL_TEXTURE_2D, texture);
         GL_PassUniform(glGetUniformLocation(program, "u_env"), 0);
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, color);
         GL_PassUniform(glGetUniformLocation(program, "u_color"), 1);
-
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, rough_metal);
         GL_PassUniform(glGetUniformLocation(program, "u_roughness_metalness"), 2);
-
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, normal);
         GL_PassUniform(glGetUniformLocation(program, "u_normal"), 3);
-
-        glActiveTexture(GL_TEXTURE4);
-        glBindTexture(GL_TEXTURE_2D, ao);
         GL_PassUniform(glGetUniformLocation(program, "u_ao"), 4);
-
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, emissive);
         GL_PassUniform(glGetUniformLocation(program, "u_emissive"), 5);
 
-        glBindVertexArray(glmesh.vao);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, glmesh.ibo);
-        glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, nullptr);
+        // The post pass below reuses unit 1, so last frame's material is
+        // gone. Paths that do not draw per submesh use the default.
+        BindGlMaterial(materials.back(), 1);
+        boundmaterial = &materials.back();
+
+        GlStaticMesh_Bind(glmesh, program);
+        size_t indexsize = GlIndexSize(glmesh.indexType);
+        // Draws count instances from first of range, whose indices are
+        // relative to the cooked mesh like a submesh's: out of the heap when
+        // the mesh is in it, otherwise from glmesh's own buffers.
+        auto drawrange = [&](const StaticSubmesh& range, GLsizei count, GLuint first) {
+            if (meshinheap) {
+                GeometryHeap_Draw(heap, meshhandle, &range, 1, count, first);
+                return;
+            }
+            glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, (GLsizei) range.numIndices, glmesh.indexType,
+                                                          (void*) (range.firstIndex * indexsize), count, range.baseVertex, first);
+        };
+        // Submesh i at LOD level as a range.
+        auto lodrange = [&](int level, size_t i) {
+            const StaticLod& l = mesh.lods[level * mesh.numSubmeshes + i];
+            StaticSubmesh range = mesh.submeshes[i];
+            range.firstIndex = l.firstIndex;
+            range.numIndices = l.numIndices;
+            return range;
+        };
+        if (gltfpath) {
+            GlGltfMesh_Draw(glgltf, program, mvp, model);
+        } else if (numinstances > 0) {
+            auto submitstart = std::chrono::high_resolution_clock::now();
+            InstanceLodParams lodparams { loderrors.data(), lodlevels, proj[1][1] * 360.0f, lodthreshold, meshcenter, meshradius,
+                                          impostors ? impostorpixels : 0.0f };
+            glm::mat4* models = instancemodels.data();
+            if (instanced) {
+                models = (glm::mat4*) glMapNamedBufferRange(instancebuffer, 0, numinstances * sizeof(glm::mat4),
+                                                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            }
+            FillInstanceField(models, levelfirst.data(), &field, cammatrot, matrot * matscale, (float) elapsed, lodparams);
+            if (instanced) glUnmapNamedBuffer(instancebuffer);
+            std::chrono::duration<double, std::milli> filldur = std::chrono::high_resolution_clock::now() - submitstart;
+
+            if (instanced) GL_PassUniform(glGetUniformLocation(program, "u_vp"), proj);
+            GLint umvp = glGetUniformLocation(program, "u_mvp");
+            GLint um = glGetUniformLocation(program, "u_m");
+            for (int level = 0; level < std::max(lodlevels, 1); ++level) {
+                GLuint first = levelfirst[level], count = levelfirst[level + 1] - first;
+                instancelevels[level] += count;
+                if (count == 0) continue;
+                for (size_t i = 0; i < mesh.numSubmeshes; ++i) {
+                    StaticSubmesh range = lodrange(level, i);
+                    bindmaterial((GLuint) i);
+                    if (instanced) {
+                        drawrange(range, (GLsizei) count, first);
+                        instancedraws++;
+                        continue;
+                    }
+                    for (GLuint k = first; k < first + count; ++k) {
+                        GL_PassUniform(umvp, proj * models[k]);
+                        GL_PassUniform(um, models[k]);
+                        drawrange(range, 1, 0);
+                    }
+                    instancedraws += count;
+                }
+            }
+            if (impostors) {
+                int level = std::max(lodlevels, 1);
+                GLuint first = levelfirst[level], count = levelfirst[level + 1] - first;
+                instanceimpostors += count;
+                if (count > 0) {
+                    glUseProgram(impostorprogram);
+                    GL_PassUniform(glGetUniformLocation(impostorprogram, "u_vp"), proj);
+                    GL_PassUniform(glGetUniformLocation(impostorprogram, "u_env"), 0);
+                    GlImpostor_Bind(glimpostor, impostorprogram);
+                    GlImpostor_Draw(heap.mesh.vao, first, count);
+                    boundmaterial = nullptr;
+                    instancedraws++;
+                }
+            }
+            std::chrono::duration<double, std::milli> submitdur = std::chrono::high_resolution_clock::now() - submitstart;
+            filltime += filldur.count();
+            submittime += submitdur.count();
+            instanceframes++;
+        } else if (numskinned > 0) {
+            // The region about to be rewritten was last drawn SKIN_FRAMES
+            // frames ago; its fence also makes that frame's timer readable.
+            size_t region = skinframe % SKIN_FRAMES;
+            if (skinfences[region]) {
+                glClientWaitSync(skinfences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+                glDeleteSync(skinfences[region]);
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(skinqueries[region], GL_QUERY_RESULT, &ns);
+                skingputime += ns * 1e-6;
+                skingpuframes++;
+            }
+
+            auto animatestart = std::chrono::high_resolution_clock::now();
+            InstanceLodParams nolod { nullptr, 0, 0.0f, 0.0f, glm::vec3 { 0.0f }, 0.0f, 0.0f };
+            glm::mat4* models = (glm::mat4*) glMapNamedBufferRange(skininstances, 0, numskinned * sizeof(glm::mat4),
+                                                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            FillInstanceField(models, levelfirst.data(), &skinfield, cammatrot, skinlocal, (float) elapsed * 0.25f, nolod);
+            glUnmapNamedBuffer(skininstances);
+            for (size_t i = 0; i < numskinned; ++i) skintimes[i] = (float) elapsed + skinfield.phases[i];
+            glm::mat4* palettes = gpuskinning ? (glm::mat4*) ((char*) skinmapped + region * skinregion) : skincpupalettes.data();
+            AnimateInstances(palettes, skinmesh, skinmesh.animations[0], skintimes.data(), numskinned);
+            std::chrono::duration<double, std::milli> animatedur = std::chrono::high_resolution_clock::now() - animatestart;
+            animatetime += animatedur.count();
+
+            GL_PassUniform(glGetUniformLocation(program, "u_vp"), proj);
+            glBindVertexArray(gpuskinning ? heap.mesh.vao : glskin.vao);
+            glBeginQuery(GL_TIME_ELAPSED, skinqueries[region]);
+            if (gpuskinning) {
+                glBindBufferRange(GL_SHADER_STORAGE_BUFFER, SKIN_PALETTE_BINDING, skinpalettes, region * skinregion,
+                                  numskinned * skinjoints * sizeof(glm::mat4));
+                glUniform1i(glGetUniformLocation(program, "u_joints"), (GLint) skinjoints);
+                GeometryHeap_Draw(heap, skinhandle, sm.submeshes.data(), sm.submeshes.size(), (GLsizei) numskinned);
+            } else {
+                auto skinstart = std::chrono::high_resolution_clock::now();
+                SkinInstances(skinverts + region * skinregion, skinmesh, palettes, numskinned);
+                std::chrono::duration<double, std::milli> skindur = std::chrono::high_resolution_clock::now() - skinstart;
+                skintime += skindur.count();
+
+                size_t numcommands = numskinned * skinmesh.mesh.submeshes.size();
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, skincommands);
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*) (region * numcommands * sizeof(GlDrawElementsIndirect)),
+                                            (GLsizei) numcommands, 0);
+            }
+            glEndQuery(GL_TIME_ELAPSED);
+            skinfences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            skinframe++;
+        } else if (streaming) {
+            // Frames whose fence has signalled no longer read any pool slot;
+            // once four are in flight, wait for the oldest.
+            for (uint64_t f = streamretired + 1; f < streamframe; ++f) {
+                GLsync& fence = streamfences[f % 4];
+                GLuint64 timeout = streamframe - f >= 4 ? 1000000000ull : 0;
+                if (glClientWaitSync(fence, 0, timeout) == GL_TIMEOUT_EXPIRED) break;
+                glDeleteSync(fence);
+                fence = 0;
+                streamretired = f;
+            }
+            MeshStreamer_Update(&streamer, MakeMeshletView(mvp, model), streamframe, streamretired, &streamdraws);
+            glBindVertexArray(streampool.vao);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, streamdraws.counts.data(), GL_UNSIGNED_SHORT,
+                                          streamdraws.offsets.data(), (GLsizei) streamdraws.counts.size(),
+                                          streamdraws.baseVertices.data());
+            streamfences[streamframe % 4] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            streamframe++;
+        } else {
+            MeshletView meshview = MakeMeshletView(mvp, model);
+            float neardist = std::max(glm::length(meshview.eye - meshcenter) - meshradius, 1e-3f);
+            lod = SelectLod(loderrors.data(), lodlevels, proj[1][1] * 360.0f / neardist, lod, lodthreshold, 0.2f);
+            lodframes[lod]++;
+
+            if (lod == 0 && cullmeshlets) {
+                auto cullstart = std::chrono::high_resolution_clock::now();
+                CullMeshlets(&drawlist, mesh.meshlets, mesh.numMeshlets, meshview, indexsize);
+                // The ranges are relative to the mesh; move them to where
+                // the heap put it.
+                if (meshinheap) {
+                    const GeometryHeapMesh& placed = heap.meshes[meshhandle];
+                    for (size_t r = 0; r < drawlist.counts.size(); ++r) {
+                        drawlist.offsets[r] = (char*) drawlist.offsets[r] + placed.firstIndex * sizeof(GLuint);
+                        drawlist.baseVertices[r] += placed.baseVertex;
+                    }
+                }
+                std::chrono::duration<double, std::micro> culldur = std::chrono::high_resolution_clock::now() - cullstart;
+                culltime += culldur.count();
+                culledback += drawlist.backfacing;
+                culledout += drawlist.outside;
+                drawranges += drawlist.counts.size();
+                frames++;
+            }
+
+            // Draws the selected level, switching materials unless the pass
+            // only writes depth.
+            auto drawmesh = [&](bool depthonly) {
+                if (lod > 0) {
+                    // Meshlets only cover full detail; coarser levels are
+                    // cheap enough to draw whole.
+                    for (size_t i = 0; i < mesh.numSubmeshes; ++i) {
+                        if (!depthonly) bindmaterial((GLuint) i);
+                        drawrange(lodrange(lod, i), 1, 0);
+                    }
+                } else if (cullmeshlets) {
+                    // One multi-draw per run of ranges sharing a material.
+                    size_t n = drawlist.counts.size(), run = 0;
+                    for (size_t r = 1; r <= n; ++r) {
+                        if (r < n && (depthonly || samematerial(drawlist.submeshes[r], drawlist.submeshes[run]))) continue;
+                        if (!depthonly) bindmaterial(drawlist.submeshes[run]);
+                        glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawlist.counts.data() + run, glmesh.indexType,
+                                                      drawlist.offsets.data() + run, (GLsizei) (r - run),
+                                                      drawlist.baseVertices.data() + run);
+                        run = r;
+                    }
+                } else {
+                    for (size_t i = 0; i < mesh.numSubmeshes; ++i) {
+                        if (!depthonly) bindmaterial((GLuint) i);
+                        drawrange(mesh.submeshes[i], 1, 0);
+                    }
+                }
+            };
+
+            // The prepass fetches positions only; the colour pass then
+            // shades each pixel once, testing against the finished depth
+            // buffer without writing it.
+            if (depthprepass) {
+                glUseProgram(depthprogram);
+                GL_PassUniform(glGetUniformLocation(depthprogram, "u_mvp"), mvp);
+                glUniform3fv(glGetUniformLocation(depthprogram, "u_pos_offset"), 1, &glmesh.posOffset.x);
+                glUniform3fv(glGetUniformLocation(depthprogram, "u_pos_scale"), 1, &glmesh.posScale.x);
+                glBindVertexArray(glmesh.posVao);
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                drawmesh(true);
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                glDepthFunc(GL_LEQUAL);
+                glDepthMask(GL_FALSE);
+                glUseProgram(program);
+                glBindVertexArray(glmesh.vao);
+            }
+            drawmesh(false);
+            if (depthprepass) {
+                glDepthMask(GL_TRUE);
+                glDepthFunc(GL_LESS);
+            }
+        }
 
         glDisable(GL_DEPTH_TEST);
         glDisable(GL_CULL_FACE);
@@ -403,24 +1144,97 @@ int main(int argc, char** argv) {
         elapsed += delta;
     }
 
+    if (frames > 0 && mesh.numMeshlets > 0) {
+        printf("meshlet culling: %zu meshlets, %.1f us/frame, %.1f%% backfacing, %.1f%% outside, %.1f draw ranges/frame\n",
+               mesh.numMeshlets, culltime / frames,
+               100.0 * culledback / (frames * mesh.numMeshlets),
+               100.0 * culledout / (frames * mesh.numMeshlets),
+               (double) drawranges / frames);
+    }
+
+    if (streaming) {
+        MeshStreamer_PrintStats(streamer, elapsed);
+        MeshStreamer_Shutdown(&streamer);
+        for (GLsync fence : streamfences) {
+            if (fence) glDeleteSync(fence);
+        }
+        glUnmapNamedBuffer(streampool.vbo);
+        glDeleteVertexArrays(1, &streampool.vao);
+        glDeleteBuffers(1, &streampool.vbo);
+        StreamedMesh_Close(&streamed);
+    }
+
+    if (skinframe > 0) {
+        printf("skinning: %zu copies of %zu verts, %zu joints on the %s, animate %.3f ms/frame, cpu skin %.3f ms/frame, gpu %.3f ms/frame\n",
+               numskinned, skinmesh.mesh.vertices.size(), skinjoints, gpuskinning ? "gpu" : "cpu", animatetime / skinframe,
+               skintime / skinframe, skingpuframes ? skingputime / skingpuframes : 0.0);
+    }
+    if (numskinned > 0) {
+        for (GLsync fence : skinfences) {
+            if (fence) glDeleteSync(fence);
+        }
+        glDeleteQueries(SKIN_FRAMES, skinqueries);
+        glUnmapNamedBuffer(gpuskinning ? skinpalettes : glskin.vbo);
+        if (!gpuskinning) {
+            glDeleteVertexArrays(1, &glskin.vao);
+            glDeleteBuffers(1, &glskin.vbo);
+            glDeleteBuffers(1, &glskin.ibo);
+        }
+        GLuint buffers[] = { skinpalettes, skininstances, skincommands };
+        glDeleteBuffers(3, buffers);
+    }
+
+    if (instanceframes > 0) {
+        printf("instances: %zu copies %s, fill %.3f ms/frame, submit %.3f ms/frame, %.1f draws/frame\n",
+               numinstances, instanced ? "instanced" : "one draw each", filltime / instanceframes,
+               submittime / instanceframes, (double) instancedraws / instanceframes);
+        for (int level = 0; level < lodlevels; ++level) {
+            printf("  LOD %d: %.1f copies/frame\n", level, (double) instancelevels[level] / instanceframes);
+        }
+        if (impostors) printf("  impostor: %.1f copies/frame\n", (double) instanceimpostors / instanceframes);
+    }
+
+    for (int level = 0; level < lodlevels; ++level) {
+        size_t tris = 0;
+        for (size_t i = 0; i < mesh.numSubmeshes; ++i) tris += mesh.lods[level * mesh.numSubmeshes + i].numIndices / 3;
+        printf("LOD %d: %zu tris, error %g, drawn %zu frames\n", level, tris, loderrors[level], lodframes[level]);
+    }
+
     glDeleteTextures(1, &texture);
-    glDeleteTextures(1, &color);
     glDeleteTextures(1, &framebuffer_texture);
     glDeleteTextures(1, &framebuffer_depth);
-    glDeleteTextures(1, &emissive);
-    glDeleteTextures(1, &ao);
-    glDeleteTextures(1, &rough_metal);
     glDeleteFramebuffers(1, &framebuffer);
     glDeleteProgram(program);
     glDeleteProgram(bdprogram);
     glDeleteProgram(fbprogram);
+    if (depthprogram) glDeleteProgram(depthprogram);
     glDeleteVertexArrays(1, &backdrop_vao);
     glDeleteBuffers(1, &backdrop_verts);
     glDeleteBuffers(1, &backdrop_coords);
 
-    glDeleteVertexArrays(1, &glmesh.vao);
-    glDeleteBuffers(1, &glmesh.vbo);
-    glDeleteBuffers(1, &glmesh.ibo);
+    if (!meshinheap) {
+        glDeleteVertexArrays(1, &glmesh.vao);
+        glDeleteBuffers(1, &glmesh.vbo);
+        glDeleteBuffers(1, &glmesh.ibo);
+        if (glmesh.posVao) {
+            glDeleteVertexArrays(1, &glmesh.posVao);
+            glDeleteBuffers(1, &glmesh.posVbo);
+        }
+        if (glmesh.lightmapVbo) glDeleteBuffers(1, &glmesh.lightmapVbo);
+    }
+    GeometryHeap_Destroy(&heap);
+    if (instancebuffer) glDeleteBuffers(1, &instancebuffer);
+    if (impostors) {
+        GlImpostor_Destroy(&glimpostor);
+        glDeleteProgram(impostorprogram);
+    }
+    CookedMesh_Close(&mesh);
+    if (gltfpath) {
+        GlGltfMesh_Destroy(&glgltf);
+        GltfAsset_Close(&gltf);
+    }
+    TextureCache_Destroy(&texcache);
+    PackFile_Close(&assetpack);
 
     SDL_DestroyWindow(window);
     SDL_Quit();
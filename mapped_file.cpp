@@ -0,0 +1,106 @@
+#include "mapped_file.hpp"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile_Open(MappedFile* file, const char* path) {
+    *file = MappedFile {};
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size)) {
+        CloseHandle(handle);
+        return false;
+    }
+    file->file = handle;
+    file->size = (size_t) size.QuadPart;
+    if (file->size == 0) return true;
+
+    file->mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!file->mapping) {
+        MappedFile_Close(file);
+        return false;
+    }
+    file->data = MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!file->data) {
+        MappedFile_Close(file);
+        return false;
+    }
+    return true;
+}
+
+void MappedFile_Close(MappedFile* file) {
+    if (file->data) UnmapViewOfFile(file->data);
+    if (file->mapping) CloseHandle(file->mapping);
+    if (file->file) CloseHandle(file->file);
+    *file = MappedFile {};
+}
+
+#if _WIN32_WINNT >= 0x0602
+// PrefetchVirtualMemory has no access-pattern hint: every range is read
+// ahead the same way.
+void MappedFile_Prefetch(const MappedFile* file, size_t offset, size_t size, bool /*sequential*/) {
+    if (!file->data || offset >= file->size) return;
+    WIN32_MEMORY_RANGE_ENTRY range { (char*) file->data + offset, std::min(size, file->size - offset) };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+#else
+// Prefetching needs Windows 8; older targets leave it to the page faults.
+void MappedFile_Prefetch(const MappedFile* /*file*/, size_t /*offset*/, size_t /*size*/, bool /*sequential*/) {}
+#endif
+
+#else
+
+bool MappedFile_Open(MappedFile* file, const char* path) {
+    *file = MappedFile {};
+    file->fd = open(path, O_RDONLY);
+    if (file->fd < 0) return false;
+
+    struct stat st;
+    if (fstat(file->fd, &st) != 0) {
+        MappedFile_Close(file);
+        return false;
+    }
+    file->size = (size_t) st.st_size;
+    if (file->size == 0) return true;
+
+    void* data = mmap(nullptr, file->size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+    if (data == MAP_FAILED) {
+        MappedFile_Close(file);
+        return false;
+    }
+    file->data = data;
+    return true;
+}
+
+void MappedFile_Close(MappedFile* file) {
+    if (file->data) munmap((void*) file->data, file->size);
+    if (file->fd >= 0) close(file->fd);
+    *file = MappedFile {};
+}
+
+void MappedFile_Prefetch(const MappedFile* file, size_t offset, size_t size, bool sequential) {
+    if (!file->data || offset >= file->size) return;
+    // madvise wants a page-aligned start.
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t begin = offset & ~(page - 1);
+    size_t end = offset + std::min(size, file->size - offset);
+    char* base = (char*) file->data;
+    if (sequential) madvise(base + begin, end - begin, MADV_SEQUENTIAL);
+    madvise(base + begin, end - begin, MADV_WILLNEED);
+}
+
+#endif
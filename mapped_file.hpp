@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+
+// Read-only view of an entire file through the OS page cache. The view stays
+// valid until MappedFile_Close, so callers can hand pointers into it straight
+// to GL without copying. A MappedFile that was never opened is closed,
+// however it was declared, and closing it again is a no-op; in particular a
+// zeroed handle would be stdin, so fd starts at -1.
+struct MappedFile {
+    const void* data = nullptr;
+    size_t      size = 0;
+#ifdef _WIN32
+    void*       file = nullptr;
+    void*       mapping = nullptr;
+#else
+    int         fd = -1;
+#endif
+};
+
+bool MappedFile_Open(MappedFile* file, const char* path);
+void MappedFile_Close(MappedFile* file);
+
+// Hints that [offset, offset + size) of the view will be read soon, front to
+// back when sequential is set. Purely advisory; failures are ignored.
+void MappedFile_Prefetch(const MappedFile* file, size_t offset, size_t size, bool sequential);
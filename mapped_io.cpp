@@ -0,0 +1,91 @@
+#include "mapped_io.hpp"
+
+#include <string.h>
+#include <algorithm>
+
+MappedIOStream::MappedIOStream(const void* data, size_t size)
+    : data((const char*) data), size(size), cursor(0), file {}, ownsFile(false) {
+}
+
+MappedIOStream::MappedIOStream(const MappedFile& file)
+    : data((const char*) file.data), size(file.size), cursor(0), file(file), ownsFile(true) {
+}
+
+MappedIOStream::~MappedIOStream() {
+    if (ownsFile) MappedFile_Close(&file);
+}
+
+size_t MappedIOStream::Read(void* buffer, size_t elemsize, size_t count) {
+    if (elemsize == 0 || cursor >= size) return 0;
+    size_t n = std::min(count, (size - cursor) / elemsize);
+    memcpy(buffer, data + cursor, n * elemsize);
+    cursor += n * elemsize;
+    return n;
+}
+
+size_t MappedIOStream::Write(const void* /*buffer*/, size_t /*elemsize*/, size_t /*count*/) {
+    return 0;
+}
+
+aiReturn MappedIOStream::Seek(size_t offset, aiOrigin origin) {
+    size_t target;
+    switch (origin) {
+        case aiOrigin_SET: target = offset; break;
+        case aiOrigin_CUR: target = cursor + offset; break;
+        // Assimp passes the distance back from the end as a positive count.
+        case aiOrigin_END: target = size - offset; break;
+        default: return aiReturn_FAILURE;
+    }
+    if (target > size) return aiReturn_FAILURE;
+    cursor = target;
+    return aiReturn_SUCCESS;
+}
+
+size_t MappedIOStream::Tell() const {
+    return cursor;
+}
+
+size_t MappedIOStream::FileSize() const {
+    return size;
+}
+
+void MappedIOStream::Flush() {
+}
+
+MappedIOSystem::MappedIOSystem(const PackFile* pack) : pack(pack) {
+}
+
+bool MappedIOSystem::Exists(const char* path) const {
+    if (PackFile_Find(pack, path)) return true;
+    MappedFile file;
+    if (!MappedFile_Open(&file, path)) return false;
+    MappedFile_Close(&file);
+    return true;
+}
+
+char MappedIOSystem::getOsSeparator() const {
+#ifdef _WIN32
+    return '\\';
+#else
+    return '/';
+#endif
+}
+
+Assimp::IOStream* MappedIOSystem::Open(const char* path, const char* mode) {
+    if (strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+')) return nullptr;
+
+    if (const PackEntry* entry = PackFile_Find(pack, path)) {
+        MappedFile_Prefetch(&pack->file, (size_t) entry->offset, (size_t) entry->size, true);
+        return new MappedIOStream(PackFile_Data(pack, entry), (size_t) entry->size);
+    }
+
+    MappedFile file;
+    if (!MappedFile_Open(&file, path)) return nullptr;
+    // Importers nearly always slurp the whole file front to back.
+    MappedFile_Prefetch(&file, 0, file.size, true);
+    return new MappedIOStream(file);
+}
+
+void MappedIOSystem::Close(Assimp::IOStream* stream) {
+    delete stream;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include "mapped_file.hpp"
+#include "pack_file.hpp"
+
+// Assimp stream over a read-only memory range. Streams opened from disk own
+// their mapping; streams served from a pack borrow the pack's.
+class MappedIOStream : public Assimp::IOStream {
+public:
+    MappedIOStream(const void* data, size_t size);
+    explicit MappedIOStream(const MappedFile& file);
+    ~MappedIOStream() override;
+
+    size_t Read(void* buffer, size_t size, size_t count) override;
+    size_t Write(const void* buffer, size_t size, size_t count) override;
+    aiReturn Seek(size_t offset, aiOrigin origin) override;
+    size_t Tell() const override;
+    size_t FileSize() const override;
+    void Flush() override;
+
+private:
+    const char* data;
+    size_t      size;
+    size_t      cursor;
+    MappedFile  file;
+    bool        ownsFile;
+};
+
+// Read-only Assimp IOSystem that maps files instead of going through stdio,
+// so importers read straight out of the page cache. Paths are looked up in
+// pack first, if given, and then on disk. The pack must outlive the system.
+class MappedIOSystem : public Assimp::IOSystem {
+public:
+    explicit MappedIOSystem(const PackFile* pack = nullptr);
+
+    bool Exists(const char* path) const override;
+    char getOsSeparator() const override;
+    Assimp::IOStream* Open(const char* path, const char* mode = "rb") override;
+    void Close(Assimp::IOStream* stream) override;
+
+private:
+    const PackFile* pack;
+};
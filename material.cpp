@@ -0,0 +1,169 @@
+#include "material.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <assimp/material.h>
+#include <assimp/scene.h>
+#include <assimp/texture.h>
+
+#include "cooked_file.hpp"
+#include "pack_file.hpp"
+#include "texture_cook.hpp"
+
+// Tried in order; the first type the material has a texture for wins.
+static const aiTextureType SLOT_TYPES[MATERIAL_SLOTS][2] = {
+    { aiTextureType_DIFFUSE,  aiTextureType_NONE },
+    { aiTextureType_UNKNOWN,  aiTextureType_SHININESS },
+    { aiTextureType_NORMALS,  aiTextureType_HEIGHT },
+    { aiTextureType_LIGHTMAP, aiTextureType_AMBIENT },
+    { aiTextureType_EMISSIVE, aiTextureType_NONE },
+};
+
+// Packs carry textures only in cooked form, so either counts.
+static bool TextureExists(const std::string& path, const PackFile* pack) {
+    SourceStamp stamp;
+    return PackFile_Find(pack, path) || PackFile_Find(pack, CookedTexture_PathFor(path.c_str())) || GetSourceStamp(path.c_str(), &stamp);
+}
+
+static std::string ResolveTexturePath(const char* assetPath, const char* texturePath, const PackFile* pack) {
+    std::string asset = assetPath, tex = texturePath;
+    std::replace(asset.begin(), asset.end(), '\\', '/');
+    std::replace(tex.begin(), tex.end(), '\\', '/');
+    while (tex.compare(0, 2, "./") == 0) tex.erase(0, 2);
+    size_t slash = asset.rfind('/');
+    std::string dir = slash == std::string::npos ? std::string() : asset.substr(0, slash + 1);
+
+    bool absolute = !tex.empty() && (tex[0] == '/' || (tex.size() > 1 && tex[1] == ':'));
+    std::string candidate = absolute ? tex : dir + tex;
+    if (TextureExists(candidate, pack)) return candidate;
+    size_t name = tex.rfind('/');
+    if (name != std::string::npos) {
+        std::string local = dir + tex.substr(name + 1);
+        if (TextureExists(local, pack)) return local;
+    }
+    return candidate;
+}
+
+static void ImportEmbedded(MaterialTexture* out, const aiTexture* tex) {
+    if (tex->mHeight == 0) {
+        const uint8_t* data = (const uint8_t*) tex->pcData;
+        out->embedded.assign(data, data + tex->mWidth);
+        return;
+    }
+    // Uncompressed payloads are BGRA texels.
+    out->width = tex->mWidth;
+    out->height = tex->mHeight;
+    out->embedded.resize((size_t) tex->mWidth * tex->mHeight * 4);
+    for (size_t i = 0; i < (size_t) tex->mWidth * tex->mHeight; ++i) {
+        const aiTexel& t = tex->pcData[i];
+        uint8_t* p = &out->embedded[i * 4];
+        p[0] = t.r;
+        p[1] = t.g;
+        p[2] = t.b;
+        p[3] = t.a;
+    }
+}
+
+void ImportSceneMaterials(std::vector<MaterialDesc>* materials, const aiScene* scene, const char* path, const PackFile* pack) {
+    materials->clear();
+    materials->resize(scene->mNumMaterials);
+    for (unsigned m = 0; m < scene->mNumMaterials; ++m) {
+        const aiMaterial* mat = scene->mMaterials[m];
+        MaterialDesc& desc = (*materials)[m];
+        aiString name;
+        if (mat->Get(AI_MATKEY_NAME, name) == AI_SUCCESS) desc.name = name.C_Str();
+
+        for (int slot = 0; slot < MATERIAL_SLOTS; ++slot) {
+            MaterialTexture& out = desc.textures[slot];
+            aiString texpath;
+            bool found = false;
+            for (aiTextureType type : SLOT_TYPES[slot]) {
+                if (type != aiTextureType_NONE && mat->GetTexture(type, 0, &texpath) == AI_SUCCESS && texpath.length > 0) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) continue;
+
+            if (texpath.data[0] == '*') {
+                unsigned index = (unsigned) atoi(texpath.data + 1);
+                if (index < scene->mNumTextures) ImportEmbedded(&out, scene->mTextures[index]);
+                else printf("%s: material %s refers to missing embedded texture %s\n", path, desc.name.c_str(), texpath.C_Str());
+                continue;
+            }
+            out.path = ResolveTexturePath(path, texpath.C_Str(), pack);
+        }
+    }
+}
+
+// Layout: u32 count, then per material the name and per slot the path and
+// the embedded payload, each as a u32 length and its bytes, followed by the
+// slot's u32 width and height.
+static void PutU32(std::vector<uint8_t>* dst, uint32_t v) {
+    uint8_t b[4];
+    memcpy(b, &v, 4);
+    dst->insert(dst->end(), b, b + 4);
+}
+
+static void PutBytes(std::vector<uint8_t>* dst, const void* data, size_t size) {
+    PutU32(dst, (uint32_t) size);
+    dst->insert(dst->end(), (const uint8_t*) data, (const uint8_t*) data + size);
+}
+
+void WriteMaterials(std::vector<uint8_t>* dst, const std::vector<MaterialDesc>& materials) {
+    dst->clear();
+    PutU32(dst, (uint32_t) materials.size());
+    for (const MaterialDesc& m : materials) {
+        PutBytes(dst, m.name.data(), m.name.size());
+        for (const MaterialTexture& t : m.textures) {
+            PutBytes(dst, t.path.data(), t.path.size());
+            PutBytes(dst, t.embedded.data(), t.embedded.size());
+            PutU32(dst, t.width);
+            PutU32(dst, t.height);
+        }
+    }
+}
+
+struct MaterialReader {
+    const uint8_t* p;
+    const uint8_t* end;
+};
+
+static bool GetU32(MaterialReader* r, uint32_t* v) {
+    if (r->end - r->p < 4) return false;
+    memcpy(v, r->p, 4);
+    r->p += 4;
+    return true;
+}
+
+static bool GetBytes(MaterialReader* r, const uint8_t** data, uint32_t* size) {
+    if (!GetU32(r, size) || (size_t) (r->end - r->p) < *size) return false;
+    *data = r->p;
+    r->p += *size;
+    return true;
+}
+
+bool ReadMaterials(std::vector<MaterialDesc>* materials, const void* src, size_t size) {
+    MaterialReader r { (const uint8_t*) src, (const uint8_t*) src + size };
+    uint32_t count;
+    materials->clear();
+    if (!GetU32(&r, &count) || count > size) return false;
+    materials->resize(count);
+    for (MaterialDesc& m : *materials) {
+        const uint8_t* data;
+        uint32_t len;
+        if (!GetBytes(&r, &data, &len)) return false;
+        m.name.assign((const char*) data, len);
+        for (MaterialTexture& t : m.textures) {
+            if (!GetBytes(&r, &data, &len)) return false;
+            t.path.assign((const char*) data, len);
+            if (!GetBytes(&r, &data, &len)) return false;
+            t.embedded.assign(data, data + len);
+            if (!GetU32(&r, &t.width) || !GetU32(&r, &t.height)) return false;
+            if (t.width && (size_t) t.width * t.height * 4 != t.embedded.size()) return false;
+        }
+    }
+    return r.p == r.end;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct PackFile;
+struct aiScene;
+
+// The textures frag.glsl samples, in the order main binds them to texture
+// units 1 to 5. u_env on unit 0 belongs to the scene, not the material.
+enum MaterialSlot {
+    MATERIAL_SLOT_COLOR,
+    MATERIAL_SLOT_ROUGHNESS_METALNESS,
+    MATERIAL_SLOT_NORMAL,
+    MATERIAL_SLOT_AO,
+    MATERIAL_SLOT_EMISSIVE,
+    MATERIAL_SLOTS
+};
+
+// Where a slot's texture comes from: a file, or an image the asset carries
+// itself. A slot with neither is unset and drawn with a default.
+struct MaterialTexture {
+    std::string          path;          // relative to the working directory, '/' separated
+    std::vector<uint8_t> embedded;      // image file contents, or raw RGBA8 if width is set
+    uint32_t             width = 0, height = 0;
+};
+
+struct MaterialDesc {
+    std::string     name;
+    MaterialTexture textures[MATERIAL_SLOTS];
+};
+
+// Reads every aiMaterial of scene, in order, so StaticSubmesh::material
+// indexes the result. Assimp's pre-PBR texture types are mapped onto the
+// slots as the common exporters fill them: diffuse to colour, unknown (the
+// glTF importer's metallicRoughness) or shininess to roughness/metalness,
+// normals or height to normal, lightmap (glTF occlusion) or ambient to AO.
+// "*N" references pull in the payload of scene->mTextures[N]. Other paths
+// are taken relative to the directory of path; if nothing exists there, the
+// bare file name in that directory is tried, since many exporters write
+// absolute paths from the artist's machine. Existence is checked in pack
+// first, as every other asset lookup is.
+void ImportSceneMaterials(std::vector<MaterialDesc>* materials, const aiScene* scene, const char* path, const PackFile* pack);
+
+// Flat serialization for cooked meshes.
+void WriteMaterials(std::vector<uint8_t>* dst, const std::vector<MaterialDesc>& materials);
+bool ReadMaterials(std::vector<MaterialDesc>* materials, const void* src, size_t size);
@@ -0,0 +1,466 @@
+#include "mesh_bvh.hpp"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <random>
+#include <thread>
+#include <glm/geometric.hpp>
+
+#include "mesh_cook.hpp"
+#include "parallel.hpp"
+#include "static_mesh.hpp"
+
+// Ranges larger than this bin in parallel; subtrees larger than
+// BVH_TASK_TRIANGLES are built on their own thread.
+static const size_t BVH_PARALLEL_BIN_TRIANGLES = 1 << 18;
+static const size_t BVH_TASK_TRIANGLES         = 1 << 14;
+static const float  BVH_TRAVERSAL_COST         = 1.0f;
+static const int    BVH_STACK_SIZE             = 64;
+
+// Past this depth ranges are split at the object median, which bounds the
+// tree depth, and with it the traversal stack, at this plus log2(triangles).
+static const int    BVH_SAH_MAX_DEPTH          = 28;
+
+struct Bounds {
+    glm::vec3 lo;
+    glm::vec3 hi;
+};
+
+static inline Bounds EmptyBounds() {
+    return Bounds { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+}
+
+static inline void Grow(Bounds* b, glm::vec3 p) {
+    b->lo = glm::min(b->lo, p);
+    b->hi = glm::max(b->hi, p);
+}
+
+static inline void Grow(Bounds* b, const Bounds& o) {
+    b->lo = glm::min(b->lo, o.lo);
+    b->hi = glm::max(b->hi, o.hi);
+}
+
+static inline float HalfArea(const Bounds& b) {
+    glm::vec3 d = glm::max(b.hi - b.lo, glm::vec3(0.0f));
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+struct BvhBuilder {
+    std::vector<Bounds>    bounds;      // per mesh triangle
+    std::vector<glm::vec3> centroids;
+    uint32_t*              refs;
+};
+
+struct RangeInfo {
+    Bounds   bounds;
+    Bounds   centroids;
+};
+
+struct BinSet {
+    Bounds   bounds[3][BVH_BINS];
+    uint32_t counts[3][BVH_BINS];
+};
+
+static RangeInfo MeasureRange(const BvhBuilder& b, size_t begin, size_t end) {
+    auto measure = [&](size_t lo, size_t hi) {
+        RangeInfo info { EmptyBounds(), EmptyBounds() };
+        for (size_t i = lo; i < hi; ++i) {
+            Grow(&info.bounds, b.bounds[b.refs[i]]);
+            Grow(&info.centroids, b.centroids[b.refs[i]]);
+        }
+        return info;
+    };
+    if (end - begin < BVH_PARALLEL_BIN_TRIANGLES) return measure(begin, end);
+
+    std::vector<RangeInfo> parts(std::max<size_t>(1, std::thread::hardware_concurrency()));
+    size_t step = (end - begin + parts.size() - 1) / parts.size();
+    ParallelFor(parts.size(), 1, [&](size_t pb, size_t pe) {
+        for (size_t p = pb; p < pe; ++p) parts[p] = measure(std::min(end, begin + p * step), std::min(end, begin + (p + 1) * step));
+    });
+    RangeInfo info { EmptyBounds(), EmptyBounds() };
+    for (const RangeInfo& p : parts) {
+        Grow(&info.bounds, p.bounds);
+        Grow(&info.centroids, p.centroids);
+    }
+    return info;
+}
+
+static inline int BinOf(float c, float lo, float scale) {
+    return std::min((int) BVH_BINS - 1, std::max(0, (int) ((c - lo) * scale)));
+}
+
+static void FillBins(const BvhBuilder& b, size_t begin, size_t end, const Bounds& cb, BinSet* bins) {
+    glm::vec3 extent = cb.hi - cb.lo;
+    glm::vec3 scale;
+    for (int a = 0; a < 3; ++a) scale[a] = extent[a] > 0.0f ? BVH_BINS / extent[a] : 0.0f;
+
+    auto fill = [&](size_t lo, size_t hi, BinSet* out) {
+        for (int a = 0; a < 3; ++a) {
+            for (unsigned k = 0; k < BVH_BINS; ++k) {
+                out->bounds[a][k] = EmptyBounds();
+                out->counts[a][k] = 0;
+            }
+        }
+        for (size_t i = lo; i < hi; ++i) {
+            uint32_t t = b.refs[i];
+            for (int a = 0; a < 3; ++a) {
+                int k = BinOf(b.centroids[t][a], cb.lo[a], scale[a]);
+                Grow(&out->bounds[a][k], b.bounds[t]);
+                out->counts[a][k]++;
+            }
+        }
+    };
+    if (end - begin < BVH_PARALLEL_BIN_TRIANGLES) {
+        fill(begin, end, bins);
+        return;
+    }
+
+    std::vector<BinSet> parts(std::max<size_t>(1, std::thread::hardware_concurrency()));
+    size_t step = (end - begin + parts.size() - 1) / parts.size();
+    ParallelFor(parts.size(), 1, [&](size_t pb, size_t pe) {
+        for (size_t p = pb; p < pe; ++p) fill(std::min(end, begin + p * step), std::min(end, begin + (p + 1) * step), &parts[p]);
+    });
+    *bins = parts[0];
+    for (size_t p = 1; p < parts.size(); ++p) {
+        for (int a = 0; a < 3; ++a) {
+            for (unsigned k = 0; k < BVH_BINS; ++k) {
+                Grow(&bins->bounds[a][k], parts[p].bounds[a][k]);
+                bins->counts[a][k] += parts[p].counts[a][k];
+            }
+        }
+    }
+}
+
+// Returns the index the range was partitioned at, or begin if it should
+// stay a leaf.
+static size_t SplitRange(const BvhBuilder& b, size_t begin, size_t end, const RangeInfo& info, int depth) {
+    size_t count = end - begin;
+    if (count <= 1) return begin;
+
+    if (depth >= BVH_SAH_MAX_DEPTH) {
+        if (count <= BVH_MAX_LEAF_TRIANGLES) return begin;
+        glm::vec3 e = info.centroids.hi - info.centroids.lo;
+        int axis = e.x > e.y ? (e.x > e.z ? 0 : 2) : (e.y > e.z ? 1 : 2);
+        size_t mid = begin + count / 2;
+        std::nth_element(b.refs + begin, b.refs + mid, b.refs + end, [&](uint32_t l, uint32_t r) {
+            return b.centroids[l][axis] < b.centroids[r][axis];
+        });
+        return mid;
+    }
+
+    int axis = -1;
+    unsigned split = 0;
+    float best = FLT_MAX;
+    glm::vec3 extent = info.centroids.hi - info.centroids.lo;
+    if (extent.x > 0.0f || extent.y > 0.0f || extent.z > 0.0f) {
+        BinSet bins;
+        FillBins(b, begin, end, info.centroids, &bins);
+        for (int a = 0; a < 3; ++a) {
+            if (extent[a] <= 0.0f) continue;
+            // Sweep from the right to get the cost of every right side,
+            // then from the left to combine.
+            float rightcost[BVH_BINS];
+            Bounds acc = EmptyBounds();
+            uint32_t n = 0;
+            for (unsigned k = BVH_BINS - 1; k > 0; --k) {
+                Grow(&acc, bins.bounds[a][k]);
+                n += bins.counts[a][k];
+                rightcost[k] = n ? HalfArea(acc) * n : 0.0f;
+            }
+            acc = EmptyBounds();
+            n = 0;
+            for (unsigned k = 0; k + 1 < BVH_BINS; ++k) {
+                Grow(&acc, bins.bounds[a][k]);
+                n += bins.counts[a][k];
+                if (n == 0 || n == count) continue;
+                float cost = HalfArea(acc) * n + rightcost[k + 1];
+                if (cost < best) {
+                    best = cost;
+                    axis = a;
+                    split = k + 1;
+                }
+            }
+        }
+    }
+
+    float leafcost = (float) count;
+    float splitcost = axis >= 0 ? BVH_TRAVERSAL_COST + best / std::max(HalfArea(info.bounds), FLT_MIN) : FLT_MAX;
+    if (count <= BVH_MAX_LEAF_TRIANGLES && leafcost <= splitcost) return begin;
+
+    if (axis < 0) {
+        // Every centroid coincides; any split is as good as another.
+        return begin + count / 2;
+    }
+    float lo = info.centroids.lo[axis];
+    float scale = BVH_BINS / extent[axis];
+    uint32_t* mid = std::partition(b.refs + begin, b.refs + end, [&](uint32_t t) {
+        return BinOf(b.centroids[t][axis], lo, scale) < (int) split;
+    });
+    return (size_t) (mid - b.refs);
+}
+
+static void BuildRange(const BvhBuilder& b, size_t begin, size_t end, int depth, std::vector<BvhNode>* out) {
+    RangeInfo info = MeasureRange(b, begin, end);
+    size_t index = out->size();
+    out->push_back(BvhNode { info.bounds.lo, (uint32_t) begin, info.bounds.hi, (uint32_t) (end - begin) });
+
+    size_t mid = SplitRange(b, begin, end, info, depth);
+    if (mid == begin) return;
+    (*out)[index].count = 0;
+
+    if (end - begin < BVH_TASK_TRIANGLES * 2) {
+        BuildRange(b, begin, mid, depth + 1, out);
+        (*out)[index].offset = (uint32_t) out->size();
+        BuildRange(b, mid, end, depth + 1, out);
+        return;
+    }
+
+    // The right subtree goes into its own array on another thread and is
+    // appended after the left one, which keeps the depth-first order.
+    std::vector<BvhNode> right;
+    auto task = std::async(std::launch::async, [&] { BuildRange(b, mid, end, depth + 1, &right); });
+    BuildRange(b, begin, mid, depth + 1, out);
+    task.get();
+
+    uint32_t base = (uint32_t) out->size();
+    (*out)[index].offset = base;
+    for (BvhNode& node : right) {
+        if (node.count == 0) node.offset += base;
+    }
+    out->insert(out->end(), right.begin(), right.end());
+}
+
+template <typename Index>
+static void BuildBvhFrom(BvhTree* bvh, const GlStaticMeshVert* verts, const StaticSubmesh* submeshes, size_t numsubmeshes, Index index) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Flatten submeshes into one triangle list, numbered in index order.
+    std::vector<size_t> firsttri(numsubmeshes + 1, 0);
+    for (size_t s = 0; s < numsubmeshes; ++s) firsttri[s + 1] = firsttri[s] + submeshes[s].numIndices / 3;
+    size_t numtris = firsttri[numsubmeshes];
+
+    bvh->tris.resize(numtris);
+    BvhBuilder b;
+    b.bounds.resize(numtris);
+    b.centroids.resize(numtris);
+    ParallelFor(numsubmeshes, 1, [&](size_t sb, size_t se) {
+        for (size_t s = sb; s < se; ++s) {
+            const StaticSubmesh& sub = submeshes[s];
+            ParallelFor(sub.numIndices / 3, 1 << 14, [&](size_t tb, size_t te) {
+                for (size_t t = tb; t < te; ++t) {
+                    glm::vec3 p0 = verts[sub.baseVertex + index(sub.firstIndex + t * 3 + 0)].pos;
+                    glm::vec3 p1 = verts[sub.baseVertex + index(sub.firstIndex + t * 3 + 1)].pos;
+                    glm::vec3 p2 = verts[sub.baseVertex + index(sub.firstIndex + t * 3 + 2)].pos;
+                    size_t id = firsttri[s] + t;
+                    bvh->tris[id] = BvhTriangle { p0, p1 - p0, p2 - p0 };
+                    b.bounds[id] = Bounds { glm::min(p0, glm::min(p1, p2)), glm::max(p0, glm::max(p1, p2)) };
+                    b.centroids[id] = (p0 + p1 + p2) * (1.0f / 3.0f);
+                }
+            });
+        }
+    });
+
+    bvh->triangles.resize(numtris);
+    for (size_t t = 0; t < numtris; ++t) bvh->triangles[t] = (uint32_t) t;
+    b.refs = bvh->triangles.data();
+
+    bvh->nodes.clear();
+    bvh->nodes.reserve(numtris / 2 + 1);
+    if (numtris > 0) BuildRange(b, 0, numtris, 0, &bvh->nodes);
+
+    // Put leaf geometry in leaf order so traversal reads it sequentially.
+    std::vector<BvhTriangle> ordered(numtris);
+    ParallelFor(numtris, 1 << 16, [&](size_t tb, size_t te) {
+        for (size_t t = tb; t < te; ++t) ordered[t] = bvh->tris[bvh->triangles[t]];
+    });
+    bvh->tris = std::move(ordered);
+
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    printf("bvh: %zu triangles, %zu nodes (%zu KiB) built in %.2f ms\n",
+           numtris, bvh->nodes.size(), bvh->nodes.size() * sizeof(BvhNode) / 1024, dur.count());
+}
+
+void BuildBvh(BvhTree* bvh, const StaticMesh& mesh) {
+    const GLuint* indices = mesh.indices.data();
+    BuildBvhFrom(bvh, mesh.vertices.data(), mesh.submeshes.data(), mesh.submeshes.size(),
+                 [indices](size_t i) { return indices[i]; });
+}
+
+void BuildBvh(BvhTree* bvh, const CookedMesh& mesh) {
+    if (mesh.indexType == GL_UNSIGNED_SHORT) {
+        auto indices = (const uint16_t*) mesh.indices;
+        BuildBvhFrom(bvh, mesh.vertices, mesh.submeshes, mesh.numSubmeshes, [indices](size_t i) { return (GLuint) indices[i]; });
+    } else {
+        auto indices = (const GLuint*) mesh.indices;
+        BuildBvhFrom(bvh, mesh.vertices, mesh.submeshes, mesh.numSubmeshes, [indices](size_t i) { return indices[i]; });
+    }
+}
+
+struct BvhRay {
+    glm::vec3 origin;
+    glm::vec3 dir;
+    glm::vec3 invdir;
+};
+
+static inline bool IntersectBounds(const BvhNode& node, const BvhRay& ray, float tmax, float* tnear) {
+    glm::vec3 t0 = (node.lo - ray.origin) * ray.invdir;
+    glm::vec3 t1 = (node.hi - ray.origin) * ray.invdir;
+    glm::vec3 tmin = glm::min(t0, t1);
+    glm::vec3 tmaxv = glm::max(t0, t1);
+    float enter = std::max(std::max(tmin.x, tmin.y), std::max(tmin.z, 0.0f));
+    float exit = std::min(std::min(tmaxv.x, tmaxv.y), std::min(tmaxv.z, tmax));
+    *tnear = enter;
+    return enter <= exit;
+}
+
+// Moller-Trumbore.
+static inline bool IntersectTriangle(const BvhTriangle& tri, const BvhRay& ray, float tmax, float* t, float* u, float* v) {
+    glm::vec3 p = glm::cross(ray.dir, tri.e2);
+    float det = glm::dot(tri.e1, p);
+    if (fabsf(det) < 1e-12f) return false;
+    float inv = 1.0f / det;
+    glm::vec3 s = ray.origin - tri.v0;
+    *u = glm::dot(s, p) * inv;
+    if (*u < 0.0f || *u > 1.0f) return false;
+    glm::vec3 q = glm::cross(s, tri.e1);
+    *v = glm::dot(ray.dir, q) * inv;
+    if (*v < 0.0f || *u + *v > 1.0f) return false;
+    *t = glm::dot(tri.e2, q) * inv;
+    return *t > 0.0f && *t < tmax;
+}
+
+template <bool AnyHit>
+static bool Traverse(const BvhTree& bvh, glm::vec3 origin, glm::vec3 dir, float tmax, BvhHit* hit) {
+    if (bvh.nodes.empty()) return false;
+    BvhRay ray { origin, dir, 1.0f / dir };
+    bool found = false;
+
+    uint32_t stack[BVH_STACK_SIZE];
+    int top = 0;
+    float tnear;
+    if (!IntersectBounds(bvh.nodes[0], ray, tmax, &tnear)) return false;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode& node = bvh.nodes[stack[--top]];
+        if (node.count > 0) {
+            for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+                float t, u, v;
+                if (!IntersectTriangle(bvh.tris[i], ray, tmax, &t, &u, &v)) continue;
+                if (AnyHit) return true;
+                tmax = t;
+                *hit = BvhHit { t, u, v, bvh.triangles[i] };
+                found = true;
+            }
+            continue;
+        }
+
+        uint32_t left = (uint32_t) (&node - bvh.nodes.data()) + 1;
+        uint32_t right = node.offset;
+        float tl, tr;
+        bool hl = IntersectBounds(bvh.nodes[left], ray, tmax, &tl);
+        bool hr = IntersectBounds(bvh.nodes[right], ray, tmax, &tr);
+        // Push the farther child first so the nearer one is popped next.
+        if (hl && hr) {
+            stack[top++] = tl < tr ? right : left;
+            stack[top++] = tl < tr ? left : right;
+        } else if (hl || hr) {
+            stack[top++] = hl ? left : right;
+        }
+    }
+    return found;
+}
+
+bool Bvh_ClosestHit(const BvhTree& bvh, glm::vec3 origin, glm::vec3 dir, float tmax, BvhHit* hit) {
+    return Traverse<false>(bvh, origin, dir, tmax, hit);
+}
+
+bool Bvh_AnyHit(const BvhTree& bvh, glm::vec3 origin, glm::vec3 dir, float tmax) {
+    return Traverse<true>(bvh, origin, dir, tmax, nullptr);
+}
+
+static void TraceBenchmark(const BvhTree& bvh, size_t numrays) {
+    if (bvh.nodes.empty()) return;
+    glm::vec3 center = (bvh.nodes[0].lo + bvh.nodes[0].hi) * 0.5f;
+    float radius = glm::length(bvh.nodes[0].hi - bvh.nodes[0].lo) * 0.5f;
+
+    // Rays start on a sphere twice the size of the bounds and aim at random
+    // points inside them.
+    struct Ray {
+        glm::vec3 origin;
+        glm::vec3 dir;
+    };
+    std::vector<Ray> rays(numrays);
+    std::mt19937 rng(7);
+    std::normal_distribution<float> normal;
+    std::uniform_real_distribution<float> unit;
+    for (Ray& r : rays) {
+        glm::vec3 a = glm::normalize(glm::vec3(normal(rng), normal(rng), normal(rng)));
+        glm::vec3 b = glm::normalize(glm::vec3(normal(rng), normal(rng), normal(rng))) * cbrtf(unit(rng));
+        r.origin = center + a * radius * 2.0f;
+        r.dir = glm::normalize(center + b * radius - r.origin);
+    }
+
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    for (int any = 0; any < 2; ++any) {
+        for (int threaded = 0; threaded < 2; ++threaded) {
+            std::vector<size_t> hits(numrays);
+            auto start = std::chrono::high_resolution_clock::now();
+            ParallelFor(numrays, threaded ? 1024 : numrays, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    BvhHit hit;
+                    hits[i] = any ? Bvh_AnyHit(bvh, rays[i].origin, rays[i].dir, FLT_MAX)
+                                  : Bvh_ClosestHit(bvh, rays[i].origin, rays[i].dir, FLT_MAX, &hit);
+                }
+            });
+            std::chrono::duration<double> dur = std::chrono::high_resolution_clock::now() - start;
+            size_t numhits = 0;
+            for (size_t h : hits) numhits += h;
+            size_t cores = threaded ? threads : 1;
+            printf("  %-8s %-9s %8.2f Mrays/s  %8.2f Mrays/s/core  %5.1f%% hit\n",
+                   any ? "any" : "closest", threaded ? "threaded" : "1 thread",
+                   numrays / dur.count() * 1e-6, numrays / dur.count() * 1e-6 / cores, 100.0 * numhits / numrays);
+        }
+    }
+}
+
+void BenchmarkBvh(const CookedMesh& mesh, size_t numrays) {
+    BvhTree bvh;
+    BuildBvh(&bvh, mesh);
+    TraceBenchmark(bvh, numrays);
+}
+
+void BenchmarkBvhSynthetic(size_t numtris, size_t numrays) {
+    // A bumpy heightfield: cheap to generate and far from uniform in size.
+    size_t side = std::max<size_t>(2, (size_t) sqrt(numtris / 2.0));
+    StaticMesh mesh;
+    mesh.vertices.resize((side + 1) * (side + 1));
+    ParallelFor(side + 1, 64, [&](size_t yb, size_t ye) {
+        for (size_t y = yb; y < ye; ++y) {
+            for (size_t x = 0; x <= side; ++x) {
+                float fx = (float) x / side, fy = (float) y / side;
+                float h = 0.05f * sinf(fx * 40.0f) * cosf(fy * 37.0f) + 0.2f * sinf(fx * 3.0f + fy * 5.0f);
+                mesh.vertices[y * (side + 1) + x].pos = glm::vec3(fx, h, fy);
+            }
+        }
+    });
+    mesh.indices.resize(side * side * 6);
+    ParallelFor(side, 64, [&](size_t yb, size_t ye) {
+        for (size_t y = yb; y < ye; ++y) {
+            for (size_t x = 0; x < side; ++x) {
+                GLuint a = (GLuint) (y * (side + 1) + x), b = a + 1, c = a + (GLuint) side + 1, d = c + 1;
+                GLuint* out = &mesh.indices[(y * side + x) * 6];
+                out[0] = a; out[1] = c; out[2] = b;
+                out[3] = b; out[4] = c; out[5] = d;
+            }
+        }
+    });
+    mesh.submeshes.push_back(StaticSubmesh { 0, (GLuint) mesh.vertices.size(), 0, (GLuint) mesh.indices.size(), 0 });
+
+    BvhTree bvh;
+    BuildBvh(&bvh, mesh);
+    TraceBenchmark(bvh, numrays);
+}
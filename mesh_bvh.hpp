@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <glm/vec3.hpp>
+
+struct StaticMesh;
+struct CookedMesh;
+
+static constexpr unsigned BVH_BINS               = 16;
+static constexpr unsigned BVH_MAX_LEAF_TRIANGLES = 4;
+
+// 32 bytes. Nodes are stored depth first: an inner node's left child
+// follows it directly and offset points at the right child. A leaf covers
+// BvhTree::triangles[offset, offset + count).
+struct BvhNode {
+    glm::vec3 lo;
+    uint32_t  offset;
+    glm::vec3 hi;
+    uint32_t  count;    // 0 for inner nodes
+};
+static_assert(sizeof(BvhNode) == 32, "BvhNode must stay 32 bytes");
+
+// Leaf triangle in the form the intersection test wants.
+struct BvhTriangle {
+    glm::vec3 v0;
+    glm::vec3 e1;
+    glm::vec3 e2;
+};
+
+// Triangles are numbered in index buffer order across all submeshes at full
+// detail: triangle t of the mesh is indices [3t, 3t + 3) of the submesh
+// ranges laid end to end. LOD ranges are not included.
+struct BvhTree {
+    std::vector<BvhNode>     nodes;
+    std::vector<uint32_t>    triangles;  // mesh triangle number, in leaf order
+    std::vector<BvhTriangle> tris;       // geometry of triangles[i]
+};
+
+struct BvhHit {
+    float    t;
+    float    u, v;      // barycentrics of vertices 1 and 2
+    uint32_t triangle;
+};
+
+// Binned SAH over BVH_BINS bins per axis. Subtrees near the root are built
+// in parallel and spliced together in depth-first order.
+void BuildBvh(BvhTree* bvh, const StaticMesh& mesh);
+void BuildBvh(BvhTree* bvh, const CookedMesh& mesh);
+
+// Nearest hit with t in (0, tmax), or false.
+bool Bvh_ClosestHit(const BvhTree& bvh, glm::vec3 origin, glm::vec3 dir, float tmax, BvhHit* hit);
+// Any hit with t in (0, tmax); cheaper, for shadow and occlusion rays.
+bool Bvh_AnyHit(const BvhTree& bvh, glm::vec3 origin, glm::vec3 dir, float tmax);
+
+// Builds a BVH over mesh, then traces numrays random rays through its
+// bounding sphere and prints build time and rays/s for both queries.
+void BenchmarkBvh(const CookedMesh& mesh, size_t numrays);
+// Same on a generated bumpy grid of about numtris triangles.
+void BenchmarkBvhSynthetic(size_t numtris, size_t numrays);
@@ -0,0 +1,851 @@
+#include "mesh_codec.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESH_CODEC_SSE 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#include "mesh_weld.hpp"
+#include "parallel.hpp"
+
+// Vertex stream: VertexStreamHeader, a VertexBlock per block, then the
+// block data.
+struct VertexStreamHeader {
+    uint32_t count;
+    uint32_t numBlocks;
+    float    offset[3];
+    float    scale[3];
+    uint32_t checksum;      // of the header, this field zeroed, then the blocks
+};
+
+struct VertexBlock {
+    uint32_t end;           // of its data, relative to the start of the block data
+    uint32_t checksum;      // of its data
+};
+
+// Index stream: IndexStreamHeader, numSegments IndexSegments, codeSize bytes
+// of triangle codes, then dataSize bytes of explicit vertex deltas.
+struct IndexStreamHeader {
+    uint32_t count;
+    uint32_t numSegments;
+    uint32_t codeSize;
+    uint32_t dataSize;
+    uint32_t checksum;      // of the header, this field zeroed, then the segments
+};
+
+struct IndexSegment {
+    uint32_t firstIndex;
+    uint32_t codeOffset;
+    uint32_t dataOffset;
+    uint32_t next;          // first vertex the "next new vertex" code refers to
+    uint32_t checksum;      // of the segment's codes, then its data
+};
+
+static const size_t LANES = 8;
+static const size_t PLANES = LANES * 2;
+static const size_t GROUP = 16;
+static const size_t VERTEX_DECODE_GRAIN = 16;   // blocks
+
+// Group widths, indexed by the 2-bit group header.
+static const uint32_t GROUP_BITS[4] = { 0, 2, 4, 8 };
+static const size_t ESCAPE_COST = 2;
+
+// Index codes: the high nibble of a triangle's first byte is the distance of
+// its shared edge in the edge FIFO, or NO_EDGE; the low nibble, and both
+// nibbles of the second byte of a NO_EDGE triangle, code a vertex.
+static const uint32_t NO_EDGE = 15;
+static const uint32_t CODE_NEXT = 0;
+static const uint32_t CODE_EXPLICIT = 15;
+static const uint32_t FIFO_SIZE = 16;
+
+// Adds src to sum as native 32-bit words, the last one zero-padded, each
+// times an odd weight that grows along the range. Odd weights keep any
+// single flipped bit visible, and growing ones catch data moved between
+// words; it costs far less than the decoding it guards.
+static uint32_t StreamChecksum(uint32_t sum, const void* src, size_t size) {
+    const uint8_t* bytes = (const uint8_t*) src;
+    uint32_t weight = 1;
+    size_t i = 0;
+    for (; i + sizeof(uint32_t) <= size; i += sizeof(uint32_t), weight += 2) {
+        uint32_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        sum += word * weight;
+    }
+    if (i < size) {
+        uint32_t word = 0;
+        memcpy(&word, bytes + i, size - i);
+        sum += word * weight;
+    }
+    return sum;
+}
+
+//
+// Vertices
+//
+
+static inline uint16_t ZigZag16(uint16_t v) {
+    return (uint16_t) ((v << 1) ^ (uint16_t) ((int16_t) v >> 15));
+}
+
+static inline uint16_t UnZigZag16(uint16_t v) {
+    return (uint16_t) ((v >> 1) ^ (uint16_t) -(int16_t) (v & 1));
+}
+
+// The eight coded attributes of a vertex. The frame is split at its field
+// boundaries so a small change of one angle stays a small delta.
+static inline void SplitLanes(const GlCompactVert& v, uint16_t lanes[LANES]) {
+    lanes[0] = v.pos[0];
+    lanes[1] = v.pos[1];
+    lanes[2] = v.pos[2];
+    lanes[3] = (uint16_t) (v.frame & 1023u);
+    lanes[4] = (uint16_t) ((v.frame >> 10) & 1023u);
+    lanes[5] = (uint16_t) (((v.frame >> 20) & 2047u) | ((v.frame >> 31) << 11));
+    lanes[6] = v.coord[0];
+    lanes[7] = v.coord[1];
+}
+
+// Inverse of SplitLanes, written the way the SIMD decoder computes it:
+// pos[3] is zero, the low frame word is lane 3 | lane 4 << 10 and the high
+// one lane 4 >> 6 | lane 5 << 4.
+static inline GlCompactVert MergeLanes(const uint16_t lanes[LANES]) {
+    GlCompactVert v;
+    v.pos[0] = lanes[0];
+    v.pos[1] = lanes[1];
+    v.pos[2] = lanes[2];
+    v.pos[3] = 0;
+    uint32_t lo = (uint16_t) (lanes[3] | (lanes[4] << 10));
+    uint32_t hi = (uint16_t) ((lanes[4] >> 6) | (lanes[5] << 4));
+    v.frame = lo | (hi << 16);
+    v.coord[0] = lanes[6];
+    v.coord[1] = lanes[7];
+    return v;
+}
+
+static void EncodePlane(std::vector<uint8_t>* dst, const uint8_t* plane, size_t groups) {
+    size_t headerPos = dst->size();
+    dst->resize(headerPos + (groups + 3) / 4, 0);
+    for (size_t g = 0; g < groups; ++g) {
+        const uint8_t* v = plane + g * GROUP;
+        // Escapes are charged twice their size: the decoder handles them a
+        // byte at a time, and a few more 8-bit groups cost less to decode
+        // than the branches they replace.
+        size_t sizes[4] = { 0, 4, 8, GROUP };
+        for (size_t i = 0; i < GROUP; ++i) {
+            if (v[i] != 0) sizes[0] = SIZE_MAX;
+            sizes[1] += (v[i] >= 3) * ESCAPE_COST;
+            sizes[2] += (v[i] >= 15) * ESCAPE_COST;
+        }
+        uint32_t mode = 0;
+        for (uint32_t m = 1; m < 4; ++m) {
+            if (sizes[m] < sizes[mode]) mode = m;
+        }
+        (*dst)[headerPos + g / 4] |= (uint8_t) (mode << ((g % 4) * 2));
+
+        if (mode == 3) {
+            dst->insert(dst->end(), v, v + GROUP);
+            continue;
+        }
+        if (mode == 0) continue;
+        uint32_t bits = GROUP_BITS[mode], sentinel = (1u << bits) - 1, perByte = 8 / bits;
+        for (size_t i = 0; i < GROUP; i += perByte) {
+            uint8_t byte = 0;
+            for (uint32_t k = 0; k < perByte; ++k) byte |= (uint8_t) (std::min<uint32_t>(v[i + k], sentinel) << (k * bits));
+            dst->push_back(byte);
+        }
+        for (size_t i = 0; i < GROUP; ++i) {
+            if (v[i] >= sentinel) dst->push_back(v[i]);
+        }
+    }
+}
+
+void EncodeMeshVertices(std::vector<uint8_t>* dst, const GlCompactVert* verts, size_t count, const CompactVertBounds& bounds) {
+    VertexStreamHeader header {};
+    header.count = (uint32_t) count;
+    header.numBlocks = (uint32_t) ((count + MESH_CODEC_BLOCK - 1) / MESH_CODEC_BLOCK);
+    memcpy(header.offset, &bounds.offset, sizeof(header.offset));
+    memcpy(header.scale, &bounds.scale, sizeof(header.scale));
+
+    dst->clear();
+    dst->resize(sizeof(header) + header.numBlocks * sizeof(VertexBlock));
+    size_t dataStart = dst->size();
+
+    uint8_t planes[PLANES][MESH_CODEC_BLOCK];
+    for (uint32_t b = 0; b < header.numBlocks; ++b) {
+        size_t begin = b * MESH_CODEC_BLOCK;
+        size_t n = std::min(count - begin, MESH_CODEC_BLOCK);
+        size_t groups = (n + GROUP - 1) / GROUP;
+        memset(planes, 0, sizeof(planes));
+
+        // Every block starts from zero so blocks decode independently.
+        uint16_t prev[LANES] = {};
+        for (size_t i = 0; i < n; ++i) {
+            uint16_t lanes[LANES];
+            SplitLanes(verts[begin + i], lanes);
+            for (size_t l = 0; l < LANES; ++l) {
+                uint16_t z = ZigZag16((uint16_t) (lanes[l] - prev[l]));
+                planes[l * 2 + 0][i] = (uint8_t) z;
+                planes[l * 2 + 1][i] = (uint8_t) (z >> 8);
+                prev[l] = lanes[l];
+            }
+        }
+        size_t blockStart = dst->size();
+        for (size_t p = 0; p < PLANES; ++p) EncodePlane(dst, planes[p], groups);
+
+        VertexBlock block { (uint32_t) (dst->size() - dataStart), StreamChecksum(0, dst->data() + blockStart, dst->size() - blockStart) };
+        memcpy(dst->data() + sizeof(header) + b * sizeof(VertexBlock), &block, sizeof(block));
+    }
+    header.checksum = StreamChecksum(StreamChecksum(0, &header, sizeof(header)), dst->data() + sizeof(header),
+                                     header.numBlocks * sizeof(VertexBlock));
+    memcpy(dst->data(), &header, sizeof(header));
+}
+
+bool ReadMeshVertexHeader(const void* src, size_t size, size_t* count, CompactVertBounds* bounds) {
+    VertexStreamHeader header;
+    if (size < sizeof(header)) return false;
+    memcpy(&header, src, sizeof(header));
+    if (header.numBlocks != (header.count + MESH_CODEC_BLOCK - 1) / MESH_CODEC_BLOCK) return false;
+    if ((size - sizeof(header)) / sizeof(VertexBlock) < header.numBlocks) return false;
+    const uint8_t* blocks = (const uint8_t*) src + sizeof(header);
+    uint32_t checksum = header.checksum;
+    header.checksum = 0;
+    if (StreamChecksum(StreamChecksum(0, &header, sizeof(header)), blocks, header.numBlocks * sizeof(VertexBlock)) != checksum) return false;
+    // The last block ends the stream.
+    VertexBlock last {};
+    if (header.numBlocks > 0) memcpy(&last, blocks + (header.numBlocks - 1) * sizeof(VertexBlock), sizeof(last));
+    if (last.end != size - sizeof(header) - header.numBlocks * sizeof(VertexBlock)) return false;
+    *count = header.count;
+    if (bounds) {
+        memcpy(&bounds->offset, header.offset, sizeof(header.offset));
+        memcpy(&bounds->scale, header.scale, sizeof(header.scale));
+    }
+    return true;
+}
+
+// Unpacks one group of plane bytes into out[0, 16). Returns the new read
+// position, or nullptr if the group runs past end.
+static const uint8_t* DecodeGroupScalar(uint8_t* out, uint32_t mode, const uint8_t* data, const uint8_t* end) {
+    if (mode == 0) {
+        memset(out, 0, GROUP);
+        return data;
+    }
+    if (mode == 3) {
+        if ((size_t) (end - data) < GROUP) return nullptr;
+        memcpy(out, data, GROUP);
+        return data + GROUP;
+    }
+    uint32_t bits = GROUP_BITS[mode], sentinel = (1u << bits) - 1, perByte = 8 / bits;
+    if ((size_t) (end - data) < GROUP / perByte) return nullptr;
+    for (size_t i = 0; i < GROUP; ++i) out[i] = (uint8_t) ((data[i / perByte] >> ((i % perByte) * bits)) & sentinel);
+    data += GROUP / perByte;
+    for (size_t i = 0; i < GROUP; ++i) {
+        if (out[i] != sentinel) continue;
+        if (data == end) return nullptr;
+        out[i] = *data++;
+    }
+    return data;
+}
+
+static bool DecodeVertexBlockScalar(GlCompactVert* dst, size_t n, const uint8_t* data, const uint8_t* end) {
+    uint8_t planes[PLANES][MESH_CODEC_BLOCK];
+    size_t groups = (n + GROUP - 1) / GROUP;
+    size_t headerSize = (groups + 3) / 4;
+    for (size_t p = 0; p < PLANES; ++p) {
+        if ((size_t) (end - data) < headerSize) return false;
+        const uint8_t* header = data;
+        data += headerSize;
+        for (size_t g = 0; g < groups; ++g) {
+            data = DecodeGroupScalar(planes[p] + g * GROUP, (header[g / 4] >> ((g % 4) * 2)) & 3, data, end);
+            if (!data) return false;
+        }
+    }
+    if (data != end) return false;
+
+    uint16_t lanes[LANES] = {};
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t l = 0; l < LANES; ++l) {
+            lanes[l] += UnZigZag16((uint16_t) (planes[l * 2][i] | (planes[l * 2 + 1][i] << 8)));
+        }
+        dst[i] = MergeLanes(lanes);
+    }
+    return true;
+}
+
+#ifdef MESH_CODEC_SSE
+
+static inline uint32_t LowestBit(uint32_t v) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, v);
+    return (uint32_t) i;
+#else
+    return (uint32_t) __builtin_ctz(v);
+#endif
+}
+
+static inline const uint8_t* DecodeGroupSse(uint8_t* out, uint32_t mode, const uint8_t* data, const uint8_t* end) {
+    __m128i v;
+    uint32_t sentinel;
+    switch (mode) {
+        case 0:
+            _mm_store_si128((__m128i*) out, _mm_setzero_si128());
+            return data;
+        case 1: {
+            if (end - data < 4) return nullptr;
+            int32_t packed;
+            memcpy(&packed, data, sizeof(packed));
+            data += 4;
+            __m128i x = _mm_cvtsi32_si128(packed);
+            __m128i mask = _mm_set1_epi8(3);
+            __m128i a = _mm_and_si128(x, mask);
+            __m128i b = _mm_and_si128(_mm_srli_epi16(x, 2), mask);
+            __m128i c = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+            __m128i d = _mm_and_si128(_mm_srli_epi16(x, 6), mask);
+            v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(a, b), _mm_unpacklo_epi8(c, d));
+            sentinel = 3;
+            break;
+        }
+        case 2: {
+            if (end - data < 8) return nullptr;
+            __m128i x = _mm_loadl_epi64((const __m128i*) data);
+            data += 8;
+            __m128i mask = _mm_set1_epi8(15);
+            v = _mm_unpacklo_epi8(_mm_and_si128(x, mask), _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+            sentinel = 15;
+            break;
+        }
+        default:
+            if (end - data < 16) return nullptr;
+            _mm_store_si128((__m128i*) out, _mm_loadu_si128((const __m128i*) data));
+            return data + 16;
+    }
+
+    _mm_store_si128((__m128i*) out, v);
+    uint32_t escapes = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char) sentinel)));
+    for (; escapes; escapes &= escapes - 1) {
+        if (data == end) return nullptr;
+        out[LowestBit(escapes)] = *data++;
+    }
+    return data;
+}
+
+// One round of the 16x16 byte transpose; four rounds move element (r, c) to
+// (c, r).
+static inline void TransposeRound(__m128i (&dst)[16], const __m128i (&src)[16]) {
+    for (int i = 0; i < 8; ++i) {
+        dst[i * 2 + 0] = _mm_unpacklo_epi8(src[i], src[i + 8]);
+        dst[i * 2 + 1] = _mm_unpackhi_epi8(src[i], src[i + 8]);
+    }
+}
+
+static bool DecodeVertexBlockSse(GlCompactVert* dst, size_t n, const uint8_t* data, const uint8_t* end) {
+    alignas(16) uint8_t planes[PLANES][MESH_CODEC_BLOCK];
+    size_t groups = (n + GROUP - 1) / GROUP;
+    size_t headerSize = (groups + 3) / 4;
+    for (size_t p = 0; p < PLANES; ++p) {
+        if ((size_t) (end - data) < headerSize) return false;
+        const uint8_t* header = data;
+        data += headerSize;
+        for (size_t g = 0; g < groups; ++g) {
+            data = DecodeGroupSse(planes[p] + g * GROUP, (header[g / 4] >> ((g % 4) * 2)) & 3, data, end);
+            if (!data) return false;
+        }
+    }
+    if (data != end) return false;
+
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i shifts = _mm_setr_epi16(1, 1, 1, 0, 1 << 10, 1 << 4, 1, 1);
+    const __m128i lowFrame = _mm_setr_epi16(0, 0, 0, 0, -1, 0, 0, 0);
+    const __m128i highFrame = _mm_setr_epi16(0, 0, 0, 0, 0, 1 << 10, 0, 0);
+    __m128i prev = _mm_setzero_si128();
+    for (size_t g = 0; g < groups; ++g) {
+        __m128i a[16], b[16];
+        for (size_t p = 0; p < PLANES; ++p) a[p] = _mm_load_si128((const __m128i*) (planes[p] + g * GROUP));
+        TransposeRound(b, a);
+        TransposeRound(a, b);
+        TransposeRound(b, a);
+        TransposeRound(a, b);
+
+        alignas(16) GlCompactVert tail[GROUP];
+        size_t m = std::min(GROUP, n - g * GROUP);
+        GlCompactVert* out = m == GROUP ? dst + g * GROUP : tail;
+        for (size_t i = 0; i < GROUP; ++i) {
+            __m128i z = a[i];
+            __m128i d = _mm_xor_si128(_mm_srli_epi16(z, 1), _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(z, one)));
+            prev = _mm_add_epi16(prev, d);
+            // Reassemble the frame: lanes 3..5 hold its three fields, see
+            // MergeLanes.
+            __m128i moved = _mm_slli_si128(prev, 2);
+            __m128i v = _mm_mullo_epi16(prev, shifts);
+            v = _mm_or_si128(v, _mm_and_si128(moved, lowFrame));
+            v = _mm_or_si128(v, _mm_mulhi_epu16(moved, highFrame));
+            _mm_storeu_si128((__m128i*) (out + i), v);
+        }
+        if (out == tail) memcpy(dst + g * GROUP, tail, m * sizeof(GlCompactVert));
+    }
+    return true;
+}
+
+#endif
+
+typedef bool DecodeBlockFn(GlCompactVert* dst, size_t n, const uint8_t* data, const uint8_t* end);
+
+static bool DecodeVertices(DecodeBlockFn* decodeBlock, GlCompactVert* dst, const void* src, size_t size, bool parallel) {
+    size_t count;
+    if (!ReadMeshVertexHeader(src, size, &count, nullptr)) return false;
+    size_t numBlocks = (count + MESH_CODEC_BLOCK - 1) / MESH_CODEC_BLOCK;
+    const uint8_t* blocks = (const uint8_t*) src + sizeof(VertexStreamHeader);
+    const uint8_t* data = blocks + numBlocks * sizeof(VertexBlock);
+    size_t dataSize = size - (size_t) (data - (const uint8_t*) src);
+
+    std::atomic<bool> ok { true };
+    ParallelFor(numBlocks, parallel ? VERTEX_DECODE_GRAIN : numBlocks, [&](size_t begin, size_t end) {
+        VertexBlock block {};
+        if (begin > 0) memcpy(&block, blocks + (begin - 1) * sizeof(VertexBlock), sizeof(block));
+        for (size_t b = begin; b < end && ok; ++b) {
+            uint32_t start = block.end;
+            memcpy(&block, blocks + b * sizeof(VertexBlock), sizeof(block));
+            size_t first = b * MESH_CODEC_BLOCK;
+            if (block.end < start || block.end > dataSize || StreamChecksum(0, data + start, block.end - start) != block.checksum
+                || !decodeBlock(dst + first, std::min(count - first, MESH_CODEC_BLOCK), data + start, data + block.end)) {
+                ok = false;
+            }
+        }
+    });
+    return ok;
+}
+
+bool DecodeMeshVertices(GlCompactVert* dst, const void* src, size_t size, bool parallel) {
+#ifdef MESH_CODEC_SSE
+    return DecodeVertices(DecodeVertexBlockSse, dst, src, size, parallel);
+#else
+    return DecodeVertices(DecodeVertexBlockScalar, dst, src, size, parallel);
+#endif
+}
+
+bool DecodeMeshVerticesScalar(GlCompactVert* dst, const void* src, size_t size, bool parallel) {
+    return DecodeVertices(DecodeVertexBlockScalar, dst, src, size, parallel);
+}
+
+//
+// Indices
+//
+
+struct IndexCoderState {
+    GLuint   edges[FIFO_SIZE][2];
+    GLuint   verts[FIFO_SIZE];
+    uint32_t edgeHead;
+    uint32_t vertHead;
+    GLuint   next;
+    GLuint   last;
+};
+
+static void ResetIndexCoder(IndexCoderState* s, GLuint next) {
+    // ~0u never occurs as an index, so the empty FIFOs match nothing.
+    memset(s->edges, 0xff, sizeof(s->edges));
+    memset(s->verts, 0xff, sizeof(s->verts));
+    s->edgeHead = 0;
+    s->vertHead = 0;
+    s->next = next;
+    s->last = next;
+}
+
+static inline void PushEdge(IndexCoderState* s, GLuint a, GLuint b) {
+    s->edges[s->edgeHead & (FIFO_SIZE - 1)][0] = a;
+    s->edges[s->edgeHead & (FIFO_SIZE - 1)][1] = b;
+    s->edgeHead++;
+}
+
+static inline void PushVertex(IndexCoderState* s, GLuint v) {
+    s->verts[s->vertHead & (FIFO_SIZE - 1)] = v;
+    s->vertHead++;
+}
+
+// Distance of edge (a, b) from the newest FIFO entry, or -1.
+static inline int FindEdge(const IndexCoderState& s, GLuint a, GLuint b) {
+    for (uint32_t d = 0; d < NO_EDGE; ++d) {
+        const GLuint* e = s.edges[(s.edgeHead - 1 - d) & (FIFO_SIZE - 1)];
+        if (e[0] == a && e[1] == b) return (int) d;
+    }
+    return -1;
+}
+
+// Vertex code of v without a state change: CODE_NEXT, a FIFO distance plus
+// one, or CODE_EXPLICIT.
+static inline uint32_t VertexCode(const IndexCoderState& s, GLuint v) {
+    if (v == s.next) return CODE_NEXT;
+    for (uint32_t k = 1; k < CODE_EXPLICIT; ++k) {
+        if (s.verts[(s.vertHead - k) & (FIFO_SIZE - 1)] == v) return k;
+    }
+    return CODE_EXPLICIT;
+}
+
+static inline uint32_t ZigZag32(int32_t v) {
+    return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+}
+
+static inline int32_t UnZigZag32(uint32_t v) {
+    return (int32_t) ((v >> 1) ^ (0u - (v & 1)));
+}
+
+// Codes v and applies the same state change the decoder will. data may be
+// null to only simulate.
+static uint32_t EncodeVertex(IndexCoderState* s, std::vector<uint8_t>* data, GLuint v) {
+    uint32_t code = VertexCode(*s, v);
+    if (code == CODE_NEXT) {
+        s->next++;
+        PushVertex(s, v);
+    } else if (code == CODE_EXPLICIT) {
+        for (uint32_t z = ZigZag32((int32_t) (v - s->last)); data; z >>= 7) {
+            data->push_back((uint8_t) ((z & 127) | (z >= 128 ? 128 : 0)));
+            if (z < 128) break;
+        }
+        s->last = v;
+        PushVertex(s, v);
+    }
+    return code;
+}
+
+// Explicit vertices a rotation of a triangle without a shared edge would
+// need, simulated on a copy of the state.
+static uint32_t NoEdgeCost(IndexCoderState s, const GLuint tri[3]) {
+    uint32_t cost = 0;
+    for (int k = 0; k < 3; ++k) cost += EncodeVertex(&s, nullptr, tri[k]) == CODE_EXPLICIT;
+    return cost;
+}
+
+static void EncodeTriangle(IndexCoderState* s, std::vector<uint8_t>* codes, std::vector<uint8_t>* data, const GLuint* tri) {
+    // Each choice below takes the first rotation of minimal cost, so a
+    // decoded triangle, which starts at the chosen corner, is coded the same
+    // way again.
+    int bestRot = -1, bestEdge = -1;
+    bool bestExplicit = true;
+    for (int r = 0; r < 3; ++r) {
+        GLuint a = tri[r], b = tri[(r + 1) % 3], c = tri[(r + 2) % 3];
+        int edge = FindEdge(*s, a, b);
+        if (edge < 0) continue;
+        bool expl = VertexCode(*s, c) == CODE_EXPLICIT;
+        if (bestRot < 0 || (bestExplicit && !expl)) {
+            bestRot = r;
+            bestEdge = edge;
+            bestExplicit = expl;
+        }
+    }
+
+    if (bestRot >= 0) {
+        GLuint a = tri[bestRot], b = tri[(bestRot + 1) % 3], c = tri[(bestRot + 2) % 3];
+        uint32_t code = EncodeVertex(s, data, c);
+        codes->push_back((uint8_t) ((bestEdge << 4) | code));
+        PushEdge(s, c, b);
+        PushEdge(s, a, c);
+        return;
+    }
+
+    uint32_t bestCost = UINT32_MAX;
+    GLuint rotated[3] = { tri[0], tri[1], tri[2] };
+    for (int r = 0; r < 3; ++r) {
+        GLuint t[3] = { tri[r], tri[(r + 1) % 3], tri[(r + 2) % 3] };
+        uint32_t cost = NoEdgeCost(*s, t);
+        if (cost < bestCost) {
+            bestCost = cost;
+            memcpy(rotated, t, sizeof(t));
+        }
+    }
+    uint32_t ca = EncodeVertex(s, data, rotated[0]);
+    uint32_t cb = EncodeVertex(s, data, rotated[1]);
+    uint32_t cc = EncodeVertex(s, data, rotated[2]);
+    codes->push_back((uint8_t) ((NO_EDGE << 4) | ca));
+    codes->push_back((uint8_t) ((cb << 4) | cc));
+    PushEdge(s, rotated[1], rotated[0]);
+    PushEdge(s, rotated[2], rotated[1]);
+    PushEdge(s, rotated[0], rotated[2]);
+}
+
+void EncodeMeshIndices(std::vector<uint8_t>* dst, const GLuint* indices, size_t count, const GLuint* restarts, size_t numRestarts) {
+    count -= count % 3;
+    std::vector<GLuint> starts { 0 };
+    for (size_t i = 0; i < numRestarts; ++i) {
+        if (restarts[i] % 3 == 0 && restarts[i] < count) starts.push_back(restarts[i]);
+    }
+    starts.push_back((GLuint) count);
+    std::sort(starts.begin(), starts.end());
+    starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+
+    std::vector<IndexSegment> segments;
+    std::vector<uint8_t> codes, data;
+    codes.reserve(count / 3 + count / 64);
+    IndexCoderState state;
+    for (size_t r = 0; r + 1 < starts.size(); ++r) {
+        for (size_t begin = starts[r]; begin < starts[r + 1]; begin += MESH_CODEC_SEGMENT_TRIANGLES * 3) {
+            size_t end = std::min<size_t>(begin + MESH_CODEC_SEGMENT_TRIANGLES * 3, starts[r + 1]);
+            // A restart forgets everything; start "next" where a segment
+            // split off a longer run left it, else at the first triangle.
+            GLuint next = begin == starts[r] ? std::min({ indices[begin], indices[begin + 1], indices[begin + 2] }) : state.next;
+            segments.push_back(IndexSegment { (uint32_t) begin, (uint32_t) codes.size(), (uint32_t) data.size(), next, 0 });
+            ResetIndexCoder(&state, next);
+            for (size_t i = begin; i < end; i += 3) EncodeTriangle(&state, &codes, &data, indices + i);
+        }
+    }
+
+    for (size_t i = 0; i < segments.size(); ++i) {
+        IndexSegment& seg = segments[i];
+        size_t codeEnd = i + 1 < segments.size() ? segments[i + 1].codeOffset : codes.size();
+        size_t dataEnd = i + 1 < segments.size() ? segments[i + 1].dataOffset : data.size();
+        seg.checksum = StreamChecksum(StreamChecksum(0, codes.data() + seg.codeOffset, codeEnd - seg.codeOffset),
+                                      data.data() + seg.dataOffset, dataEnd - seg.dataOffset);
+    }
+    IndexStreamHeader header { (uint32_t) count, (uint32_t) segments.size(), (uint32_t) codes.size(), (uint32_t) data.size(), 0 };
+    header.checksum = StreamChecksum(StreamChecksum(0, &header, sizeof(header)), segments.data(), segments.size() * sizeof(IndexSegment));
+    dst->clear();
+    dst->resize(sizeof(header) + segments.size() * sizeof(IndexSegment));
+    memcpy(dst->data(), &header, sizeof(header));
+    if (!segments.empty()) memcpy(dst->data() + sizeof(header), segments.data(), segments.size() * sizeof(IndexSegment));
+    dst->insert(dst->end(), codes.begin(), codes.end());
+    dst->insert(dst->end(), data.begin(), data.end());
+}
+
+static bool ReadIndexHeader(const void* src, size_t size, IndexStreamHeader* header) {
+    if (size < sizeof(*header)) return false;
+    memcpy(header, src, sizeof(*header));
+    uint64_t need = sizeof(*header) + (uint64_t) header->numSegments * sizeof(IndexSegment)
+                  + header->codeSize + header->dataSize;
+    if (header->count % 3 != 0 || need != size || (header->count == 0) != (header->numSegments == 0)) return false;
+    IndexStreamHeader zeroed = *header;
+    zeroed.checksum = 0;
+    uint32_t sum = StreamChecksum(0, &zeroed, sizeof(zeroed));
+    return StreamChecksum(sum, (const uint8_t*) src + sizeof(zeroed), header->numSegments * sizeof(IndexSegment)) == header->checksum;
+}
+
+bool ReadMeshIndexHeader(const void* src, size_t size, size_t* count) {
+    IndexStreamHeader header;
+    if (!ReadIndexHeader(src, size, &header)) return false;
+    *count = header.count;
+    return true;
+}
+
+struct IndexDecodeRange {
+    const uint8_t* code;
+    const uint8_t* codeEnd;
+    const uint8_t* data;
+    const uint8_t* dataEnd;
+};
+
+template <typename T>
+static bool DecodeIndexSegment(T* dst, size_t begin, size_t end, IndexDecodeRange in, GLuint next) {
+    IndexCoderState s;
+    ResetIndexCoder(&s, next);
+    const uint8_t* code = in.code;
+    const uint8_t* data = in.data;
+    GLuint seen = 0;
+
+    // Decodes one vertex code, mirroring EncodeVertex.
+    auto vertex = [&](uint32_t k, GLuint* v) {
+        if (k == CODE_NEXT) {
+            *v = s.next++;
+        } else if (k < CODE_EXPLICIT) {
+            // Reaching past what was pushed since the reset finds ~0u.
+            *v = s.verts[(s.vertHead - k) & (FIFO_SIZE - 1)];
+            return *v != ~0u;
+        } else {
+            uint32_t z = 0;
+            for (uint32_t shift = 0; ; shift += 7) {
+                if (data == in.dataEnd || shift > 28) return false;
+                uint8_t byte = *data++;
+                z |= (uint32_t) (byte & 127) << shift;
+                if (byte < 128) break;
+            }
+            s.last += (GLuint) UnZigZag32(z);
+            *v = s.last;
+        }
+        PushVertex(&s, *v);
+        return true;
+    };
+
+    for (size_t i = begin; i < end; i += 3) {
+        if (code == in.codeEnd) return false;
+        uint32_t c = *code++;
+        GLuint a, b, v;
+        if ((c >> 4) != NO_EDGE) {
+            const GLuint* e = s.edges[(s.edgeHead - 1 - (c >> 4)) & (FIFO_SIZE - 1)];
+            a = e[0];
+            b = e[1];
+            if (a == ~0u || !vertex(c & 15, &v)) return false;
+            PushEdge(&s, v, b);
+            PushEdge(&s, a, v);
+        } else {
+            if (code == in.codeEnd) return false;
+            uint32_t c2 = *code++;
+            if (!vertex(c & 15, &a) || !vertex(c2 >> 4, &b) || !vertex(c2 & 15, &v)) return false;
+            PushEdge(&s, b, a);
+            PushEdge(&s, v, b);
+            PushEdge(&s, a, v);
+        }
+        seen |= a | b | v;
+        dst[i + 0] = (T) a;
+        dst[i + 1] = (T) b;
+        dst[i + 2] = (T) v;
+    }
+    // Values too wide for T only come from corrupt input.
+    return code == in.codeEnd && data == in.dataEnd && (GLuint) (T) seen == seen;
+}
+
+bool DecodeMeshIndices(void* dst, GLenum type, const void* src, size_t size, bool parallel) {
+    IndexStreamHeader header;
+    if (!ReadIndexHeader(src, size, &header)) return false;
+    auto segments = (const uint8_t*) src + sizeof(header);
+    const uint8_t* codes = segments + header.numSegments * sizeof(IndexSegment);
+    const uint8_t* data = codes + header.codeSize;
+
+    auto segment = [&](size_t i) {
+        IndexSegment seg;
+        memcpy(&seg, segments + i * sizeof(IndexSegment), sizeof(seg));
+        return seg;
+    };
+    for (size_t i = 0; i < header.numSegments; ++i) {
+        IndexSegment seg = segment(i);
+        IndexSegment prev = i > 0 ? segment(i - 1) : IndexSegment {};
+        if (seg.firstIndex % 3 != 0 || seg.firstIndex >= header.count || (i == 0) != (seg.firstIndex == 0)) return false;
+        if (i > 0 && (seg.firstIndex <= prev.firstIndex || seg.codeOffset < prev.codeOffset || seg.dataOffset < prev.dataOffset)) return false;
+        if (seg.codeOffset > header.codeSize || seg.dataOffset > header.dataSize) return false;
+    }
+
+    std::atomic<bool> ok { true };
+    ParallelFor(header.numSegments, parallel ? 1 : header.numSegments, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end && ok; ++i) {
+            IndexSegment seg = segment(i);
+            IndexSegment next = i + 1 < header.numSegments ? segment(i + 1)
+                                                           : IndexSegment { header.count, header.codeSize, header.dataSize, 0, 0 };
+            IndexDecodeRange in { codes + seg.codeOffset, codes + next.codeOffset, data + seg.dataOffset, data + next.dataOffset };
+            uint32_t checksum = StreamChecksum(StreamChecksum(0, in.code, in.codeEnd - in.code), in.data, in.dataEnd - in.data);
+            bool segOk = checksum == seg.checksum && (type == GL_UNSIGNED_SHORT
+                ? DecodeIndexSegment((uint16_t*) dst, seg.firstIndex, next.firstIndex, in, seg.next)
+                : DecodeIndexSegment((GLuint*) dst, seg.firstIndex, next.firstIndex, in, seg.next));
+            if (!segOk) ok = false;
+        }
+    });
+    return ok;
+}
+
+void CollectIndexRestarts(std::vector<GLuint>* restarts, const StaticMesh& mesh) {
+    restarts->clear();
+    for (const StaticSubmesh& sub : mesh.submeshes) restarts->push_back(sub.firstIndex);
+    for (const StaticLod& lod : mesh.lods) restarts->push_back(lod.firstIndex);
+    std::sort(restarts->begin(), restarts->end());
+    restarts->erase(std::unique(restarts->begin(), restarts->end()), restarts->end());
+}
+
+//
+// Benchmark
+//
+
+// Whether b holds the triangles of a in the same order and winding.
+static bool SameTriangles(const GLuint* a, const GLuint* b, size_t count) {
+    for (size_t i = 0; i < count; i += 3) {
+        bool same = false;
+        for (int r = 0; r < 3 && !same; ++r) {
+            same = a[i] == b[i + r] && a[i + 1] == b[i + (r + 1) % 3] && a[i + 2] == b[i + (r + 2) % 3];
+        }
+        if (!same) return false;
+    }
+    return true;
+}
+
+template <typename Fn>
+static double BestOf5(Fn&& fn) {
+    double best = 1e30;
+    for (int rep = 0; rep < 5; ++rep) {
+        auto start = std::chrono::high_resolution_clock::now();
+        fn();
+        std::chrono::duration<double> dur = std::chrono::high_resolution_clock::now() - start;
+        best = std::min(best, dur.count());
+    }
+    return best;
+}
+
+void BenchmarkMeshCodec(const StaticMesh& mesh, const char* name) {
+    size_t numverts = mesh.vertices.size(), numindices = mesh.indices.size() - mesh.indices.size() % 3;
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    CompactVertBounds bounds = ComputeCompactBounds(mesh.vertices.data(), numverts);
+    std::vector<GlCompactVert> quantized(numverts);
+    PackCompactVerts(quantized.data(), mesh.vertices.data(), numverts, bounds);
+    std::vector<GLuint> restarts;
+    CollectIndexRestarts(&restarts, mesh);
+
+    std::vector<uint8_t> vstream, istream;
+    auto start = std::chrono::high_resolution_clock::now();
+    EncodeMeshVertices(&vstream, quantized.data(), numverts, bounds);
+    std::chrono::duration<double, std::milli> vencode = std::chrono::high_resolution_clock::now() - start;
+    start = std::chrono::high_resolution_clock::now();
+    EncodeMeshIndices(&istream, mesh.indices.data(), numindices, restarts.data(), restarts.size());
+    std::chrono::duration<double, std::milli> iencode = std::chrono::high_resolution_clock::now() - start;
+
+    GLenum indexType = StaticMeshIndexType(mesh);
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(GLuint);
+    size_t tris = std::max<size_t>(1, numindices / 3);
+    size_t rawVerts = numverts * sizeof(GlStaticMeshVert), quantVerts = numverts * sizeof(GlCompactVert);
+    size_t rawIndices = numindices * indexSize;
+    printf("mesh codec, %s: %zu verts, %zu tris, %zu cores\n", name, numverts, numindices / 3, threads);
+    printf("  vertices %9zu B fp32, %9zu B quantized -> %9zu B  %5.2f B/vert  %5.2f:1 vs fp32  %5.2f:1 vs quantized  encode %.2f ms\n",
+           rawVerts, quantVerts, vstream.size(), (double) vstream.size() / std::max<size_t>(1, numverts),
+           (double) rawVerts / vstream.size(), (double) quantVerts / vstream.size(), vencode.count());
+    printf("  indices  %9zu B %s                 -> %9zu B  %5.2f B/tri   %5.2f:1                        encode %.2f ms\n",
+           rawIndices, indexSize == 2 ? "u16" : "u32", istream.size(), (double) istream.size() / tris,
+           (double) rawIndices / istream.size(), iencode.count());
+
+    // Round trip: exact quantized vertices, the same triangles, and the same
+    // bytes again when the decoded result is re-encoded.
+    std::vector<GlCompactVert> verts(numverts), scalarVerts(numverts);
+    std::vector<GLuint> indices(numindices);
+    bool vok = DecodeMeshVertices(verts.data(), vstream.data(), vstream.size())
+            && DecodeMeshVerticesScalar(scalarVerts.data(), vstream.data(), vstream.size())
+            && memcmp(verts.data(), quantized.data(), quantVerts) == 0
+            && memcmp(scalarVerts.data(), quantized.data(), quantVerts) == 0;
+    bool iok = DecodeMeshIndices(indices.data(), GL_UNSIGNED_INT, istream.data(), istream.size())
+            && SameTriangles(mesh.indices.data(), indices.data(), numindices);
+    if (indexType == GL_UNSIGNED_SHORT) {
+        std::vector<uint16_t> shorts(numindices);
+        iok = iok && DecodeMeshIndices(shorts.data(), GL_UNSIGNED_SHORT, istream.data(), istream.size());
+        for (size_t i = 0; i < numindices && iok; ++i) iok = shorts[i] == indices[i];
+    }
+    std::vector<uint8_t> again;
+    EncodeMeshVertices(&again, verts.data(), numverts, bounds);
+    bool vstable = again == vstream;
+    EncodeMeshIndices(&again, indices.data(), numindices, restarts.data(), restarts.size());
+    bool istable = again == istream;
+    printf("  round trip: vertices %s, triangles %s, re-encode %s\n",
+           vok ? "exact" : "MISMATCH", iok ? "exact" : "MISMATCH", vstable && istable ? "stable" : "UNSTABLE");
+
+    struct Run {
+        const char* name;
+        double      seconds;
+        size_t      bytes;      // decoded
+        size_t      cores;
+    };
+    size_t vblocks = (numverts + MESH_CODEC_BLOCK - 1) / MESH_CODEC_BLOCK;
+    size_t vcores = std::min(threads, std::max<size_t>(1, (vblocks + VERTEX_DECODE_GRAIN - 1) / VERTEX_DECODE_GRAIN));
+    IndexStreamHeader iheader;
+    memcpy(&iheader, istream.data(), sizeof(iheader));
+    size_t icores = std::min<size_t>(threads, std::max<uint32_t>(1, iheader.numSegments));
+    std::vector<GlStaticMeshVert> unpacked(numverts);
+    const Run runs[] = {
+        { "vertices, scalar, 1 thread", BestOf5([&] { DecodeMeshVerticesScalar(verts.data(), vstream.data(), vstream.size(), false); }), quantVerts, 1 },
+        { "vertices, simd, 1 thread",   BestOf5([&] { DecodeMeshVertices(verts.data(), vstream.data(), vstream.size(), false); }), quantVerts, 1 },
+        { "vertices, simd, threaded",   BestOf5([&] { DecodeMeshVertices(verts.data(), vstream.data(), vstream.size(), true); }), quantVerts, vcores },
+        { "indices, 1 thread",          BestOf5([&] { DecodeMeshIndices(indices.data(), GL_UNSIGNED_INT, istream.data(), istream.size(), false); }), numindices * sizeof(GLuint), 1 },
+        { "indices, threaded",          BestOf5([&] { DecodeMeshIndices(indices.data(), GL_UNSIGNED_INT, istream.data(), istream.size(), true); }), numindices * sizeof(GLuint), icores },
+        { "unpack to fp32, threaded",   BestOf5([&] { UnpackCompactVerts(unpacked.data(), verts.data(), numverts, bounds); }), rawVerts, threads },
+    };
+    for (const Run& run : runs) {
+        double rate = run.bytes / std::max(run.seconds, 1e-9) * 1e-9;
+        printf("  %-27s %8.2f ms  %7.2f GB/s  %7.2f GB/s/core\n", run.name, run.seconds * 1e3, rate, rate / run.cores);
+    }
+}
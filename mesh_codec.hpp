@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "static_mesh.hpp"
+#include "vertex_compact.hpp"
+
+// Disk-side compression for cooked meshes. Both streams are lossless with
+// respect to their input: vertices are coded in their GlCompactVert form, so
+// quantization is the only loss against the fp32 source, and indices come
+// back as the same triangles in the same order and winding, each possibly
+// rotated to start at a different corner.
+//
+// Vertices go in blocks of MESH_CODEC_BLOCK. Each vertex is split into eight
+// 16-bit attributes (position xyz, octahedral normal xy, tangent angle with
+// the handedness bit, half-float uv), each attribute is delta coded against
+// the previous vertex and zigzagged, and the low and high bytes of every
+// attribute are stored as separate planes. Every 16 bytes of a plane are
+// then stored with 0, 2, 4 or 8 bits each, picked per group; values that do
+// not fit the 2- or 4-bit width are escaped to a trailing byte. After
+// OptimizeVertexFetch neighbouring vertices are close in space, so most
+// groups end up at 2 or 4 bits, and decoding stays a handful of SIMD ops per
+// byte.
+//
+// Indices are coded a triangle at a time against a FIFO of recently seen
+// edges and one of recently seen vertices. A triangle that shares an edge
+// with a recent one takes a single byte: the edge, and the third vertex as
+// either the next vertex never referenced before, a FIFO hit, or an explicit
+// delta from the last explicit one in a separate varint stream. The coder
+// restarts at every submesh and LOD range, and every
+// MESH_CODEC_SEGMENT_TRIANGLES triangles within them, so segments decode
+// independently and in parallel.
+//
+// Both headers, with their block or segment tables, and every block and
+// segment carry a checksum, a sum of 32-bit words, checked before decoding,
+// so truncated, spliced or bit-flipped input fails rather than decoding to
+// something else.
+
+static constexpr size_t MESH_CODEC_BLOCK             = 256;
+static constexpr size_t MESH_CODEC_SEGMENT_TRIANGLES = 1 << 14;
+
+void EncodeMeshVertices(std::vector<uint8_t>* dst, const GlCompactVert* verts, size_t count, const CompactVertBounds& bounds);
+
+// Reads the vertex count and dequantization bounds of an encoded stream.
+bool ReadMeshVertexHeader(const void* src, size_t size, size_t* count, CompactVertBounds* bounds);
+
+// Decodes all ReadMeshVertexHeader count vertices into dst, across all
+// threads if parallel. Uses SSE2 where available. Returns false if src is
+// malformed; dst is then partially written.
+bool DecodeMeshVertices(GlCompactVert* dst, const void* src, size_t size, bool parallel = true);
+
+// Plain scalar reference for DecodeMeshVertices.
+bool DecodeMeshVerticesScalar(GlCompactVert* dst, const void* src, size_t size, bool parallel = true);
+
+// restarts lists the first index of every independently drawn range, e.g.
+// from CollectIndexRestarts; indices must hold whole triangles.
+void EncodeMeshIndices(std::vector<uint8_t>* dst, const GLuint* indices, size_t count, const GLuint* restarts, size_t numRestarts);
+
+bool ReadMeshIndexHeader(const void* src, size_t size, size_t* count);
+
+// Decodes all ReadMeshIndexHeader count indices into dst as GL_UNSIGNED_SHORT
+// or GL_UNSIGNED_INT. Fails on malformed input, including values that do not
+// fit a 16-bit type.
+bool DecodeMeshIndices(void* dst, GLenum type, const void* src, size_t size, bool parallel = true);
+
+// The firstIndex of every submesh and LOD level, sorted and deduplicated.
+void CollectIndexRestarts(std::vector<GLuint>* restarts, const StaticMesh& mesh);
+
+// Encodes mesh with both codecs, checks that decoding gives back the
+// quantized vertices and the triangles exactly and that re-encoding the
+// result is stable, and prints size, ratio and decode throughput for the
+// scalar and SIMD decoders, single- and multi-threaded.
+void BenchmarkMeshCodec(const StaticMesh& mesh, const char* name);
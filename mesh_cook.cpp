@@ -0,0 +1,257 @@
+#include "mesh_cook.hpp"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "mesh_codec.hpp"
+#include "mesh_lod.hpp"
+#include "mesh_optimize.hpp"
+#include "mesh_weld.hpp"
+#include "vertex_compact.hpp"
+
+std::string CookedMesh_PathFor(const char* sourcePath) {
+    return Cooked_PathFor(sourcePath, ".mesh");
+}
+
+bool CookedMesh_Write(const StaticMesh& mesh, const char* path, const char* sourcePath, bool compress) {
+    SourceStamp stamp;
+    if (!GetSourceStamp(sourcePath, &stamp)) return false;
+
+    // 16-bit indices stay relative to their submesh baseVertex, so they only
+    // need narrowing here.
+    GLenum indexType = StaticMeshIndexType(mesh);
+    std::vector<uint16_t> shortIndices;
+    if (indexType == GL_UNSIGNED_SHORT && !compress) {
+        shortIndices.resize(mesh.indices.size());
+        PackIndices16(shortIndices.data(), mesh.indices.data(), mesh.indices.size());
+    }
+    uint32_t indexStride = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(GLuint);
+    const void* indexData = indexType == GL_UNSIGNED_SHORT ? (const void*) shortIndices.data() : (const void*) mesh.indices.data();
+
+    std::vector<uint8_t> packedVerts, packedIndices;
+    if (compress) {
+        auto start = std::chrono::high_resolution_clock::now();
+        CompactVertBounds bounds = ComputeCompactBounds(mesh.vertices.data(), mesh.vertices.size());
+        std::vector<GlCompactVert> quantized(mesh.vertices.size());
+        PackCompactVerts(quantized.data(), mesh.vertices.data(), mesh.vertices.size(), bounds);
+        EncodeMeshVertices(&packedVerts, quantized.data(), quantized.size(), bounds);
+        std::vector<GLuint> restarts;
+        CollectIndexRestarts(&restarts, mesh);
+        EncodeMeshIndices(&packedIndices, mesh.indices.data(), mesh.indices.size(), restarts.data(), restarts.size());
+        std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+        printf("%s: packed %zu verts into %zu B (%.2f B/vert), %zu tris into %zu B (%.2f B/tri) in %.2f ms\n",
+               sourcePath, mesh.vertices.size(), packedVerts.size(), (double) packedVerts.size() / std::max<size_t>(1, mesh.vertices.size()),
+               mesh.indices.size() / 3, packedIndices.size(), (double) packedIndices.size() / std::max<size_t>(1, mesh.indices.size() / 3),
+               dur.count());
+    }
+
+    std::vector<uint8_t> materials;
+    WriteMaterials(&materials, mesh.materials);
+
+    std::vector<CookedPayload> payloads = {
+        compress ? CookedPayload { COOKED_CHUNK_PACKED_VERTICES, 1, packedVerts.data(), packedVerts.size() }
+                 : CookedPayload { COOKED_CHUNK_VERTICES, sizeof(GlStaticMeshVert), mesh.vertices.data(), mesh.vertices.size() * sizeof(GlStaticMeshVert) },
+        compress ? CookedPayload { COOKED_CHUNK_PACKED_INDICES, 1, packedIndices.data(), packedIndices.size() }
+                 : CookedPayload { COOKED_CHUNK_INDICES, indexStride, indexData, mesh.indices.size() * indexStride },
+        { COOKED_CHUNK_SUBMESHES, sizeof(StaticSubmesh),   mesh.submeshes.data(), mesh.submeshes.size() * sizeof(StaticSubmesh) },
+        { COOKED_CHUNK_MESHLETS,  sizeof(Meshlet),         mesh.meshlets.data(),  mesh.meshlets.size() * sizeof(Meshlet) },
+        { COOKED_CHUNK_LODS,      sizeof(StaticLod),       mesh.lods.data(),      mesh.lods.size() * sizeof(StaticLod) },
+        { COOKED_CHUNK_MATERIALS, 1,                       materials.data(),      materials.size() },
+    };
+    if (!mesh.lightmapCoords.empty()) {
+        payloads.push_back(CookedPayload { COOKED_CHUNK_LIGHTMAP_COORDS, sizeof(glm::vec2), mesh.lightmapCoords.data(),
+                                           mesh.lightmapCoords.size() * sizeof(glm::vec2) });
+        payloads.push_back(CookedPayload { COOKED_CHUNK_LIGHTMAP_INFO, sizeof(LightmapInfo), &mesh.lightmap, sizeof(LightmapInfo) });
+    }
+    return Cooked_Write(path, COOKED_MESH_MAGIC, COOKED_MESH_VERSION, stamp, payloads.data(), payloads.size());
+}
+
+// Decodes the COOKED_CHUNK_PACKED_* streams of a compressed cooked mesh into
+// decodedVertices and decodedIndices. The submeshes must already be parsed:
+// the index type follows from them as it does for StaticMeshIndexType.
+static bool DecodeCookedMesh(CookedMesh* mesh, const void* verts, size_t vertsSize, const void* indices, size_t indicesSize) {
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t numverts, numindices;
+    CompactVertBounds bounds;
+    if (!ReadMeshVertexHeader(verts, vertsSize, &numverts, &bounds) || !ReadMeshIndexHeader(indices, indicesSize, &numindices)) return false;
+    GLenum indexType = GL_UNSIGNED_SHORT;
+    for (size_t i = 0; i < mesh->numSubmeshes; ++i) {
+        if (mesh->submeshes[i].numVertices > MAX_SHORT_INDEXED_VERTICES) indexType = GL_UNSIGNED_INT;
+    }
+
+    std::vector<GlCompactVert> quantized(numverts);
+    mesh->decodedIndices.resize(numindices * (indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(GLuint)));
+    if (!DecodeMeshVertices(quantized.data(), verts, vertsSize)
+        || !DecodeMeshIndices(mesh->decodedIndices.data(), indexType, indices, indicesSize)) {
+        mesh->decodedIndices.clear();
+        return false;
+    }
+    mesh->decodedVertices.resize(numverts);
+    UnpackCompactVerts(mesh->decodedVertices.data(), quantized.data(), numverts, bounds);
+
+    mesh->vertices = mesh->decodedVertices.data();
+    mesh->numVertices = numverts;
+    mesh->indices = mesh->decodedIndices.data();
+    mesh->numIndices = numindices;
+    mesh->indexType = indexType;
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    printf("decoded compressed mesh, %zu verts, %zu indices in %.2f ms\n", numverts, numindices, dur.count());
+    return true;
+}
+
+// Whether every submesh, LOD and meshlet range lies within the vertices and
+// indices, and the LODs come in whole levels of one entry per submesh.
+static bool CookedMeshRangesValid(const CookedMesh& mesh) {
+    if (mesh.numSubmeshes ? mesh.numLods % mesh.numSubmeshes != 0 : mesh.numLods != 0) return false;
+    for (size_t i = 0; i < mesh.numSubmeshes; ++i) {
+        const StaticSubmesh& s = mesh.submeshes[i];
+        if (s.baseVertex < 0 || (size_t) s.baseVertex > mesh.numVertices || s.numVertices > mesh.numVertices - (size_t) s.baseVertex) return false;
+        if (s.firstIndex > mesh.numIndices || s.numIndices > mesh.numIndices - s.firstIndex) return false;
+    }
+    for (size_t i = 0; i < mesh.numLods; ++i) {
+        const StaticLod& l = mesh.lods[i];
+        if (l.firstIndex > mesh.numIndices || l.numIndices > mesh.numIndices - l.firstIndex) return false;
+    }
+    for (size_t i = 0; i < mesh.numMeshlets; ++i) {
+        const Meshlet& m = mesh.meshlets[i];
+        if (m.firstIndex > mesh.numIndices || m.numIndices > mesh.numIndices - m.firstIndex) return false;
+        if (m.submesh >= mesh.numSubmeshes || m.baseVertex != mesh.submeshes[m.submesh].baseVertex) return false;
+    }
+    return true;
+}
+
+static bool ParseCookedMesh(CookedMesh* mesh, const void* data, size_t size) {
+    const CookedChunk* verts = Cooked_FindChunk(data, size, COOKED_CHUNK_VERTICES, sizeof(GlStaticMeshVert));
+    const CookedChunk* indices = Cooked_FindChunk(data, size, COOKED_CHUNK_INDICES, sizeof(uint16_t));
+    GLenum indexType = GL_UNSIGNED_SHORT;
+    if (!indices) {
+        indices = Cooked_FindChunk(data, size, COOKED_CHUNK_INDICES, sizeof(GLuint));
+        indexType = GL_UNSIGNED_INT;
+    }
+    const CookedChunk* packedVerts = Cooked_FindChunk(data, size, COOKED_CHUNK_PACKED_VERTICES, 1);
+    const CookedChunk* packedIndices = Cooked_FindChunk(data, size, COOKED_CHUNK_PACKED_INDICES, 1);
+    const CookedChunk* submeshes = Cooked_FindChunk(data, size, COOKED_CHUNK_SUBMESHES, sizeof(StaticSubmesh));
+    const CookedChunk* meshlets = Cooked_FindChunk(data, size, COOKED_CHUNK_MESHLETS, sizeof(Meshlet));
+    const CookedChunk* lods = Cooked_FindChunk(data, size, COOKED_CHUNK_LODS, sizeof(StaticLod));
+    const CookedChunk* materials = Cooked_FindChunk(data, size, COOKED_CHUNK_MATERIALS, 1);
+    const CookedChunk* lightmapCoords = Cooked_FindChunk(data, size, COOKED_CHUNK_LIGHTMAP_COORDS, sizeof(glm::vec2));
+    const CookedChunk* lightmap = Cooked_FindChunk(data, size, COOKED_CHUNK_LIGHTMAP_INFO, sizeof(LightmapInfo));
+    bool packed = !verts && !indices && packedVerts && packedIndices;
+    if (!(verts && indices) && !packed) return false;
+    if (!submeshes || !meshlets || !lods || !materials) return false;
+
+    auto base = (const char*) data;
+    if (!ReadMaterials(&mesh->materials, base + materials->offset, (size_t) materials->size)) return false;
+    mesh->submeshes = (const StaticSubmesh*) (base + submeshes->offset);
+    mesh->numSubmeshes = (size_t) (submeshes->size / sizeof(StaticSubmesh));
+    mesh->meshlets = (const Meshlet*) (base + meshlets->offset);
+    mesh->numMeshlets = (size_t) (meshlets->size / sizeof(Meshlet));
+    mesh->lods = (const StaticLod*) (base + lods->offset);
+    mesh->numLods = (size_t) (lods->size / sizeof(StaticLod));
+    mesh->lightmapCoords = nullptr;
+    mesh->lightmap = LightmapInfo {};
+    if (packed) {
+        if (!DecodeCookedMesh(mesh, base + packedVerts->offset, (size_t) packedVerts->size,
+                              base + packedIndices->offset, (size_t) packedIndices->size)) return false;
+    } else {
+        mesh->vertices = (const GlStaticMeshVert*) (base + verts->offset);
+        mesh->numVertices = (size_t) (verts->size / sizeof(GlStaticMeshVert));
+        mesh->indices = base + indices->offset;
+        mesh->numIndices = (size_t) (indices->size / indices->stride);
+        mesh->indexType = indexType;
+    }
+    if (lightmapCoords && lightmap && lightmapCoords->size / sizeof(glm::vec2) == mesh->numVertices) {
+        mesh->lightmapCoords = (const glm::vec2*) (base + lightmapCoords->offset);
+        mesh->lightmap = *(const LightmapInfo*) (base + lightmap->offset);
+    }
+    return CookedMeshRangesValid(*mesh);
+}
+
+bool CookedMesh_Open(CookedMesh* mesh, const char* path, const char* sourcePath) {
+    if (!Cooked_Open(&mesh->file, path, COOKED_MESH_MAGIC, COOKED_MESH_VERSION, sourcePath)) return false;
+    if (!ParseCookedMesh(mesh, mesh->file.data, mesh->file.size)) {
+        MappedFile_Close(&mesh->file);
+        return false;
+    }
+    return true;
+}
+
+bool CookedMesh_OpenMemory(CookedMesh* mesh, const void* data, size_t size) {
+    return Cooked_Validate(data, size, COOKED_MESH_MAGIC, COOKED_MESH_VERSION)
+        && ParseCookedMesh(mesh, data, size);
+}
+
+void CookedMesh_Close(CookedMesh* mesh) {
+    MappedFile_Close(&mesh->file);
+    mesh->vertices = nullptr;
+    mesh->numVertices = 0;
+    mesh->indices = nullptr;
+    mesh->numIndices = 0;
+    mesh->indexType = GL_UNSIGNED_INT;
+    mesh->submeshes = nullptr;
+    mesh->numSubmeshes = 0;
+    mesh->meshlets = nullptr;
+    mesh->numMeshlets = 0;
+    mesh->lods = nullptr;
+    mesh->numLods = 0;
+    mesh->lightmapCoords = nullptr;
+    mesh->lightmap = LightmapInfo {};
+    mesh->imported = StaticMesh {};
+    mesh->decodedVertices = std::vector<GlStaticMeshVert> {};
+    mesh->decodedIndices = std::vector<uint8_t> {};
+    mesh->materials = std::vector<MaterialDesc> {};
+}
+
+bool CookStaticMesh(StaticMesh* mesh, const char* sourcePath, const PackFile* pack, const LightmapUvParams* lightmap) {
+    if (!LoadStaticMesh(mesh, sourcePath, pack)) return false;
+    if (lightmap) GenerateLightmapUvs(mesh, *lightmap);
+    SplitStaticMesh(mesh);
+    OptimizeStaticMesh(mesh);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    BuildMeshlets(&mesh->meshlets, *mesh);
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    printf("%s: %zu meshlets built in %.2f ms\n", sourcePath, mesh->meshlets.size(), dur.count());
+    BuildLods(mesh, MAX_LOD_LEVELS);
+    return true;
+}
+
+bool LoadCookedStaticMesh(CookedMesh* mesh, const char* sourcePath, const PackFile* pack, const LightmapUvParams* lightmap) {
+    std::string cookedPath = CookedMesh_PathFor(sourcePath);
+    std::string_view packed = PackFile_View(pack, cookedPath);
+    if (packed.data() && CookedMesh_OpenMemory(mesh, packed.data(), packed.size())) {
+        if (!lightmap || mesh->lightmapCoords) return true;
+        CookedMesh_Close(mesh);
+    }
+    if (CookedMesh_Open(mesh, cookedPath.c_str(), sourcePath)) {
+        if (!lightmap || mesh->lightmapCoords) return true;
+        CookedMesh_Close(mesh);
+    }
+
+    printf("%s: cooked mesh missing or stale%s, importing\n", sourcePath, lightmap ? " or without lightmap UVs" : "");
+    if (!CookStaticMesh(&mesh->imported, sourcePath, pack, lightmap)) return false;
+    if (CookedMesh_Write(mesh->imported, cookedPath.c_str(), sourcePath)
+        && CookedMesh_Open(mesh, cookedPath.c_str(), sourcePath)) {
+        mesh->imported = StaticMesh {};
+        return true;
+    }
+
+    printf("%s: could not write %s, using imported mesh\n", sourcePath, cookedPath.c_str());
+    mesh->vertices = mesh->imported.vertices.data();
+    mesh->numVertices = mesh->imported.vertices.size();
+    mesh->indices = mesh->imported.indices.data();
+    mesh->numIndices = mesh->imported.indices.size();
+    mesh->indexType = GL_UNSIGNED_INT;
+    mesh->submeshes = mesh->imported.submeshes.data();
+    mesh->numSubmeshes = mesh->imported.submeshes.size();
+    mesh->meshlets = mesh->imported.meshlets.data();
+    mesh->numMeshlets = mesh->imported.meshlets.size();
+    mesh->lods = mesh->imported.lods.data();
+    mesh->numLods = mesh->imported.lods.size();
+    mesh->lightmapCoords = mesh->imported.lightmapCoords.empty() ? nullptr : mesh->imported.lightmapCoords.data();
+    mesh->lightmap = mesh->imported.lightmap;
+    mesh->materials = mesh->imported.materials;
+    return true;
+}
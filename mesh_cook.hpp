@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "cooked_file.hpp"
+#include "lightmap_uv.hpp"
+#include "mapped_file.hpp"
+#include "pack_file.hpp"
+#include "static_mesh.hpp"
+
+// Cooked meshes use the cooked_file container with payloads laid out exactly
+// as they are uploaded, so a cooked file can be mapped and handed to
+// LoadStaticMesh(GlStaticMesh*, ...) without parsing.
+// Bump COOKED_MESH_VERSION whenever the payload layout changes; older files
+// are then treated as stale and recooked from the source asset. The index
+// chunk stride is 2 when every submesh fits in 16-bit indices, else 4.
+//
+// A compressed cooked mesh replaces the vertex and index chunks with
+// mesh_codec streams in COOKED_CHUNK_PACKED_*. Its vertices are quantized to
+// GlCompactVert precision on the way, and it is decoded into memory on open
+// instead of being used in place.
+//
+// Materials are stored with WriteMaterials, embedded textures included, and
+// are always copied out on open.
+//
+// Meshes cooked with lightmap UVs add COOKED_CHUNK_LIGHTMAP_COORDS, one
+// glm::vec2 per vertex, uncompressed either way, and the LightmapInfo of
+// their atlas in COOKED_CHUNK_LIGHTMAP_INFO.
+
+static constexpr uint32_t COOKED_MESH_MAGIC     = 0x4d524250; // "PBRM"
+static constexpr uint32_t COOKED_MESH_VERSION   = 11;
+
+enum CookedMeshChunkId : uint32_t {
+    COOKED_CHUNK_VERTICES        = 1,
+    COOKED_CHUNK_INDICES         = 2,
+    COOKED_CHUNK_SUBMESHES       = 3,
+    COOKED_CHUNK_MESHLETS        = 4,
+    COOKED_CHUNK_LODS            = 5,
+    COOKED_CHUNK_PACKED_VERTICES = 6,
+    COOKED_CHUNK_PACKED_INDICES  = 7,
+    COOKED_CHUNK_MATERIALS       = 8,
+    COOKED_CHUNK_LIGHTMAP_COORDS = 9,
+    COOKED_CHUNK_LIGHTMAP_INFO   = 10,
+};
+
+struct CookedMesh {
+    MappedFile              file;
+    const GlStaticMeshVert* vertices;
+    size_t                  numVertices;
+    const void*             indices;
+    size_t                  numIndices;
+    GLenum                  indexType;      // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    const StaticSubmesh*    submeshes;
+    size_t                  numSubmeshes;
+    const Meshlet*          meshlets;
+    size_t                  numMeshlets;
+    const StaticLod*        lods;
+    size_t                  numLods;        // levels * numSubmeshes entries
+    const glm::vec2*        lightmapCoords; // numVertices entries, or null
+    LightmapInfo            lightmap;
+
+    // Only used when the cooked file could not be written, e.g. from a
+    // read-only install directory. The pointers above then refer to this.
+    StaticMesh              imported;
+
+    // Decoded vertices and indices of a compressed cooked mesh, which
+    // vertices and indices then refer to.
+    std::vector<GlStaticMeshVert> decodedVertices;
+    std::vector<uint8_t>          decodedIndices;
+
+    std::vector<MaterialDesc>     materials;
+};
+
+// COOKED_DIR/<sourcePath>.mesh
+std::string CookedMesh_PathFor(const char* sourcePath);
+// compress writes the vertices and indices as COOKED_CHUNK_PACKED_* streams.
+bool CookedMesh_Write(const StaticMesh& mesh, const char* path, const char* sourcePath, bool compress = false);
+bool CookedMesh_Open(CookedMesh* mesh, const char* path, const char* sourcePath);
+// Views a cooked mesh in memory owned by someone else, e.g. a pack entry,
+// which must outlive it.
+bool CookedMesh_OpenMemory(CookedMesh* mesh, const void* data, size_t size);
+void CookedMesh_Close(CookedMesh* mesh);
+
+// Imports sourcePath through Assimp, gives it lightmap UVs if lightmap is
+// set, splits it for 16-bit indices, runs it through OptimizeStaticMesh,
+// splits it into meshlets and gives it a LOD chain: everything that goes
+// into a cooked mesh. The source is read from pack when it contains it.
+bool CookStaticMesh(StaticMesh* mesh, const char* sourcePath, const PackFile* pack = nullptr,
+                    const LightmapUvParams* lightmap = nullptr);
+
+// Opens the cooked version of sourcePath: from pack if given and it has one,
+// else as written to disk by assetcook or an earlier run. If that is missing
+// or stale, or lightmap is set and it has no lightmap UVs, it is cooked with
+// CookStaticMesh and written back.
+bool LoadCookedStaticMesh(CookedMesh* mesh, const char* sourcePath, const PackFile* pack = nullptr,
+                          const LightmapUvParams* lightmap = nullptr);
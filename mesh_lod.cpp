@@ -0,0 +1,387 @@
+#include "mesh_lod.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+#include <glm/geometric.hpp>
+
+#include "mesh_optimize.hpp"
+#include "parallel.hpp"
+
+// Penalty for moving a border or seam vertex off its edge, relative to the
+// area-weighted triangle planes.
+static const double BORDER_WEIGHT = 10.0;
+
+// Sum of weighted squared plane distances: Q(p) = p.A.p + 2 b.p + c,
+// normalized by the total weight so errors are mean squared distances.
+struct Quadric {
+    double a00, a11, a22, a01, a02, a12;
+    double b0, b1, b2;
+    double c;
+    double w;
+};
+
+static void Quadric_AddPlane(Quadric* q, glm::dvec3 n, double d, double w) {
+    q->a00 += w * n.x * n.x;
+    q->a11 += w * n.y * n.y;
+    q->a22 += w * n.z * n.z;
+    q->a01 += w * n.x * n.y;
+    q->a02 += w * n.x * n.z;
+    q->a12 += w * n.y * n.z;
+    q->b0 += w * n.x * d;
+    q->b1 += w * n.y * d;
+    q->b2 += w * n.z * d;
+    q->c += w * d * d;
+    q->w += w;
+}
+
+static void Quadric_Add(Quadric* q, const Quadric& o) {
+    q->a00 += o.a00; q->a11 += o.a11; q->a22 += o.a22;
+    q->a01 += o.a01; q->a02 += o.a02; q->a12 += o.a12;
+    q->b0 += o.b0; q->b1 += o.b1; q->b2 += o.b2;
+    q->c += o.c;
+    q->w += o.w;
+}
+
+static double Quadric_Eval(const Quadric& q, glm::dvec3 p) {
+    double r = q.a00 * p.x * p.x + q.a11 * p.y * p.y + q.a22 * p.z * p.z
+             + 2.0 * (q.a01 * p.x * p.y + q.a02 * p.x * p.z + q.a12 * p.y * p.z)
+             + 2.0 * (q.b0 * p.x + q.b1 * p.y + q.b2 * p.z)
+             + q.c;
+    return q.w > 0.0 ? std::max(r, 0.0) / q.w : 0.0;
+}
+
+enum VertexKind : unsigned char {
+    VK_MANIFOLD,    // interior, no attribute seam: collapses anywhere
+    VK_BORDER,      // on an open border: collapses along the border
+    VK_SEAM,        // one of two attribute copies: collapses along the seam with its twin
+    VK_LOCKED,      // corners, seam junctions, non-manifold: never moves
+};
+
+struct PosKey {
+    uint32_t x, y, z;
+    bool operator==(const PosKey& o) const { return x == o.x && y == o.y && z == o.z; }
+};
+
+struct PosKeyHash {
+    size_t operator()(const PosKey& k) const {
+        return (size_t) ((k.x * 73856093u) ^ (k.y * 19349663u) ^ (k.z * 83492791u));
+    }
+};
+
+static inline PosKey MakePosKey(glm::vec3 p) {
+    PosKey k;
+    // + 0.0f folds -0 into +0 so they weld.
+    float x = p.x + 0.0f, y = p.y + 0.0f, z = p.z + 0.0f;
+    memcpy(&k.x, &x, 4);
+    memcpy(&k.y, &y, 4);
+    memcpy(&k.z, &z, 4);
+    return k;
+}
+
+static inline uint64_t EdgeKey(GLuint a, GLuint b) {
+    return ((uint64_t) a << 32) | b;
+}
+
+// Sorted edge keys; cheaper to build and probe than a hash set at these sizes.
+struct EdgeSet {
+    std::vector<uint64_t> keys;
+
+    void Build(const std::vector<GLuint>& indices, const GLuint* remap, bool directed) {
+        keys.resize(indices.size());
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                GLuint a = remap ? remap[indices[i + k]] : indices[i + k];
+                GLuint b = remap ? remap[indices[i + (k + 1) % 3]] : indices[i + (k + 1) % 3];
+                keys[i + k] = directed ? EdgeKey(a, b) : EdgeKey(std::min(a, b), std::max(a, b));
+            }
+        }
+        std::sort(keys.begin(), keys.end());
+    }
+
+    bool Contains(uint64_t key) const {
+        return std::binary_search(keys.begin(), keys.end(), key);
+    }
+};
+
+struct Collapse {
+    GLuint u, v;        // u moves onto v
+    GLuint u2, v2;      // seam twins, only for VK_SEAM
+    double cost;
+};
+
+size_t SimplifyMesh(
+        GLuint*                 dst,
+        const GLuint*           indices,
+        size_t                  numindices,
+        const GlStaticMeshVert* verts,
+        size_t                  numverts,
+        size_t                  targetindices,
+        float*                  error) {
+    *error = 0.0f;
+    std::vector<GLuint> cur(indices, indices + numindices);
+    if (targetindices >= numindices || numverts == 0) {
+        std::copy(cur.begin(), cur.end(), dst);
+        return numindices;
+    }
+
+    // Weld positions; wedge[] links all vertices sharing one position in a cycle.
+    std::vector<GLuint> posid(numverts), wedge(numverts);
+    {
+        std::unordered_map<PosKey, GLuint, PosKeyHash> lookup;
+        lookup.reserve(numverts);
+        for (GLuint v = 0; v < numverts; ++v) {
+            auto it = lookup.emplace(MakePosKey(verts[v].pos), v).first;
+            posid[v] = it->second;
+            wedge[v] = v;
+            if (it->second != v) {
+                wedge[v] = wedge[it->second];
+                wedge[it->second] = v;
+            }
+        }
+    }
+
+    EdgeSet posedges, edges;
+    posedges.Build(cur, posid.data(), true);
+    edges.Build(cur, nullptr, true);
+
+    // Classify vertices and build quadrics from the full-detail surface.
+    std::vector<bool> onborder(numverts, false);
+    std::vector<Quadric> quadrics(numverts, Quadric {});
+    for (size_t i = 0; i < numindices; i += 3) {
+        glm::dvec3 p[3] = { verts[cur[i]].pos, verts[cur[i + 1]].pos, verts[cur[i + 2]].pos };
+        glm::dvec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+        double area = glm::length(n);
+        if (area <= 0.0) continue;
+        n /= area;
+        for (int k = 0; k < 3; ++k) Quadric_AddPlane(&quadrics[posid[cur[i + k]]], n, -glm::dot(n, p[0]), area * 0.5);
+
+        for (int k = 0; k < 3; ++k) {
+            GLuint a = cur[i + k], b = cur[i + (k + 1) % 3];
+            bool border = !posedges.Contains(EdgeKey(posid[b], posid[a]));
+            bool seam = !border && !edges.Contains(EdgeKey(b, a));
+            if (border) onborder[posid[a]] = onborder[posid[b]] = true;
+            if (!border && !seam) continue;
+
+            // Plane through the edge, perpendicular to the triangle.
+            glm::dvec3 e = p[(k + 1) % 3] - p[k];
+            glm::dvec3 en = glm::cross(e, n);
+            double len = glm::length(en);
+            if (len <= 0.0) continue;
+            en /= len;
+            double w = glm::dot(e, e) * BORDER_WEIGHT;
+            Quadric_AddPlane(&quadrics[posid[a]], en, -glm::dot(en, p[k]), w);
+            Quadric_AddPlane(&quadrics[posid[b]], en, -glm::dot(en, p[k]), w);
+        }
+    }
+
+    std::vector<VertexKind> kind(numverts);
+    for (GLuint v = 0; v < numverts; ++v) {
+        unsigned copies = 1;
+        for (GLuint w = wedge[v]; w != v && copies < 3; w = wedge[w]) copies++;
+        bool border = onborder[posid[v]];
+        if (copies == 1) kind[v] = border ? VK_BORDER : VK_MANIFOLD;
+        else if (copies == 2 && !border) kind[v] = VK_SEAM;
+        else kind[v] = VK_LOCKED;
+    }
+
+    std::vector<GLuint> remap(numverts);
+    for (GLuint v = 0; v < numverts; ++v) remap[v] = v;
+    std::vector<unsigned> adjoffsets, adjtris;
+    std::vector<bool> locked;
+    std::vector<Collapse> candidates;
+    double maxcost = 0.0;
+
+    for (int pass = 0; pass < 256 && cur.size() > targetindices; ++pass) {
+        size_t numtris = cur.size() / 3;
+
+        // Position -> triangle adjacency and current edge sets.
+        adjoffsets.assign(numverts + 1, 0);
+        for (GLuint v : cur) adjoffsets[posid[v] + 1]++;
+        for (size_t v = 0; v < numverts; ++v) adjoffsets[v + 1] += adjoffsets[v];
+        adjtris.resize(cur.size());
+        {
+            std::vector<unsigned> fill(adjoffsets.begin(), adjoffsets.end() - 1);
+            for (size_t i = 0; i < cur.size(); ++i) adjtris[fill[posid[cur[i]]]++] = (unsigned) (i / 3);
+        }
+        posedges.Build(cur, posid.data(), true);
+        edges.Build(cur, nullptr, false);
+
+        candidates.clear();
+        for (size_t i = 0; i < cur.size(); i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                GLuint a = cur[i + k], b = cur[i + (k + 1) % 3];
+                bool open = !posedges.Contains(EdgeKey(posid[b], posid[a]));
+                for (int dir = 0; dir < 2; ++dir) {
+                    GLuint u = dir ? b : a, v = dir ? a : b;
+                    if (posid[u] == posid[v]) continue;
+                    Collapse c { u, v, u, v, 0.0 };
+                    if (kind[u] == VK_LOCKED) continue;
+                    if (kind[u] == VK_BORDER && !open) continue;
+                    if (kind[u] == VK_SEAM) {
+                        // The twin of u must share an edge with a twin of v,
+                        // otherwise u-v does not run along the seam.
+                        c.u2 = wedge[u];
+                        c.v2 = v;
+                        for (GLuint w = wedge[v]; w != v; w = wedge[w]) {
+                            if (edges.Contains(EdgeKey(std::min(c.u2, w), std::max(c.u2, w)))) {
+                                c.v2 = w;
+                                break;
+                            }
+                        }
+                        if (c.v2 == v) continue;
+                    }
+                    c.cost = Quadric_Eval(quadrics[posid[u]], glm::dvec3 { verts[v].pos });
+                    candidates.push_back(c);
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& x, const Collapse& y) {
+            return x.cost < y.cost;
+        });
+
+        // Collapses in one pass must not share triangles, so the flip test
+        // below always sees the geometry the collapse is applied to.
+        locked.assign(numverts, false);
+        size_t needed = numtris - targetindices / 3;
+        size_t removed = 0, performed = 0;
+        for (const Collapse& c : candidates) {
+            if (removed >= needed) break;
+            GLuint pu = posid[c.u], pv = posid[c.v];
+            if (locked[pu] || locked[pv]) continue;
+
+            glm::vec3 target = verts[c.v].pos;
+            bool flips = false;
+            for (unsigned a = adjoffsets[pu]; a < adjoffsets[pu + 1] && !flips; ++a) {
+                const GLuint* t = &cur[adjtris[a] * 3];
+                if (posid[t[0]] == pv || posid[t[1]] == pv || posid[t[2]] == pv) continue;
+                glm::vec3 p[3], q[3];
+                for (int k = 0; k < 3; ++k) {
+                    p[k] = verts[t[k]].pos;
+                    q[k] = posid[t[k]] == pu ? target : p[k];
+                }
+                glm::vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 n1 = glm::cross(q[1] - q[0], q[2] - q[0]);
+                flips = glm::dot(n0, n1) <= 1e-3f * glm::length(n0) * glm::length(n1);
+            }
+            if (flips) continue;
+
+            remap[c.u] = c.v;
+            remap[c.u2] = c.v2;
+            Quadric_Add(&quadrics[pv], quadrics[pu]);
+            for (unsigned a = adjoffsets[pu]; a < adjoffsets[pu + 1]; ++a) {
+                const GLuint* t = &cur[adjtris[a] * 3];
+                for (int k = 0; k < 3; ++k) locked[posid[t[k]]] = true;
+            }
+            locked[pu] = locked[pv] = true;
+            maxcost = std::max(maxcost, c.cost);
+            removed += kind[c.u] == VK_BORDER ? 1 : 2;
+            performed++;
+        }
+        if (performed == 0) break;
+
+        size_t out = 0;
+        for (size_t i = 0; i < cur.size(); i += 3) {
+            GLuint a = remap[cur[i]], b = remap[cur[i + 1]], c = remap[cur[i + 2]];
+            if (posid[a] == posid[b] || posid[b] == posid[c] || posid[c] == posid[a]) continue;
+            cur[out++] = a;
+            cur[out++] = b;
+            cur[out++] = c;
+        }
+        cur.resize(out);
+        for (const Collapse& c : candidates) {
+            remap[c.u] = c.u;
+            remap[c.u2] = c.u2;
+        }
+    }
+
+    *error = (float) sqrt(maxcost);
+    std::copy(cur.begin(), cur.end(), dst);
+    return cur.size();
+}
+
+void BuildLods(StaticMesh* mesh, int levels) {
+    auto start = std::chrono::high_resolution_clock::now();
+    levels = std::max(1, std::min(levels, MAX_LOD_LEVELS));
+    size_t numsubs = mesh->submeshes.size();
+
+    struct Level {
+        std::vector<GLuint> indices;
+        float               error;
+    };
+    std::vector<std::vector<Level>> sublevels(numsubs);
+    ParallelFor(numsubs, 1, [&](size_t begin, size_t end) {
+        std::vector<GLuint> scratch;
+        for (size_t s = begin; s < end; ++s) {
+            const StaticSubmesh& sub = mesh->submeshes[s];
+            const GlStaticMeshVert* verts = mesh->vertices.data() + sub.baseVertex;
+            const GLuint* prev = mesh->indices.data() + sub.firstIndex;
+            size_t prevcount = sub.numIndices;
+            float error = 0.0f;
+            for (int level = 1; level < levels; ++level) {
+                scratch.resize(prevcount);
+                float passerror;
+                size_t target = prevcount / 6 * 3;
+                size_t count = SimplifyMesh(scratch.data(), prev, prevcount, verts, sub.numVertices, target, &passerror);
+                // Stop once locked seams and borders keep the level from
+                // getting meaningfully cheaper than the previous one.
+                if (count == 0 || count > prevcount * 9 / 10) break;
+
+                // Each pass measures its error against the level it started
+                // from, whose quadrics no longer know the original surface,
+                // so the sum bounds how far this level is from level 0.
+                error += passerror;
+                Level lod { std::vector<GLuint>(count), error };
+                OptimizeVertexCache(lod.indices.data(), scratch.data(), count, sub.numVertices, VERTEX_CACHE_SIZE);
+                sublevels[s].push_back(std::move(lod));
+                prev = sublevels[s].back().indices.data();
+                prevcount = count;
+            }
+        }
+    });
+
+    // Every submesh gets the same number of levels; those that ran out of
+    // headroom repeat their coarsest one.
+    size_t built = 1;
+    for (const auto& l : sublevels) built = std::max(built, l.size() + 1);
+    mesh->lods.clear();
+    mesh->lods.reserve(built * numsubs);
+    for (const StaticSubmesh& sub : mesh->submeshes) {
+        mesh->lods.push_back(StaticLod { sub.firstIndex, sub.numIndices, 0.0f });
+    }
+    for (size_t level = 1; level < built; ++level) {
+        for (size_t s = 0; s < numsubs; ++s) {
+            if (level > sublevels[s].size()) {
+                mesh->lods.push_back(mesh->lods[(level - 1) * numsubs + s]);
+                continue;
+            }
+            const Level& lod = sublevels[s][level - 1];
+            mesh->lods.push_back(StaticLod { (GLuint) mesh->indices.size(), (GLuint) lod.indices.size(), lod.error });
+            mesh->indices.insert(mesh->indices.end(), lod.indices.begin(), lod.indices.end());
+        }
+    }
+
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    printf("built %zu LODs in %.2f ms\n", built, dur.count());
+    for (size_t level = 0; level < built; ++level) {
+        size_t tris = 0;
+        float error = 0.0f;
+        for (size_t s = 0; s < numsubs; ++s) {
+            tris += mesh->lods[level * numsubs + s].numIndices / 3;
+            error = std::max(error, mesh->lods[level * numsubs + s].error);
+        }
+        printf("  LOD %zu: %zu tris, error %g\n", level, tris, error);
+    }
+}
+
+int SelectLod(const float* errors, int levels, float pxperunit, int current, float thresholdpx, float hysteresis) {
+    for (int level = levels - 1; level > 0; --level) {
+        float limit = thresholdpx * (level > current ? 1.0f - hysteresis : 1.0f);
+        if (errors[level] * pxperunit <= limit) return level;
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "static_mesh.hpp"
+
+static constexpr int MAX_LOD_LEVELS = 6;
+
+// Quadric error edge-collapse simplification (Garland & Heckbert) using
+// half-edge collapses only, so the result indexes a subset of verts.
+// Vertices on open borders only slide along the border, and vertices split
+// by UV or tangent-frame seams only collapse along the seam together with
+// their twin; anything more tangled than that stays put. Writes at most
+// numindices indices to dst (which may alias indices) and returns the count;
+// *error receives the largest collapse error in mesh units.
+size_t SimplifyMesh(
+        GLuint*                 dst,
+        const GLuint*           indices,
+        size_t                  numindices,
+        const GlStaticMeshVert* verts,
+        size_t                  numverts,
+        size_t                  targetindices,
+        float*                  error);
+
+// Builds up to `levels` LODs (including level 0) per submesh, halving the
+// triangle count each level, appends their indices to mesh->indices and
+// fills mesh->lods. Each level is simplified from the one before it, and its
+// error is the sum of every pass's so far, an upper bound on its distance
+// from level 0. Prints triangle count and error per level.
+void BuildLods(StaticMesh* mesh, int levels);
+
+// Coarsest level whose error, projected to the screen, stays within
+// thresholdpx. pxperunit is the projected size of one object-space unit at
+// the object's nearest point. Moving to a coarser level than `current`
+// additionally requires the error to drop below (1 - hysteresis) of the
+// threshold, which keeps objects near a boundary from flickering.
+int SelectLod(const float* errors, int levels, float pxperunit, int current, float thresholdpx, float hysteresis);
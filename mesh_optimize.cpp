@@ -0,0 +1,304 @@
+#include "mesh_optimize.hpp"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <glm/geometric.hpp>
+
+#include "parallel.hpp"
+
+// FIFO cache simulated with timestamps: a vertex is resident while fewer
+// than cachesize misses happened since it was last loaded.
+struct CacheSim {
+    std::vector<unsigned> stamps;
+    unsigned              time;
+    unsigned              size;
+
+    CacheSim(size_t numverts, unsigned cachesize)
+        : stamps(numverts, 0), time(cachesize + 1), size(cachesize) {}
+
+    unsigned Access(GLuint v) {
+        if (time - stamps[v] <= size) return 0;
+        stamps[v] = time++;
+        return 1;
+    }
+
+    void Flush() { time += size + 1; }
+};
+
+VertexCacheStats AnalyzeVertexCache(const GLuint* indices, size_t numindices, size_t numverts, unsigned cachesize) {
+    VertexCacheStats stats {};
+    CacheSim cache { numverts, cachesize };
+    std::vector<bool> used(numverts, false);
+    for (size_t i = 0; i < numindices; ++i) {
+        stats.misses += cache.Access(indices[i]);
+        if (!used[indices[i]]) {
+            used[indices[i]] = true;
+            stats.vertices++;
+        }
+    }
+    stats.triangles = numindices / 3;
+    stats.acmr = stats.triangles ? (float) stats.misses / stats.triangles : 0.0f;
+    stats.atvr = stats.vertices ? (float) stats.misses / stats.vertices : 0.0f;
+    return stats;
+}
+
+VertexCacheStats AnalyzeVertexCache(const StaticMesh& mesh, unsigned cachesize) {
+    VertexCacheStats total {};
+    for (const StaticSubmesh& sub : mesh.submeshes) {
+        VertexCacheStats stats = AnalyzeVertexCache(
+            mesh.indices.data() + sub.firstIndex, sub.numIndices, sub.numVertices, cachesize);
+        total.misses += stats.misses;
+        total.triangles += stats.triangles;
+        total.vertices += stats.vertices;
+    }
+    total.acmr = total.triangles ? (float) total.misses / total.triangles : 0.0f;
+    total.atvr = total.vertices ? (float) total.misses / total.vertices : 0.0f;
+    return total;
+}
+
+// Vertex -> triangle adjacency in compressed rows.
+struct TriangleAdjacency {
+    std::vector<unsigned> offsets;
+    std::vector<unsigned> triangles;
+};
+
+static void BuildAdjacency(TriangleAdjacency* adj, const GLuint* indices, size_t numindices, size_t numverts) {
+    adj->offsets.assign(numverts + 1, 0);
+    for (size_t i = 0; i < numindices; ++i) adj->offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < numverts; ++v) adj->offsets[v + 1] += adj->offsets[v];
+
+    std::vector<unsigned> fill(adj->offsets.begin(), adj->offsets.end() - 1);
+    adj->triangles.resize(numindices);
+    for (size_t i = 0; i < numindices; ++i) adj->triangles[fill[indices[i]]++] = (unsigned) (i / 3);
+}
+
+void OptimizeVertexCache(GLuint* dst, const GLuint* indices, size_t numindices, size_t numverts, unsigned cachesize) {
+    size_t numtris = numindices / 3;
+    TriangleAdjacency adj;
+    BuildAdjacency(&adj, indices, numindices, numverts);
+
+    std::vector<unsigned> live(numverts);
+    for (size_t v = 0; v < numverts; ++v) live[v] = adj.offsets[v + 1] - adj.offsets[v];
+
+    std::vector<unsigned> stamps(numverts, 0);
+    std::vector<bool> emitted(numtris, false);
+    std::vector<GLuint> deadend;
+    std::vector<GLuint> candidates;
+    unsigned time = cachesize + 1;
+    size_t cursor = 0;
+    size_t out = 0;
+
+    auto skipDeadEnd = [&]() -> long long {
+        while (!deadend.empty()) {
+            GLuint v = deadend.back();
+            deadend.pop_back();
+            if (live[v] > 0) return v;
+        }
+        for (; cursor < numverts; ++cursor) {
+            if (live[cursor] > 0) return (long long) cursor;
+        }
+        return -1;
+    };
+
+    long long fan = skipDeadEnd();
+    while (fan >= 0) {
+        candidates.clear();
+        for (unsigned a = adj.offsets[fan]; a < adj.offsets[fan + 1]; ++a) {
+            unsigned t = adj.triangles[a];
+            if (emitted[t]) continue;
+            emitted[t] = true;
+            for (int k = 0; k < 3; ++k) {
+                GLuint v = indices[t * 3 + k];
+                dst[out++] = v;
+                deadend.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - stamps[v] > cachesize) stamps[v] = time++;
+            }
+        }
+
+        // Prefer the candidate that stays in cache longest once its remaining
+        // triangles are emitted; fall back to the dead-end stack otherwise.
+        long long next = -1;
+        int best = -1;
+        for (GLuint v : candidates) {
+            if (live[v] == 0) continue;
+            int priority = 0;
+            if (time - stamps[v] + 2 * live[v] <= cachesize) priority = (int) (time - stamps[v]);
+            if (priority > best) {
+                best = priority;
+                next = v;
+            }
+        }
+        fan = next >= 0 ? next : skipDeadEnd();
+    }
+}
+
+void OptimizeOverdraw(
+        GLuint*                 dst,
+        const GLuint*           indices,
+        size_t                  numindices,
+        const GlStaticMeshVert* verts,
+        size_t                  numverts,
+        unsigned                cachesize,
+        float                   threshold) {
+    size_t numtris = numindices / 3;
+    if (numtris == 0) return;
+
+    // Hard boundaries: triangles where all three vertices miss, i.e. where
+    // Tipsify jumped to a new dead end.
+    std::vector<size_t> hard;
+    CacheSim cache { numverts, cachesize };
+    for (size_t t = 0; t < numtris; ++t) {
+        unsigned misses = cache.Access(indices[t * 3 + 0])
+                        + cache.Access(indices[t * 3 + 1])
+                        + cache.Access(indices[t * 3 + 2]);
+        if (t == 0 || misses == 3) hard.push_back(t);
+    }
+
+    // Soft boundaries: split each hard cluster as soon as its running ACMR,
+    // measured from a cold cache, is within threshold of the whole cluster's.
+    std::vector<size_t> clusters;
+    for (size_t c = 0; c < hard.size(); ++c) {
+        size_t start = hard[c];
+        size_t end = c + 1 < hard.size() ? hard[c + 1] : numtris;
+
+        cache.Flush();
+        unsigned clustermisses = 0;
+        for (size_t t = start; t < end; ++t) {
+            clustermisses += cache.Access(indices[t * 3 + 0])
+                           + cache.Access(indices[t * 3 + 1])
+                           + cache.Access(indices[t * 3 + 2]);
+        }
+        float target = threshold * clustermisses / (float) (end - start);
+
+        clusters.push_back(start);
+        cache.Flush();
+        unsigned misses = 0, faces = 0;
+        for (size_t t = start; t < end; ++t) {
+            misses += cache.Access(indices[t * 3 + 0])
+                    + cache.Access(indices[t * 3 + 1])
+                    + cache.Access(indices[t * 3 + 2]);
+            faces++;
+            if (t + 1 < end && (float) misses / faces <= target) {
+                clusters.push_back(t + 1);
+                cache.Flush();
+                misses = faces = 0;
+            }
+        }
+    }
+
+    glm::vec3 meshcenter { 0.0f };
+    for (size_t v = 0; v < numverts; ++v) meshcenter += verts[v].pos;
+    meshcenter /= (float) std::max<size_t>(numverts, 1);
+
+    struct Cluster {
+        size_t start;
+        size_t end;
+        float  key;
+    };
+    std::vector<Cluster> sorted(clusters.size());
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        Cluster& cl = sorted[c];
+        cl.start = clusters[c];
+        cl.end = c + 1 < clusters.size() ? clusters[c + 1] : numtris;
+
+        glm::vec3 center { 0.0f }, normal { 0.0f };
+        float area = 0.0f;
+        for (size_t t = cl.start; t < cl.end; ++t) {
+            glm::vec3 a = verts[indices[t * 3 + 0]].pos;
+            glm::vec3 b = verts[indices[t * 3 + 1]].pos;
+            glm::vec3 c = verts[indices[t * 3 + 2]].pos;
+            glm::vec3 n = glm::cross(b - a, c - a);
+            float ta = glm::length(n);
+            center += (a + b + c) * (ta / 3.0f);
+            normal += n;
+            area += ta;
+        }
+        if (area > 0.0f) center /= area;
+        float len = glm::length(normal);
+        cl.key = len > 0.0f ? glm::dot(center - meshcenter, normal / len) : 0.0f;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) {
+        return a.key > b.key;
+    });
+
+    size_t out = 0;
+    for (const Cluster& cl : sorted) {
+        for (size_t i = cl.start * 3; i < cl.end * 3; ++i) dst[out++] = indices[i];
+    }
+}
+
+size_t OptimizeVertexFetch(
+        GlStaticMeshVert*       dst,
+        GLuint*                 indices,
+        size_t                  numindices,
+        const GlStaticMeshVert* verts,
+        size_t                  numverts) {
+    const GLuint unused = ~0u;
+    std::vector<GLuint> remap(numverts, unused);
+    size_t next = 0;
+    for (size_t i = 0; i < numindices; ++i) {
+        GLuint& r = remap[indices[i]];
+        if (r == unused) {
+            dst[next] = verts[indices[i]];
+            r = (GLuint) next++;
+        }
+        indices[i] = r;
+    }
+    return next;
+}
+
+void OptimizeStaticMesh(StaticMesh* mesh) {
+    auto start = std::chrono::high_resolution_clock::now();
+    VertexCacheStats before = AnalyzeVertexCache(*mesh, VERTEX_CACHE_SIZE);
+
+    std::vector<std::vector<GlStaticMeshVert>> subverts(mesh->submeshes.size());
+    std::vector<std::vector<glm::vec2>> sublightmap(mesh->submeshes.size());
+    bool lightmap = !mesh->lightmapCoords.empty();
+    ParallelFor(mesh->submeshes.size(), 1, [&](size_t begin, size_t end) {
+        std::vector<GLuint> scratch;
+        for (size_t s = begin; s < end; ++s) {
+            const StaticSubmesh& sub = mesh->submeshes[s];
+            GLuint* indices = mesh->indices.data() + sub.firstIndex;
+            const GlStaticMeshVert* verts = mesh->vertices.data() + sub.baseVertex;
+
+            scratch.resize(sub.numIndices);
+            OptimizeVertexCache(scratch.data(), indices, sub.numIndices, sub.numVertices, VERTEX_CACHE_SIZE);
+            OptimizeOverdraw(indices, scratch.data(), sub.numIndices, verts, sub.numVertices, VERTEX_CACHE_SIZE, 1.05f);
+
+            // Lightmap coordinates follow the vertices into first-use
+            // order, read off the indices before they are remapped.
+            if (lightmap) {
+                const glm::vec2* coords = mesh->lightmapCoords.data() + sub.baseVertex;
+                scratch.assign(sub.numVertices, 0);
+                for (GLuint i = 0; i < sub.numIndices; ++i) {
+                    GLuint v = indices[i];
+                    if (scratch[v]) continue;
+                    scratch[v] = 1;
+                    sublightmap[s].push_back(coords[v]);
+                }
+            }
+            subverts[s].resize(sub.numVertices);
+            size_t used = OptimizeVertexFetch(subverts[s].data(), indices, sub.numIndices, verts, sub.numVertices);
+            subverts[s].resize(used);
+        }
+    });
+
+    mesh->vertices.clear();
+    mesh->lightmapCoords.clear();
+    for (size_t s = 0; s < mesh->submeshes.size(); ++s) {
+        StaticSubmesh& sub = mesh->submeshes[s];
+        sub.baseVertex = (GLint) mesh->vertices.size();
+        sub.numVertices = (GLuint) subverts[s].size();
+        mesh->vertices.insert(mesh->vertices.end(), subverts[s].begin(), subverts[s].end());
+        mesh->lightmapCoords.insert(mesh->lightmapCoords.end(), sublightmap[s].begin(), sublightmap[s].end());
+    }
+
+    VertexCacheStats after = AnalyzeVertexCache(*mesh, VERTEX_CACHE_SIZE);
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    printf("optimized %zu tris in %.2f ms: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+           after.triangles, dur.count(), before.acmr, after.acmr, before.atvr, after.atvr);
+}
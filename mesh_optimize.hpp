@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "static_mesh.hpp"
+
+// Post-transform cache size the optimizer targets and the analysis simulates.
+// 16 entries is a conservative match for the FIFO caches of current desktop
+// GPUs; ordering for a smaller cache degrades gracefully on larger ones.
+static constexpr unsigned VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats {
+    size_t misses;
+    size_t triangles;
+    size_t vertices;
+    float  acmr;     // transformed vertices per triangle, 0.5 is the ideal for a regular grid
+    float  atvr;     // transformed vertices per referenced vertex, 1.0 is ideal
+};
+
+// Simulates a FIFO post-transform cache over indices (all < numverts).
+VertexCacheStats AnalyzeVertexCache(const GLuint* indices, size_t numindices, size_t numverts, unsigned cachesize);
+VertexCacheStats AnalyzeVertexCache(const StaticMesh& mesh, unsigned cachesize);
+
+// Tipsify (Sander et al. 2007). Writes a reordered copy of the triangle list
+// to dst, which must not alias indices.
+void OptimizeVertexCache(GLuint* dst, const GLuint* indices, size_t numindices, size_t numverts, unsigned cachesize);
+
+// Splits a cache-optimized triangle list into clusters and sorts them so
+// outward-facing clusters draw first, which approximates a view-independent
+// front-to-back order. threshold bounds how much ACMR may be given up for
+// finer clusters, 1.05 allows 5%. dst must not alias indices.
+void OptimizeOverdraw(
+        GLuint*                 dst,
+        const GLuint*           indices,
+        size_t                  numindices,
+        const GlStaticMeshVert* verts,
+        size_t                  numverts,
+        unsigned                cachesize,
+        float                   threshold);
+
+// Rewrites verts into first-use order of indices and remaps indices to match.
+// Unreferenced vertices are dropped; returns the new vertex count.
+size_t OptimizeVertexFetch(
+        GlStaticMeshVert*       dst,
+        GLuint*                 indices,
+        size_t                  numindices,
+        const GlStaticMeshVert* verts,
+        size_t                  numverts);
+
+// Runs the three passes above over every submesh, reordering the lightmap
+// coordinates along with the vertices, and prints ACMR/ATVR before and
+// after.
+void OptimizeStaticMesh(StaticMesh* mesh);
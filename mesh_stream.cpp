@@ -0,0 +1,406 @@
+#include "mesh_stream.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <glm/geometric.hpp>
+
+#include "parallel.hpp"
+
+// lcm(sizeof(GlStaticMeshVert), 4096): slots start on a page and on a vertex.
+static constexpr size_t STREAM_SLOT_GRANULARITY = 12288;
+static_assert(STREAM_SLOT_GRANULARITY % sizeof(GlStaticMeshVert) == 0, "slot granularity must hold whole vertices");
+static_assert(STREAM_SLOT_GRANULARITY % 4096 == 0, "slot granularity must hold whole pages");
+
+enum StreamChunkState : uint8_t {
+    STREAM_CHUNK_ON_DISK,
+    STREAM_CHUNK_LOADING,
+    STREAM_CHUNK_RESIDENT,
+};
+
+static inline uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+std::string StreamedMesh_PathFor(const char* sourcePath) {
+    return Cooked_PathFor(sourcePath, ".stream");
+}
+
+struct ChunkRange {
+    uint32_t submesh;
+    size_t   begin;
+    size_t   count;
+};
+
+// Median splits along the longest axis of the triangle centroids until every
+// range is small enough, so chunks come out compact and evenly filled.
+static void PartitionTriangles(std::vector<ChunkRange>* ranges, uint32_t* tris, const glm::vec3* centroids,
+                               uint32_t submesh, size_t begin, size_t count) {
+    std::vector<std::pair<size_t, size_t>> stack { { begin, count } };
+    while (!stack.empty()) {
+        auto [first, n] = stack.back();
+        stack.pop_back();
+        if (n <= STREAM_CHUNK_MAX_TRIANGLES) {
+            ranges->push_back(ChunkRange { submesh, first, n });
+            continue;
+        }
+        glm::vec3 lo { INFINITY }, hi { -INFINITY };
+        for (size_t i = first; i < first + n; ++i) {
+            lo = glm::min(lo, centroids[tris[i]]);
+            hi = glm::max(hi, centroids[tris[i]]);
+        }
+        glm::vec3 extent = hi - lo;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        size_t half = n / 2;
+        std::nth_element(tris + first, tris + first + half, tris + first + n,
+                         [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+        stack.push_back({ first + half, n - half });
+        stack.push_back({ first, half });
+    }
+}
+
+bool StreamedMesh_Write(const char* path, const SourceStamp& stamp,
+                        const GlStaticMeshVert* vertices, const void* indices, GLenum indexType,
+                        const StaticSubmesh* submeshes, size_t numSubmeshes) {
+    auto start = std::chrono::high_resolution_clock::now();
+    auto index = [&](size_t i) -> GLuint {
+        return indexType == GL_UNSIGNED_SHORT ? ((const uint16_t*) indices)[i] : ((const GLuint*) indices)[i];
+    };
+
+    // Global triangle ids, grouped by submesh, carry their absolute corners.
+    std::vector<GLuint> corners;
+    std::vector<uint32_t> tris;
+    std::vector<glm::vec3> centroids;
+    std::vector<ChunkRange> ranges;
+    for (size_t s = 0; s < numSubmeshes; ++s) {
+        const StaticSubmesh& sub = submeshes[s];
+        size_t firstTri = tris.size();
+        size_t numTris = sub.numIndices / 3;
+        corners.resize(corners.size() + numTris * 3);
+        tris.resize(firstTri + numTris);
+        centroids.resize(firstTri + numTris);
+        ParallelFor(numTris, 16384, [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t) {
+                glm::vec3 c { 0.0f };
+                for (int k = 0; k < 3; ++k) {
+                    GLuint v = index(sub.firstIndex + t * 3 + k) + (GLuint) sub.baseVertex;
+                    corners[(firstTri + t) * 3 + k] = v;
+                    c += vertices[v].pos;
+                }
+                tris[firstTri + t] = (uint32_t) (firstTri + t);
+                centroids[firstTri + t] = c / 3.0f;
+            }
+        });
+        PartitionTriangles(&ranges, tris.data(), centroids.data(), (uint32_t) s, firstTri, numTris);
+    }
+
+    // Each chunk gets its own vertices, in first-use order of the original
+    // (vertex cache optimized) triangle order, and 16-bit local indices.
+    std::vector<StreamChunk> chunks(ranges.size());
+    std::vector<std::vector<GLuint>> chunkVerts(ranges.size());
+    ParallelFor(ranges.size(), 1, [&](size_t begin, size_t end) {
+        std::vector<GLuint> ids;
+        for (size_t c = begin; c < end; ++c) {
+            const ChunkRange& r = ranges[c];
+            std::sort(tris.begin() + r.begin, tris.begin() + r.begin + r.count);
+            ids.clear();
+            for (size_t t = r.begin; t < r.begin + r.count; ++t) {
+                for (int k = 0; k < 3; ++k) ids.push_back(corners[tris[t] * 3 + k]);
+            }
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+            chunkVerts[c] = ids;
+
+            StreamChunk& chunk = chunks[c];
+            chunk.lo = glm::vec3 { INFINITY };
+            chunk.hi = glm::vec3 { -INFINITY };
+            for (GLuint v : ids) {
+                chunk.lo = glm::min(chunk.lo, vertices[v].pos);
+                chunk.hi = glm::max(chunk.hi, vertices[v].pos);
+            }
+            chunk.submesh = r.submesh;
+            chunk.numVertices = (uint32_t) ids.size();
+            chunk.numIndices = (uint32_t) (r.count * 3);
+            chunk.size = (uint32_t) (ids.size() * sizeof(GlStaticMeshVert) + r.count * 3 * sizeof(uint16_t));
+        }
+    });
+
+    uint64_t dataSize = 0;
+    for (StreamChunk& chunk : chunks) {
+        chunk.offset = dataSize;
+        dataSize = AlignUp(dataSize + chunk.size, 4096);
+    }
+    std::vector<uint8_t> data((size_t) dataSize);
+    ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            const ChunkRange& r = ranges[c];
+            const std::vector<GLuint>& ids = chunkVerts[c];
+            auto verts = (GlStaticMeshVert*) (data.data() + chunks[c].offset);
+            auto local = (uint16_t*) (verts + ids.size());
+            for (size_t i = 0; i < ids.size(); ++i) verts[i] = vertices[ids[i]];
+            for (size_t t = 0; t < r.count; ++t) {
+                for (int k = 0; k < 3; ++k) {
+                    GLuint v = corners[tris[r.begin + t] * 3 + k];
+                    local[t * 3 + k] = (uint16_t) (std::lower_bound(ids.begin(), ids.end(), v) - ids.begin());
+                }
+            }
+        }
+    });
+
+    const CookedPayload payloads[] = {
+        { COOKED_CHUNK_STREAM_CHUNKS, sizeof(StreamChunk), chunks.data(), chunks.size() * sizeof(StreamChunk) },
+        { COOKED_CHUNK_STREAM_DATA,   1,                   data.data(),   data.size() },
+    };
+    if (!Cooked_Write(path, STREAMED_MESH_MAGIC, STREAMED_MESH_VERSION, stamp, payloads, sizeof(payloads) / sizeof(payloads[0]))) {
+        return false;
+    }
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    printf("%s: %zu chunks, %.1f MB streamable, written in %.2f ms\n", path, chunks.size(), dataSize / (1024.0 * 1024.0), dur.count());
+    return true;
+}
+
+bool StreamedMesh_Open(StreamedMesh* mesh, const char* path, const char* sourcePath) {
+    *mesh = StreamedMesh {};
+    bool ok = sourcePath ? Cooked_Open(&mesh->file, path, STREAMED_MESH_MAGIC, STREAMED_MESH_VERSION, sourcePath)
+                         : MappedFile_Open(&mesh->file, path)
+                           && Cooked_Validate(mesh->file.data, mesh->file.size, STREAMED_MESH_MAGIC, STREAMED_MESH_VERSION);
+    const CookedChunk* table = ok ? Cooked_FindChunk(mesh->file.data, mesh->file.size, COOKED_CHUNK_STREAM_CHUNKS, sizeof(StreamChunk)) : nullptr;
+    const CookedChunk* data = ok ? Cooked_FindChunk(mesh->file.data, mesh->file.size, COOKED_CHUNK_STREAM_DATA, 1) : nullptr;
+    ok = table && data;
+    if (ok) {
+        auto base = (const char*) mesh->file.data;
+        mesh->chunks = (const StreamChunk*) (base + table->offset);
+        mesh->numChunks = (size_t) (table->size / sizeof(StreamChunk));
+        mesh->data = (const uint8_t*) (base + data->offset);
+    }
+    for (size_t i = 0; ok && i < mesh->numChunks; ++i) {
+        const StreamChunk& c = mesh->chunks[i];
+        ok = c.offset <= data->size && c.size <= data->size - c.offset
+          && c.size == c.numVertices * sizeof(GlStaticMeshVert) + c.numIndices * sizeof(uint16_t);
+        mesh->maxChunkSize = std::max<size_t>(mesh->maxChunkSize, c.size);
+    }
+    if (!ok) StreamedMesh_Close(mesh);
+    return ok;
+}
+
+void StreamedMesh_Close(StreamedMesh* mesh) {
+    MappedFile_Close(&mesh->file);
+    *mesh = StreamedMesh {};
+}
+
+size_t StreamedMesh_SlotSize(const StreamedMesh& mesh) {
+    return (size_t) AlignUp(std::max<size_t>(mesh.maxChunkSize, 1), STREAM_SLOT_GRANULARITY);
+}
+
+static void LoaderThread(MeshStreamer* s) {
+    for (;;) {
+        StreamLoad load;
+        {
+            std::unique_lock<std::mutex> guard(s->lock);
+            s->wake.wait(guard, [s] { return s->quit || !s->queued.empty(); });
+            if (s->quit) return;
+            load = s->queued.front();
+            s->queued.pop_front();
+        }
+
+        // The copy out of the mapping is where the disk read happens; the
+        // destination is GPU-visible, so nothing is left for the render thread.
+        auto start = std::chrono::high_resolution_clock::now();
+        const StreamChunk& chunk = s->mesh->chunks[load.chunk];
+        const uint8_t* src = s->mesh->data + chunk.offset;
+        MappedFile_Prefetch(&s->mesh->file, (size_t) (src - (const uint8_t*) s->mesh->file.data), chunk.size, true);
+        memcpy(s->pool + (size_t) load.slot * s->slotSize, src, chunk.size);
+        std::chrono::duration<double> dur = std::chrono::high_resolution_clock::now() - start;
+        load.seconds = dur.count();
+
+        std::lock_guard<std::mutex> guard(s->lock);
+        s->finished.push_back(load);
+    }
+}
+
+void MeshStreamer_Init(MeshStreamer* s, const StreamedMesh* mesh, void* pool, size_t poolSize, size_t numLoaders) {
+    s->mesh = mesh;
+    s->pool = (uint8_t*) pool;
+    s->slotSize = StreamedMesh_SlotSize(*mesh);
+    size_t numSlots = poolSize / s->slotSize;
+    s->slotChunk.assign(numSlots, -1);
+    s->slotLastUsed.assign(numSlots, 0);
+    s->chunkState.assign(mesh->numChunks, STREAM_CHUNK_ON_DISK);
+    s->chunkSlot.assign(mesh->numChunks, 0);
+    s->maxInFlight = std::max<size_t>(1, numLoaders) * 2;
+    s->inFlight = 0;
+    s->stats = MeshStreamerStats {};
+    s->queued.clear();
+    s->finished.clear();
+    s->quit = false;
+    for (size_t i = 0; i < std::max<size_t>(1, numLoaders); ++i) s->loaders.emplace_back(LoaderThread, s);
+}
+
+void MeshStreamer_Shutdown(MeshStreamer* s) {
+    {
+        std::lock_guard<std::mutex> guard(s->lock);
+        s->quit = true;
+    }
+    s->wake.notify_all();
+    for (auto& t : s->loaders) t.join();
+    s->loaders.clear();
+    s->queued.clear();
+    s->finished.clear();
+}
+
+// A free slot, else, if allowed, the least recently drawn resident slot the
+// GPU is done with. Returns -1 if neither exists.
+static int64_t AcquireSlot(MeshStreamer* s, bool evict, uint64_t frame, uint64_t retiredFrame) {
+    int64_t best = -1;
+    for (size_t i = 0; i < s->slotChunk.size(); ++i) {
+        if (s->slotChunk[i] < 0) return (int64_t) i;
+        if (!evict || s->chunkState[s->slotChunk[i]] != STREAM_CHUNK_RESIDENT) continue;
+        if (s->slotLastUsed[i] > retiredFrame || s->slotLastUsed[i] >= frame) continue;
+        if (best < 0 || s->slotLastUsed[i] < s->slotLastUsed[best]) best = (int64_t) i;
+    }
+    if (best >= 0) {
+        s->chunkState[s->slotChunk[best]] = STREAM_CHUNK_ON_DISK;
+        s->slotChunk[best] = -1;
+        s->stats.evictions++;
+    }
+    return best;
+}
+
+static void QueueLoad(MeshStreamer* s, uint32_t chunk, uint32_t slot, uint64_t frame) {
+    s->slotChunk[slot] = (int32_t) chunk;
+    s->slotLastUsed[slot] = frame;
+    s->chunkState[chunk] = STREAM_CHUNK_LOADING;
+    s->chunkSlot[chunk] = slot;
+    s->inFlight++;
+    {
+        std::lock_guard<std::mutex> guard(s->lock);
+        s->queued.push_back(StreamLoad { chunk, slot, 0.0 });
+    }
+    s->wake.notify_one();
+}
+
+void MeshStreamer_Update(MeshStreamer* s, const MeshletView& view, uint64_t frame, uint64_t retiredFrame,
+                         StreamDrawList* draws) {
+    std::vector<StreamLoad> finished;
+    {
+        std::lock_guard<std::mutex> guard(s->lock);
+        finished.swap(s->finished);
+    }
+    for (const StreamLoad& load : finished) {
+        s->chunkState[load.chunk] = STREAM_CHUNK_RESIDENT;
+        s->inFlight--;
+        s->stats.loads++;
+        s->stats.bytesLoaded += s->mesh->chunks[load.chunk].size;
+        s->stats.loadSeconds += load.seconds;
+    }
+
+    std::vector<std::pair<float, uint32_t>> visible, nearby;
+    for (size_t i = 0; i < s->mesh->numChunks; ++i) {
+        const StreamChunk& chunk = s->mesh->chunks[i];
+        glm::vec3 center = (chunk.lo + chunk.hi) * 0.5f;
+        float radius = glm::length(chunk.hi - chunk.lo) * 0.5f;
+        float dist = std::max(glm::length(view.eye - center) - radius, 0.0f);
+        bool outside = false;
+        for (const glm::vec4& p : view.planes) outside = outside || glm::dot(glm::vec3 { p }, center) + p.w < -radius;
+        (outside ? nearby : visible).push_back({ dist, (uint32_t) i });
+    }
+    std::sort(visible.begin(), visible.end());
+    s->stats.frames++;
+    s->stats.visibleChunks += visible.size();
+
+    // Claim every resident visible chunk for this frame before evicting
+    // anything, nearest first so draws go roughly front to back.
+    draws->counts.clear();
+    draws->offsets.clear();
+    draws->baseVertices.clear();
+    for (auto [dist, c] : visible) {
+        if (s->chunkState[c] != STREAM_CHUNK_RESIDENT) continue;
+        const StreamChunk& chunk = s->mesh->chunks[c];
+        size_t base = (size_t) s->chunkSlot[c] * s->slotSize;
+        s->slotLastUsed[s->chunkSlot[c]] = frame;
+        s->stats.residentHits++;
+        draws->counts.push_back((GLsizei) chunk.numIndices);
+        draws->offsets.push_back((void*) (base + chunk.numVertices * sizeof(GlStaticMeshVert)));
+        draws->baseVertices.push_back((GLint) (base / sizeof(GlStaticMeshVert)));
+    }
+
+    for (auto [dist, c] : visible) {
+        if (s->inFlight >= s->maxInFlight) break;
+        if (s->chunkState[c] != STREAM_CHUNK_ON_DISK) continue;
+        int64_t slot = AcquireSlot(s, true, frame, retiredFrame);
+        if (slot < 0) break;
+        QueueLoad(s, c, (uint32_t) slot, frame);
+    }
+
+    // Prefetch only into free slots: it must never push out anything that
+    // is actually on screen.
+    if (s->inFlight < s->maxInFlight) {
+        size_t n = std::min(nearby.size(), s->maxInFlight * 4);
+        std::partial_sort(nearby.begin(), nearby.begin() + n, nearby.end());
+        for (size_t i = 0; i < n && s->inFlight < s->maxInFlight; ++i) {
+            uint32_t c = nearby[i].second;
+            if (s->chunkState[c] != STREAM_CHUNK_ON_DISK) continue;
+            int64_t slot = AcquireSlot(s, false, frame, retiredFrame);
+            if (slot < 0) break;
+            QueueLoad(s, c, (uint32_t) slot, frame);
+        }
+    }
+}
+
+void MeshStreamer_PrintStats(const MeshStreamer& s, double seconds) {
+    const MeshStreamerStats& st = s.stats;
+    size_t total = 0;
+    for (size_t i = 0; i < s.mesh->numChunks; ++i) total += s.mesh->chunks[i].size;
+    double mb = 1024.0 * 1024.0;
+    printf("streaming: %zu chunks, %.1f MB through a %.1f MB pool (%zu slots of %.2f MB)\n", s.mesh->numChunks, total / mb,
+           s.slotChunk.size() * s.slotSize / mb, s.slotChunk.size(), s.slotSize / mb);
+    printf("  %zu frames, %.1f visible chunks/frame, residency hit rate %.1f%%\n", st.frames,
+           st.frames ? (double) st.visibleChunks / st.frames : 0.0,
+           st.visibleChunks ? 100.0 * st.residentHits / st.visibleChunks : 100.0);
+    printf("  %zu loads, %zu evictions, %.1f MB uploaded: %.1f MB/s over %.1f s, %.1f MB/s per loader while busy\n",
+           st.loads, st.evictions, st.bytesLoaded / mb, seconds > 0.0 ? st.bytesLoaded / mb / seconds : 0.0, seconds,
+           st.loadSeconds > 0.0 ? st.bytesLoaded / mb / st.loadSeconds : 0.0);
+}
+
+void MakeStreamStressMesh(StaticMesh* mesh, size_t side) {
+    side = std::max<size_t>(side, 2);
+    *mesh = StaticMesh {};
+    mesh->vertices.resize(side * side);
+    mesh->indices.resize((side - 1) * (side - 1) * 6);
+
+    auto height = [](float x, float z) {
+        float h = 0.0f, amp = 0.05f, freq = 3.0f;
+        for (int octave = 0; octave < 5; ++octave) {
+            h += amp * (1.0f - fabsf(sinf(x * freq + octave) * cosf(z * freq * 1.3f - octave)));
+            amp *= 0.5f;
+            freq *= 2.1f;
+        }
+        return h;
+    };
+    float step = 2.0f / (float) (side - 1);
+    ParallelFor(side, 64, [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j) {
+            for (size_t i = 0; i < side; ++i) {
+                float x = -1.0f + i * step, z = -1.0f + j * step;
+                float dx = height(x + step, z) - height(x - step, z);
+                float dz = height(x, z + step) - height(x, z - step);
+                GlStaticMeshVert& v = mesh->vertices[j * side + i];
+                v.pos = glm::vec3 { x, height(x, z), z };
+                v.norm = glm::normalize(glm::vec3 { -dx, 2.0f * step, -dz });
+                glm::vec3 t = glm::normalize(glm::vec3 { 2.0f * step, dx, 0.0f });
+                v.tang = glm::vec4 { t, 1.0f };
+                v.coord = glm::vec2 { x, z } * 16.0f;
+            }
+            if (j + 1 == side) continue;
+            for (size_t i = 0; i + 1 < side; ++i) {
+                GLuint v00 = (GLuint) (j * side + i), v10 = v00 + 1, v01 = v00 + (GLuint) side, v11 = v01 + 1;
+                GLuint* tri = &mesh->indices[(j * (side - 1) + i) * 6];
+                tri[0] = v00; tri[1] = v01; tri[2] = v10;
+                tri[3] = v10; tri[4] = v01; tri[5] = v11;
+            }
+        }
+    });
+    mesh->submeshes.push_back(StaticSubmesh { 0, (GLuint) mesh->vertices.size(), 0, (GLuint) mesh->indices.size(), 0 });
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/vec3.hpp>
+
+#include "cooked_file.hpp"
+#include "mapped_file.hpp"
+#include "meshlet.hpp"
+#include "static_mesh.hpp"
+
+// Out-of-core meshes: the full-detail triangles of every submesh are cut into
+// spatially compact chunks of at most STREAM_CHUNK_MAX_TRIANGLES, each stored
+// as one page-aligned blob of GlStaticMeshVert followed by 16-bit indices.
+// A MeshStreamer keeps a budgeted subset of them resident in a fixed pool of
+// equally sized slots and pages the rest in and out on background threads.
+
+static constexpr uint32_t STREAMED_MESH_MAGIC        = 0x53524250; // "PBRS"
+static constexpr uint32_t STREAMED_MESH_VERSION      = 1;
+static constexpr uint32_t STREAM_CHUNK_MAX_TRIANGLES = 16384;      // <= 49152 vertices, fits 16-bit indices
+
+enum StreamedMeshChunkId : uint32_t {
+    COOKED_CHUNK_STREAM_CHUNKS = 1,
+    COOKED_CHUNK_STREAM_DATA   = 2,
+};
+
+struct StreamChunk {
+    glm::vec3 lo;
+    uint32_t  submesh;
+    glm::vec3 hi;
+    uint32_t  numVertices;
+    uint64_t  offset;       // into the data chunk, page aligned
+    uint32_t  numIndices;
+    uint32_t  size;         // vertices and indices, unpadded
+};
+
+struct StreamedMesh {
+    MappedFile         file;
+    const StreamChunk* chunks;
+    size_t             numChunks;
+    const uint8_t*     data;
+    size_t             maxChunkSize;
+};
+
+// COOKED_DIR/<sourcePath>.stream
+std::string StreamedMesh_PathFor(const char* sourcePath);
+
+// Chunks the given mesh and writes it to path, stamped with stamp. Indices
+// are relative to their submesh's baseVertex, in either index type.
+bool StreamedMesh_Write(const char* path, const SourceStamp& stamp,
+                        const GlStaticMeshVert* vertices, const void* indices, GLenum indexType,
+                        const StaticSubmesh* submeshes, size_t numSubmeshes);
+
+// Opens a streamed mesh cooked from sourcePath as it is now, or without a
+// staleness check when sourcePath is null (generated meshes).
+bool StreamedMesh_Open(StreamedMesh* mesh, const char* path, const char* sourcePath);
+void StreamedMesh_Close(StreamedMesh* mesh);
+
+// Pool slots are a multiple of the vertex size and the page size, so a
+// slot's vertices can be addressed with a base vertex.
+size_t StreamedMesh_SlotSize(const StreamedMesh& mesh);
+
+struct StreamDrawList {
+    std::vector<GLsizei> counts;
+    std::vector<void*>   offsets;
+    std::vector<GLint>   baseVertices;
+};
+
+struct MeshStreamerStats {
+    size_t frames;
+    size_t visibleChunks;       // summed over frames
+    size_t residentHits;        // visible chunks that were resident when drawn
+    size_t loads;
+    size_t evictions;
+    size_t bytesLoaded;
+    double loadSeconds;         // summed over loader threads
+};
+
+struct StreamLoad {
+    uint32_t chunk;
+    uint32_t slot;
+    double   seconds;
+};
+
+struct MeshStreamer {
+    const StreamedMesh*     mesh;
+    uint8_t*                pool;           // numSlots * slotSize bytes, written by the loaders
+    size_t                  slotSize;
+    std::vector<int32_t>    slotChunk;      // -1 when free
+    std::vector<uint64_t>   slotLastUsed;   // frame the slot was last drawn or filled
+    std::vector<uint8_t>    chunkState;
+    std::vector<uint32_t>   chunkSlot;
+    size_t                  maxInFlight;
+    size_t                  inFlight;
+    MeshStreamerStats       stats;
+
+    std::mutex              lock;
+    std::condition_variable wake;
+    std::deque<StreamLoad>  queued;
+    std::vector<StreamLoad> finished;
+    bool                    quit;
+    std::vector<std::thread> loaders;
+};
+
+// Splits pool into as many slots as fit and starts numLoaders threads that
+// copy chunks out of the mapped file into it. pool must stay writable, e.g.
+// a persistently mapped GL buffer, until MeshStreamer_Shutdown.
+void MeshStreamer_Init(MeshStreamer* streamer, const StreamedMesh* mesh, void* pool, size_t poolSize, size_t numLoaders);
+void MeshStreamer_Shutdown(MeshStreamer* streamer);
+
+// Per frame: retires finished loads, collects the resident chunks that pass
+// the frustum test into *draws, and queues loads for missing visible chunks,
+// nearest first, evicting the least recently drawn slots. Slots drawn after
+// retiredFrame may still be read by the GPU and are never evicted. Free
+// slots left over are used to prefetch chunks around the eye.
+void MeshStreamer_Update(MeshStreamer* streamer, const MeshletView& view, uint64_t frame, uint64_t retiredFrame,
+                         StreamDrawList* draws);
+
+void MeshStreamer_PrintStats(const MeshStreamer& streamer, double seconds);
+
+// A heightfield of side x side vertices over [-1, 1]^2 with a few octaves of
+// ridges, as one submesh; large enough sides make a mesh that does not fit in
+// any sensible budget.
+void MakeStreamStressMesh(StaticMesh* mesh, size_t side);
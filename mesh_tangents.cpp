@@ -0,0 +1,158 @@
+#include "mesh_tangents.hpp"
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <glm/geometric.hpp>
+
+#include "parallel.hpp"
+
+static const size_t TANGENT_GRAIN = 1 << 14;
+
+enum TriTangentFlags : uint8_t {
+    TRI_ORIENT_PRESERVING = 1,  // uv winding agrees with the geometric winding
+    TRI_GOOD              = 2,  // non-degenerate in uv; votes on the sign
+};
+
+struct TriTangent {
+    glm::vec3 os;
+    uint8_t   flags;
+};
+
+// MikkTSpace's NotZero: anything that survives as a normal float.
+static inline bool NotZero(float v) {
+    return fabsf(v) > FLT_MIN;
+}
+
+static inline glm::vec3 NormalizeSafe(glm::vec3 v) {
+    float len = glm::length(v);
+    return NotZero(len) ? v / len : v;
+}
+
+static TriTangent ComputeTriTangent(const GlStaticMeshVert& a, const GlStaticMeshVert& b, const GlStaticMeshVert& c) {
+    glm::vec3 d1 = b.pos - a.pos;
+    glm::vec3 d2 = c.pos - a.pos;
+    glm::vec2 t21 = b.coord - a.coord;
+    glm::vec2 t31 = c.coord - a.coord;
+    float area = t21.x * t31.y - t21.y * t31.x;
+    glm::vec3 os = t31.y * d1 - t21.y * d2;
+    glm::vec3 ot = -t31.x * d1 + t21.x * d2;
+
+    TriTangent tri { glm::vec3(0.0f), (uint8_t) (area > 0.0f ? TRI_ORIENT_PRESERVING : 0) };
+    if (!NotZero(area)) return tri;
+    float lenos = glm::length(os);
+    float lenot = glm::length(ot);
+    if (NotZero(lenos)) tri.os = os * ((area > 0.0f ? 1.0f : -1.0f) / lenos);
+    if (NotZero(lenos) && NotZero(lenot)) tri.flags |= TRI_GOOD;
+    return tri;
+}
+
+static glm::vec3 AnyTangent(glm::vec3 n) {
+    glm::vec3 axis = fabsf(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    return NormalizeSafe(axis - n * glm::dot(n, axis));
+}
+
+size_t GenerateTangents(std::vector<GlStaticMeshVert>* verts, GLuint* indices, size_t numindices) {
+    size_t numverts = verts->size();
+    size_t numtris = numindices / 3;
+    GlStaticMeshVert* v = verts->data();
+
+    std::vector<TriTangent> tris(numtris);
+    ParallelFor(numtris, TANGENT_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            tris[t] = ComputeTriTangent(v[indices[t * 3]], v[indices[t * 3 + 1]], v[indices[t * 3 + 2]]);
+        }
+    });
+
+    // Corners grouped by vertex, in index order so the sums come out the
+    // same on every run.
+    std::vector<uint32_t> offsets(numverts + 1, 0);
+    for (size_t i = 0; i < numindices; ++i) offsets[indices[i] + 1]++;
+    for (size_t i = 0; i < numverts; ++i) offsets[i + 1] += offsets[i];
+    std::vector<uint32_t> corners(numindices);
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < numindices; ++i) corners[cursor[indices[i]]++] = (uint32_t) i;
+
+    // Tangent for the vertex's other uv winding, when both occur.
+    std::vector<glm::vec4> other(numverts);
+    std::vector<uint8_t> split(numverts, 0);
+    ParallelFor(numverts, TANGENT_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t vi = begin; vi < end; ++vi) {
+            glm::vec3 n = v[vi].norm;
+            glm::vec3 sum[2] = { glm::vec3(0.0f), glm::vec3(0.0f) };
+            unsigned votes[2] = { 0, 0 };
+            for (uint32_t c = offsets[vi]; c < offsets[vi + 1]; ++c) {
+                uint32_t corner = corners[c];
+                const TriTangent& tri = tris[corner / 3];
+                if (!(tri.flags & TRI_GOOD)) continue;
+                int orient = tri.flags & TRI_ORIENT_PRESERVING;
+                votes[orient]++;
+
+                glm::vec3 os = NormalizeSafe(tri.os - n * glm::dot(n, tri.os));
+                uint32_t base = corner - corner % 3;
+                glm::vec3 p0 = v[indices[base + (corner + 2) % 3]].pos;
+                glm::vec3 p1 = v[vi].pos;
+                glm::vec3 p2 = v[indices[base + (corner + 1) % 3]].pos;
+                glm::vec3 e1 = p0 - p1;
+                glm::vec3 e2 = p2 - p1;
+                e1 = NormalizeSafe(e1 - n * glm::dot(n, e1));
+                e2 = NormalizeSafe(e2 - n * glm::dot(n, e2));
+                float angle = acosf(std::min(1.0f, std::max(-1.0f, glm::dot(e1, e2))));
+                sum[orient] += angle * os;
+            }
+
+            int primary = votes[1] >= votes[0] ? 1 : 0;
+            auto finish = [&](int orient) {
+                glm::vec3 t = NormalizeSafe(sum[orient]);
+                if (!NotZero(glm::dot(t, t))) t = AnyTangent(n);
+                return glm::vec4(t, orient ? 1.0f : -1.0f);
+            };
+            v[vi].tang = finish(primary);
+            if (votes[1 - primary] > 0) {
+                other[vi] = finish(1 - primary);
+                split[vi] = 1;
+            }
+        }
+    });
+
+    size_t added = 0;
+    for (size_t vi = 0; vi < numverts; ++vi) {
+        if (!split[vi]) continue;
+        GlStaticMeshVert copy = (*verts)[vi];
+        copy.tang = other[vi];
+        GLuint nv = (GLuint) verts->size();
+        verts->push_back(copy);
+        added++;
+
+        float sign = (*verts)[vi].tang.w;
+        for (uint32_t c = offsets[vi]; c < offsets[vi + 1]; ++c) {
+            const TriTangent& tri = tris[corners[c] / 3];
+            bool preserving = tri.flags & TRI_ORIENT_PRESERVING;
+            if ((tri.flags & TRI_GOOD) && preserving != (sign > 0.0f)) indices[corners[c]] = nv;
+        }
+    }
+    return added;
+}
+
+void GenerateStaticMeshTangents(StaticMesh* mesh) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<GlStaticMeshVert> vertices;
+    vertices.reserve(mesh->vertices.size());
+    std::vector<GlStaticMeshVert> subverts;
+    size_t added = 0;
+    for (StaticSubmesh& sub : mesh->submeshes) {
+        subverts.assign(mesh->vertices.begin() + sub.baseVertex, mesh->vertices.begin() + sub.baseVertex + sub.numVertices);
+        added += GenerateTangents(&subverts, mesh->indices.data() + sub.firstIndex, sub.numIndices);
+        sub.baseVertex = (GLint) vertices.size();
+        sub.numVertices = (GLuint) subverts.size();
+        vertices.insert(vertices.end(), subverts.begin(), subverts.end());
+    }
+    mesh->vertices = std::move(vertices);
+
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    printf("tangents for %zu verts in %.2f ms, %zu split on uv winding\n", mesh->vertices.size(), dur.count(), added);
+}
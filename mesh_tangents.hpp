@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#include "static_mesh.hpp"
+
+// Per-vertex tangents computed the way MikkTSpace computes them, so normal
+// maps baked against MikkTSpace shade without seams: per-triangle tangents
+// from the uv derivatives, projected into each vertex's normal plane and
+// summed weighted by the corner angle. tang.w is the bitangent sign, from
+// the triangle's uv winding; the shader rebuilds the bitangent as
+// cross(norm, tang.xyz) * tang.w.
+//
+// MikkTSpace groups corners with identical attributes, so indices must
+// already be welded. A vertex shared by triangles of both uv windings, as on
+// mirrored uv seams, is split and the copy appended to verts. Returns the
+// number of vertices appended.
+size_t GenerateTangents(std::vector<GlStaticMeshVert>* verts, GLuint* indices, size_t numindices);
+void GenerateStaticMeshTangents(StaticMesh* mesh);
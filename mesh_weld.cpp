@@ -0,0 +1,208 @@
+#include "mesh_weld.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+
+#include "parallel.hpp"
+
+static const size_t WELD_GRAIN = 1 << 16;
+// Position, normal and uv. Welding runs before tangents are generated.
+static const int KEY_COMPONENTS = 3 + 3 + 2;
+
+struct WeldKey {
+    int32_t q[KEY_COMPONENTS];
+    bool operator==(const WeldKey& o) const { return memcmp(q, o.q, sizeof(q)) == 0; }
+};
+
+struct WeldKeyHash {
+    size_t operator()(const WeldKey& k) const {
+        // FNV-1a over the quantized components.
+        uint64_t h = 14695981039346656037ull;
+        for (int32_t v : k.q) h = (h ^ (uint32_t) v) * 1099511628211ull;
+        return (size_t) h;
+    }
+};
+
+// Each component is quantized from the low end of its range over the
+// vertices being welded, in steps of epsilon times that range, so keys stay
+// within 0 .. 1 / epsilon however large or far from the origin the mesh is.
+struct WeldGrid {
+    float  origin[KEY_COMPONENTS];
+    double scale[KEY_COMPONENTS];
+};
+
+static inline void WeldComponents(float* f, const GlStaticMeshVert& vert) {
+    f[0] = vert.pos.x;  f[1] = vert.pos.y;  f[2] = vert.pos.z;
+    f[3] = vert.norm.x; f[4] = vert.norm.y; f[5] = vert.norm.z;
+    f[6] = vert.coord.x; f[7] = vert.coord.y;
+}
+
+static WeldGrid MakeWeldGrid(const GlStaticMeshVert* verts, size_t numverts, float epsilon) {
+    float lo[KEY_COMPONENTS], hi[KEY_COMPONENTS], f[KEY_COMPONENTS];
+    WeldComponents(lo, verts[0]);
+    WeldComponents(hi, verts[0]);
+    for (size_t i = 1; i < numverts; ++i) {
+        WeldComponents(f, verts[i]);
+        for (int c = 0; c < KEY_COMPONENTS; ++c) {
+            lo[c] = std::min(lo[c], f[c]);
+            hi[c] = std::max(hi[c], f[c]);
+        }
+    }
+    WeldGrid grid;
+    for (int c = 0; c < KEY_COMPONENTS; ++c) {
+        double range = (double) hi[c] - lo[c];
+        grid.origin[c] = lo[c];
+        grid.scale[c] = range > 0.0 ? 1.0 / (range * epsilon) : 0.0;
+    }
+    return grid;
+}
+
+static inline WeldKey MakeWeldKey(const GlStaticMeshVert& vert, const WeldGrid& grid) {
+    float f[KEY_COMPONENTS];
+    WeldComponents(f, vert);
+    WeldKey key;
+    for (int i = 0; i < KEY_COMPONENTS; ++i) key.q[i] = (int32_t) llround(((double) f[i] - grid.origin[i]) * grid.scale[i]);
+    return key;
+}
+
+size_t WeldVertices(GlStaticMeshVert* verts, size_t numverts, GLuint* indices, size_t numindices, float epsilon) {
+    if (numverts == 0) return 0;
+    WeldGrid grid = MakeWeldGrid(verts, numverts, epsilon);
+    WeldKeyHash hasher;
+
+    std::vector<WeldKey> keys(numverts);
+    std::vector<size_t> hashes(numverts);
+    ParallelFor(numverts, WELD_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            keys[i] = MakeWeldKey(verts[i], grid);
+            hashes[i] = hasher(keys[i]);
+        }
+    });
+
+    // Each partition owns the keys whose hash lands in it, so partitions
+    // dedup independently and the first occurrence still wins.
+    size_t partitions = numverts < WELD_GRAIN ? 1 : std::max<size_t>(1, std::thread::hardware_concurrency());
+    std::vector<GLuint> canonical(numverts);
+    ParallelFor(partitions, 1, [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+            std::unordered_map<WeldKey, GLuint, WeldKeyHash> first;
+            first.reserve(numverts / partitions + 1);
+            for (size_t i = 0; i < numverts; ++i) {
+                if (hashes[i] % partitions != p) continue;
+                canonical[i] = first.emplace(keys[i], (GLuint) i).first->second;
+            }
+        }
+    });
+
+    std::vector<GLuint> remap(numverts);
+    size_t next = 0;
+    for (size_t i = 0; i < numverts; ++i) {
+        if (canonical[i] == i) {
+            verts[next] = verts[i];
+            remap[i] = (GLuint) next++;
+        } else {
+            remap[i] = remap[canonical[i]];
+        }
+    }
+
+    ParallelFor(numindices, WELD_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) indices[i] = remap[indices[i]];
+    });
+    return next;
+}
+
+void WeldStaticMesh(StaticMesh* mesh, float epsilon) {
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t before = mesh->vertices.size();
+
+    size_t out = 0;
+    for (StaticSubmesh& sub : mesh->submeshes) {
+        GlStaticMeshVert* verts = mesh->vertices.data() + sub.baseVertex;
+        size_t count = WeldVertices(verts, sub.numVertices, mesh->indices.data() + sub.firstIndex, sub.numIndices, epsilon);
+        std::copy(verts, verts + count, mesh->vertices.data() + out);
+        sub.baseVertex = (GLint) out;
+        sub.numVertices = (GLuint) count;
+        out += count;
+    }
+    mesh->vertices.resize(out);
+
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    printf("welded %zu -> %zu verts in %.2f ms\n", before, out, dur.count());
+}
+
+void SplitStaticMesh(StaticMesh* mesh) {
+    bool needed = false;
+    for (const StaticSubmesh& sub : mesh->submeshes) needed |= sub.numVertices > MAX_SHORT_INDEXED_VERTICES;
+    if (!needed) return;
+
+    std::vector<GlStaticMeshVert> vertices;
+    std::vector<glm::vec2> lightmapCoords;
+    std::vector<GLuint> indices;
+    std::vector<StaticSubmesh> submeshes;
+    bool lightmap = !mesh->lightmapCoords.empty();
+    vertices.reserve(mesh->vertices.size());
+    lightmapCoords.reserve(mesh->lightmapCoords.size());
+    indices.reserve(mesh->indices.size());
+
+    std::vector<GLuint> local;
+    std::vector<size_t> stamp;
+    size_t chunkid = 0;
+    for (const StaticSubmesh& sub : mesh->submeshes) {
+        const GlStaticMeshVert* verts = mesh->vertices.data() + sub.baseVertex;
+        const GLuint* subindices = mesh->indices.data() + sub.firstIndex;
+        local.assign(sub.numVertices, 0);
+        stamp.assign(sub.numVertices, ~(size_t) 0);
+
+        StaticSubmesh chunk {};
+        auto begin = [&] {
+            chunk = StaticSubmesh { (GLint) vertices.size(), 0, (GLuint) indices.size(), 0, sub.material };
+            chunkid++;
+        };
+        begin();
+        for (GLuint i = 0; i < sub.numIndices; i += 3) {
+            unsigned added = 0;
+            for (int k = 0; k < 3; ++k) added += stamp[subindices[i + k]] != chunkid;
+            if (chunk.numVertices + added > MAX_SHORT_INDEXED_VERTICES) {
+                submeshes.push_back(chunk);
+                begin();
+            }
+            for (int k = 0; k < 3; ++k) {
+                GLuint v = subindices[i + k];
+                if (stamp[v] != chunkid) {
+                    stamp[v] = chunkid;
+                    local[v] = chunk.numVertices++;
+                    vertices.push_back(verts[v]);
+                    if (lightmap) lightmapCoords.push_back(mesh->lightmapCoords[sub.baseVertex + v]);
+                }
+                indices.push_back(local[v]);
+            }
+            chunk.numIndices += 3;
+        }
+        if (chunk.numIndices > 0) submeshes.push_back(chunk);
+    }
+
+    printf("split %zu submeshes into %zu for 16-bit indices, %zu -> %zu verts\n",
+           mesh->submeshes.size(), submeshes.size(), mesh->vertices.size(), vertices.size());
+    mesh->vertices = std::move(vertices);
+    mesh->lightmapCoords = std::move(lightmapCoords);
+    mesh->indices = std::move(indices);
+    mesh->submeshes = std::move(submeshes);
+}
+
+GLenum StaticMeshIndexType(const StaticMesh& mesh) {
+    for (const StaticSubmesh& sub : mesh.submeshes) {
+        if (sub.numVertices > MAX_SHORT_INDEXED_VERTICES) return GL_UNSIGNED_INT;
+    }
+    return GL_UNSIGNED_SHORT;
+}
+
+void PackIndices16(uint16_t* dst, const GLuint* indices, size_t numindices) {
+    ParallelFor(numindices, WELD_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) dst[i] = (uint16_t) indices[i];
+    });
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "static_mesh.hpp"
+
+// Attributes closer than this fraction of their range over a submesh, after
+// rounding to a grid of that spacing, weld. Being relative, it welds a mesh
+// in large units or far from the origin the same as one near it. Must be
+// above 1e-9 so quantized components fit in 32 bits.
+static constexpr float WELD_EPSILON = 1e-5f;
+
+// Largest vertex range a submesh may span to be drawn with 16-bit indices.
+static constexpr size_t MAX_SHORT_INDEXED_VERTICES = 65536;
+
+// Merges vertices of verts whose position, normal and uv quantize to the same
+// cell of a grid spanning their bounds, epsilon of it on a side, keeping the
+// first occurrence, and rewrites indices to match.
+// Tangents are ignored; weld before generating them. Hashing and remapping
+// run in parallel for large inputs. Returns the new vertex count.
+size_t WeldVertices(GlStaticMeshVert* verts, size_t numverts, GLuint* indices, size_t numindices, float epsilon);
+void WeldStaticMesh(StaticMesh* mesh, float epsilon);
+
+// Splits every submesh spanning more than MAX_SHORT_INDEXED_VERTICES
+// vertices into consecutive chunks that fit, duplicating vertices shared
+// across a chunk boundary, lightmap coordinates included. Must run before
+// meshlets and LODs are built.
+void SplitStaticMesh(StaticMesh* mesh);
+
+// GL_UNSIGNED_SHORT when every submesh fits in 16-bit indices.
+GLenum StaticMeshIndexType(const StaticMesh& mesh);
+void PackIndices16(uint16_t* dst, const GLuint* indices, size_t numindices);
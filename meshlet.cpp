@@ -0,0 +1,237 @@
+#include "meshlet.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "static_mesh.hpp"
+
+static void FinishMeshlet(Meshlet* m, const GlStaticMeshVert* verts, const GLuint* indices) {
+    glm::vec3 lo { INFINITY }, hi { -INFINITY };
+    for (GLuint i = 0; i < m->numIndices; ++i) {
+        lo = glm::min(lo, verts[indices[i]].pos);
+        hi = glm::max(hi, verts[indices[i]].pos);
+    }
+    m->center = (lo + hi) * 0.5f;
+    m->radius = 0.0f;
+    for (GLuint i = 0; i < m->numIndices; ++i) {
+        m->radius = std::max(m->radius, glm::length(verts[indices[i]].pos - m->center));
+    }
+
+    // The cone has to contain every triangle normal. Degenerate triangles
+    // carry no facing and are skipped.
+    std::vector<glm::vec3> normals;
+    normals.reserve(m->numIndices / 3);
+    glm::vec3 axis { 0.0f };
+    for (GLuint i = 0; i < m->numIndices; i += 3) {
+        glm::vec3 a = verts[indices[i + 0]].pos;
+        glm::vec3 b = verts[indices[i + 1]].pos;
+        glm::vec3 c = verts[indices[i + 2]].pos;
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float len = glm::length(n);
+        if (len <= 0.0f) continue;
+        normals.push_back(n / len);
+        axis += n / len;
+    }
+    float len = glm::length(axis);
+    float mindot = 1.0f;
+    if (len > 0.0f) {
+        axis /= len;
+        for (glm::vec3 n : normals) mindot = std::min(mindot, glm::dot(axis, n));
+    }
+    if (len <= 0.0f || mindot <= 0.1f) {
+        // Wider than ~84 degrees: the test would almost never pass.
+        m->coneAxis = glm::vec3 { 0.0f };
+        m->coneCutoff = 1.0f;
+    } else {
+        m->coneAxis = axis;
+        m->coneCutoff = sqrtf(1.0f - mindot * mindot);
+    }
+}
+
+void BuildMeshlets(std::vector<Meshlet>* meshlets, const StaticMesh& mesh) {
+    std::vector<unsigned> stamp;
+    unsigned meshletid = 0;
+    for (size_t s = 0; s < mesh.submeshes.size(); ++s) {
+        const StaticSubmesh& sub = mesh.submeshes[s];
+        const GlStaticMeshVert* verts = mesh.vertices.data() + sub.baseVertex;
+        const GLuint* indices = mesh.indices.data() + sub.firstIndex;
+        stamp.assign(sub.numVertices, ~0u);
+
+        Meshlet current {};
+        unsigned numverts = 0;
+        auto start = [&](GLuint first) {
+            current = Meshlet {};
+            current.baseVertex = sub.baseVertex;
+            current.firstIndex = sub.firstIndex + first;
+            current.submesh = (GLuint) s;
+            numverts = 0;
+            meshletid++;
+        };
+        auto finish = [&] {
+            if (current.numIndices == 0) return;
+            FinishMeshlet(&current, verts, mesh.indices.data() + current.firstIndex);
+            meshlets->push_back(current);
+        };
+
+        start(0);
+        for (GLuint i = 0; i < sub.numIndices; i += 3) {
+            unsigned added = 0;
+            for (int k = 0; k < 3; ++k) added += stamp[indices[i + k]] != meshletid;
+            if (numverts + added > MESHLET_MAX_VERTICES || current.numIndices / 3 >= MESHLET_MAX_TRIANGLES) {
+                finish();
+                start(i);
+            }
+            for (int k = 0; k < 3; ++k) {
+                GLuint v = indices[i + k];
+                if (stamp[v] == meshletid) continue;
+                stamp[v] = meshletid;
+                numverts++;
+            }
+            current.numIndices += 3;
+        }
+        finish();
+    }
+}
+
+MeshletView MakeMeshletView(const glm::mat4& mvp, const glm::mat4& modelview) {
+    // Gribb/Hartmann: each clip plane is a sum or difference of the w row
+    // with one of the other rows, already in object space for an mvp.
+    MeshletView view;
+    glm::mat4 t = glm::transpose(mvp);
+    view.planes[0] = t[3] + t[0];
+    view.planes[1] = t[3] - t[0];
+    view.planes[2] = t[3] + t[1];
+    view.planes[3] = t[3] - t[1];
+    view.planes[4] = t[3] + t[2];
+    view.planes[5] = t[3] - t[2];
+    for (glm::vec4& p : view.planes) p /= glm::length(glm::vec3 { p });
+    view.eye = glm::vec3 { glm::inverse(modelview) * glm::vec4 { 0.0f, 0.0f, 0.0f, 1.0f } };
+    return view;
+}
+
+bool Meshlet_IsBackfacing(const Meshlet& meshlet, const MeshletView& view) {
+    // Every triangle faces away if the whole sphere lies behind the cone's
+    // apex plane as seen from the eye.
+    glm::vec3 d = meshlet.center - view.eye;
+    return glm::dot(d, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(d) + meshlet.radius;
+}
+
+bool Meshlet_IsOutside(const Meshlet& meshlet, const MeshletView& view) {
+    for (const glm::vec4& p : view.planes) {
+        if (glm::dot(glm::vec3 { p }, meshlet.center) + p.w < -meshlet.radius) return true;
+    }
+    return false;
+}
+
+void CullMeshlets(MeshletDrawList* list, const Meshlet* meshlets, size_t count, const MeshletView& view, size_t indexsize) {
+    list->counts.clear();
+    list->offsets.clear();
+    list->baseVertices.clear();
+    list->submeshes.clear();
+    list->visible = list->backfacing = list->outside = 0;
+
+    GLuint nextindex = ~0u;
+    GLuint submesh = ~0u;
+    for (size_t i = 0; i < count; ++i) {
+        const Meshlet& m = meshlets[i];
+        if (Meshlet_IsOutside(m, view)) {
+            list->outside++;
+            continue;
+        }
+        if (Meshlet_IsBackfacing(m, view)) {
+            list->backfacing++;
+            continue;
+        }
+        list->visible++;
+        if (m.submesh == submesh && m.firstIndex == nextindex) {
+            list->counts.back() += (GLsizei) m.numIndices;
+        } else {
+            list->counts.push_back((GLsizei) m.numIndices);
+            list->offsets.push_back((void*) (m.firstIndex * indexsize));
+            list->baseVertices.push_back(m.baseVertex);
+            list->submeshes.push_back(m.submesh);
+        }
+        submesh = m.submesh;
+        nextindex = m.firstIndex + m.numIndices;
+    }
+}
+
+void BenchmarkMeshlets(const StaticMesh& mesh, const char* name, size_t views) {
+    std::vector<Meshlet> meshlets;
+    double buildms = INFINITY;
+    for (int run = 0; run < 5; ++run) {
+        meshlets.clear();
+        auto start = std::chrono::high_resolution_clock::now();
+        BuildMeshlets(&meshlets, mesh);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        buildms = std::min(buildms, elapsed.count());
+    }
+    size_t numtris = mesh.indices.size() / 3, fullverts = 0, fulltris = 0;
+    glm::vec3 lo { INFINITY }, hi { -INFINITY };
+    for (const GlStaticMeshVert& v : mesh.vertices) {
+        lo = glm::min(lo, v.pos);
+        hi = glm::max(hi, v.pos);
+    }
+    std::vector<GLuint> distinct;
+    for (const Meshlet& m : meshlets) {
+        const GLuint* indices = mesh.indices.data() + m.firstIndex;
+        distinct.assign(indices, indices + m.numIndices);
+        std::sort(distinct.begin(), distinct.end());
+        fullverts += std::unique(distinct.begin(), distinct.end()) - distinct.begin();
+        fulltris += m.numIndices / 3;
+    }
+    size_t count = std::max<size_t>(1, meshlets.size());
+    printf("meshlets, %s: %zu tris -> %zu meshlets, %.1f verts and %.1f tris each, built in %.2f ms (%.1f Mtri/s)\n",
+           name, numtris, meshlets.size(), (double) fullverts / count, (double) fulltris / count, buildms,
+           numtris / std::max(buildms, 1e-6) * 1e-3);
+
+    // Views orbit the mesh at twice its bounding radius, looking at random
+    // points near the center, so most of it is in view and half of it faces
+    // away. Per view, the triangles the cone test removed are compared with
+    // the triangles that actually face away.
+    glm::vec3 center = (lo + hi) * 0.5f;
+    float radius = std::max(glm::length(hi - lo) * 0.5f, 1e-6f);
+    glm::mat4 proj = glm::perspective(1.0f, 16.0f / 9.0f, radius * 0.01f, radius * 10.0f);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    MeshletDrawList list;
+    double cullns = 0.0;
+    size_t outside = 0, backfacing = 0, conetris = 0, backtris = 0;
+    for (size_t view = 0; view < views; ++view) {
+        glm::vec3 dir { unit(rng), unit(rng), unit(rng) };
+        glm::vec3 eye = center + dir * (2.0f * radius / std::max(glm::length(dir), 1e-3f));
+        glm::vec3 target = center + glm::vec3 { unit(rng), unit(rng), unit(rng) } * (0.25f * radius);
+        glm::mat4 modelview = glm::lookAt(eye, target, glm::vec3 { 0.0f, 1.0f, 0.0f });
+        MeshletView mv = MakeMeshletView(proj * modelview, modelview);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        CullMeshlets(&list, meshlets.data(), meshlets.size(), mv, sizeof(GLuint));
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start;
+        cullns += elapsed.count();
+        outside += list.outside;
+        backfacing += list.backfacing;
+
+        for (const Meshlet& m : meshlets) {
+            const GLuint* indices = mesh.indices.data() + m.firstIndex;
+            const GlStaticMeshVert* verts = mesh.vertices.data() + m.baseVertex;
+            bool cone = !Meshlet_IsOutside(m, mv) && Meshlet_IsBackfacing(m, mv);
+            for (GLuint i = 0; i < m.numIndices; i += 3) {
+                glm::vec3 a = verts[indices[i]].pos, b = verts[indices[i + 1]].pos, c = verts[indices[i + 2]].pos;
+                bool away = glm::dot(glm::cross(b - a, c - a), mv.eye - a) <= 0.0f;
+                backtris += away;
+                conetris += cone && away;
+            }
+        }
+    }
+    double perview = (double) std::max<size_t>(1, views);
+    printf("  cull over %zu views: %.1f us/view (%.1f ns/meshlet), %.1f%% outside, %.1f%% backfacing, "
+           "cone test removes %.1f%% of backfacing triangles\n",
+           views, cullns / perview * 1e-3, cullns / perview / count, 100.0 * outside / perview / count,
+           100.0 * backfacing / perview / count, 100.0 * conetris / std::max<size_t>(1, backtris));
+}
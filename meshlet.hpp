@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+struct StaticMesh;
+
+static constexpr unsigned MESHLET_MAX_VERTICES  = 64;
+static constexpr unsigned MESHLET_MAX_TRIANGLES = 124;
+
+// A run of at most MESHLET_MAX_TRIANGLES consecutive triangles of one
+// submesh that reference at most MESHLET_MAX_VERTICES distinct vertices.
+// Meshlets never reorder the index buffer; they are ranges into it.
+struct Meshlet {
+    glm::vec3 center;       // bounding sphere
+    float     radius;
+    glm::vec3 coneAxis;     // average facing of the triangles
+    float     coneCutoff;   // sine of the cone's half angle, 1 if it cannot be culled
+    GLint     baseVertex;
+    GLuint    firstIndex;
+    GLuint    numIndices;
+    GLuint    submesh;
+};
+
+// Object-space view used for culling: frustum planes extracted from the
+// model-view-projection matrix and the eye position.
+struct MeshletView {
+    glm::vec4 planes[6];
+    glm::vec3 eye;
+};
+
+// Ready-made arguments for glMultiDrawElementsBaseVertex. Adjacent visible
+// meshlets of the same submesh are merged into a single range.
+struct MeshletDrawList {
+    std::vector<GLsizei>    counts;
+    std::vector<void*>      offsets;
+    std::vector<GLint>      baseVertices;
+    std::vector<GLuint>     submeshes;      // of each range, to switch materials between them
+    size_t                  visible;
+    size_t                  backfacing;
+    size_t                  outside;
+};
+
+// Splits every submesh of mesh into meshlets, appended to *meshlets in
+// index buffer order.
+void BuildMeshlets(std::vector<Meshlet>* meshlets, const StaticMesh& mesh);
+
+// modelview places the mesh relative to the camera, which sits at its origin.
+MeshletView MakeMeshletView(const glm::mat4& mvp, const glm::mat4& modelview);
+bool Meshlet_IsBackfacing(const Meshlet& meshlet, const MeshletView& view);
+bool Meshlet_IsOutside(const Meshlet& meshlet, const MeshletView& view);
+// Offsets in the draw list are byte offsets for indices of indexsize bytes.
+void CullMeshlets(MeshletDrawList* list, const Meshlet* meshlets, size_t count, const MeshletView& view, size_t indexsize);
+
+// Times BuildMeshlets on mesh and prints meshlet counts and fill, then
+// times CullMeshlets from views cameras orbiting the mesh and prints how
+// much the frustum and cone tests remove, the latter against a per-triangle
+// backface test.
+void BenchmarkMeshlets(const StaticMesh& mesh, const char* name, size_t views);
@@ -0,0 +1,389 @@
+#include "offset_allocator.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline uint32_t LowestBit(uint32_t v) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, v);
+    return (uint32_t) i;
+#else
+    return (uint32_t) __builtin_ctz(v);
+#endif
+}
+
+static inline uint32_t HighestBit(uint32_t v) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanReverse(&i, v);
+    return (uint32_t) i;
+#else
+    return 31 - (uint32_t) __builtin_clz(v);
+#endif
+}
+
+// Lowest set bit of mask at or above first, or OFFSET_ALLOC_NONE.
+static inline uint32_t LowestBitFrom(uint32_t mask, uint32_t first) {
+    if (first >= 32) return OFFSET_ALLOC_NONE;
+    mask &= ~((1u << first) - 1);
+    return mask ? LowestBit(mask) : OFFSET_ALLOC_NONE;
+}
+
+// Sizes as small floats: below 8 they are their own bin; above, the bin is
+// the exponent and the 3 bits under the leading one. Searching rounds up,
+// so any range in the bin found fits; filing rounds down, so a range never
+// sits in a bin promising more than it has.
+static uint32_t SizeToBinRoundUp(uint32_t size) {
+    if (size < OFFSET_ALLOC_LEAF_BINS) return size;
+    uint32_t shift = HighestBit(size) - OFFSET_ALLOC_MANTISSA_BITS;
+    uint32_t bin = (shift + 1) << OFFSET_ALLOC_MANTISSA_BITS | ((size >> shift) & (OFFSET_ALLOC_LEAF_BINS - 1));
+    // A carry out of the mantissa moves to the next exponent, as it should.
+    return (size & ((1u << shift) - 1)) ? bin + 1 : bin;
+}
+
+static uint32_t SizeToBinRoundDown(uint32_t size) {
+    if (size < OFFSET_ALLOC_LEAF_BINS) return size;
+    uint32_t shift = HighestBit(size) - OFFSET_ALLOC_MANTISSA_BITS;
+    return (shift + 1) << OFFSET_ALLOC_MANTISSA_BITS | ((size >> shift) & (OFFSET_ALLOC_LEAF_BINS - 1));
+}
+
+static uint32_t BinToSize(uint32_t bin) {
+    uint32_t exp = bin >> OFFSET_ALLOC_MANTISSA_BITS;
+    uint32_t mantissa = bin & (OFFSET_ALLOC_LEAF_BINS - 1);
+    return exp == 0 ? mantissa : (mantissa | OFFSET_ALLOC_LEAF_BINS) << (exp - 1);
+}
+
+static uint32_t InsertFreeRange(OffsetAllocator* alloc, uint32_t offset, uint32_t size) {
+    uint32_t bin = SizeToBinRoundDown(size);
+    uint32_t top = bin >> OFFSET_ALLOC_MANTISSA_BITS, leaf = bin & (OFFSET_ALLOC_LEAF_BINS - 1);
+    if (alloc->binHeads[bin] == OFFSET_ALLOC_NONE) {
+        alloc->usedBins[top] |= 1 << leaf;
+        alloc->usedBinsTop |= 1u << top;
+    }
+
+    uint32_t index = alloc->unusedNodes.back();
+    alloc->unusedNodes.pop_back();
+    uint32_t head = alloc->binHeads[bin];
+    OffsetAllocNode& node = alloc->nodes[index];
+    node.offset = offset;
+    node.size = size;
+    node.binPrev = OFFSET_ALLOC_NONE;
+    node.binNext = head;
+    node.neighborPrev = OFFSET_ALLOC_NONE;
+    node.neighborNext = OFFSET_ALLOC_NONE;
+    node.state = OffsetAllocNode::FREE;
+    if (head != OFFSET_ALLOC_NONE) alloc->nodes[head].binPrev = index;
+    alloc->binHeads[bin] = index;
+    alloc->freeStorage += size;
+    return index;
+}
+
+// Takes a free range out of its bin. It becomes USED, or UNUSED when release
+// is set and it has been merged into a neighbour.
+static void RemoveFreeRange(OffsetAllocator* alloc, uint32_t index, bool release) {
+    OffsetAllocNode& node = alloc->nodes[index];
+    if (node.binPrev != OFFSET_ALLOC_NONE) {
+        alloc->nodes[node.binPrev].binNext = node.binNext;
+    } else {
+        uint32_t bin = SizeToBinRoundDown(node.size);
+        alloc->binHeads[bin] = node.binNext;
+        if (node.binNext == OFFSET_ALLOC_NONE) {
+            uint32_t top = bin >> OFFSET_ALLOC_MANTISSA_BITS, leaf = bin & (OFFSET_ALLOC_LEAF_BINS - 1);
+            alloc->usedBins[top] &= ~(1 << leaf);
+            if (!alloc->usedBins[top]) alloc->usedBinsTop &= ~(1u << top);
+        }
+    }
+    if (node.binNext != OFFSET_ALLOC_NONE) alloc->nodes[node.binNext].binPrev = node.binPrev;
+    alloc->freeStorage -= node.size;
+    if (release) {
+        node.state = OffsetAllocNode::UNUSED;
+        alloc->unusedNodes.push_back(index);
+    } else {
+        node.state = OffsetAllocNode::USED;
+    }
+}
+
+void OffsetAllocator_Init(OffsetAllocator* alloc, uint32_t size, uint32_t maxAllocs) {
+    alloc->size = size;
+    alloc->freeStorage = 0;
+    alloc->numAllocs = 0;
+    alloc->usedBinsTop = 0;
+    memset(alloc->usedBins, 0, sizeof(alloc->usedBins));
+    std::fill(alloc->binHeads, alloc->binHeads + OFFSET_ALLOC_BINS, OFFSET_ALLOC_NONE);
+
+    // Free ranges never outnumber allocations by more than one.
+    uint32_t numNodes = maxAllocs * 2 + 1;
+    alloc->nodes.assign(numNodes, OffsetAllocNode {});
+    alloc->unusedNodes.resize(numNodes);
+    for (uint32_t i = 0; i < numNodes; ++i) alloc->unusedNodes[i] = numNodes - 1 - i;
+    if (size > 0) InsertFreeRange(alloc, 0, size);
+}
+
+OffsetAllocation OffsetAllocator_Alloc(OffsetAllocator* alloc, uint32_t size) {
+    OffsetAllocation result { OFFSET_ALLOC_NONE, OFFSET_ALLOC_NONE };
+    if (size == 0 || size > alloc->freeStorage || alloc->numAllocs * 2 + 1 >= alloc->nodes.size()) return result;
+
+    // The first bin at least as large as size: further up its own leaf
+    // mask, or the smallest of the next non-empty top bin.
+    uint32_t minBin = SizeToBinRoundUp(size);
+    uint32_t top = minBin >> OFFSET_ALLOC_MANTISSA_BITS;
+    uint32_t leaf = OFFSET_ALLOC_NONE;
+    if (top < OFFSET_ALLOC_TOP_BINS && (alloc->usedBinsTop & (1u << top))) {
+        leaf = LowestBitFrom(alloc->usedBins[top], minBin & (OFFSET_ALLOC_LEAF_BINS - 1));
+    }
+    if (leaf == OFFSET_ALLOC_NONE) {
+        top = LowestBitFrom(alloc->usedBinsTop, top + 1);
+        if (top != OFFSET_ALLOC_NONE) leaf = LowestBit(alloc->usedBins[top]);
+    }
+    uint32_t index;
+    if (leaf != OFFSET_ALLOC_NONE) {
+        index = alloc->binHeads[top << OFFSET_ALLOC_MANTISSA_BITS | leaf];
+    } else {
+        // Nothing is sure to fit, but the bin below may start with a range
+        // that does, such as the hole a mesh of the same size left.
+        index = alloc->binHeads[SizeToBinRoundDown(size)];
+        if (index == OFFSET_ALLOC_NONE || alloc->nodes[index].size < size) return result;
+    }
+    RemoveFreeRange(alloc, index, false);
+    alloc->numAllocs++;
+
+    // The rest goes back as a free range right after.
+    OffsetAllocNode& node = alloc->nodes[index];
+    uint32_t remainder = node.size - size;
+    node.size = size;
+    if (remainder > 0) {
+        uint32_t rest = InsertFreeRange(alloc, node.offset + size, remainder);
+        OffsetAllocNode& used = alloc->nodes[index];
+        OffsetAllocNode& free = alloc->nodes[rest];
+        free.neighborPrev = index;
+        free.neighborNext = used.neighborNext;
+        if (used.neighborNext != OFFSET_ALLOC_NONE) alloc->nodes[used.neighborNext].neighborPrev = rest;
+        used.neighborNext = rest;
+    }
+    result.offset = alloc->nodes[index].offset;
+    result.node = index;
+    return result;
+}
+
+bool OffsetAllocator_Free(OffsetAllocator* alloc, uint32_t index) {
+    OffsetAllocNode& node = alloc->nodes[index];
+    if (node.state != OffsetAllocNode::USED) return false;
+    uint32_t offset = node.offset, size = node.size;
+    uint32_t prev = node.neighborPrev, next = node.neighborNext;
+    if (prev != OFFSET_ALLOC_NONE && alloc->nodes[prev].state == OffsetAllocNode::FREE) {
+        offset = alloc->nodes[prev].offset;
+        size += alloc->nodes[prev].size;
+        uint32_t before = alloc->nodes[prev].neighborPrev;
+        RemoveFreeRange(alloc, prev, true);
+        prev = before;
+    }
+    if (next != OFFSET_ALLOC_NONE && alloc->nodes[next].state == OffsetAllocNode::FREE) {
+        size += alloc->nodes[next].size;
+        uint32_t after = alloc->nodes[next].neighborNext;
+        RemoveFreeRange(alloc, next, true);
+        next = after;
+    }
+    node.state = OffsetAllocNode::UNUSED;
+    alloc->unusedNodes.push_back(index);
+    alloc->numAllocs--;
+
+    uint32_t merged = InsertFreeRange(alloc, offset, size);
+    alloc->nodes[merged].neighborPrev = prev;
+    alloc->nodes[merged].neighborNext = next;
+    if (prev != OFFSET_ALLOC_NONE) alloc->nodes[prev].neighborNext = merged;
+    if (next != OFFSET_ALLOC_NONE) alloc->nodes[next].neighborPrev = merged;
+    return true;
+}
+
+OffsetAllocatorStats OffsetAllocator_Stats(const OffsetAllocator& alloc) {
+    OffsetAllocatorStats stats {};
+    stats.numAllocs = alloc.numAllocs;
+    stats.freeStorage = alloc.freeStorage;
+    stats.usedStorage = alloc.size - alloc.freeStorage;
+    for (uint32_t head : alloc.binHeads) {
+        for (uint32_t i = head; i != OFFSET_ALLOC_NONE; i = alloc.nodes[i].binNext) {
+            stats.numFreeRanges++;
+            stats.largestFree = std::max(stats.largestFree, alloc.nodes[i].size);
+        }
+    }
+    if (alloc.usedBinsTop) {
+        uint32_t top = HighestBit(alloc.usedBinsTop);
+        stats.largestAlloc = BinToSize(top << OFFSET_ALLOC_MANTISSA_BITS | HighestBit(alloc.usedBins[top]));
+    }
+    stats.fragmentation = alloc.freeStorage ? 1.0f - (float) stats.largestFree / alloc.freeStorage : 0.0f;
+    return stats;
+}
+
+// The range at offset 0, where walks in address order start.
+static uint32_t FirstRange(const OffsetAllocator& alloc) {
+    for (uint32_t i = 0; i < alloc.nodes.size(); ++i) {
+        const OffsetAllocNode& node = alloc.nodes[i];
+        if (node.state != OffsetAllocNode::UNUSED && node.neighborPrev == OFFSET_ALLOC_NONE) return i;
+    }
+    return OFFSET_ALLOC_NONE;
+}
+
+void OffsetAllocator_Compact(OffsetAllocator* alloc, std::vector<OffsetAllocMove>* moves) {
+    moves->clear();
+    uint32_t cursor = 0, last = OFFSET_ALLOC_NONE;
+    for (uint32_t i = FirstRange(*alloc); i != OFFSET_ALLOC_NONE;) {
+        OffsetAllocNode& node = alloc->nodes[i];
+        uint32_t next = node.neighborNext;
+        if (node.state == OffsetAllocNode::FREE) {
+            RemoveFreeRange(alloc, i, true);
+        } else {
+            if (node.offset != cursor) moves->push_back(OffsetAllocMove { i, node.offset, cursor, node.size });
+            node.offset = cursor;
+            node.neighborPrev = last;
+            node.neighborNext = OFFSET_ALLOC_NONE;
+            if (last != OFFSET_ALLOC_NONE) alloc->nodes[last].neighborNext = i;
+            cursor += node.size;
+            last = i;
+        }
+        i = next;
+    }
+    if (cursor < alloc->size) {
+        uint32_t rest = InsertFreeRange(alloc, cursor, alloc->size - cursor);
+        alloc->nodes[rest].neighborPrev = last;
+        if (last != OFFSET_ALLOC_NONE) alloc->nodes[last].neighborNext = rest;
+    }
+}
+
+bool OffsetAllocator_Validate(const OffsetAllocator& alloc) {
+    uint32_t cursor = 0, used = 0, freeRanges = 0, freeStorage = 0, walked = 0;
+    uint32_t prev = OFFSET_ALLOC_NONE;
+    for (uint32_t i = FirstRange(alloc); i != OFFSET_ALLOC_NONE; i = alloc.nodes[i].neighborNext) {
+        const OffsetAllocNode& node = alloc.nodes[i];
+        if (++walked > alloc.nodes.size()) {
+            printf("offset allocator: neighbour links loop\n");
+            return false;
+        }
+        if (node.state == OffsetAllocNode::UNUSED || node.neighborPrev != prev || node.offset != cursor || node.size == 0) {
+            printf("offset allocator: range %u at %u (size %u) does not follow %u, which ends at %u\n",
+                   i, node.offset, node.size, prev, cursor);
+            return false;
+        }
+        if (node.state == OffsetAllocNode::FREE) {
+            if (prev != OFFSET_ALLOC_NONE && alloc.nodes[prev].state == OffsetAllocNode::FREE) {
+                printf("offset allocator: free ranges %u and %u were not merged\n", prev, i);
+                return false;
+            }
+            freeRanges++;
+            freeStorage += node.size;
+        } else {
+            used++;
+        }
+        cursor += node.size;
+        prev = i;
+    }
+    if (cursor != alloc.size) {
+        printf("offset allocator: ranges cover %u of %u\n", cursor, alloc.size);
+        return false;
+    }
+    if (used != alloc.numAllocs || freeStorage != alloc.freeStorage) {
+        printf("offset allocator: counted %u allocations and %u free, expected %u and %u\n",
+               used, freeStorage, alloc.numAllocs, alloc.freeStorage);
+        return false;
+    }
+
+    uint32_t binned = 0;
+    for (uint32_t bin = 0; bin < OFFSET_ALLOC_BINS; ++bin) {
+        uint32_t top = bin >> OFFSET_ALLOC_MANTISSA_BITS, leaf = bin & (OFFSET_ALLOC_LEAF_BINS - 1);
+        bool marked = (alloc.usedBins[top] >> leaf) & 1;
+        if (marked != (alloc.binHeads[bin] != OFFSET_ALLOC_NONE) || ((alloc.usedBinsTop >> top) & 1) != (alloc.usedBins[top] != 0)) {
+            printf("offset allocator: bitmasks disagree with bin %u\n", bin);
+            return false;
+        }
+        uint32_t before = OFFSET_ALLOC_NONE;
+        for (uint32_t i = alloc.binHeads[bin]; i != OFFSET_ALLOC_NONE; i = alloc.nodes[i].binNext) {
+            const OffsetAllocNode& node = alloc.nodes[i];
+            if (++binned > freeRanges || node.state != OffsetAllocNode::FREE || node.binPrev != before
+                || SizeToBinRoundDown(node.size) != bin) {
+                printf("offset allocator: bin %u holds range %u (size %u) wrongly\n", bin, i, node.size);
+                return false;
+            }
+            before = i;
+        }
+    }
+    if (binned != freeRanges) {
+        printf("offset allocator: %u free ranges, %u of them in bins\n", freeRanges, binned);
+        return false;
+    }
+    if (alloc.unusedNodes.size() + used + freeRanges != alloc.nodes.size()) {
+        printf("offset allocator: %zu nodes unaccounted for\n", alloc.nodes.size() - alloc.unusedNodes.size() - used - freeRanges);
+        return false;
+    }
+    return true;
+}
+
+// Mostly small sizes with a long tail, like meshes: log-uniform up to max.
+static uint32_t RandomSize(std::mt19937& rng, uint32_t max) {
+    std::uniform_real_distribution<float> dist(0.0f, logf((float) max));
+    return std::max<uint32_t>(1, (uint32_t) expf(dist(rng)));
+}
+
+void BenchmarkOffsetAllocator(size_t ops) {
+    const uint32_t SPACE = 1 << 22, MAX_ALLOCS = 1 << 14, MAX_SIZE = 1 << 14;
+    std::mt19937 rng(23);
+    OffsetAllocator alloc;
+    OffsetAllocator_Init(&alloc, SPACE, MAX_ALLOCS);
+
+    // Churn into a steady state first, noting how full the space was when
+    // allocations first failed and what compaction does to fragmentation.
+    std::vector<uint32_t> live;
+    std::vector<OffsetAllocMove> moves;
+    size_t failures = 0;
+    float firstFailure = 0.0f;
+    for (size_t op = 0; op < ops; ++op) {
+        if (live.empty() || (rng() % 100 < 55 && live.size() < MAX_ALLOCS)) {
+            OffsetAllocation a = OffsetAllocator_Alloc(&alloc, RandomSize(rng, MAX_SIZE));
+            if (a.node != OFFSET_ALLOC_NONE) live.push_back(a.node);
+            else if (failures++ == 0) firstFailure = 1.0f - (float) alloc.freeStorage / SPACE;
+        } else {
+            size_t k = rng() % live.size();
+            OffsetAllocator_Free(&alloc, live[k]);
+            live[k] = live.back();
+            live.pop_back();
+        }
+    }
+    float fragmentation = OffsetAllocator_Stats(alloc).fragmentation;
+    auto start = std::chrono::high_resolution_clock::now();
+    OffsetAllocator_Compact(&alloc, &moves);
+    std::chrono::duration<double, std::milli> compactDur = std::chrono::high_resolution_clock::now() - start;
+    OffsetAllocatorStats stats = OffsetAllocator_Stats(alloc);
+    printf("offset allocator: %zu ops, %zu allocs failed, the first at %.1f%% used\n",
+           ops, failures, firstFailure * 100.0f);
+    printf("  compaction: %zu of %u allocs moved in %.2f ms, fragmentation %.1f%% -> %.1f%%\n",
+           moves.size(), stats.numAllocs, compactDur.count(), fragmentation * 100.0f, stats.fragmentation * 100.0f);
+
+    // The same mix timed, starting from the churned state.
+    std::vector<uint32_t> sizes(ops);
+    for (uint32_t& s : sizes) s = RandomSize(rng, MAX_SIZE);
+    start = std::chrono::high_resolution_clock::now();
+    size_t allocs = 0, frees = 0;
+    for (size_t op = 0; op < ops; ++op) {
+        if (live.empty() || ((sizes[op] & 1) && live.size() < MAX_ALLOCS)) {
+            OffsetAllocation a = OffsetAllocator_Alloc(&alloc, sizes[op]);
+            if (a.node != OFFSET_ALLOC_NONE) live.push_back(a.node);
+            allocs++;
+        } else {
+            size_t k = sizes[op] % live.size();
+            OffsetAllocator_Free(&alloc, live[k]);
+            live[k] = live.back();
+            live.pop_back();
+            frees++;
+        }
+    }
+    std::chrono::duration<double, std::nano> dur = std::chrono::high_resolution_clock::now() - start;
+    stats = OffsetAllocator_Stats(alloc);
+    printf("  %zu allocs and %zu frees in %.2f ms, %.1f ns/op; now %zu live, %u free ranges, %.1f%% fragmented\n",
+           allocs, frees, dur.count() * 1e-6, dur.count() / ops, live.size(), stats.numFreeRanges, stats.fragmentation * 100.0f);
+}
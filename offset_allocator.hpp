@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Two-level segregated fit (TLSF) allocator for ranges of some outside
+// resource, such as elements of a GL buffer; it hands out offsets and never
+// touches memory itself. Free ranges live in one of OFFSET_ALLOC_BINS lists
+// by size, binned as a small float with 3 mantissa bits, and two levels of
+// bitmasks find the first non-empty list large enough, so Alloc and Free are
+// O(1) whatever the number of allocations. Freed ranges merge with free
+// neighbours at once.
+//
+// Bins round sizes up by up to 1/8 when searching, so a range in the bin
+// below, whose size may be just enough, is only tried when nothing larger is
+// left, and then only the first one; OffsetAllocator_Stats reports the
+// largest size guaranteed to succeed.
+
+static constexpr uint32_t OFFSET_ALLOC_MANTISSA_BITS = 3;
+static constexpr uint32_t OFFSET_ALLOC_LEAF_BINS     = 1 << OFFSET_ALLOC_MANTISSA_BITS;
+static constexpr uint32_t OFFSET_ALLOC_TOP_BINS      = 32;
+static constexpr uint32_t OFFSET_ALLOC_BINS          = OFFSET_ALLOC_TOP_BINS * OFFSET_ALLOC_LEAF_BINS;
+static constexpr uint32_t OFFSET_ALLOC_NONE          = 0xffffffff;
+
+struct OffsetAllocNode {
+    enum State : uint8_t { UNUSED, FREE, USED };
+
+    uint32_t offset;
+    uint32_t size;
+    uint32_t binPrev, binNext;              // free ranges in the same bin
+    uint32_t neighborPrev, neighborNext;    // ranges before and after, free or used
+    State    state;
+};
+
+struct OffsetAllocator {
+    uint32_t                     size;
+    uint32_t                     freeStorage;
+    uint32_t                     numAllocs;
+    uint32_t                     usedBinsTop;                   // bit t: usedBins[t] != 0
+    uint8_t                      usedBins[OFFSET_ALLOC_TOP_BINS];  // bit l: binHeads[t * 8 + l] is not empty
+    uint32_t                     binHeads[OFFSET_ALLOC_BINS];
+    std::vector<OffsetAllocNode> nodes;
+    std::vector<uint32_t>        unusedNodes;                   // stack of UNUSED entries of nodes
+};
+
+// node is the handle to free the range with, and stays the same through
+// OffsetAllocator_Compact; it is OFFSET_ALLOC_NONE when Alloc failed.
+struct OffsetAllocation {
+    uint32_t offset;
+    uint32_t node;
+};
+
+struct OffsetAllocatorStats {
+    uint32_t numAllocs;
+    uint32_t numFreeRanges;
+    uint32_t usedStorage;
+    uint32_t freeStorage;
+    uint32_t largestFree;       // largest single free range
+    uint32_t largestAlloc;      // largest size Alloc is sure to satisfy
+    float    fragmentation;     // 1 - largestFree / freeStorage
+};
+
+// One free range of size units, and room for maxAllocs live allocations;
+// size must be below 2^31.
+void OffsetAllocator_Init(OffsetAllocator* alloc, uint32_t size, uint32_t maxAllocs);
+
+OffsetAllocation OffsetAllocator_Alloc(OffsetAllocator* alloc, uint32_t size);
+
+// Returns false, changing nothing, when node is not a live allocation, as
+// on a second free of the same node.
+bool OffsetAllocator_Free(OffsetAllocator* alloc, uint32_t node);
+
+static inline uint32_t OffsetAllocator_Offset(const OffsetAllocator& alloc, uint32_t node) {
+    return alloc.nodes[node].offset;
+}
+static inline uint32_t OffsetAllocator_Size(const OffsetAllocator& alloc, uint32_t node) {
+    return alloc.nodes[node].size;
+}
+
+OffsetAllocatorStats OffsetAllocator_Stats(const OffsetAllocator& alloc);
+
+// A live allocation moved by OffsetAllocator_Compact.
+struct OffsetAllocMove {
+    uint32_t node;
+    uint32_t from, to;
+    uint32_t size;
+};
+
+// Slides every allocation down to close the gaps between them, in address
+// order, leaving one free range at the end, and lists what moved in
+// ascending order of offset. Node handles stay valid; their offsets change.
+// Each move goes to a lower offset, so applying them in order never
+// overwrites a range that has yet to move, though a range can overlap its
+// own destination.
+void OffsetAllocator_Compact(OffsetAllocator* alloc, std::vector<OffsetAllocMove>* moves);
+
+// Walks every range and bin and checks that they tile [0, size) with no
+// two free neighbours, that each free range is in the bin for its size,
+// and that the bitmasks and counters agree. Prints the first problem.
+bool OffsetAllocator_Validate(const OffsetAllocator& alloc);
+
+// Random allocs and frees of mixed sizes; prints how much of the space was
+// in use when allocations first failed, fragmentation before and after
+// compaction, and ns/op for the same mix timed. Correctness is covered by
+// tests/test_offset_allocator.cpp.
+void BenchmarkOffsetAllocator(size_t ops);
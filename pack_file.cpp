@@ -0,0 +1,149 @@
+#include "pack_file.hpp"
+
+#include <stdio.h>
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+uint64_t Pack_HashPath(std::string_view path) {
+    while (path.size() >= 2 && path[0] == '.' && (path[1] == '/' || path[1] == '\\')) path.remove_prefix(2);
+    uint64_t h = 14695981039346656037ull;
+    for (char c : path) {
+        char ch = c == '\\' ? '/' : c;
+        h = (h ^ (uint8_t) ch) * 1099511628211ull;
+    }
+    return h;
+}
+
+bool PackFile_Open(PackFile* pack, const char* path) {
+    *pack = PackFile {};
+    if (!MappedFile_Open(&pack->file, path)) return false;
+
+    const MappedFile& file = pack->file;
+    auto header = (const PackHeader*) file.data;
+    bool valid = file.size >= sizeof(PackHeader)
+              && header->magic == PACK_MAGIC
+              && header->version == PACK_VERSION
+              && header->numEntries <= (file.size - sizeof(PackHeader)) / sizeof(PackEntry);
+    if (!valid) {
+        printf("%s: not a pack file\n", path);
+        PackFile_Close(pack);
+        return false;
+    }
+
+    pack->entries = (const PackEntry*) (header + 1);
+    pack->numEntries = (size_t) header->numEntries;
+    for (size_t i = 0; i < pack->numEntries; ++i) {
+        const PackEntry& e = pack->entries[i];
+        if (e.offset > file.size || e.size > file.size - e.offset || (i > 0 && pack->entries[i - 1].hash >= e.hash)) {
+            printf("%s: corrupt table of contents\n", path);
+            PackFile_Close(pack);
+            return false;
+        }
+    }
+    return true;
+}
+
+void PackFile_Close(PackFile* pack) {
+    MappedFile_Close(&pack->file);
+    pack->entries = nullptr;
+    pack->numEntries = 0;
+}
+
+const PackEntry* PackFile_Find(const PackFile* pack, std::string_view path) {
+    if (!pack || pack->numEntries == 0) return nullptr;
+    uint64_t hash = Pack_HashPath(path);
+    const PackEntry* end = pack->entries + pack->numEntries;
+    const PackEntry* it = std::lower_bound(pack->entries, end, hash,
+        [](const PackEntry& e, uint64_t h) { return e.hash < h; });
+    return it != end && it->hash == hash ? it : nullptr;
+}
+
+const void* PackFile_Data(const PackFile* pack, const PackEntry* entry) {
+    return (const char*) pack->file.data + entry->offset;
+}
+
+std::string_view PackFile_View(const PackFile* pack, std::string_view path) {
+    const PackEntry* entry = PackFile_Find(pack, path);
+    if (!entry) return std::string_view {};
+    // Zero-length entries may sit at the very end of the mapping; point them
+    // at the header so the view is still non-null.
+    if (entry->size == 0) return std::string_view((const char*) pack->file.data, 0);
+    return std::string_view((const char*) PackFile_Data(pack, entry), (size_t) entry->size);
+}
+
+static inline uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static bool WritePadding(FILE* file, uint64_t from, uint64_t to) {
+    static const char zeros[PACK_ALIGNMENT] = {};
+    while (from < to) {
+        size_t n = (size_t) std::min<uint64_t>(to - from, sizeof(zeros));
+        if (fwrite(zeros, 1, n, file) != n) return false;
+        from += n;
+    }
+    return true;
+}
+
+bool PackFile_Write(const char* path, const char* const* files, size_t numFiles) {
+    struct Source {
+        const char* path;
+        MappedFile  file;
+    };
+    std::vector<Source> sources(numFiles);
+    std::vector<PackEntry> entries(numFiles);
+    bool ok = true;
+    for (size_t i = 0; ok && i < numFiles; ++i) {
+        sources[i].path = files[i];
+        ok = MappedFile_Open(&sources[i].file, files[i]);
+        if (!ok) printf("%s: could not open\n", files[i]);
+        entries[i] = PackEntry { Pack_HashPath(files[i]), i, ok ? sources[i].file.size : 0, 0, 0 };
+    }
+
+    // Offsets hold source indices until the table is sorted.
+    std::sort(entries.begin(), entries.end(), [](const PackEntry& a, const PackEntry& b) { return a.hash < b.hash; });
+    for (size_t i = 1; ok && i < entries.size(); ++i) {
+        if (entries[i - 1].hash == entries[i].hash) {
+            printf("%s and %s hash the same\n", sources[entries[i - 1].offset].path, sources[entries[i].offset].path);
+            ok = false;
+        }
+    }
+    std::vector<size_t> order(entries.size());
+    uint64_t offset = AlignUp(sizeof(PackHeader) + entries.size() * sizeof(PackEntry), PACK_ALIGNMENT);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        order[i] = (size_t) entries[i].offset;
+        entries[i].offset = offset;
+        offset = AlignUp(offset + entries[i].size, PACK_ALIGNMENT);
+    }
+
+    std::string tmpPath = std::string(path) + ".tmp";
+    FILE* file = ok ? fopen(tmpPath.c_str(), "wb") : nullptr;
+    if (file) {
+        PackHeader header { PACK_MAGIC, PACK_VERSION, entries.size() };
+        ok = fwrite(&header, sizeof(header), 1, file) == 1
+          && (entries.empty() || fwrite(entries.data(), entries.size() * sizeof(PackEntry), 1, file) == 1);
+        uint64_t written = sizeof(header) + entries.size() * sizeof(PackEntry);
+        for (size_t i = 0; ok && i < entries.size(); ++i) {
+            const MappedFile& src = sources[order[i]].file;
+            ok = WritePadding(file, written, entries[i].offset)
+              && (src.size == 0 || fwrite(src.data, src.size, 1, file) == 1);
+            written = entries[i].offset + entries[i].size;
+        }
+        ok = ok && WritePadding(file, written, AlignUp(written, PACK_ALIGNMENT));
+        ok = (fclose(file) == 0) && ok;
+    } else {
+        ok = false;
+    }
+    for (Source& source : sources) MappedFile_Close(&source.file);
+
+    std::error_code ec;
+    if (ok) std::filesystem::rename(tmpPath, path, ec);
+    if (!ok || ec) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+
+#include "mapped_file.hpp"
+
+// Packs bundle many asset files into one file read through a single mapping.
+// Layout: a PackHeader, numEntries PackEntry records sorted by hash, then
+// the file contents, each starting on a PACK_ALIGNMENT boundary. Entries are
+// found by the hash of their normalized path (see Pack_HashPath); paths
+// themselves are not stored.
+
+static constexpr uint32_t PACK_MAGIC     = 0x4b524250; // "PBRK"
+static constexpr uint32_t PACK_VERSION   = 1;
+static constexpr uint64_t PACK_ALIGNMENT = 4096;
+
+struct PackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t numEntries;
+};
+
+struct PackEntry {
+    uint64_t hash;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+struct PackFile {
+    MappedFile       file;
+    const PackEntry* entries;
+    size_t           numEntries;
+};
+
+// 64-bit FNV-1a of path with '\' turned into '/' and any leading "./"
+// dropped, so "res\a.fbx", "./res/a.fbx" and "res/a.fbx" hash the same.
+uint64_t Pack_HashPath(std::string_view path);
+
+bool PackFile_Open(PackFile* pack, const char* path);
+void PackFile_Close(PackFile* pack);
+
+// Returns the entry for path, or nullptr if pack is null or does not contain
+// it. Lookups touch only the mapped table of contents, never the filesystem.
+const PackEntry* PackFile_Find(const PackFile* pack, std::string_view path);
+const void* PackFile_Data(const PackFile* pack, const PackEntry* entry);
+
+// Contents of path inside the mapping, valid until PackFile_Close. A view
+// with a null data() means the pack does not have it; an empty file gives a
+// non-null, zero-length view.
+std::string_view PackFile_View(const PackFile* pack, std::string_view path);
+
+// Bundles files, stored under the paths they are given by, into a new pack
+// at path. Written to a temporary file and renamed into place.
+bool PackFile_Write(const char* path, const char* const* files, size_t numFiles);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
+
+// Splits [0, count) into contiguous ranges of at least `grain` items and runs
+// fn(begin, end) on each, one range per hardware thread. The calling thread
+// takes the last range, so small inputs never pay for a thread launch.
+template <typename Fn>
+void ParallelFor(size_t count, size_t grain, Fn&& fn) {
+    if (count == 0) return;
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t tasks = std::min(threads, (count + grain - 1) / std::max<size_t>(1, grain));
+    if (tasks <= 1) {
+        fn((size_t) 0, count);
+        return;
+    }
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(tasks - 1);
+    size_t step = (count + tasks - 1) / tasks;
+    for (size_t begin = 0; begin + step < count; begin += step) {
+        futures.push_back(std::async(std::launch::async, [&fn, begin, step] { fn(begin, begin + step); }));
+    }
+    fn(futures.size() * step, count);
+    for (auto& fut : futures) fut.get();
+}
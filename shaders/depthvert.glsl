@@ -0,0 +1,35 @@
+#version 430 core
+
+// Depth-only variant of vert.glsl for GlStaticMesh::posVao, or any VAO with
+// the position at location 0. The position math has to stay the same as in
+// vert.glsl; together with invariant gl_Position that makes a depth prepass
+// match the colour pass exactly. in_pos is declared by main from the
+// layout of the position stream; see GlStaticMesh_PositionInputs.
+
+#ifdef INSTANCED
+layout (location = 5) in mat4 in_model;
+uniform mat4 u_vp;
+#endif
+
+uniform mat4 u_mvp;
+
+#ifdef COMPACT_VERTS
+uniform vec3 u_pos_offset;
+uniform vec3 u_pos_scale;
+#endif
+
+invariant gl_Position;
+
+void main() {
+#ifdef COMPACT_VERTS
+    vec3 pos = u_pos_offset + in_pos * u_pos_scale;
+#else
+    vec3 pos = in_pos;
+#endif
+#ifdef INSTANCED
+    mat4 mvp = u_vp * in_model;
+#else
+    mat4 mvp = u_mvp;
+#endif
+    gl_Position = mvp * vec4(pos, 1.0);
+}
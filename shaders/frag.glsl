@@ -17,6 +17,13 @@ uniform sampler2D u_normal;
 uniform sampler2D u_ao;
 uniform sampler2D u_emissive;
 
+#ifdef LIGHTMAP_COORDS
+// Nothing is baked into the lightmap yet, so its texels show as a
+// checkerboard over the albedo, to judge chart layout and density by.
+in vec2 pass_lightmap_coord;
+uniform vec2 u_lightmap_size;
+#endif
+
 vec2 equirect(vec3 dir) {
     const float PI = 3.14159;
     float lon = atan(-dir.z, dir.x) * 2.0 / PI;
@@ -38,6 +45,10 @@ void main() {
     vec3 difcol = texture(u_color, pass_coord).rgb;
     float ao = texture(u_ao, pass_coord).r;
     vec3 emissive = texture(u_emissive, pass_coord).rgb;
+#ifdef LIGHTMAP_COORDS
+    ivec2 texel = ivec2(floor(pass_lightmap_coord * u_lightmap_size));
+    difcol *= (texel.x + texel.y) % 2 == 0 ? 1.0 : 0.6;
+#endif
 
     mat3 tbn = mat3(pass_tang, pass_bitang, pass_norm);
     vec3 norm = tbn * normal;
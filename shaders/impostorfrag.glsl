@@ -0,0 +1,95 @@
+#version 430 core
+precision highp float;
+
+// Blends the three frames impostorvert.glsl picked, weighting each by its
+// coverage, then shades the result like frag.glsl and moves the depth to
+// the baked surface so impostors intersect each other and the meshes.
+
+in vec4 pass_pos_mvp;
+in vec2 pass_frame_coord[3];
+in vec4 pass_clip;
+in vec4 pass_clip_dir;
+flat in vec2 pass_frame[3];
+flat in vec3 pass_weights;
+flat in mat3 pass_normal_matrix;
+
+out vec4 out_color;
+
+uniform sampler2D u_env;
+uniform sampler2D u_impostor_albedo;
+uniform sampler2D u_impostor_normal;
+uniform sampler2D u_impostor_material;
+uniform sampler2D u_impostor_depth;
+uniform int u_impostor_grid;
+uniform float u_impostor_radius;
+
+vec2 equirect(vec3 dir) {
+    const float PI = 3.14159;
+    float lon = atan(-dir.z, dir.x) * 2.0 / PI;
+    float lat = asin(dir.y) * 2.0 / PI;
+    vec2 vec = vec2(
+        mod(0.25 + lon / (1.0 * PI), 1.0),
+        mod(0.5 + lat / (2.0 * PI), 1.0)
+    );
+    return vec;
+}
+
+float random(vec2 st) {
+    return fract(sin(0.5 * dot(st.xy, vec2(12.9898,78.233))));
+}
+
+void main() {
+    vec3 difcol = vec3(0.0);
+    vec3 normal = vec3(0.0);
+    vec3 material = vec3(0.0);
+    float depth = 0.0;
+    float coverage = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        // Clamped rather than skipped, so every sample is in uniform control
+        // flow and gets its mip from the derivatives.
+        vec2 coord = pass_frame_coord[i];
+        vec2 at = (pass_frame[i] + clamp(coord, 0.0, 1.0)) / float(u_impostor_grid);
+        bool inside = all(greaterThanEqual(coord, vec2(0.0))) && all(lessThanEqual(coord, vec2(1.0)));
+        vec4 albedo = texture(u_impostor_albedo, at);
+        float w = inside ? pass_weights[i] * albedo.a : 0.0;
+        difcol += albedo.rgb * w;
+        normal += (texture(u_impostor_normal, at).xyz * 2.0 - 1.0) * w;
+        material += texture(u_impostor_material, at).rgb * w;
+        depth += texture(u_impostor_depth, at).r * w;
+        coverage += w;
+    }
+    if (coverage < 0.5) discard;
+    difcol /= coverage;
+    material /= coverage;
+    depth /= coverage;
+
+    float roughness = material.g;
+    float metalness = material.b;
+    vec3 norm = normalize(pass_normal_matrix * normal);
+    vec3 camsurf = normalize(pass_pos_mvp.xyz * 2.0 - 1.0);
+    vec3 reflectdir = reflect(camsurf, norm);
+    vec3 reflectcol = vec3(0.0);
+    vec3 scattercol = vec3(0.0);
+    for (int i = 0; i < 8; ++i) {
+        vec3 scattervec = vec3(
+            (random(vec2(i)) * 2.0 - 1.0),
+            (random(vec2(i * i)) * 2.0 - 1.0),
+            (random(vec2(-i)) * 2.0 - 1.0)
+        );
+        scattercol += texture(u_env, equirect(scattervec + reflectdir * 0.1)).rgb;
+        reflectcol += texture(u_env, equirect(reflectdir)).rgb;
+    }
+    reflectcol /= 8.0;
+    scattercol /= 8.0;
+
+    vec3 refl = mix(reflectcol, scattercol, roughness);
+    vec3 dielectric = difcol + refl * 0.1 * (1.0 - roughness);
+    vec3 metal = difcol * refl;
+    out_color.rgb = pow(mix(dielectric, metal, metalness), vec3(1.0 / 2.2));
+    out_color.a = 1.0;
+
+    // Baked depth runs from the sphere's near side to its far side; the
+    // quad passes through its centre.
+    vec4 clip = pass_clip + pass_clip_dir * (u_impostor_radius * (1.0 - 2.0 * depth));
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+}
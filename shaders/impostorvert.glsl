@@ -0,0 +1,95 @@
+#version 430 core
+
+// Impostor billboards; see impostor.hpp and gl_impostor.hpp. Each instance
+// is a quad of four strip vertices from gl_VertexID, facing the camera
+// across the bounding sphere, placed by the same per-instance matrix as the
+// INSTANCED variant of vert.glsl. The three frames around the direction the
+// camera sees the object from are blended by their barycentric weights in
+// the atlas grid, each frame projected onto the quad along the view.
+
+layout (location = 5) in mat4 in_model;
+
+uniform mat4 u_vp;
+uniform int u_impostor_grid;
+uniform vec3 u_impostor_center;
+uniform float u_impostor_radius;
+
+out vec4 pass_pos_mvp;
+out vec2 pass_frame_coord[3];       // within each frame, [0, 1]^2 where it has texels
+out vec4 pass_clip;                 // the quad point, and the clip-space step
+out vec4 pass_clip_dir;             // per object unit towards the camera
+flat out vec2 pass_frame[3];        // frame cells in the atlas grid
+flat out vec3 pass_weights;
+flat out mat3 pass_normal_matrix;
+
+// Must match Impostor_FrameDirection in impostor.cpp.
+vec3 frameDirection(ivec2 frame) {
+    vec2 p = (vec2(frame) + 0.5) / float(u_impostor_grid) * 2.0 - 1.0;
+    vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (n.z < 0.0) n.xy = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// Must match Impostor_FrameBasis in impostor.cpp.
+void frameBasis(vec3 dir, out vec3 right, out vec3 up) {
+    vec3 ref = abs(dir.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(0.0, 0.0, 1.0);
+    right = normalize(cross(ref, dir));
+    up = cross(dir, right);
+}
+
+vec2 octahedralCoord(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.xy * 0.5 + 0.5;
+}
+
+// Cells past an edge of the octahedral map continue mirrored along it.
+ivec2 wrapFrame(ivec2 f) {
+    int n = u_impostor_grid;
+    if (f.x < 0 || f.x >= n) f = ivec2(clamp(f.x, 0, n - 1), n - 1 - f.y);
+    if (f.y < 0 || f.y >= n) f = ivec2(n - 1 - f.x, clamp(f.y, 0, n - 1));
+    return f;
+}
+
+void main() {
+    // The camera sits at the view-space origin; find it in object space.
+    vec3 camera = vec3(inverse(in_model) * vec4(0.0, 0.0, 0.0, 1.0));
+    vec3 dir = normalize(camera - u_impostor_center);
+
+    vec2 g = octahedralCoord(dir) * float(u_impostor_grid) - 0.5;
+    vec2 cell = floor(g);
+    vec2 f = g - cell;
+    ivec2 frames[3];
+    if (f.x + f.y < 1.0) {
+        frames[0] = ivec2(cell);
+        pass_weights = vec3(1.0 - f.x - f.y, f.x, f.y);
+    } else {
+        frames[0] = ivec2(cell) + ivec2(1, 1);
+        pass_weights = vec3(f.x + f.y - 1.0, 1.0 - f.y, 1.0 - f.x);
+    }
+    frames[1] = ivec2(cell) + ivec2(1, 0);
+    frames[2] = ivec2(cell) + ivec2(0, 1);
+
+    vec3 right, up;
+    frameBasis(dir, right, up);
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec3 offset = (corner.x * right + corner.y * up) * u_impostor_radius;
+    for (int i = 0; i < 3; ++i) {
+        ivec2 frame = wrapFrame(frames[i]);
+        vec3 fdir = frameDirection(frame);
+        vec3 fright, fup;
+        frameBasis(fdir, fright, fup);
+        // Along the view onto the plane the frame was baked on.
+        vec3 onplane = offset - dir * (dot(offset, fdir) / max(dot(dir, fdir), 1e-3));
+        pass_frame_coord[i] = vec2(dot(onplane, fright), dot(onplane, fup)) / (2.0 * u_impostor_radius) + 0.5;
+        pass_frame[i] = vec2(frame);
+    }
+
+    vec4 pos = vec4(u_impostor_center + offset, 1.0);
+    mat4 mvp = u_vp * in_model;
+    pass_pos_mvp = in_model * pos;
+    pass_clip = mvp * pos;
+    pass_clip_dir = mvp * vec4(dir, 0.0);
+    pass_normal_matrix = mat3(in_model);
+    gl_Position = pass_clip;
+}
@@ -1,10 +1,34 @@
-#version 400 core
+#version 430 core
 
-layout (location = 0) in vec3 in_pos;
-layout (location = 1) in vec3 in_norm;
-layout (location = 2) in vec3 in_tang;
-layout (location = 3) in vec3 in_bitang;
-layout (location = 4) in vec2 in_coord;
+// The vertex inputs, in_pos, in_norm, in_tang and in_coord, or in_pos,
+// in_frame and in_coord with COMPACT_VERTS, in_joints and in_weights with
+// SKINNED, and in_lightmapCoord with LIGHTMAP_COORDS, are declared from the
+// layouts in gl_mesh.hpp and inserted ahead of this by main; see
+// GlStaticMesh_VertexInputs.
+
+#if defined(PULLED_VERTS)
+// No vertex attributes; must match GlPulledVert and PULLED_VERTS_BINDING in
+// gl_mesh.hpp. Records are four uints from the start of the buffer, the
+// float xyz positions they index follow from u_pull_positions.
+layout (std430, binding = 1) readonly buffer PulledVerts {
+    uint pulled[];
+};
+uniform uint u_pull_positions;
+#endif
+
+#ifdef INSTANCED
+layout (location = 5) in mat4 in_model;
+uniform mat4 u_vp;
+#endif
+
+#ifdef SKINNED
+// Instance i of a draw reads joints [i * u_joints, (i + 1) * u_joints) of
+// the palette.
+layout (std430, binding = 0) readonly buffer SkinPalette {
+    mat4 palette[];
+};
+uniform int u_joints;
+#endif
 
 out vec3 pass_pos;
 out vec4 pass_pos_mvp;
@@ -12,18 +36,111 @@ out vec3 pass_norm;
 out vec3 pass_tang;
 out vec3 pass_bitang;
 out vec2 pass_coord;
+#ifdef LIGHTMAP_COORDS
+out vec2 pass_lightmap_coord;
+#endif
 
 uniform mat4 u_mvp;
 uniform mat4 u_m;
 uniform mat4 u_rot;
 
-void main() {
-    pass_pos = vec3(u_mvp * vec4(in_pos, 1.0));
-    pass_pos_mvp = u_m * vec4(in_pos, 1.0);
-    pass_norm = normalize((u_m * vec4(in_norm, 0.0)).xyz);
-    pass_tang = normalize((u_m * vec4(in_tang, 0.0)).xyz);
-    pass_bitang = normalize((u_m * vec4(in_bitang, 0.0)).xyz);
-    pass_coord = vec2(in_coord.x, in_coord.y);
-    gl_Position = u_mvp * vec4(in_pos, 1.0);
+// So a depth prepass with depthvert.glsl lands on exactly the same depth.
+invariant gl_Position;
+
+#ifdef COMPACT_VERTS
+uniform vec3 u_pos_offset;
+uniform vec3 u_pos_scale;
+
+float signNotZero(float v) { return v >= 0.0 ? 1.0 : -1.0; }
+
+vec3 decodeOctahedral(uint x, uint y) {
+    vec3 n = vec3(vec2(x, y) / 1023.0 * 2.0 - 1.0, 0.0);
+    n.z = 1.0 - abs(n.x) - abs(n.y);
+    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(signNotZero(n.x), signNotZero(n.y));
+    return normalize(n);
 }
 
+// Must match PackCompactVert/TangentBasis in vertex_compact.cpp.
+void decodeFrame(uint frame, out vec3 norm, out vec3 tang, out vec3 bitang) {
+    const float PI = 3.14159265;
+    norm = decodeOctahedral(frame & 1023u, (frame >> 10) & 1023u);
+    float s = signNotZero(norm.z);
+    float a = -1.0 / (s + norm.z);
+    float b = norm.x * norm.y * a;
+    vec3 b1 = vec3(1.0 + s * norm.x * norm.x * a, s * b, -s * norm.x);
+    vec3 b2 = vec3(b, s + norm.y * norm.y * a, -norm.y);
+    float angle = float((frame >> 20) & 2047u) / 2048.0 * 2.0 * PI - PI;
+    tang = b1 * cos(angle) + b2 * sin(angle);
+    bitang = cross(norm, tang) * ((frame >> 31) != 0u ? -1.0 : 1.0);
+}
+#endif
+
+#ifdef PULLED_VERTS
+// Must match OctahedralUnfold in vertex_pull.cpp.
+vec3 decodeOctahedral16(uint v) {
+    vec2 p = unpackSnorm2x16(v);
+    vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// snorm10 xyz and a 2-bit w, as GL_INT_2_10_10_10_REV.
+vec4 unpackSnorm3x10_1x2(uint v) {
+    ivec4 i = ivec4(bitfieldExtract(int(v), 0, 10), bitfieldExtract(int(v), 10, 10),
+                    bitfieldExtract(int(v), 20, 10), bitfieldExtract(int(v), 30, 2));
+    return clamp(vec4(i) / vec4(511.0, 511.0, 511.0, 1.0), -1.0, 1.0);
+}
+#endif
+
+void main() {
+#if defined(PULLED_VERTS)
+    uint record = uint(gl_VertexID) * 4u;
+    uint p = u_pull_positions + pulled[record] * 3u;
+    vec3 pos = vec3(uintBitsToFloat(pulled[p]), uintBitsToFloat(pulled[p + 1u]), uintBitsToFloat(pulled[p + 2u]));
+    vec3 norm = decodeOctahedral16(pulled[record + 1u]);
+    vec4 packed_tang = unpackSnorm3x10_1x2(pulled[record + 2u]);
+    vec3 tang = normalize(packed_tang.xyz);
+    vec3 bitang = cross(norm, tang) * packed_tang.w;
+    vec2 coord = unpackHalf2x16(pulled[record + 3u]);
+#elif defined(COMPACT_VERTS)
+    vec3 pos = u_pos_offset + in_pos * u_pos_scale;
+    vec3 norm, tang, bitang;
+    decodeFrame(in_frame, norm, tang, bitang);
+    vec2 coord = in_coord;
+#else
+    vec3 pos = in_pos;
+    vec3 norm = in_norm;
+    vec3 tang = in_tang.xyz;
+    vec3 bitang = cross(norm, tang) * in_tang.w;
+    vec2 coord = in_coord;
+#endif
+#ifdef SKINNED
+    float handedness = dot(cross(norm, tang), bitang) < 0.0 ? -1.0 : 1.0;
+    int base = gl_InstanceID * u_joints;
+    mat4 skin = palette[base + int(in_joints.x)] * in_weights.x
+              + palette[base + int(in_joints.y)] * in_weights.y
+              + palette[base + int(in_joints.z)] * in_weights.z
+              + palette[base + int(in_joints.w)] * in_weights.w;
+    pos = vec3(skin * vec4(pos, 1.0));
+    norm = normalize(mat3(skin) * norm);
+    tang = normalize(mat3(skin) * tang);
+    bitang = cross(norm, tang) * handedness;
+#endif
+#ifdef INSTANCED
+    mat4 m = in_model;
+    mat4 mvp = u_vp * in_model;
+#else
+    mat4 m = u_m;
+    mat4 mvp = u_mvp;
+#endif
+    pass_pos = vec3(mvp * vec4(pos, 1.0));
+    pass_pos_mvp = m * vec4(pos, 1.0);
+    pass_norm = normalize((m * vec4(norm, 0.0)).xyz);
+    pass_tang = normalize((m * vec4(tang, 0.0)).xyz);
+    pass_bitang = normalize((m * vec4(bitang, 0.0)).xyz);
+    pass_coord = coord;
+#ifdef LIGHTMAP_COORDS
+    pass_lightmap_coord = in_lightmapCoord;
+#endif
+    gl_Position = mvp * vec4(pos, 1.0);
+}
@@ -0,0 +1,374 @@
+#include "skeletal_mesh.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "mapped_io.hpp"
+#include "mesh_tangents.hpp"
+#include "mesh_weld.hpp"
+
+static glm::mat4 ToGlm(const aiMatrix4x4& m) {
+    // Assimp matrices are row-major, glm's column-major.
+    return glm::mat4 {
+        m.a1, m.b1, m.c1, m.d1,
+        m.a2, m.b2, m.c2, m.d2,
+        m.a3, m.b3, m.c3, m.d3,
+        m.a4, m.b4, m.c4, m.d4,
+    };
+}
+
+static void SetJoint(JointPose4* groups, size_t joint, glm::vec3 t, glm::quat r, glm::vec3 s) {
+    JointPose4& g = groups[joint / 4];
+    size_t l = joint % 4;
+    g.tx[l] = t.x; g.ty[l] = t.y; g.tz[l] = t.z;
+    g.rx[l] = r.x; g.ry[l] = r.y; g.rz[l] = r.z; g.rw[l] = r.w;
+    g.sx[l] = s.x; g.sy[l] = s.y; g.sz[l] = s.z;
+}
+
+static void ResetJointGroups(std::vector<JointPose4>* groups, size_t count) {
+    groups->resize(count);
+    for (JointPose4& g : *groups) {
+        memset(&g, 0, sizeof(g));
+        for (int l = 0; l < 4; ++l) g.rw[l] = g.sx[l] = g.sy[l] = g.sz[l] = 1.0f;
+    }
+}
+
+// Keeps the top four influences of a vertex, strongest first.
+struct InfluenceSet {
+    float    weights[4];
+    uint32_t joints[4];
+
+    void Add(uint32_t joint, float weight) {
+        if (weight <= weights[3]) return;
+        int i = 3;
+        for (; i > 0 && weights[i - 1] < weight; --i) {
+            weights[i] = weights[i - 1];
+            joints[i] = joints[i - 1];
+        }
+        weights[i] = weight;
+        joints[i] = joint;
+    }
+};
+
+static SkinWeights QuantizeInfluences(const InfluenceSet& set, uint32_t rigid) {
+    SkinWeights out {};
+    float total = set.weights[0] + set.weights[1] + set.weights[2] + set.weights[3];
+    if (!(total > 0.0f)) {
+        out.joints[0] = (uint8_t) rigid;
+        out.weights[0] = 255;
+        return out;
+    }
+    // Round the weaker three and give the remainder to the strongest, so the
+    // weights sum to exactly 255 and the skinned vertex stays affine.
+    int rest = 0;
+    for (int i = 1; i < 4; ++i) {
+        out.joints[i] = (uint8_t) set.joints[i];
+        out.weights[i] = (uint8_t) lrintf(set.weights[i] / total * 255.0f);
+        rest += out.weights[i];
+    }
+    out.joints[0] = (uint8_t) set.joints[0];
+    out.weights[0] = (uint8_t) (255 - rest);
+    return out;
+}
+
+struct SkeletonBuilder {
+    std::unordered_set<std::string>               needed;
+    std::unordered_map<const aiNode*, uint32_t>   joints;
+    std::vector<aiMatrix4x4>                      globals;
+};
+
+static bool MarkJoints(SkeletonBuilder* b, const aiNode* node) {
+    bool keep = b->needed.count(node->mName.C_Str()) > 0;
+    for (unsigned i = 0; i < node->mNumChildren; ++i) keep |= MarkJoints(b, node->mChildren[i]);
+    if (keep) b->joints[node] = 0;
+    return keep;
+}
+
+static void FlattenJoints(SkeletonBuilder* b, Skeleton* skel, const aiNode* node, int32_t parent, const aiMatrix4x4& parentGlobal) {
+    if (!b->joints.count(node)) return;
+    uint32_t index = (uint32_t) skel->names.size();
+    b->joints[node] = index;
+    aiMatrix4x4 global = parentGlobal * node->mTransformation;
+    skel->names.push_back(node->mName.C_Str());
+    skel->parents.push_back(parent);
+    skel->inverseBinds.push_back(glm::inverse(ToGlm(global)));
+    b->globals.push_back(global);
+    for (unsigned i = 0; i < node->mNumChildren; ++i) FlattenJoints(b, skel, node->mChildren[i], (int32_t) index, global);
+}
+
+template <typename Key>
+static unsigned FindKey(const Key* keys, unsigned count, double time) {
+    unsigned lo = 0, hi = count - 1;
+    while (lo + 1 < hi) {
+        unsigned mid = (lo + hi) / 2;
+        if (keys[mid].mTime <= time) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static glm::vec3 SampleVectorKeys(const aiVectorKey* keys, unsigned count, double time) {
+    if (count == 1 || time <= keys[0].mTime) return glm::vec3 { keys[0].mValue.x, keys[0].mValue.y, keys[0].mValue.z };
+    const aiVectorKey& last = keys[count - 1];
+    if (time >= last.mTime) return glm::vec3 { last.mValue.x, last.mValue.y, last.mValue.z };
+    unsigned k = FindKey(keys, count, time);
+    const aiVectorKey& a = keys[k];
+    const aiVectorKey& b = keys[k + 1];
+    float t = (float) ((time - a.mTime) / std::max(b.mTime - a.mTime, 1e-9));
+    return glm::mix(glm::vec3 { a.mValue.x, a.mValue.y, a.mValue.z }, glm::vec3 { b.mValue.x, b.mValue.y, b.mValue.z }, t);
+}
+
+static glm::quat SampleQuatKeys(const aiQuatKey* keys, unsigned count, double time) {
+    auto q = [](const aiQuaternion& v) { return glm::normalize(glm::quat { v.w, v.x, v.y, v.z }); };
+    if (count == 1 || time <= keys[0].mTime) return q(keys[0].mValue);
+    if (time >= keys[count - 1].mTime) return q(keys[count - 1].mValue);
+    unsigned k = FindKey(keys, count, time);
+    const aiQuatKey& a = keys[k];
+    const aiQuatKey& b = keys[k + 1];
+    float t = (float) ((time - a.mTime) / std::max(b.mTime - a.mTime, 1e-9));
+    return glm::slerp(q(a.mValue), q(b.mValue), t);
+}
+
+static void ImportAnimation(SkeletalAnimation* out, const aiAnimation* anim, const Skeleton& skel) {
+    double ticks = anim->mTicksPerSecond > 0.0 ? anim->mTicksPerSecond : 25.0;
+    out->name = anim->mName.C_Str();
+    out->duration = (float) std::max(anim->mDuration / ticks, 1.0 / SKIN_SAMPLE_RATE);
+    out->numFrames = (size_t) ceilf(out->duration * SKIN_SAMPLE_RATE) + 1;
+
+    size_t numJoints = skel.names.size(), groups = JointGroups(numJoints);
+    std::unordered_map<std::string, const aiNodeAnim*> channels;
+    for (unsigned i = 0; i < anim->mNumChannels; ++i) channels[anim->mChannels[i]->mNodeName.C_Str()] = anim->mChannels[i];
+
+    ResetJointGroups(&out->frames, out->numFrames * groups);
+    for (size_t j = 0; j < numJoints; ++j) {
+        const JointPose4& g = skel.bindPose[j / 4];
+        size_t l = j % 4;
+        glm::vec3 bt { g.tx[l], g.ty[l], g.tz[l] };
+        glm::quat br { g.rw[l], g.rx[l], g.ry[l], g.rz[l] };
+        glm::vec3 bs { g.sx[l], g.sy[l], g.sz[l] };
+        auto it = channels.find(skel.names[j]);
+        const aiNodeAnim* ch = it != channels.end() ? it->second : nullptr;
+        for (size_t f = 0; f < out->numFrames; ++f) {
+            double time = std::min((double) f / SKIN_SAMPLE_RATE, (double) out->duration) * ticks;
+            glm::vec3 t = ch && ch->mNumPositionKeys ? SampleVectorKeys(ch->mPositionKeys, ch->mNumPositionKeys, time) : bt;
+            glm::quat r = ch && ch->mNumRotationKeys ? SampleQuatKeys(ch->mRotationKeys, ch->mNumRotationKeys, time) : br;
+            glm::vec3 s = ch && ch->mNumScalingKeys ? SampleVectorKeys(ch->mScalingKeys, ch->mNumScalingKeys, time) : bs;
+            SetJoint(&out->frames[f * groups], j, t, r, s);
+        }
+    }
+}
+
+// Welding and tangent generation only move and copy vertices within a
+// submesh, and every format keeps influences per position, so the influence
+// stream is re-attached by exact position afterwards.
+struct PositionKey {
+    uint32_t bits[3];
+    bool operator==(const PositionKey& o) const { return memcmp(bits, o.bits, sizeof(bits)) == 0; }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& k) const {
+        uint64_t h = 14695981039346656037ull;
+        for (uint32_t v : k.bits) h = (h ^ v) * 1099511628211ull;
+        return (size_t) h;
+    }
+};
+
+static PositionKey MakePositionKey(const glm::vec3& pos) {
+    PositionKey key;
+    memcpy(key.bits, &pos.x, sizeof(key.bits));
+    return key;
+}
+
+bool LoadSkeletalMesh(SkeletalMesh* mesh, const char* path, const PackFile* pack) {
+    using namespace Assimp;
+    Importer imp {};
+    imp.SetIOHandler(new MappedIOSystem(pack));
+
+    const aiScene* as = imp.ReadFile(path,
+        aiProcess_Triangulate | aiProcess_SortByPType);
+    if (!as || !as->mRootNode) {
+        printf("%s: %s\n", path, imp.GetErrorString());
+        return false;
+    }
+
+    std::vector<SceneMeshSource> sources;
+    if (!ImportSceneMeshes(&mesh->mesh, as, path, &sources)) return false;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    SkeletonBuilder b;
+    for (const SceneMeshSource& src : sources) {
+        b.needed.insert(src.node->mName.C_Str());
+        for (unsigned i = 0; i < src.mesh->mNumBones; ++i) b.needed.insert(src.mesh->mBones[i]->mName.C_Str());
+    }
+    for (unsigned a = 0; a < as->mNumAnimations; ++a) {
+        for (unsigned i = 0; i < as->mAnimations[a]->mNumChannels; ++i) b.needed.insert(as->mAnimations[a]->mChannels[i]->mNodeName.C_Str());
+    }
+    MarkJoints(&b, as->mRootNode);
+
+    Skeleton& skel = mesh->skeleton;
+    skel = Skeleton {};
+    FlattenJoints(&b, &skel, as->mRootNode, -1, aiMatrix4x4 {});
+    size_t numJoints = skel.names.size();
+    if (numJoints > MAX_SKIN_JOINTS) {
+        printf("%s: %zu joints, at most %zu are supported\n", path, numJoints, MAX_SKIN_JOINTS);
+        return false;
+    }
+    std::unordered_map<std::string, uint32_t> byName;
+    for (const auto& j : b.joints) byName.emplace(j.first->mName.C_Str(), j.second);
+
+    ResetJointGroups(&skel.bindPose, JointGroups(numJoints));
+    for (const auto& j : b.joints) {
+        aiVector3D s, t;
+        aiQuaternion r;
+        j.first->mTransformation.Decompose(s, r, t);
+        SetJoint(skel.bindPose.data(), j.second, glm::vec3 { t.x, t.y, t.z }, glm::normalize(glm::quat { r.w, r.x, r.y, r.z }),
+                 glm::vec3 { s.x, s.y, s.z });
+    }
+
+    // Vertices have their node's transform baked in, while bone offsets map
+    // from the mesh's own space; fold the difference into the inverse bind.
+    // The first mesh to name a bone decides its offset.
+    std::vector<uint8_t> fromBone(numJoints, 0);
+    std::vector<SkinWeights> skin(mesh->mesh.vertices.size());
+    size_t weighted = 0;
+    for (size_t s = 0; s < sources.size(); ++s) {
+        const aiMesh* m = sources[s].mesh;
+        uint32_t rigid = b.joints.at(sources[s].node);
+        aiMatrix4x4 unbake = b.globals[rigid];
+        unbake.Inverse();
+
+        std::vector<InfluenceSet> sets(m->mNumVertices, InfluenceSet { { 0.0f, 0.0f, 0.0f, 0.0f }, { 0, 0, 0, 0 } });
+        for (unsigned i = 0; i < m->mNumBones; ++i) {
+            const aiBone* bone = m->mBones[i];
+            auto it = byName.find(bone->mName.C_Str());
+            if (it == byName.end()) continue;
+            if (!fromBone[it->second]) {
+                skel.inverseBinds[it->second] = ToGlm(bone->mOffsetMatrix * unbake);
+                fromBone[it->second] = 1;
+            }
+            for (unsigned w = 0; w < bone->mNumWeights; ++w) {
+                const aiVertexWeight& vw = bone->mWeights[w];
+                if (vw.mVertexId < m->mNumVertices) sets[vw.mVertexId].Add(it->second, vw.mWeight);
+            }
+        }
+        SkinWeights* dst = skin.data() + mesh->mesh.submeshes[s].baseVertex;
+        for (unsigned v = 0; v < m->mNumVertices; ++v) {
+            dst[v] = QuantizeInfluences(sets[v], rigid);
+            weighted += sets[v].weights[0] > 0.0f;
+        }
+    }
+
+    std::vector<std::unordered_map<PositionKey, SkinWeights, PositionKeyHash>> byPosition(sources.size());
+    for (size_t s = 0; s < sources.size(); ++s) {
+        const StaticSubmesh& sub = mesh->mesh.submeshes[s];
+        for (GLuint v = 0; v < sub.numVertices; ++v) {
+            byPosition[s].emplace(MakePositionKey(mesh->mesh.vertices[sub.baseVertex + v].pos), skin[sub.baseVertex + v]);
+        }
+    }
+
+    WeldStaticMesh(&mesh->mesh, WELD_EPSILON);
+    GenerateStaticMeshTangents(&mesh->mesh);
+
+    mesh->skin.resize(mesh->mesh.vertices.size());
+    for (size_t s = 0; s < sources.size(); ++s) {
+        const StaticSubmesh& sub = mesh->mesh.submeshes[s];
+        for (GLuint v = 0; v < sub.numVertices; ++v) {
+            mesh->skin[sub.baseVertex + v] = byPosition[s].at(MakePositionKey(mesh->mesh.vertices[sub.baseVertex + v].pos));
+        }
+    }
+
+    mesh->animations.clear();
+    mesh->animations.resize(as->mNumAnimations);
+    for (unsigned a = 0; a < as->mNumAnimations; ++a) ImportAnimation(&mesh->animations[a], as->mAnimations[a], skel);
+
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    printf("%s: %zu joints, %zu weighted verts, %zu animations imported in %.2f ms\n", path, numJoints, weighted,
+           mesh->animations.size(), dur.count());
+    for (const SkeletalAnimation& anim : mesh->animations) {
+        printf("  %s: %.2f s, %zu frames\n", anim.name.c_str(), anim.duration, anim.numFrames);
+    }
+    return true;
+}
+
+void MakeSkinStressMesh(SkeletalMesh* mesh, size_t rings, size_t segments, size_t joints) {
+    const float PI = 3.14159265f;
+    const float HEIGHT = 2.0f, RADIUS = 0.2f, DURATION = 2.0f;
+    rings = std::max<size_t>(rings, 1);
+    segments = std::max<size_t>(segments, 3);
+    joints = std::clamp<size_t>(joints, 1, MAX_SKIN_JOINTS);
+    float bone = HEIGHT / (float) joints;
+
+    StaticMesh& m = mesh->mesh;
+    m = StaticMesh {};
+    mesh->skin.clear();
+    for (size_t r = 0; r <= rings; ++r) {
+        float y = HEIGHT * (float) r / (float) rings;
+        InfluenceSet set { { 0.0f, 0.0f, 0.0f, 0.0f }, { 0, 0, 0, 0 } };
+        for (size_t j = 0; j < joints; ++j) {
+            // Each joint owns the section above it, fading out over one and a
+            // half sections either side of its middle.
+            float d = fabsf(y - ((float) j + 0.5f) * bone) / (1.5f * bone);
+            set.Add((uint32_t) j, std::max(0.0f, 1.0f - d));
+        }
+        SkinWeights w = QuantizeInfluences(set, 0);
+        for (size_t s = 0; s <= segments; ++s) {
+            float a = 2.0f * PI * (float) s / (float) segments;
+            glm::vec3 n { cosf(a), 0.0f, -sinf(a) };
+            GlStaticMeshVert v;
+            v.pos = glm::vec3 { n.x * RADIUS, y, n.z * RADIUS };
+            v.norm = n;
+            v.tang = glm::vec4 { -sinf(a), 0.0f, -cosf(a), 1.0f };
+            v.coord = glm::vec2 { (float) s / (float) segments, (float) r / (float) rings };
+            m.vertices.push_back(v);
+            mesh->skin.push_back(w);
+        }
+    }
+    for (size_t r = 0; r < rings; ++r) {
+        for (size_t s = 0; s < segments; ++s) {
+            GLuint i0 = (GLuint) (r * (segments + 1) + s), i1 = i0 + 1;
+            GLuint i2 = i0 + (GLuint) (segments + 1), i3 = i2 + 1;
+            m.indices.insert(m.indices.end(), { i0, i1, i2, i2, i1, i3 });
+        }
+    }
+    m.submeshes.push_back(StaticSubmesh { 0, (GLuint) m.vertices.size(), 0, (GLuint) m.indices.size(), 0 });
+
+    Skeleton& skel = mesh->skeleton;
+    skel = Skeleton {};
+    ResetJointGroups(&skel.bindPose, JointGroups(joints));
+    for (size_t j = 0; j < joints; ++j) {
+        skel.names.push_back("joint" + std::to_string(j));
+        skel.parents.push_back((int32_t) j - 1);
+        skel.inverseBinds.push_back(glm::translate(glm::mat4(1.0f), glm::vec3 { 0.0f, -bone * (float) j, 0.0f }));
+        SetJoint(skel.bindPose.data(), j, glm::vec3 { 0.0f, j ? bone : 0.0f, 0.0f }, glm::quat { 1.0f, 0.0f, 0.0f, 0.0f }, glm::vec3 { 1.0f });
+    }
+
+    // A travelling wave of bends, stronger towards the tip, that loops.
+    mesh->animations.clear();
+    mesh->animations.resize(1);
+    SkeletalAnimation& anim = mesh->animations[0];
+    anim.name = "whip";
+    anim.duration = DURATION;
+    anim.numFrames = (size_t) ceilf(DURATION * SKIN_SAMPLE_RATE) + 1;
+    size_t groups = JointGroups(joints);
+    ResetJointGroups(&anim.frames, anim.numFrames * groups);
+    for (size_t f = 0; f < anim.numFrames; ++f) {
+        float phase = 2.0f * PI * (float) f / (float) (anim.numFrames - 1);
+        for (size_t j = 0; j < joints; ++j) {
+            float amp = 0.15f + 0.35f * (float) j / (float) joints;
+            glm::quat r = glm::angleAxis(amp * sinf(phase - 0.7f * (float) j), glm::vec3 { 0.0f, 0.0f, 1.0f })
+                        * glm::angleAxis(0.6f * amp * cosf(phase - 0.5f * (float) j), glm::vec3 { 1.0f, 0.0f, 0.0f });
+            SetJoint(&anim.frames[f * groups], j, glm::vec3 { 0.0f, j ? bone : 0.0f, 0.0f }, r, glm::vec3 { 1.0f });
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+#include "static_mesh.hpp"
+
+struct PackFile;
+
+// Joint indices are stored in a byte.
+static constexpr size_t MAX_SKIN_JOINTS = 256;
+
+// Keyframes are resampled to this rate on import, so sampling at runtime is
+// two frame lookups and a blend for every joint at once, whatever the
+// source's key layout.
+static constexpr float SKIN_SAMPLE_RATE = 30.0f;
+
+// The four strongest influences of one vertex. Weights are unorm8 summing to
+// exactly 255; unused influences have weight 0.
+struct SkinWeights {
+    uint8_t joints[4];
+    uint8_t weights[4];
+};
+
+// Local transforms of four consecutive joints, component-major, so four
+// joints blend with one pass of 4-wide arithmetic. Padding joints past the
+// end of the skeleton are identity.
+struct alignas(16) JointPose4 {
+    float tx[4], ty[4], tz[4];
+    float rx[4], ry[4], rz[4], rw[4];
+    float sx[4], sy[4], sz[4];
+};
+
+static inline size_t JointGroups(size_t numJoints) {
+    return (numJoints + 3) / 4;
+}
+
+// Joints are ordered parents first, so a pose resolves in one forward pass.
+struct Skeleton {
+    std::vector<std::string> names;
+    std::vector<int32_t>     parents;       // -1 for roots
+    std::vector<glm::mat4>   inverseBinds;  // mesh space to joint space at bind time
+    std::vector<JointPose4>  bindPose;      // JointGroups(names.size()) groups
+};
+
+// A clip resampled at SKIN_SAMPLE_RATE; joints without a channel hold their
+// bind pose.
+struct SkeletalAnimation {
+    std::string             name;
+    float                   duration;       // seconds
+    size_t                  numFrames;
+    std::vector<JointPose4> frames;         // frames[frame * JointGroups(numJoints) + group]
+};
+
+// A StaticMesh in bind pose with an influence stream parallel to its
+// vertices. Vertices of meshes without bones are bound rigidly to the joint
+// of the node that places them, so node animation moves them too.
+struct SkeletalMesh {
+    StaticMesh                     mesh;
+    std::vector<SkinWeights>       skin;
+    Skeleton                       skeleton;
+    std::vector<SkeletalAnimation> animations;
+};
+
+// Imports the meshes the way LoadStaticMesh does, plus aiMesh::mBones and
+// aiScene::mAnimations. The skeleton keeps only nodes that are bones,
+// animated, or place a mesh, and their ancestors.
+bool LoadSkeletalMesh(SkeletalMesh* mesh, const char* path, const PackFile* pack = nullptr);
+
+// An open tube of rings x segments quads along +y, bound to a chain of
+// joints with up to four influences per vertex, and one looping clip that
+// whips it around. Stands in for animated content in the skinning modes.
+void MakeSkinStressMesh(SkeletalMesh* mesh, size_t rings, size_t segments, size_t joints);
@@ -0,0 +1,387 @@
+#include "skinning.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SKINNING_SSE 1
+#endif
+
+// The AVX2 skinner is compiled on every x86 target and picked at runtime,
+// so builds without /arch:AVX2 still use it on CPUs that have it.
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define SKINNING_AVX2 1
+#define SKINNING_AVX2_TARGET
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SKINNING_AVX2 1
+#define SKINNING_AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+
+#include "parallel.hpp"
+
+static const size_t ANIMATE_GRAIN = 16;
+static const size_t SKIN_GRAIN = 1 << 14;
+
+// Frames to blend at time, looping over the clip.
+static void FindFrames(const SkeletalAnimation& anim, float time, size_t* k0, size_t* k1, float* alpha) {
+    float t = fmodf(time, anim.duration);
+    if (t < 0.0f) t += anim.duration;
+    float f = t * SKIN_SAMPLE_RATE;
+    size_t k = (size_t) f;
+    if (k + 1 >= anim.numFrames) {
+        *k0 = *k1 = anim.numFrames - 1;
+        *alpha = 0.0f;
+        return;
+    }
+    *k0 = k;
+    *k1 = k + 1;
+    *alpha = f - (float) k;
+}
+
+void SampleAnimationScalar(JointPose4* pose, const SkeletalAnimation& anim, size_t numJoints, float time) {
+    size_t groups = JointGroups(numJoints), k0, k1;
+    float a;
+    FindFrames(anim, time, &k0, &k1, &a);
+    const JointPose4* f0 = &anim.frames[k0 * groups];
+    const JointPose4* f1 = &anim.frames[k1 * groups];
+    for (size_t g = 0; g < groups; ++g) {
+        const JointPose4& p = f0[g];
+        const JointPose4& q = f1[g];
+        JointPose4& out = pose[g];
+        for (int l = 0; l < 4; ++l) {
+            glm::vec3 t = glm::mix(glm::vec3 { p.tx[l], p.ty[l], p.tz[l] }, glm::vec3 { q.tx[l], q.ty[l], q.tz[l] }, a);
+            glm::vec3 s = glm::mix(glm::vec3 { p.sx[l], p.sy[l], p.sz[l] }, glm::vec3 { q.sx[l], q.sy[l], q.sz[l] }, a);
+            glm::quat r = glm::slerp(glm::quat { p.rw[l], p.rx[l], p.ry[l], p.rz[l] }, glm::quat { q.rw[l], q.rx[l], q.ry[l], q.rz[l] }, a);
+            out.tx[l] = t.x; out.ty[l] = t.y; out.tz[l] = t.z;
+            out.rx[l] = r.x; out.ry[l] = r.y; out.rz[l] = r.z; out.rw[l] = r.w;
+            out.sx[l] = s.x; out.sy[l] = s.y; out.sz[l] = s.z;
+        }
+    }
+}
+
+#ifdef SKINNING_SSE
+
+// Eberly, "A Fast and Accurate Algorithm for Computing SLERP": the slerp
+// weights sin(t a) / sin(a) as a polynomial in cos(a) - 1, truncated after
+// eight terms with the last one scaled by mu to spread the truncation error.
+static const int   SLERP_TERMS = 8;
+static const float SLERP_MU    = 1.85298109240830f;
+
+static inline __m128 Lerp4(const float* a, const float* b, __m128 t) {
+    __m128 va = _mm_load_ps(a);
+    return _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b), va), t));
+}
+
+void SampleAnimation(JointPose4* pose, const SkeletalAnimation& anim, size_t numJoints, float time) {
+    size_t groups = JointGroups(numJoints), k0, k1;
+    float a;
+    FindFrames(anim, time, &k0, &k1, &a);
+    const JointPose4* f0 = &anim.frames[k0 * groups];
+    const JointPose4* f1 = &anim.frames[k1 * groups];
+
+    // Every joint blends with the same t, so the polynomial's coefficients
+    // are scalars; only the powers of cos(a) - 1 are per joint.
+    float ct[SLERP_TERMS], cd[SLERP_TERMS];
+    float d = 1.0f - a;
+    for (int i = 0; i < SLERP_TERMS; ++i) {
+        float n = (float) (i + 1);
+        float u = 1.0f / (n * (2.0f * n + 1.0f)), v = n / (2.0f * n + 1.0f);
+        if (i == SLERP_TERMS - 1) {
+            u *= SLERP_MU;
+            v *= SLERP_MU;
+        }
+        ct[i] = u * a * a - v;
+        cd[i] = u * d * d - v;
+    }
+
+    const __m128 t = _mm_set1_ps(a), one = _mm_set1_ps(1.0f);
+    const __m128 signbit = _mm_set1_ps(-0.0f);
+    for (size_t g = 0; g < groups; ++g) {
+        const JointPose4& p = f0[g];
+        const JointPose4& q = f1[g];
+        JointPose4& out = pose[g];
+        _mm_store_ps(out.tx, Lerp4(p.tx, q.tx, t));
+        _mm_store_ps(out.ty, Lerp4(p.ty, q.ty, t));
+        _mm_store_ps(out.tz, Lerp4(p.tz, q.tz, t));
+        _mm_store_ps(out.sx, Lerp4(p.sx, q.sx, t));
+        _mm_store_ps(out.sy, Lerp4(p.sy, q.sy, t));
+        _mm_store_ps(out.sz, Lerp4(p.sz, q.sz, t));
+
+        __m128 x0 = _mm_load_ps(p.rx), y0 = _mm_load_ps(p.ry), z0 = _mm_load_ps(p.rz), w0 = _mm_load_ps(p.rw);
+        __m128 x1 = _mm_load_ps(q.rx), y1 = _mm_load_ps(q.ry), z1 = _mm_load_ps(q.rz), w1 = _mm_load_ps(q.rw);
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, x1), _mm_mul_ps(y0, y1)),
+                                _mm_add_ps(_mm_mul_ps(z0, z1), _mm_mul_ps(w0, w1)));
+        // Take the short way round: flip q1 where the dot is negative.
+        __m128 sign = _mm_and_ps(dot, signbit);
+        x1 = _mm_xor_ps(x1, sign);
+        y1 = _mm_xor_ps(y1, sign);
+        z1 = _mm_xor_ps(z1, sign);
+        w1 = _mm_xor_ps(w1, sign);
+        __m128 xm1 = _mm_sub_ps(_mm_xor_ps(dot, sign), one);
+
+        __m128 wt = one, wd = one;
+        for (int i = SLERP_TERMS - 1; i >= 0; --i) {
+            wt = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(ct[i]), xm1), wt));
+            wd = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(cd[i]), xm1), wd));
+        }
+        wt = _mm_mul_ps(wt, t);
+        wd = _mm_mul_ps(wd, _mm_set1_ps(d));
+
+        __m128 rx = _mm_add_ps(_mm_mul_ps(x0, wd), _mm_mul_ps(x1, wt));
+        __m128 ry = _mm_add_ps(_mm_mul_ps(y0, wd), _mm_mul_ps(y1, wt));
+        __m128 rz = _mm_add_ps(_mm_mul_ps(z0, wd), _mm_mul_ps(z1, wt));
+        __m128 rw = _mm_add_ps(_mm_mul_ps(w0, wd), _mm_mul_ps(w1, wt));
+        __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)),
+                                            _mm_add_ps(_mm_mul_ps(rz, rz), _mm_mul_ps(rw, rw))));
+        __m128 inv = _mm_div_ps(one, len);
+        _mm_store_ps(out.rx, _mm_mul_ps(rx, inv));
+        _mm_store_ps(out.ry, _mm_mul_ps(ry, inv));
+        _mm_store_ps(out.rz, _mm_mul_ps(rz, inv));
+        _mm_store_ps(out.rw, _mm_mul_ps(rw, inv));
+    }
+}
+
+#else
+
+void SampleAnimation(JointPose4* pose, const SkeletalAnimation& anim, size_t numJoints, float time) {
+    SampleAnimationScalar(pose, anim, numJoints, time);
+}
+
+#endif
+
+void ComputeSkinPalette(glm::mat4* palette, glm::mat4* globals, const Skeleton& skel, const JointPose4* pose) {
+    size_t numJoints = skel.parents.size();
+    for (size_t j = 0; j < numJoints; ++j) {
+        const JointPose4& g = pose[j / 4];
+        size_t l = j % 4;
+        float x = g.rx[l], y = g.ry[l], z = g.rz[l], w = g.rw[l];
+        glm::mat4 local {
+            (1.0f - 2.0f * (y * y + z * z)) * g.sx[l], 2.0f * (x * y + w * z) * g.sx[l], 2.0f * (x * z - w * y) * g.sx[l], 0.0f,
+            2.0f * (x * y - w * z) * g.sy[l], (1.0f - 2.0f * (x * x + z * z)) * g.sy[l], 2.0f * (y * z + w * x) * g.sy[l], 0.0f,
+            2.0f * (x * z + w * y) * g.sz[l], 2.0f * (y * z - w * x) * g.sz[l], (1.0f - 2.0f * (x * x + y * y)) * g.sz[l], 0.0f,
+            g.tx[l], g.ty[l], g.tz[l], 1.0f,
+        };
+        int32_t parent = skel.parents[j];
+        globals[j] = parent < 0 ? local : globals[parent] * local;
+        palette[j] = globals[j] * skel.inverseBinds[j];
+    }
+}
+
+void AnimateInstances(glm::mat4* palettes, const SkeletalMesh& mesh, const SkeletalAnimation& anim, const float* times, size_t count) {
+    size_t numJoints = mesh.skeleton.parents.size();
+    ParallelFor(count, ANIMATE_GRAIN, [&](size_t begin, size_t end) {
+        std::vector<JointPose4> pose(JointGroups(numJoints));
+        std::vector<glm::mat4> globals(numJoints);
+        for (size_t i = begin; i < end; ++i) {
+            SampleAnimation(pose.data(), anim, numJoints, times[i]);
+            ComputeSkinPalette(palettes + i * numJoints, globals.data(), mesh.skeleton, pose.data());
+        }
+    });
+}
+
+static inline glm::vec3 SafeNormalize(glm::vec3 v) {
+    float len = glm::length(v);
+    return len > 0.0f ? v / len : v;
+}
+
+void SkinVerticesScalar(GlStaticMeshVert* dst, const GlStaticMeshVert* bind, const SkinWeights* skin, const glm::mat4* palette,
+                        size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        const SkinWeights& s = skin[i];
+        glm::mat4 m = palette[s.joints[0]] * (s.weights[0] * (1.0f / 255.0f));
+        for (int k = 1; k < 4; ++k) m += palette[s.joints[k]] * (s.weights[k] * (1.0f / 255.0f));
+        const GlStaticMeshVert& v = bind[i];
+        GlStaticMeshVert out;
+        out.pos = glm::vec3(m * glm::vec4(v.pos, 1.0f));
+        out.norm = SafeNormalize(glm::vec3(m * glm::vec4(v.norm, 0.0f)));
+        out.tang = glm::vec4(SafeNormalize(glm::vec3(m * glm::vec4(glm::vec3(v.tang), 0.0f))), v.tang.w);
+        out.coord = v.coord;
+        dst[i] = out;
+    }
+}
+
+#ifdef SKINNING_AVX2
+
+static bool DetectAvx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool fma = (info[2] & (1 << 12)) != 0, osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+    if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+static const bool HAS_AVX2 = DetectAvx2();
+
+SKINNING_AVX2_TARGET
+static inline __m128 Sum256(__m256 v) {
+    return _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+}
+
+SKINNING_AVX2_TARGET
+static inline __m128 Normalize3(__m128 v) {
+    __m128 len2 = _mm_max_ps(_mm_dp_ps(v, v, 0x7F), _mm_set1_ps(1e-30f));
+    return _mm_div_ps(v, _mm_sqrt_ps(len2));
+}
+
+// One vertex at a time: a column-major mat4 is two 256-bit halves, so the
+// four weighted matrices blend in eight FMAs, and each transformed vector is
+// the sum of the two halves scaled by its (x, y) and (z, w) components.
+SKINNING_AVX2_TARGET
+static void SkinVerticesAvx2(GlStaticMeshVert* dst, const GlStaticMeshVert* bind, const SkinWeights* skin, const glm::mat4* palette,
+                             size_t begin, size_t end) {
+    static_assert(sizeof(GlStaticMeshVert) == 12 * sizeof(float), "GlStaticMeshVert must be 12 packed floats");
+    const float* pal = &palette[0][0][0];
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    for (size_t i = begin; i < end; ++i) {
+        const SkinWeights& s = skin[i];
+        __m256 c01 = _mm256_setzero_ps(), c23 = _mm256_setzero_ps();
+        for (int k = 0; k < 4; ++k) {
+            const float* m = pal + s.joints[k] * 16;
+            __m256 w = _mm256_set1_ps(s.weights[k] * (1.0f / 255.0f));
+            c01 = _mm256_fmadd_ps(_mm256_loadu_ps(m), w, c01);
+            c23 = _mm256_fmadd_ps(_mm256_loadu_ps(m + 8), w, c23);
+        }
+
+        // [px py pz nx] [ny nz tx ty] [tz tw u v]
+        const float* b = &bind[i].pos.x;
+        __m128 v0 = _mm_loadu_ps(b), v1 = _mm_loadu_ps(b + 4), v2 = _mm_loadu_ps(b + 8);
+        __m128 pos = Sum256(_mm256_fmadd_ps(c01, _mm256_set_m128(_mm_shuffle_ps(v0, v0, 0x55), _mm_shuffle_ps(v0, v0, 0x00)),
+                                            _mm256_mul_ps(c23, _mm256_set_m128(one, _mm_shuffle_ps(v0, v0, 0xAA)))));
+        __m128 norm = Sum256(_mm256_fmadd_ps(c01, _mm256_set_m128(_mm_shuffle_ps(v1, v1, 0x00), _mm_shuffle_ps(v0, v0, 0xFF)),
+                                             _mm256_mul_ps(c23, _mm256_set_m128(zero, _mm_shuffle_ps(v1, v1, 0x55)))));
+        __m128 tang = Sum256(_mm256_fmadd_ps(c01, _mm256_set_m128(_mm_shuffle_ps(v1, v1, 0xFF), _mm_shuffle_ps(v1, v1, 0xAA)),
+                                             _mm256_mul_ps(c23, _mm256_set_m128(zero, _mm_shuffle_ps(v2, v2, 0x00)))));
+        norm = Normalize3(norm);
+        tang = Normalize3(tang);
+
+        float* o = &dst[i].pos.x;
+        _mm_storeu_ps(o + 0, _mm_blend_ps(pos, _mm_shuffle_ps(norm, norm, 0x00), 0x8));
+        _mm_storeu_ps(o + 4, _mm_shuffle_ps(norm, tang, _MM_SHUFFLE(1, 0, 2, 1)));
+        _mm_storeu_ps(o + 8, _mm_blend_ps(v2, _mm_shuffle_ps(tang, tang, 0xAA), 0x1));
+    }
+}
+
+bool SkinningUsesAvx2() {
+    return HAS_AVX2;
+}
+
+void SkinVertices(GlStaticMeshVert* dst, const GlStaticMeshVert* bind, const SkinWeights* skin, const glm::mat4* palette,
+                  size_t begin, size_t end) {
+    if (HAS_AVX2) SkinVerticesAvx2(dst, bind, skin, palette, begin, end);
+    else SkinVerticesScalar(dst, bind, skin, palette, begin, end);
+}
+
+#else
+
+bool SkinningUsesAvx2() {
+    return false;
+}
+
+void SkinVertices(GlStaticMeshVert* dst, const GlStaticMeshVert* bind, const SkinWeights* skin, const glm::mat4* palette,
+                  size_t begin, size_t end) {
+    SkinVerticesScalar(dst, bind, skin, palette, begin, end);
+}
+
+#endif
+
+using SkinFn = void(GlStaticMeshVert*, const GlStaticMeshVert*, const SkinWeights*, const glm::mat4*, size_t, size_t);
+
+// Spreads count copies of the mesh over threads as one flat range of
+// vertices, so a few large copies balance as well as many small ones.
+static void SkinAll(SkinFn* fn, GlStaticMeshVert* dst, const SkeletalMesh& mesh, const glm::mat4* palettes, size_t count, size_t grain) {
+    size_t numVerts = mesh.mesh.vertices.size(), numJoints = mesh.skeleton.parents.size();
+    if (numVerts == 0) return;
+    ParallelFor(count * numVerts, grain, [&](size_t begin, size_t end) {
+        while (begin < end) {
+            size_t inst = begin / numVerts, v = begin % numVerts;
+            size_t run = std::min(end - begin, numVerts - v);
+            fn(dst + inst * numVerts, mesh.mesh.vertices.data(), mesh.skin.data(), palettes + inst * numJoints, v, v + run);
+            begin += run;
+        }
+    });
+}
+
+void SkinInstances(GlStaticMeshVert* dst, const SkeletalMesh& mesh, const glm::mat4* palettes, size_t count) {
+    SkinAll(SkinVertices, dst, mesh, palettes, count, SKIN_GRAIN);
+}
+
+static double Seconds(std::chrono::high_resolution_clock::time_point since) {
+    std::chrono::duration<double> dur = std::chrono::high_resolution_clock::now() - since;
+    return dur.count();
+}
+
+void BenchmarkSkinning(const SkeletalMesh& mesh, size_t instances) {
+    if (mesh.animations.empty() || mesh.mesh.vertices.empty()) {
+        printf("skinning: nothing to animate\n");
+        return;
+    }
+    const SkeletalAnimation& anim = mesh.animations[0];
+    size_t numVerts = mesh.mesh.vertices.size(), numJoints = mesh.skeleton.parents.size();
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    printf("skinning: %zu verts, %zu joints, %zu instances, %zu cores, %s\n", numVerts, numJoints, instances, threads,
+           SkinningUsesAvx2() ? "avx2" : "no avx2");
+
+    size_t groups = JointGroups(numJoints);
+    std::vector<JointPose4> fast(groups), ref(groups);
+    std::vector<float> times(instances);
+    for (size_t i = 0; i < instances; ++i) times[i] = fmodf(i * 0.618034f, 1.0f) * anim.duration;
+    std::vector<glm::mat4> palettes(instances * numJoints);
+    double best = 1e30, bestsimd = 1e30, bestscalar = 1e30;
+    for (int rep = 0; rep < 5; ++rep) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < instances; ++i) SampleAnimation(fast.data(), anim, numJoints, times[i]);
+        bestsimd = std::min(bestsimd, Seconds(start));
+        start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < instances; ++i) SampleAnimationScalar(ref.data(), anim, numJoints, times[i]);
+        bestscalar = std::min(bestscalar, Seconds(start));
+        start = std::chrono::high_resolution_clock::now();
+        AnimateInstances(palettes.data(), mesh, anim, times.data(), instances);
+        best = std::min(best, Seconds(start));
+    }
+    printf("  sampling, 1 thread: simd %.3f ms/frame, scalar %.3f ms/frame; sample + palette, threaded: %.3f ms/frame\n",
+           bestsimd * 1e3, bestscalar * 1e3, best * 1e3);
+
+    size_t total = numVerts * instances;
+    std::vector<GlStaticMeshVert> skinned(total);
+    struct Run {
+        const char* name;
+        SkinFn*     fn;
+        size_t      grain;
+        size_t      cores;
+    };
+    const Run runs[] = {
+        { "scalar, 1 thread", SkinVerticesScalar, total,      1 },
+        { "simd, 1 thread",   SkinVertices,       total,      1 },
+        { "scalar, threaded", SkinVerticesScalar, SKIN_GRAIN, threads },
+        { "simd, threaded",   SkinVertices,       SKIN_GRAIN, threads },
+    };
+    for (const Run& run : runs) {
+        best = 1e30;
+        for (int rep = 0; rep < 5; ++rep) {
+            auto start = std::chrono::high_resolution_clock::now();
+            SkinAll(run.fn, skinned.data(), mesh, palettes.data(), instances, run.grain);
+            best = std::min(best, Seconds(start));
+        }
+        double rate = total / best;
+        printf("  %-17s %8.2f ms/frame  %8.1f Mverts/s  %8.1f Mverts/s/core\n",
+               run.name, best * 1e3, rate * 1e-6, rate * 1e-6 / run.cores);
+    }
+}
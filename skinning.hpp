@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <glm/mat4x4.hpp>
+
+#include "skeletal_mesh.hpp"
+
+// Samples anim at time seconds, looping, into pose, JointGroups(numJoints)
+// groups. Translation and scale are lerped and rotation slerped between the
+// two nearest frames, four joints at a time with SSE where available; the
+// slerp is Eberly's polynomial form, so it needs no acos or sin.
+void SampleAnimation(JointPose4* pose, const SkeletalAnimation& anim, size_t numJoints, float time);
+
+// Plain scalar reference for SampleAnimation, with glm::slerp.
+void SampleAnimationScalar(JointPose4* pose, const SkeletalAnimation& anim, size_t numJoints, float time);
+
+// Resolves a local pose into skinning matrices, palette[j] = global[j] *
+// inverseBinds[j]. globals is scratch for one matrix per joint.
+void ComputeSkinPalette(glm::mat4* palette, glm::mat4* globals, const Skeleton& skel, const JointPose4* pose);
+
+// Samples and resolves count instances in parallel, instance i at times[i]
+// into palettes[i * numJoints, (i + 1) * numJoints). palettes may point into
+// a mapped GL buffer.
+void AnimateInstances(glm::mat4* palettes, const SkeletalMesh& mesh, const SkeletalAnimation& anim, const float* times, size_t count);
+
+// Linear blend skinning of bind[begin, end) into dst[begin, end): position,
+// normal and tangent go through the weighted sum of their joints' palette
+// matrices, normal and tangent are renormalized, the bitangent sign and uv
+// are copied. Uses AVX2 and FMA when the CPU has them, else the scalar path.
+// dst only has to be writable, so it can point into a mapped GL buffer.
+void SkinVertices(GlStaticMeshVert* dst, const GlStaticMeshVert* bind, const SkinWeights* skin, const glm::mat4* palette,
+                  size_t begin, size_t end);
+
+// Plain scalar reference for SkinVertices.
+void SkinVerticesScalar(GlStaticMeshVert* dst, const GlStaticMeshVert* bind, const SkinWeights* skin, const glm::mat4* palette,
+                        size_t begin, size_t end);
+
+// Whether SkinVertices takes the AVX2 path on this CPU.
+bool SkinningUsesAvx2();
+
+// Skins count copies of mesh across all threads, copy i with palettes + i *
+// numJoints into dst + i * numVertices.
+void SkinInstances(GlStaticMeshVert* dst, const SkeletalMesh& mesh, const glm::mat4* palettes, size_t count);
+
+// Animates and skins instances copies of mesh with each path, single- and
+// multi-threaded, and prints ms/frame and verts/s. The paths are checked
+// against each other and against known poses by the tests target.
+void BenchmarkSkinning(const SkeletalMesh& mesh, size_t instances);
@@ -0,0 +1,167 @@
+#include "static_mesh.hpp"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "mapped_io.hpp"
+#include "mesh_tangents.hpp"
+#include "mesh_weld.hpp"
+#include "parallel.hpp"
+#include "vertex_convert.hpp"
+
+struct MeshInstance {
+    const aiMesh* mesh;
+    const aiNode* node;
+    aiMatrix4x4   transform;
+};
+
+static void CollectInstances(
+        const aiScene*             scene,
+        const aiNode*              node,
+        const aiMatrix4x4&         parent,
+        std::vector<MeshInstance>* instances) {
+    aiMatrix4x4 transform = parent * node->mTransformation;
+    for (unsigned i = 0; i < node->mNumMeshes; ++i) {
+        const aiMesh* m = scene->mMeshes[node->mMeshes[i]];
+        // SortByPType leaves point and line primitives in meshes of their own.
+        if (m->mPrimitiveTypes != aiPrimitiveType_TRIANGLE) continue;
+        instances->push_back(MeshInstance { m, node, transform });
+    }
+    for (unsigned i = 0; i < node->mNumChildren; ++i) {
+        CollectInstances(scene, node->mChildren[i], transform, instances);
+    }
+}
+
+// Vertices and faces are converted in chunks of this many items, so one huge
+// mesh spreads across all threads just like many small ones.
+static const size_t IMPORT_GRAIN = 1 << 14;
+
+struct ImportTask {
+    size_t instance;
+    size_t begin;
+    size_t end;
+    bool   faces;
+};
+
+static VertexTransform MakeVertexTransform(const aiMatrix4x4& m) {
+    aiMatrix3x3 norms = aiMatrix3x3 { m }.Inverse().Transpose();
+    return VertexTransform {
+        { { m.a1, m.a2, m.a3, m.a4 }, { m.b1, m.b2, m.b3, m.b4 }, { m.c1, m.c2, m.c3, m.c4 } },
+        { { norms.a1, norms.a2, norms.a3 }, { norms.b1, norms.b2, norms.b3 }, { norms.c1, norms.c2, norms.c3 } },
+    };
+}
+
+static VertexStreams MakeVertexStreams(const aiMesh* m) {
+    static_assert(sizeof(aiVector3D) == 3 * sizeof(float), "aiVector3D must be three packed floats");
+    return VertexStreams {
+        &m->mVertices[0].x,
+        m->mNormals ? &m->mNormals[0].x : nullptr,
+        m->mTextureCoords[0] ? &m->mTextureCoords[0][0].x : nullptr,
+        m->mNumVertices,
+    };
+}
+
+static void ImportFaces(GLuint* indices, const aiMesh* m, bool flip, size_t begin, size_t end) {
+    // A mirroring transform turns the winding inside out; swap it back so
+    // back-face culling still works on the baked vertices.
+    for (size_t i = begin; i < end; ++i) {
+        const aiFace& face = m->mFaces[i];
+        indices[i * 3 + 0] = (GLuint) face.mIndices[0];
+        indices[i * 3 + 1] = (GLuint) face.mIndices[flip ? 2 : 1];
+        indices[i * 3 + 2] = (GLuint) face.mIndices[flip ? 1 : 2];
+    }
+}
+
+bool ImportSceneMeshes(StaticMesh* mesh, const aiScene* scene, const char* path, std::vector<SceneMeshSource>* sources) {
+    std::vector<MeshInstance> instances;
+    CollectInstances(scene, scene->mRootNode, aiMatrix4x4 {}, &instances);
+    if (instances.empty()) {
+        printf("%s: no triangle meshes\n", path);
+        return false;
+    }
+    if (sources) {
+        sources->clear();
+        for (const MeshInstance& inst : instances) sources->push_back(SceneMeshSource { inst.mesh, inst.node });
+    }
+
+    mesh->submeshes.clear();
+    mesh->submeshes.reserve(instances.size());
+    size_t numverts = 0, numindices = 0;
+    for (const MeshInstance& inst : instances) {
+        mesh->submeshes.push_back(StaticSubmesh {
+            (GLint) numverts,
+            inst.mesh->mNumVertices,
+            (GLuint) numindices,
+            inst.mesh->mNumFaces * 3,
+            inst.mesh->mMaterialIndex
+        });
+        numverts += inst.mesh->mNumVertices;
+        numindices += inst.mesh->mNumFaces * 3;
+    }
+
+    std::vector<VertexTransform> transforms;
+    std::vector<VertexStreams> streams;
+    std::vector<ImportTask> tasks;
+    transforms.reserve(instances.size());
+    streams.reserve(instances.size());
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const aiMesh* m = instances[i].mesh;
+        transforms.push_back(MakeVertexTransform(instances[i].transform));
+        streams.push_back(MakeVertexStreams(m));
+        for (size_t v = 0; v < m->mNumVertices; v += IMPORT_GRAIN) {
+            tasks.push_back(ImportTask { i, v, std::min<size_t>(v + IMPORT_GRAIN, m->mNumVertices), false });
+        }
+        for (size_t f = 0; f < m->mNumFaces; f += IMPORT_GRAIN) {
+            tasks.push_back(ImportTask { i, f, std::min<size_t>(f + IMPORT_GRAIN, m->mNumFaces), true });
+        }
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    mesh->vertices.resize(numverts);
+    mesh->indices.resize(numindices);
+    ParallelFor(tasks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const ImportTask& task = tasks[t];
+            const StaticSubmesh& sub = mesh->submeshes[task.instance];
+            if (task.faces) {
+                bool flip = aiMatrix3x3 { instances[task.instance].transform }.Determinant() < 0.0f;
+                ImportFaces(mesh->indices.data() + sub.firstIndex, instances[task.instance].mesh, flip, task.begin, task.end);
+            } else {
+                ConvertVertices(mesh->vertices.data() + sub.baseVertex, streams[task.instance], transforms[task.instance], task.begin, task.end);
+            }
+        }
+    });
+    std::chrono::duration<double> dur = std::chrono::high_resolution_clock::now() - start;
+    size_t cores = std::min<size_t>(tasks.size(), std::max<size_t>(1, std::thread::hardware_concurrency()));
+    printf("%s: converted %zu verts, %zu indices in %.2f ms, %.1f Mverts/s/core on %zu cores\n",
+           path, numverts, numindices, dur.count() * 1e3, numverts / std::max(dur.count(), 1e-9) * 1e-6 / cores, cores);
+    return true;
+}
+
+bool LoadStaticMesh(StaticMesh* mesh, const char *path, const PackFile* pack) {
+    using namespace Assimp;
+    Importer imp {};
+    imp.SetIOHandler(new MappedIOSystem(pack));
+
+    const aiScene* as = imp.ReadFile(path,
+        aiProcess_Triangulate | aiProcess_SortByPType);
+    if (!as || !as->mRootNode) {
+        printf("%s: %s\n", path, imp.GetErrorString());
+        return false;
+    }
+    if (!ImportSceneMeshes(mesh, as, path, nullptr)) return false;
+    ImportSceneMaterials(&mesh->materials, as, path, pack);
+
+    // Tangents are generated per welded vertex, the way MikkTSpace groups
+    // corners, so welding has to come first.
+    WeldStaticMesh(mesh, WELD_EPSILON);
+    GenerateStaticMeshTangents(mesh);
+
+    printf("%s: %zu submeshes, %zu verts\n", path, mesh->submeshes.size(), mesh->vertices.size());
+    return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "material.hpp"
+#include "meshlet.hpp"
+
+struct PackFile;
+struct aiMesh;
+struct aiNode;
+struct aiScene;
+
+struct GlStaticMeshVert {
+    glm::vec3 pos;
+    glm::vec3 norm;
+    glm::vec4 tang;     // xyz tangent, w bitangent sign (MikkTSpace convention)
+    glm::vec2 coord;
+};
+
+// One mesh instance of the imported scene. Its vertices occupy
+// [baseVertex, baseVertex + numVertices) of StaticMesh::vertices and its
+// indices, relative to baseVertex, occupy [firstIndex, firstIndex + numIndices)
+// of StaticMesh::indices, so it draws with glDrawElementsBaseVertex.
+struct StaticSubmesh {
+    GLint  baseVertex;
+    GLuint numVertices;
+    GLuint firstIndex;
+    GLuint numIndices;
+    GLuint material;
+};
+
+// A simplified version of one submesh. Coarser levels only remove vertices,
+// so they draw with the submesh's own baseVertex; their indices are appended
+// to StaticMesh::indices after every submesh's full-detail triangles.
+struct StaticLod {
+    GLuint firstIndex;
+    GLuint numIndices;
+    float  error;       // bound on object-space deviation from the full-detail surface
+};
+
+// The atlas a mesh's lightmap coordinates address; see lightmap_uv.hpp.
+struct LightmapInfo {
+    uint32_t width;
+    uint32_t height;
+    float    texelsPerUnit;     // object-space density the charts were packed at
+    uint32_t numCharts;
+};
+
+struct StaticMesh {
+    std::vector<GlStaticMeshVert>   vertices;
+    std::vector<GLuint>             indices;
+    std::vector<StaticSubmesh>      submeshes;
+    std::vector<Meshlet>            meshlets;
+
+    // lods[level * submeshes.size() + submesh]; level 0 mirrors the submesh.
+    std::vector<StaticLod>          lods;
+
+    // Indexed by StaticSubmesh::material.
+    std::vector<MaterialDesc>       materials;
+
+    // Second UV set from GenerateLightmapUvs, one per vertex, in [0, 1]
+    // over the atlas lightmap describes; empty when the mesh has none.
+    std::vector<glm::vec2>          lightmapCoords;
+    LightmapInfo                    lightmap {};
+};
+
+// Imports every triangle mesh referenced from the scene's node hierarchy,
+// with node transforms baked into the vertices, welded, and with tangents
+// from GenerateStaticMeshTangents, and with the scene's materials. Files
+// are read through MappedIOSystem, out of pack when it contains them.
+bool LoadStaticMesh(StaticMesh* mesh, const char *path, const PackFile* pack = nullptr);
+
+// A triangle mesh of an imported scene and the node that places it.
+struct SceneMeshSource {
+    const aiMesh* mesh;
+    const aiNode* node;
+};
+
+// The conversion step of LoadStaticMesh: every triangle mesh referenced from
+// scene's node hierarchy becomes one submesh, in node order, with node
+// transforms baked in, but is neither welded nor given tangents yet. sources,
+// if given, receives what each submesh was converted from.
+bool ImportSceneMeshes(StaticMesh* mesh, const aiScene* scene, const char* path, std::vector<SceneMeshSource>* sources);
@@ -0,0 +1,169 @@
+#include "tests.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <glm/geometric.hpp>
+
+#include "../impostor.hpp"
+#include "../mesh_cook.hpp"
+#include "test_meshes.hpp"
+
+// mesh as the baker reads it, from memory rather than a cooked file.
+static CookedMesh ViewMesh(const StaticMesh& mesh) {
+    CookedMesh view {};
+    view.vertices = mesh.vertices.data();
+    view.numVertices = mesh.vertices.size();
+    view.indices = mesh.indices.data();
+    view.numIndices = mesh.indices.size();
+    view.indexType = GL_UNSIGNED_INT;
+    view.submeshes = mesh.submeshes.data();
+    view.numSubmeshes = mesh.submeshes.size();
+    view.materials = mesh.materials;
+    return view;
+}
+
+// Frame directions are unit vectors spread evenly over the whole sphere,
+// which an even grid keeps symmetric, and each frame's basis is right-handed with the direction pointing at the viewer.
+static void Frames(uint32_t gridSize) {
+    glm::vec3 sum { 0.0f };
+    bool unit = true, basis = true;
+    for (uint32_t y = 0; y < gridSize; ++y) {
+        for (uint32_t x = 0; x < gridSize; ++x) {
+            glm::vec3 dir = Impostor_FrameDirection(x, y, gridSize), right, up;
+            Impostor_FrameBasis(dir, &right, &up);
+            unit &= fabsf(glm::length(dir) - 1.0f) < 1e-5f;
+            basis &= fabsf(glm::length(right) - 1.0f) < 1e-5f && fabsf(glm::length(up) - 1.0f) < 1e-5f;
+            basis &= glm::length(glm::cross(right, up) - dir) < 1e-5f;
+            sum += dir;
+        }
+    }
+    TEST_CHECK(unit);
+    TEST_CHECK(basis);
+    TEST_CHECK(glm::length(sum) < 1e-3f * gridSize * gridSize);
+}
+
+// Every frame of a sphere covers the disc its bounding sphere leaves it,
+// with the sphere's own normal and depth inside, and the material's colour
+// or the defaults' constants.
+static void Sphere(const ImpostorAtlas& atlas, glm::vec3 center, float radius, const uint8_t* albedo) {
+    const ImpostorInfo& info = atlas.info;
+    // The bounding sphere is taken around the box, sqrt(3) times the radius.
+    TEST_CHECK(glm::length(info.center - center) < 1e-3f * radius);
+    TEST_CHECK(fabsf(info.radius - radius * sqrtf(3.0f)) < 1e-3f * radius);
+    // A disc of 1 / sqrt(3) of the frame's width covers pi / 12 of it, give
+    // or take the tessellation and the texel centres along its edge.
+    float coverage = ImpostorAtlas_Coverage(atlas);
+    TEST_CHECK(fabsf(coverage - 3.14159265f / 12.0f) < 0.01f);
+
+    uint32_t F = info.frameSize;
+    size_t side = (size_t) info.gridSize * F;
+    float worstNormal = 0.0f, worstDepth = 0.0f;
+    bool inside = true, outside = true, colour = true, material = true;
+    for (uint32_t fy = 0; fy < info.gridSize; ++fy) {
+        for (uint32_t fx = 0; fx < info.gridSize; ++fx) {
+            glm::vec3 dir = Impostor_FrameDirection(fx, fy, info.gridSize), right, up;
+            Impostor_FrameBasis(dir, &right, &up);
+            for (uint32_t y = 0; y < F; ++y) {
+                for (uint32_t x = 0; x < F; ++x) {
+                    size_t o = ((size_t) fy * F + y) * side + (size_t) fx * F + x;
+                    float a = ((x + 0.5f) / F * 2.0f - 1.0f) * info.radius;
+                    float b = ((y + 0.5f) / F * 2.0f - 1.0f) * info.radius;
+                    float r2 = (a * a + b * b) / (radius * radius);
+                    bool covered = atlas.albedo[o * 4 + 3] == 255;
+                    if (r2 > 1.1f) outside &= !covered;
+                    if (r2 > 0.8f) continue;
+                    inside &= covered;
+
+                    glm::vec3 rel = right * a + up * b + dir * sqrtf(radius * radius - a * a - b * b);
+                    glm::vec3 want = rel / radius;
+                    glm::vec3 got = glm::vec3 { atlas.normal[o * 4], atlas.normal[o * 4 + 1], atlas.normal[o * 4 + 2] } / 255.0f * 2.0f - 1.0f;
+                    worstNormal = std::max(worstNormal, glm::length(glm::normalize(got) - want));
+                    float depth = (info.radius - glm::dot(rel + center - info.center, dir)) / (2.0f * info.radius);
+                    worstDepth = std::max(worstDepth, fabsf(atlas.depth[o] / 65535.0f - depth));
+
+                    for (int k = 0; k < 3; ++k) colour &= abs(atlas.albedo[o * 4 + k] - albedo[k]) <= 1;
+                    material &= atlas.material[o * 4] == 255 && atlas.material[o * 4 + 1] == 255 && atlas.material[o * 4 + 2] == 0;
+                }
+            }
+        }
+    }
+    TEST_CHECK(inside);
+    TEST_CHECK(outside);
+    // 48 segments leave the facets within about 4 degrees of the sphere.
+    TEST_CHECK(worstNormal < 0.08f);
+    TEST_CHECK(worstDepth < 0.01f);
+    TEST_CHECK(colour);
+    TEST_CHECK(material);
+}
+
+// Written and opened again, the atlas comes back byte for byte, and once
+// its source changes it is refused.
+static void RoundTrip(const ImpostorAtlas& atlas) {
+    std::filesystem::path dir = std::filesystem::temp_directory_path();
+    std::string source = (dir / "test_impostor.src").string(), cooked = (dir / "test_impostor.impostor").string();
+    FILE* f = fopen(source.c_str(), "wb");
+    if (!TEST_CHECK(f != nullptr)) return;
+    fputs("sphere", f);
+    fclose(f);
+
+    SourceStamp stamp;
+    TEST_CHECK(GetSourceStamp(source.c_str(), &stamp));
+    TEST_CHECK(ImpostorAtlas_Write(atlas, cooked.c_str(), stamp));
+    ImpostorAtlas opened {};
+    if (TEST_CHECK(ImpostorAtlas_Open(&opened, cooked.c_str(), source.c_str()))) {
+        size_t texels = (size_t) atlas.info.gridSize * atlas.info.frameSize * atlas.info.gridSize * atlas.info.frameSize;
+        TEST_CHECK(memcmp(&opened.info, &atlas.info, sizeof(ImpostorInfo)) == 0);
+        TEST_CHECK(memcmp(opened.albedo, atlas.albedo, texels * 4) == 0);
+        TEST_CHECK(memcmp(opened.normal, atlas.normal, texels * 4) == 0);
+        TEST_CHECK(memcmp(opened.material, atlas.material, texels * 4) == 0);
+        TEST_CHECK(memcmp(opened.depth, atlas.depth, texels * sizeof(uint16_t)) == 0);
+        TEST_CHECK(ImpostorAtlas_Coverage(opened) == ImpostorAtlas_Coverage(atlas));
+    }
+    ImpostorAtlas_Close(&opened);
+
+    f = fopen(source.c_str(), "ab");
+    if (f) {
+        fputs(", edited", f);
+        fclose(f);
+    }
+    TEST_CHECK(!ImpostorAtlas_Open(&opened, cooked.c_str(), source.c_str()));
+    std::filesystem::remove(source);
+    std::filesystem::remove(cooked);
+}
+
+void Test_Impostor() {
+    Frames(8);
+    Frames(16);
+
+    const glm::vec3 center { 3.0f, -1.0f, 2.0f };
+    const float radius = 2.0f;
+    StaticMesh sphere;
+    Test_AppendSphere(&sphere, center, radius, 24, 48);
+
+    // No materials: every slot comes from the defaults, all unset, so the
+    // colour is white and AO, roughness and metalness 1, 1 and 0.
+    ImpostorAtlas atlas {};
+    const uint8_t white[] = { 255, 255, 255 };
+    if (TEST_CHECK(BakeImpostor(&atlas, ViewMesh(sphere), MaterialDesc {}, nullptr, 8, 32))) Sphere(atlas, center, radius, white);
+
+    // A raw embedded colour texture, constant so filtering keeps it exact.
+    const uint8_t orange[] = { 200, 100, 50 };
+    MaterialDesc material;
+    MaterialTexture& tex = material.textures[MATERIAL_SLOT_COLOR];
+    tex.width = tex.height = 2;
+    for (int i = 0; i < 4; ++i) tex.embedded.insert(tex.embedded.end(), { orange[0], orange[1], orange[2], 255 });
+    sphere.materials.push_back(material);
+    if (TEST_CHECK(BakeImpostor(&atlas, ViewMesh(sphere), MaterialDesc {}, nullptr, 6, 40))) {
+        Sphere(atlas, center, radius, orange);
+        RoundTrip(atlas);
+    }
+
+    TEST_CHECK(!BakeImpostor(&atlas, ViewMesh(sphere), MaterialDesc {}, nullptr, 0, 32));
+    TEST_CHECK(!BakeImpostor(&atlas, ViewMesh(sphere), MaterialDesc {}, nullptr, 64, 512));
+    ImpostorAtlas_Close(&atlas);
+}
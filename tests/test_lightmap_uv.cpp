@@ -0,0 +1,156 @@
+#include "tests.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <glm/geometric.hpp>
+
+#include "../lightmap_uv.hpp"
+#include "../mesh_optimize.hpp"
+#include "../mesh_weld.hpp"
+#include "test_meshes.hpp"
+
+static bool SameVert(const GlStaticMeshVert& a, const GlStaticMeshVert& b) {
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static float Cross2(glm::vec2 a, glm::vec2 b) {
+    return a.x * b.y - a.y * b.x;
+}
+
+// Generates lightmap UVs for a copy of mesh and checks them against the
+// original: submeshes keep their index ranges and every index still reaches
+// the vertex it did, the coordinates lie inside the atlas with no triangle
+// flipped or overlapping another, and the texels they cover add up to the
+// surface at the density the stats report, which is the target unless the
+// atlas had to shrink.
+static StaticMesh Generate(const StaticMesh& mesh, float texelsPerUnit, uint32_t maxAtlasSize) {
+    StaticMesh out = mesh;
+    LightmapUvParams params = DEFAULT_LIGHTMAP_UV_PARAMS;
+    params.texelsPerUnit = texelsPerUnit;
+    params.maxAtlasSize = maxAtlasSize;
+    LightmapUvStats stats;
+    GenerateLightmapUvs(&out, params, &stats);
+
+    TEST_CHECK(ValidateLightmapUvs(out));
+    if (!TEST_CHECK(out.lightmapCoords.size() == out.vertices.size() && out.submeshes.size() == mesh.submeshes.size())) return out;
+    TEST_CHECK(out.lightmap.width == stats.width && out.lightmap.height == stats.height);
+    TEST_CHECK(out.lightmap.texelsPerUnit == stats.texelsPerUnit && out.lightmap.numCharts == stats.charts);
+    TEST_CHECK(std::max(stats.width, stats.height) <= maxAtlasSize);
+    TEST_CHECK(stats.texelsPerUnit <= texelsPerUnit);
+    TEST_CHECK(stats.vertsBefore == mesh.vertices.size() && stats.vertsAfter == out.vertices.size());
+    TEST_CHECK(stats.charts > 0);
+    TEST_CHECK(stats.areaEfficiency > 0.0f && stats.areaEfficiency <= stats.rectEfficiency && stats.rectEfficiency <= 1.0f);
+
+    glm::vec2 atlas { (float) out.lightmap.width, (float) out.lightmap.height };
+    double surface = 0.0, texels = 0.0;
+    GLint nextVertex = 0;
+    for (size_t s = 0; s < mesh.submeshes.size(); ++s) {
+        const StaticSubmesh& in = mesh.submeshes[s];
+        const StaticSubmesh& sub = out.submeshes[s];
+        TEST_CHECK(sub.firstIndex == in.firstIndex && sub.numIndices == in.numIndices && sub.material == in.material);
+        TEST_CHECK(sub.baseVertex == nextVertex);
+        nextVertex += (GLint) sub.numVertices;
+
+        bool same = true, inRange = true, flipped = false;
+        for (GLuint i = 0; i < sub.numIndices; i += 3) {
+            glm::vec3 p[3];
+            glm::vec2 q[3];
+            for (int k = 0; k < 3; ++k) {
+                GLuint v = out.indices[sub.firstIndex + i + k];
+                inRange &= v < sub.numVertices;
+                if (v >= sub.numVertices) v = 0;
+                const GlStaticMeshVert& vert = out.vertices[sub.baseVertex + v];
+                same &= SameVert(vert, mesh.vertices[in.baseVertex + mesh.indices[in.firstIndex + i + k]]);
+                p[k] = vert.pos;
+                q[k] = out.lightmapCoords[sub.baseVertex + v] * atlas;
+            }
+            float area3 = 0.5f * glm::length(glm::cross(p[1] - p[0], p[2] - p[0]));
+            float area2 = 0.5f * Cross2(q[1] - q[0], q[2] - q[0]);
+            flipped |= area3 > 1e-6f && area2 <= 0.0f;
+            surface += area3;
+            texels += area2;
+        }
+        TEST_CHECK(same);
+        TEST_CHECK(inRange);
+        TEST_CHECK(!flipped);
+    }
+    TEST_CHECK(out.vertices.size() == (size_t) nextVertex);
+    double want = surface * stats.texelsPerUnit * stats.texelsPerUnit;
+    TEST_CHECK(fabs(texels - want) <= 1e-3 * want);
+    return out;
+}
+
+// A triangle as its corners' positions and lightmap coordinates, rotated to
+// start at its smallest corner so the winding is kept.
+typedef std::array<float, 15> LitTriangle;
+
+// The lightmapped triangles of each material, sorted, so two meshes compare
+// equal when one only splits, reorders or renumbers the other.
+static std::vector<std::vector<LitTriangle>> LitTriangles(const StaticMesh& mesh) {
+    std::vector<std::vector<LitTriangle>> out;
+    for (const StaticSubmesh& sub : mesh.submeshes) {
+        if (out.size() <= sub.material) out.resize(sub.material + 1);
+        for (GLuint i = 0; i < sub.numIndices; i += 3) {
+            std::array<float, 5> corner[3];
+            for (int k = 0; k < 3; ++k) {
+                GLuint v = sub.baseVertex + mesh.indices[sub.firstIndex + i + k];
+                const glm::vec3& p = mesh.vertices[v].pos;
+                const glm::vec2& q = mesh.lightmapCoords[v];
+                corner[k] = { p.x, p.y, p.z, q.x, q.y };
+            }
+            int r = (int) (std::min_element(corner, corner + 3) - corner);
+            LitTriangle tri;
+            for (int k = 0; k < 3; ++k) std::copy(corner[(r + k) % 3].begin(), corner[(r + k) % 3].end(), tri.begin() + k * 5);
+            out[sub.material].push_back(tri);
+        }
+    }
+    for (std::vector<LitTriangle>& tris : out) std::sort(tris.begin(), tris.end());
+    return out;
+}
+
+// Splitting into 16-bit chunks and optimizing carry the coordinates along
+// with their vertices: every triangle keeps its lightmap texels, and the
+// result still validates.
+static void CarriedAlong(const StaticMesh& lit) {
+    std::vector<std::vector<LitTriangle>> before = LitTriangles(lit);
+    StaticMesh mesh = lit;
+    SplitStaticMesh(&mesh);
+    TEST_CHECK(mesh.submeshes.size() > lit.submeshes.size());
+    if (!TEST_CHECK(mesh.lightmapCoords.size() == mesh.vertices.size())) return;
+    TEST_CHECK(LitTriangles(mesh) == before);
+
+    OptimizeStaticMesh(&mesh);
+    if (!TEST_CHECK(mesh.lightmapCoords.size() == mesh.vertices.size())) return;
+    TEST_CHECK(LitTriangles(mesh) == before);
+    TEST_CHECK(memcmp(&mesh.lightmap, &lit.lightmap, sizeof(LightmapInfo)) == 0);
+    TEST_CHECK(ValidateLightmapUvs(mesh));
+}
+
+void Test_LightmapUv() {
+    // Smooth, with the seam of the first UV set and the poles to get past.
+    StaticMesh sphere;
+    Test_AppendSphere(&sphere, glm::vec3 { 0.0f }, 1.0f, 24, 48);
+    for (float density : { 8.0f, 32.0f, 128.0f }) Generate(sphere, density, 0xffffffffu);
+
+    // Triangles up to 20 units across that cross each other in space, each
+    // of which must still get texels of its own, next to a sphere in a
+    // second submesh.
+    StaticMesh soup;
+    Test_AppendSoup(&soup, 300, 400 * (uint32_t) testFuzzScale, 51);
+    for (float density : { 0.5f, 2.0f, 8.0f }) Generate(soup, density, 0xffffffffu);
+    Test_AppendSphere(&soup, glm::vec3 { 30.0f, 0.0f, 0.0f }, 5.0f, 24, 48);
+    Generate(soup, 4.0f, 0xffffffffu);
+
+    // Over the size limit, the density drops until the atlas fits.
+    StaticMesh shrunk = Generate(soup, 16.0f, 256);
+    TEST_CHECK(shrunk.lightmap.texelsPerUnit < 16.0f);
+
+    // Past 64k vertices, so the split has chunks to make.
+    StaticMesh large;
+    Test_AppendSphere(&large, glm::vec3 { 0.0f }, 1.0f, 300, 300);
+    Test_AppendSphere(&large, glm::vec3 { 3.0f, 0.0f, 0.0f }, 0.5f, 16, 32);
+    CarriedAlong(Generate(large, 64.0f, 0xffffffffu));
+}
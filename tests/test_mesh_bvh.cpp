@@ -0,0 +1,169 @@
+#include "tests.hpp"
+
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <glm/geometric.hpp>
+
+#include "../mesh_bvh.hpp"
+#include "test_meshes.hpp"
+
+// Corners of triangle t of mesh in the BVH's numbering.
+static void MeshTrianglePoints(const StaticMesh& mesh, size_t t, glm::vec3 p[3]) {
+    for (const StaticSubmesh& sub : mesh.submeshes) {
+        if (t < sub.numIndices / 3) {
+            const GLuint* idx = mesh.indices.data() + sub.firstIndex + t * 3;
+            for (int k = 0; k < 3; ++k) p[k] = mesh.vertices[sub.baseVertex + idx[k]].pos;
+            return;
+        }
+        t -= sub.numIndices / 3;
+    }
+}
+
+// The same triangle as the builder forms it.
+static BvhTriangle MeshTriangle(const StaticMesh& mesh, size_t t) {
+    glm::vec3 p[3];
+    MeshTrianglePoints(mesh, t, p);
+    return BvhTriangle { p[0], p[1] - p[0], p[2] - p[0] };
+}
+
+// Moller-Trumbore against every triangle, nearest first.
+static bool BruteForceHit(const std::vector<BvhTriangle>& tris, glm::vec3 origin, glm::vec3 dir, float tmax, BvhHit* hit) {
+    bool found = false;
+    for (size_t i = 0; i < tris.size(); ++i) {
+        const BvhTriangle& tri = tris[i];
+        glm::vec3 p = glm::cross(dir, tri.e2);
+        float det = glm::dot(tri.e1, p);
+        if (fabsf(det) < 1e-12f) continue;
+        float inv = 1.0f / det;
+        glm::vec3 s = origin - tri.v0;
+        float u = glm::dot(s, p) * inv;
+        if (u < 0.0f || u > 1.0f) continue;
+        glm::vec3 q = glm::cross(s, tri.e1);
+        float v = glm::dot(dir, q) * inv;
+        if (v < 0.0f || u + v > 1.0f) continue;
+        float t = glm::dot(tri.e2, q) * inv;
+        if (t <= 0.0f || t >= tmax) continue;
+        tmax = t;
+        *hit = BvhHit { t, u, v, (uint32_t) i };
+        found = true;
+    }
+    return found;
+}
+
+static bool Contains(const BvhNode& outer, glm::vec3 lo, glm::vec3 hi) {
+    return glm::all(glm::lessThanEqual(outer.lo, lo)) && glm::all(glm::lessThanEqual(hi, outer.hi));
+}
+
+// Nodes are numbered in a left-first depth-first walk, every child lies
+// inside its parent, the leaves hold each triangle once, and the leaf
+// geometry is the mesh's.
+static void Structure(const BvhTree& bvh, const StaticMesh& mesh, size_t numtris) {
+    TEST_CHECK(sizeof(BvhNode) == 32 && offsetof(BvhNode, hi) == 16);
+    if (!TEST_CHECK(!bvh.nodes.empty() && bvh.triangles.size() == numtris && bvh.tris.size() == numtris)) return;
+
+    std::vector<uint32_t> stack { 0 };
+    std::vector<int> covered(numtris, 0);
+    uint32_t expected = 0;
+    bool order = true, nested = true, geometry = true;
+    while (!stack.empty()) {
+        uint32_t n = stack.back();
+        stack.pop_back();
+        order &= n == expected++;
+        const BvhNode& node = bvh.nodes[n];
+        if (node.count > 0) {
+            for (uint32_t i = node.offset; i < node.offset + node.count && i < numtris; ++i) {
+                const BvhTriangle& tri = bvh.tris[i];
+                glm::vec3 p[3];
+                MeshTrianglePoints(mesh, bvh.triangles[i], p);
+                nested &= Contains(node, glm::min(p[0], glm::min(p[1], p[2])), glm::max(p[0], glm::max(p[1], p[2])));
+                covered[bvh.triangles[i]]++;
+                geometry &= tri.v0 == p[0] && tri.e1 == p[1] - p[0] && tri.e2 == p[2] - p[0];
+            }
+            continue;
+        }
+        if (!TEST_CHECK(node.offset > n + 1 && node.offset < bvh.nodes.size())) return;
+        nested &= Contains(node, bvh.nodes[n + 1].lo, bvh.nodes[n + 1].hi);
+        nested &= Contains(node, bvh.nodes[node.offset].lo, bvh.nodes[node.offset].hi);
+        stack.push_back(node.offset);
+        stack.push_back(n + 1);
+    }
+    TEST_CHECK(order);
+    TEST_CHECK(expected == bvh.nodes.size());
+    TEST_CHECK(nested);
+    TEST_CHECK(geometry);
+    TEST_CHECK(std::all_of(covered.begin(), covered.end(), [](int c) { return c == 1; }));
+}
+
+// Random rays, some along the axes, some limited in length: both queries
+// agree with the brute-force test. A different triangle at the same
+// distance is accepted for the closest hit, since the order in which ties
+// are met differs.
+static void Rays(const BvhTree& bvh, const StaticMesh& mesh, size_t numtris, size_t numrays, uint32_t seed) {
+    std::vector<BvhTriangle> tris(numtris);
+    for (size_t t = 0; t < numtris; ++t) tris[t] = MeshTriangle(mesh, t);
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    size_t hits = 0, closestOk = 0, anyOk = 0;
+    for (size_t r = 0; r < numrays; ++r) {
+        glm::vec3 origin = glm::vec3 { unit(rng), unit(rng), unit(rng) } * 15.0f;
+        glm::vec3 dir;
+        if (r % 8 == 0) {
+            dir = glm::vec3 { 0.0f };
+            dir[r / 8 % 3] = r & 8 ? 1.0f : -1.0f;
+        } else {
+            dir = glm::normalize(glm::vec3 { unit(rng), unit(rng), unit(rng) } + glm::vec3 { 0.0f, 0.0f, 1e-3f });
+        }
+        float tmax = r % 3 == 0 ? 8.0f : FLT_MAX;
+
+        BvhHit want {}, got {};
+        bool expect = BruteForceHit(tris, origin, dir, tmax, &want);
+        bool found = Bvh_ClosestHit(bvh, origin, dir, tmax, &got);
+        hits += expect;
+        if (found == expect && (!expect || (got.triangle == want.triangle && got.t == want.t && got.u == want.u && got.v == want.v)
+                                        || fabsf(got.t - want.t) <= 1e-5f * want.t)) {
+            closestOk++;
+        }
+        anyOk += Bvh_AnyHit(bvh, origin, dir, tmax) == expect;
+    }
+    TEST_CHECK(closestOk == numrays);
+    TEST_CHECK(anyOk == numrays);
+    TEST_CHECK(hits > numrays / 10 && hits < numrays);
+}
+
+void Test_MeshBvh() {
+    StaticMesh mesh;
+    Test_AppendSoup(&mesh, 3000, 2000 * (uint32_t) testFuzzScale, 41);
+    Test_AppendSphere(&mesh, glm::vec3 { 2.0f, 0.0f, -3.0f }, 6.0f, 24, 48);
+    size_t numtris = mesh.indices.size() / 3;
+    BvhTree bvh;
+    BuildBvh(&bvh, mesh);
+    Structure(bvh, mesh, numtris);
+    Rays(bvh, mesh, numtris, 2000 * testFuzzScale, 42);
+
+    // Large enough that subtrees are built on other threads and spliced in.
+    StaticMesh large;
+    Test_AppendSphere(&large, glm::vec3 { 0.0f }, 9.0f, 200, 200);
+    numtris = large.indices.size() / 3;
+    BuildBvh(&bvh, large);
+    Structure(bvh, large, numtris);
+    Rays(bvh, large, numtris, 200 * testFuzzScale, 44);
+
+    // A single triangle is a lone leaf, and an empty mesh hits nothing.
+    StaticMesh one;
+    Test_AppendSoup(&one, 3, 1, 43);
+    BuildBvh(&bvh, one);
+    Structure(bvh, one, 1);
+    TEST_CHECK(bvh.nodes.size() == 1 && bvh.nodes[0].count == 1);
+
+    StaticMesh empty;
+    BuildBvh(&bvh, empty);
+    BvhHit hit;
+    TEST_CHECK(bvh.nodes.empty());
+    TEST_CHECK(!Bvh_ClosestHit(bvh, glm::vec3 { 0.0f }, glm::vec3 { 0, 0, 1 }, FLT_MAX, &hit));
+    TEST_CHECK(!Bvh_AnyHit(bvh, glm::vec3 { 0.0f }, glm::vec3 { 0, 0, 1 }, FLT_MAX));
+}
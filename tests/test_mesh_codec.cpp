@@ -0,0 +1,216 @@
+#include "tests.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "../mesh_codec.hpp"
+#include "../mesh_weld.hpp"
+#include "test_meshes.hpp"
+
+// Decoded outputs get this many guard elements past their end, which must
+// come back untouched. Reads past a stream are caught by passing every
+// stream in a buffer of exactly its size, which AddressSanitizer checks.
+static const size_t GUARD = 64;
+static const uint8_t GUARD_BYTE = 0xcd;
+
+struct EncodedMesh {
+    std::vector<GlCompactVert> quantized;
+    CompactVertBounds          bounds;
+    std::vector<GLuint>        restarts;
+    std::vector<uint8_t>       verts;
+    std::vector<uint8_t>       indices;
+};
+
+static void Encode(EncodedMesh* out, const StaticMesh& mesh) {
+    out->bounds = ComputeCompactBounds(mesh.vertices.data(), mesh.vertices.size());
+    out->quantized.resize(mesh.vertices.size());
+    PackCompactVerts(out->quantized.data(), mesh.vertices.data(), mesh.vertices.size(), out->bounds);
+    CollectIndexRestarts(&out->restarts, mesh);
+    EncodeMeshVertices(&out->verts, out->quantized.data(), out->quantized.size(), out->bounds);
+    EncodeMeshIndices(&out->indices, mesh.indices.data(), mesh.indices.size(), out->restarts.data(), out->restarts.size());
+}
+
+static bool GuardIntact(const void* end) {
+    const uint8_t* bytes = (const uint8_t*) end;
+    for (size_t i = 0; i < GUARD * sizeof(GLuint); ++i) {
+        if (bytes[i] != GUARD_BYTE) return false;
+    }
+    return true;
+}
+
+// Whether b holds the triangles of a in the same order and winding, each
+// possibly starting at another corner.
+static bool SameTriangles(const GLuint* a, const GLuint* b, size_t count) {
+    for (size_t i = 0; i < count; i += 3) {
+        bool same = false;
+        for (int r = 0; r < 3 && !same; ++r) {
+            same = a[i] == b[i + r] && a[i + 1] == b[i + (r + 1) % 3] && a[i + 2] == b[i + (r + 2) % 3];
+        }
+        if (!same) return false;
+    }
+    return true;
+}
+
+// Every decoder, threaded or not, must reproduce the quantized vertices and
+// the triangles exactly, as 16-bit indices only when they fit, and
+// re-encoding the result must give the same bytes.
+static void RoundTrip(const StaticMesh& mesh) {
+    EncodedMesh enc;
+    Encode(&enc, mesh);
+    size_t numverts = mesh.vertices.size(), numindices = mesh.indices.size();
+
+    size_t count = ~(size_t) 0;
+    CompactVertBounds bounds {};
+    TEST_CHECK(ReadMeshVertexHeader(enc.verts.data(), enc.verts.size(), &count, &bounds) && count == numverts);
+    TEST_CHECK(memcmp(&bounds, &enc.bounds, sizeof(bounds)) == 0);
+    TEST_CHECK(ReadMeshIndexHeader(enc.indices.data(), enc.indices.size(), &count) && count == numindices);
+
+    std::vector<GlCompactVert> verts(numverts + GUARD);
+    for (int decoder = 0; decoder < 4; ++decoder) {
+        memset(verts.data(), GUARD_BYTE, verts.size() * sizeof(GlCompactVert));
+        bool parallel = decoder & 1;
+        bool ok = decoder < 2 ? DecodeMeshVertices(verts.data(), enc.verts.data(), enc.verts.size(), parallel)
+                              : DecodeMeshVerticesScalar(verts.data(), enc.verts.data(), enc.verts.size(), parallel);
+        TEST_CHECK(ok);
+        TEST_CHECK(std::equal(verts.begin(), verts.begin() + numverts, enc.quantized.begin(), [](const GlCompactVert& x, const GlCompactVert& y) {
+            return memcmp(&x, &y, sizeof(x)) == 0;
+        }));
+        TEST_CHECK(GuardIntact(verts.data() + numverts));
+    }
+
+    std::vector<GLuint> indices(numindices + GUARD);
+    for (int parallel = 0; parallel < 2; ++parallel) {
+        memset(indices.data(), GUARD_BYTE, indices.size() * sizeof(GLuint));
+        TEST_CHECK(DecodeMeshIndices(indices.data(), GL_UNSIGNED_INT, enc.indices.data(), enc.indices.size(), parallel));
+        TEST_CHECK(SameTriangles(mesh.indices.data(), indices.data(), numindices));
+        TEST_CHECK(GuardIntact(indices.data() + numindices));
+    }
+    std::vector<uint16_t> shorts(numindices + GUARD * 2);
+    memset(shorts.data(), GUARD_BYTE, shorts.size() * sizeof(uint16_t));
+    bool fits = StaticMeshIndexType(mesh) == GL_UNSIGNED_SHORT;
+    TEST_CHECK(DecodeMeshIndices(shorts.data(), GL_UNSIGNED_SHORT, enc.indices.data(), enc.indices.size()) == fits);
+    TEST_CHECK(GuardIntact(shorts.data() + numindices));
+    if (fits) TEST_CHECK(std::equal(shorts.begin(), shorts.begin() + numindices, indices.begin()));
+
+    std::vector<uint8_t> again;
+    EncodeMeshVertices(&again, verts.data(), numverts, enc.bounds);
+    TEST_CHECK(again == enc.verts);
+    EncodeMeshIndices(&again, indices.data(), numindices, enc.restarts.data(), enc.restarts.size());
+    TEST_CHECK(again == enc.indices);
+}
+
+// Decodes stream, copied into a buffer of exactly its size, with both
+// vertex decoders or as both index types into outputs sized for the
+// original mesh; returns how many decodes succeeded and checks the guards.
+static int DecodeCorrupt(const std::vector<uint8_t>& stream, bool vertices, size_t numverts, size_t numindices) {
+    std::vector<uint8_t> src(stream);
+    int succeeded = 0;
+    if (vertices) {
+        std::vector<GlCompactVert> verts(numverts + GUARD);
+        memset(verts.data(), GUARD_BYTE, verts.size() * sizeof(GlCompactVert));
+        succeeded += DecodeMeshVertices(verts.data(), src.data(), src.size(), false);
+        succeeded += DecodeMeshVerticesScalar(verts.data(), src.data(), src.size(), false);
+        TEST_CHECK(GuardIntact(verts.data() + numverts));
+    } else {
+        std::vector<GLuint> indices(numindices + GUARD);
+        memset(indices.data(), GUARD_BYTE, indices.size() * sizeof(GLuint));
+        succeeded += DecodeMeshIndices(indices.data(), GL_UNSIGNED_INT, src.data(), src.size(), false);
+        succeeded += DecodeMeshIndices(indices.data(), GL_UNSIGNED_SHORT, src.data(), src.size(), false);
+        TEST_CHECK(GuardIntact(indices.data() + numindices));
+    }
+    return succeeded;
+}
+
+// Every truncation and every single flipped bit of both streams must be
+// rejected.
+static void Corruption(const StaticMesh& mesh) {
+    EncodedMesh enc;
+    Encode(&enc, mesh);
+    size_t numverts = mesh.vertices.size(), numindices = mesh.indices.size();
+    for (int pass = 0; pass < 2; ++pass) {
+        bool vertices = pass == 0;
+        const std::vector<uint8_t>& stream = vertices ? enc.verts : enc.indices;
+        size_t truncations = 0, flips = 0;
+        for (size_t size = 0; size < stream.size(); ++size) {
+            std::vector<uint8_t> cut(stream.begin(), stream.begin() + size);
+            truncations += DecodeCorrupt(cut, vertices, numverts, numindices) == 0;
+        }
+        std::vector<uint8_t> flipped(stream);
+        for (size_t bit = 0; bit < stream.size() * 8; ++bit) {
+            flipped[bit / 8] ^= (uint8_t) (1 << (bit % 8));
+            flips += DecodeCorrupt(flipped, vertices, numverts, numindices) == 0;
+            flipped[bit / 8] ^= (uint8_t) (1 << (bit % 8));
+        }
+        TEST_CHECK(truncations == stream.size());
+        TEST_CHECK(flips == stream.size() * 8);
+    }
+}
+
+// Streams of the wrong kind, and streams whose tables belong to one mesh
+// and whose data to another with the same counts, must be rejected.
+static void WrongStreams() {
+    StaticMesh a, b;
+    Test_AppendSphere(&a, glm::vec3 { 0.0f }, 1.0f, 20, 30);
+    Test_AppendSphere(&b, glm::vec3 { 0.5f }, 3.0f, 20, 30);
+    // The same triangles in reverse order, so the index streams differ.
+    for (size_t i = 0, n = b.indices.size(); i < n / 2; i += 3) {
+        std::swap_ranges(b.indices.begin() + i, b.indices.begin() + i + 3, b.indices.end() - i - 3);
+    }
+    EncodedMesh ea, eb;
+    Encode(&ea, a);
+    Encode(&eb, b);
+    size_t numverts = a.vertices.size(), numindices = a.indices.size();
+
+    TEST_CHECK(DecodeCorrupt(ea.indices, true, numverts, numindices) == 0);
+    TEST_CHECK(DecodeCorrupt(ea.verts, false, numverts, numindices) == 0);
+
+    for (int pass = 0; pass < 2; ++pass) {
+        const std::vector<uint8_t>& first = pass == 0 ? ea.verts : ea.indices;
+        const std::vector<uint8_t>& second = pass == 0 ? eb.verts : eb.indices;
+        if (!TEST_CHECK(first != second)) continue;
+        for (size_t split : { (size_t) 64, first.size() / 4, first.size() / 2, first.size() - 4 }) {
+            std::vector<uint8_t> spliced(first.begin(), first.begin() + split);
+            spliced.insert(spliced.end(), second.begin() + std::min(split, second.size()), second.end());
+            spliced.resize(first.size());
+            if (spliced == first) continue;
+            if (!TEST_CHECK(DecodeCorrupt(spliced, pass == 0, numverts, numindices) == 0)) printf("  spliced %s at %zu of %zu\n", pass == 0 ? "vertices" : "indices", split, first.size());
+        }
+        std::vector<uint8_t> doubled(first);
+        doubled.insert(doubled.end(), first.begin(), first.end());
+        TEST_CHECK(DecodeCorrupt(doubled, pass == 0, numverts, numindices) == 0);
+    }
+}
+
+void Test_MeshCodec() {
+    StaticMesh empty;
+    RoundTrip(empty);
+
+    StaticMesh one;
+    Test_AppendSoup(&one, 3, 1, 1);
+    RoundTrip(one);
+
+    // Several submeshes and a block count that does not divide evenly.
+    StaticMesh spheres;
+    Test_AppendSphere(&spheres, glm::vec3 { 0.0f }, 1.0f, 17, 29);
+    Test_AppendSphere(&spheres, glm::vec3 { 4.0f, 0.0f, 0.0f }, 2.0f, 64, 96);
+    Test_AppendSoup(&spheres, 300, 500, 2);
+    RoundTrip(spheres);
+
+    // Segments split within one long submesh.
+    StaticMesh big;
+    Test_AppendSphere(&big, glm::vec3 { 0.0f }, 100.0f, 256, 128);
+    RoundTrip(big);
+
+    // More vertices than 16-bit indices reach: only 32-bit decoding works.
+    StaticMesh wide;
+    Test_AppendSoup(&wide, 70000, 20000, 3);
+    RoundTrip(wide);
+
+    StaticMesh small;
+    Test_AppendSphere(&small, glm::vec3 { 0.0f }, 1.0f, 10, 16);
+    Test_AppendSoup(&small, 40, 30, 4);
+    Corruption(small);
+    WrongStreams();
+}
@@ -0,0 +1,265 @@
+#include "tests.hpp"
+
+#include <math.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+#include <glm/geometric.hpp>
+
+#include "../mesh_lod.hpp"
+#include "test_meshes.hpp"
+
+// A gently curved height field over an n by n grid of unit cells, facing +z,
+// so everything on its rim is an open border.
+static void AppendGrid(StaticMesh* mesh, uint32_t n) {
+    StaticSubmesh sub {};
+    sub.baseVertex = (GLint) mesh->vertices.size();
+    sub.firstIndex = (GLuint) mesh->indices.size();
+    sub.material = (GLuint) mesh->submeshes.size();
+    for (uint32_t y = 0; y <= n; ++y) {
+        for (uint32_t x = 0; x <= n; ++x) {
+            GlStaticMeshVert v {};
+            v.pos = glm::vec3 { (float) x, (float) y, 2.0f * sinf(x * 0.15f) * cosf(y * 0.1f) };
+            v.norm = glm::vec3 { 0.0f, 0.0f, 1.0f };
+            v.tang = glm::vec4 { 1.0f, 0.0f, 0.0f, 1.0f };
+            v.coord = glm::vec2 { (float) x, (float) y } / (float) n;
+            mesh->vertices.push_back(v);
+        }
+    }
+    for (uint32_t y = 0; y < n; ++y) {
+        for (uint32_t x = 0; x < n; ++x) {
+            GLuint a = y * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+            mesh->indices.insert(mesh->indices.end(), { a, b, c, b, d, c });
+        }
+    }
+    sub.numVertices = (GLuint) mesh->vertices.size() - sub.baseVertex;
+    sub.numIndices = (GLuint) mesh->indices.size() - sub.firstIndex;
+    mesh->submeshes.push_back(sub);
+}
+
+typedef std::pair<glm::vec3, glm::vec3> PosEdge;
+
+struct PosEdgeLess {
+    bool operator()(const PosEdge& a, const PosEdge& b) const {
+        for (int k = 0; k < 3; ++k) if (a.first[k] != b.first[k]) return a.first[k] < b.first[k];
+        for (int k = 0; k < 3; ++k) if (a.second[k] != b.second[k]) return a.second[k] < b.second[k];
+        return false;
+    }
+};
+
+// Directed edges of a list by position, counted.
+static std::map<PosEdge, int, PosEdgeLess> PosEdges(const std::vector<GLuint>& indices, const GlStaticMeshVert* verts) {
+    std::map<PosEdge, int, PosEdgeLess> edges;
+    for (size_t i = 0; i < indices.size(); ++i) {
+        GLuint a = indices[i], b = indices[i - i % 3 + (i + 1) % 3];
+        edges[PosEdge { verts[a].pos, verts[b].pos }]++;
+    }
+    return edges;
+}
+
+// Simplifies submesh sub of mesh to about ratio of its triangles and checks
+// what holds for any input: the result is a whole number of triangles, no
+// more than asked of it when the mesh allows, draws only vertices the input
+// drew and no triangle collapsed to a line by position.
+static std::vector<GLuint> Simplify(const StaticMesh& mesh, size_t s, float ratio, float* error) {
+    const StaticSubmesh& sub = mesh.submeshes[s];
+    const GLuint* indices = mesh.indices.data() + sub.firstIndex;
+    const GlStaticMeshVert* verts = mesh.vertices.data() + sub.baseVertex;
+    size_t target = (size_t) (sub.numIndices * ratio) / 3 * 3;
+    std::vector<GLuint> out(sub.numIndices);
+    out.resize(SimplifyMesh(out.data(), indices, sub.numIndices, verts, sub.numVertices, target, error));
+
+    std::vector<bool> used(sub.numVertices, false);
+    for (GLuint i = 0; i < sub.numIndices; ++i) used[indices[i]] = true;
+    bool subset = true, degenerate = false;
+    for (size_t i = 0; i < out.size(); i += 3) {
+        for (int k = 0; k < 3; ++k) subset &= out[i + k] < sub.numVertices && used[out[i + k]];
+        if (!subset) break;
+        glm::vec3 p[3] = { verts[out[i]].pos, verts[out[i + 1]].pos, verts[out[i + 2]].pos };
+        degenerate |= p[0] == p[1] || p[1] == p[2] || p[2] == p[0];
+    }
+    TEST_CHECK(out.size() % 3 == 0);
+    TEST_CHECK(out.size() < sub.numIndices && out.size() <= target + target / 10);
+    TEST_CHECK(subset);
+    TEST_CHECK(!degenerate);
+    TEST_CHECK(*error > 0.0f && isfinite(*error));
+    return out;
+}
+
+// The rim of an n-cell grid only slides along itself: each open edge of
+// the result runs along one side of the square, the corners stay, and the
+// area inside the rim, projected onto the grid, is still the whole square.
+static void Border(uint32_t n) {
+    StaticMesh mesh;
+    AppendGrid(&mesh, n);
+    const GlStaticMeshVert* verts = mesh.vertices.data();
+    for (float ratio : { 0.5f, 0.1f }) {
+        float error;
+        std::vector<GLuint> out = Simplify(mesh, 0, ratio, &error);
+        std::map<PosEdge, int, PosEdgeLess> edges = PosEdges(out, verts);
+        float side = (float) n;
+        bool along = true;
+        for (const auto& e : edges) {
+            if (edges.count(PosEdge { e.first.second, e.first.first })) continue;
+            glm::vec3 a = e.first.first, b = e.first.second;
+            along &= (a.x == 0.0f && b.x == 0.0f) || (a.x == side && b.x == side)
+                  || (a.y == 0.0f && b.y == 0.0f) || (a.y == side && b.y == side);
+        }
+        TEST_CHECK(along);
+
+        std::set<GLuint> kept(out.begin(), out.end());
+        TEST_CHECK(kept.count(0) && kept.count(n) && kept.count(n * (n + 1)) && kept.count((n + 1) * (n + 1) - 1));
+        double area = 0.0;
+        for (size_t i = 0; i < out.size(); i += 3) {
+            glm::vec2 p { verts[out[i]].pos }, q { verts[out[i + 1]].pos }, r { verts[out[i + 2]].pos };
+            area += 0.5 * ((double) (q.x - p.x) * (r.y - p.y) - (double) (q.y - p.y) * (r.x - p.x));
+        }
+        TEST_CHECK(fabs(area - (double) side * side) < 1e-3);
+    }
+}
+
+// A closed sphere stays closed by position, and its seams stay where they
+// were: every edge of the result that splits attributes either runs along
+// the duplicated u seam or fans out from a pole, whose copies never move,
+// and the two copies of a u seam vertex are kept or dropped together.
+static void Seams(uint32_t rings, uint32_t segments) {
+    StaticMesh mesh;
+    Test_AppendSphere(&mesh, glm::vec3 { 0.0f }, 1.0f, rings, segments);
+    const GlStaticMeshVert* verts = mesh.vertices.data();
+    const StaticSubmesh& sub = mesh.submeshes[0];
+    std::vector<GLuint> in(mesh.indices.begin() + sub.firstIndex, mesh.indices.begin() + sub.firstIndex + sub.numIndices);
+
+    // Closed by position, and every edge with a partner by position but not
+    // by index on a seam.
+    auto check = [&](const std::vector<GLuint>& indices) {
+        auto uSeam = [&](GLuint v) { return v % (segments + 1) == 0 || v % (segments + 1) == segments; };
+        auto pole = [&](GLuint v) { return v / (segments + 1) == 0 || v / (segments + 1) == rings; };
+        std::set<std::pair<GLuint, GLuint>> byIndex;
+        for (size_t i = 0; i < indices.size(); ++i) byIndex.insert({ indices[i], indices[i - i % 3 + (i + 1) % 3] });
+        std::map<PosEdge, int, PosEdgeLess> byPos = PosEdges(indices, verts);
+        bool closed = true, seams = true, split = false;
+        for (const auto& e : byIndex) {
+            closed &= byPos.count(PosEdge { verts[e.second].pos, verts[e.first].pos }) > 0;
+            if (byIndex.count({ e.second, e.first })) continue;
+            seams &= pole(e.first) || pole(e.second) || (uSeam(e.first) && uSeam(e.second));
+            split |= !pole(e.first) && !pole(e.second);
+        }
+        TEST_CHECK(closed);
+        TEST_CHECK(seams);
+        TEST_CHECK(split);
+    };
+    check(in);
+
+    for (float ratio : { 0.5f, 0.2f }) {
+        float error;
+        std::vector<GLuint> out = Simplify(mesh, 0, ratio, &error);
+        check(out);
+
+        std::vector<bool> used(sub.numVertices, false);
+        for (GLuint v : out) used[v] = true;
+        bool twins = true;
+        for (uint32_t r = 1; r < rings; ++r) twins &= used[r * (segments + 1)] == used[r * (segments + 1) + segments];
+        TEST_CHECK(twins);
+    }
+}
+
+// Every level of every submesh lies within the index buffer, draws only the
+// submesh's vertices, has no more triangles than the one before and no less
+// error; the levels that were simplified rather than repeated are strictly
+// smaller and strictly worse.
+static void Levels() {
+    StaticMesh mesh;
+    Test_AppendSphere(&mesh, glm::vec3 { 0.0f }, 1.0f, 32, 64);
+    AppendGrid(&mesh, 48);
+    Test_AppendSphere(&mesh, glm::vec3 { 5.0f, 0.0f, 0.0f }, 2.0f, 4, 8);
+    size_t numsubs = mesh.submeshes.size();
+    BuildLods(&mesh, MAX_LOD_LEVELS);
+    if (!TEST_CHECK(!mesh.lods.empty() && mesh.lods.size() % numsubs == 0)) return;
+    size_t levels = mesh.lods.size() / numsubs;
+    TEST_CHECK(levels > 2 && levels <= MAX_LOD_LEVELS);
+
+    for (size_t s = 0; s < numsubs; ++s) {
+        const StaticSubmesh& sub = mesh.submeshes[s];
+        const StaticLod& base = mesh.lods[s];
+        TEST_CHECK(base.firstIndex == sub.firstIndex && base.numIndices == sub.numIndices && base.error == 0.0f);
+        bool inRange = true, monotonic = true, progress = true;
+        for (size_t level = 1; level < levels; ++level) {
+            const StaticLod& prev = mesh.lods[(level - 1) * numsubs + s];
+            const StaticLod& lod = mesh.lods[level * numsubs + s];
+            inRange &= lod.numIndices % 3 == 0 && (size_t) lod.firstIndex + lod.numIndices <= mesh.indices.size();
+            if (!inRange) break;
+            for (GLuint i = 0; i < lod.numIndices; ++i) inRange &= mesh.indices[lod.firstIndex + i] < sub.numVertices;
+            monotonic &= lod.numIndices <= prev.numIndices && lod.error >= prev.error;
+            bool repeated = lod.firstIndex == prev.firstIndex && lod.numIndices == prev.numIndices;
+            progress &= repeated ? lod.error == prev.error : lod.numIndices < prev.numIndices && lod.error > prev.error;
+        }
+        TEST_CHECK(inRange);
+        TEST_CHECK(monotonic);
+        TEST_CHECK(progress);
+    }
+    // The big sphere and the grid have headroom for a few halvings.
+    TEST_CHECK(mesh.lods[2 * numsubs].numIndices * 3 < mesh.submeshes[0].numIndices);
+    TEST_CHECK(mesh.lods[2 * numsubs + 1].numIndices * 3 < mesh.submeshes[1].numIndices);
+}
+
+// Walking slowly towards and away from the object picks finer levels as the
+// error grows past the threshold and coarser ones only once it is well under,
+// so jitter around a boundary never flips the level back and forth.
+static void Hysteresis() {
+    const float errors[] = { 0.0f, 0.01f, 0.02f, 0.04f, 0.08f };
+    const int levels = 5;
+    const float threshold = 1.0f, hysteresis = 0.2f;
+
+    // Far away everything fits the coarsest level, up close only level 0.
+    TEST_CHECK(SelectLod(errors, levels, 1.0f, 0, threshold, hysteresis) == levels - 1);
+    TEST_CHECK(SelectLod(errors, levels, 1e4f, levels - 1, threshold, hysteresis) == 0);
+
+    // Just past the boundary of level 2 at 50 px per unit: coming from
+    // level 1 it holds until 40, coming from level 3 it refines at once.
+    TEST_CHECK(SelectLod(errors, levels, 49.0f, 1, threshold, hysteresis) == 1);
+    TEST_CHECK(SelectLod(errors, levels, 39.0f, 1, threshold, hysteresis) == 2);
+    TEST_CHECK(SelectLod(errors, levels, 51.0f, 2, threshold, hysteresis) == 1);
+    TEST_CHECK(SelectLod(errors, levels, 49.0f, 3, threshold, hysteresis) == 2);
+    TEST_CHECK(SelectLod(errors, levels, 49.0f, 2, threshold, hysteresis) == 2);
+
+    // Jitter of two percent around every boundary switches at most once.
+    bool steady = true;
+    for (int level = 1; level < levels; ++level) {
+        float boundary = threshold / errors[level];
+        int current = SelectLod(errors, levels, boundary * 1.01f, 0, threshold, hysteresis);
+        int switches = 0;
+        for (int step = 0; step < 100; ++step) {
+            float px = boundary * (step & 1 ? 0.99f : 1.01f);
+            int next = SelectLod(errors, levels, px, current, threshold, hysteresis);
+            switches += next != current;
+            current = next;
+        }
+        steady &= switches <= 1;
+    }
+    TEST_CHECK(steady);
+
+    // Errors repeated by submeshes that ran out of headroom select fine.
+    const float flat[] = { 0.0f, 0.01f, 0.01f, 0.01f };
+    TEST_CHECK(SelectLod(flat, 4, 10.0f, 0, threshold, hysteresis) == 3);
+    TEST_CHECK(SelectLod(flat, 4, 1000.0f, 3, threshold, hysteresis) == 0);
+}
+
+void Test_MeshLod() {
+    Border(32);
+    Border(7);
+    Seams(24, 48);
+    Seams(64, 128);
+    Levels();
+    Hysteresis();
+
+    // A target at or above the input copies it with no error.
+    StaticMesh mesh;
+    Test_AppendSphere(&mesh, glm::vec3 { 0.0f }, 1.0f, 8, 16);
+    std::vector<GLuint> out(mesh.indices.size());
+    float error = -1.0f;
+    size_t count = SimplifyMesh(out.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size(),
+                                mesh.indices.size(), &error);
+    TEST_CHECK(count == mesh.indices.size() && out == mesh.indices && error == 0.0f);
+}
@@ -0,0 +1,140 @@
+#include "tests.hpp"
+
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "../mesh_optimize.hpp"
+#include "test_meshes.hpp"
+
+// Misses of a FIFO cache of cachesize entries, kept as an actual queue.
+static size_t ReferenceMisses(const GLuint* indices, size_t numindices, unsigned cachesize) {
+    std::deque<GLuint> fifo;
+    size_t misses = 0;
+    for (size_t i = 0; i < numindices; ++i) {
+        if (std::find(fifo.begin(), fifo.end(), indices[i]) != fifo.end()) continue;
+        misses++;
+        fifo.push_back(indices[i]);
+        if (fifo.size() > cachesize) fifo.pop_front();
+    }
+    return misses;
+}
+
+// Triangles of a list rotated to start at their smallest index, which keeps
+// the winding, and sorted, so two lists compare equal when one reorders the
+// other's triangles.
+static std::vector<uint64_t> TriangleSet(const GLuint* indices, size_t numindices) {
+    std::vector<uint64_t> tris;
+    for (size_t i = 0; i < numindices; i += 3) {
+        GLuint t[3] = { indices[i], indices[i + 1], indices[i + 2] };
+        int r = t[0] <= t[1] && t[0] <= t[2] ? 0 : t[1] <= t[2] ? 1 : 2;
+        tris.push_back((uint64_t) t[r] << 42 | (uint64_t) t[(r + 1) % 3] << 21 | t[(r + 2) % 3]);
+    }
+    std::sort(tris.begin(), tris.end());
+    return tris;
+}
+
+static void Analyze() {
+    // One triangle, then the same one again from the cache.
+    const GLuint twice[] = { 0, 1, 2, 2, 1, 0 };
+    VertexCacheStats stats = AnalyzeVertexCache(twice, 6, 3, VERTEX_CACHE_SIZE);
+    TEST_CHECK(stats.misses == 3 && stats.triangles == 2 && stats.vertices == 3);
+    TEST_CHECK(stats.acmr == 1.5f && stats.atvr == 1.0f);
+
+    // A three-entry cache has pushed vertex 0 out by the time it returns.
+    const GLuint evicted[] = { 0, 1, 2, 1, 2, 3, 0, 2, 3 };
+    stats = AnalyzeVertexCache(evicted, 9, 4, 3);
+    TEST_CHECK(stats.misses == 5 && stats.vertices == 4);
+
+    StaticMesh soup;
+    Test_AppendSoup(&soup, 300, 2000, 31);
+    for (unsigned cachesize : { 3u, 16u, 32u }) {
+        stats = AnalyzeVertexCache(soup.indices.data(), soup.indices.size(), 300, cachesize);
+        TEST_CHECK(stats.misses == ReferenceMisses(soup.indices.data(), soup.indices.size(), cachesize));
+    }
+}
+
+// Both reorderings only permute the triangles, and the cache order does
+// not do worse than the input; the overdraw order gives up at most its
+// threshold of that, plus the cold cache at each cluster it cut.
+static void Reorder(const StaticMesh& mesh, float maxAcmr) {
+    const StaticSubmesh& sub = mesh.submeshes[0];
+    const GLuint* indices = mesh.indices.data() + sub.firstIndex;
+    const GlStaticMeshVert* verts = mesh.vertices.data() + sub.baseVertex;
+    std::vector<GLuint> cached(sub.numIndices), overdrawn(sub.numIndices);
+    OptimizeVertexCache(cached.data(), indices, sub.numIndices, sub.numVertices, VERTEX_CACHE_SIZE);
+    OptimizeOverdraw(overdrawn.data(), cached.data(), sub.numIndices, verts, sub.numVertices, VERTEX_CACHE_SIZE, 1.05f);
+
+    std::vector<uint64_t> input = TriangleSet(indices, sub.numIndices);
+    TEST_CHECK(TriangleSet(cached.data(), sub.numIndices) == input);
+    TEST_CHECK(TriangleSet(overdrawn.data(), sub.numIndices) == input);
+
+    float before = AnalyzeVertexCache(indices, sub.numIndices, sub.numVertices, VERTEX_CACHE_SIZE).acmr;
+    float after = AnalyzeVertexCache(cached.data(), sub.numIndices, sub.numVertices, VERTEX_CACHE_SIZE).acmr;
+    float sorted = AnalyzeVertexCache(overdrawn.data(), sub.numIndices, sub.numVertices, VERTEX_CACHE_SIZE).acmr;
+    TEST_CHECK(after <= before);
+    TEST_CHECK(after <= maxAcmr);
+    TEST_CHECK(sorted <= after * 1.05f + 0.05f);
+}
+
+// Vertices come out in first-use order without the unreferenced ones, and
+// every index still reaches the vertex it did.
+static void Fetch(const StaticMesh& mesh) {
+    const StaticSubmesh& sub = mesh.submeshes[0];
+    std::vector<GLuint> indices(mesh.indices.begin() + sub.firstIndex, mesh.indices.begin() + sub.firstIndex + sub.numIndices);
+    const GlStaticMeshVert* verts = mesh.vertices.data() + sub.baseVertex;
+    std::vector<GlStaticMeshVert> fetched(sub.numVertices);
+    size_t used = OptimizeVertexFetch(fetched.data(), indices.data(), indices.size(), verts, sub.numVertices);
+
+    std::vector<GLuint> firstUse;
+    std::vector<bool> seen(sub.numVertices);
+    for (GLuint i = 0; i < sub.numIndices; ++i) {
+        GLuint v = mesh.indices[sub.firstIndex + i];
+        if (!seen[v]) firstUse.push_back(v);
+        seen[v] = true;
+    }
+    if (!TEST_CHECK(used == firstUse.size())) return;
+
+    bool order = true, same = true, ascending = true;
+    for (size_t v = 0; v < used; ++v) order &= memcmp(&fetched[v], &verts[firstUse[v]], sizeof(GlStaticMeshVert)) == 0;
+    GLuint highest = 0;
+    for (size_t i = 0; i < indices.size(); ++i) {
+        GLuint v = indices[i];
+        ascending &= v <= highest + (i > 0);
+        highest = std::max(highest, v);
+        same &= v < used && memcmp(&fetched[v], &verts[mesh.indices[sub.firstIndex + i]], sizeof(GlStaticMeshVert)) == 0;
+    }
+    TEST_CHECK(order);
+    TEST_CHECK(same);
+    TEST_CHECK(ascending);
+}
+
+void Test_MeshOptimize() {
+    Analyze();
+
+    // Rows of a sphere are already decent; shuffled, they start out as bad
+    // as a soup, and both end up near the 0.5 - 0.7 of a regular grid.
+    StaticMesh sphere;
+    Test_AppendSphere(&sphere, glm::vec3 { 0.0f }, 1.0f, 64, 128);
+    Reorder(sphere, 0.75f);
+
+    StaticMesh shuffled = sphere;
+    std::mt19937 rng(32);
+    for (size_t t = shuffled.indices.size() / 3; t > 1; --t) {
+        size_t u = rng() % t;
+        std::swap_ranges(shuffled.indices.begin() + (t - 1) * 3, shuffled.indices.begin() + t * 3, shuffled.indices.begin() + u * 3);
+    }
+    Reorder(shuffled, 0.75f);
+
+    // Random triangles share few vertices, so the most to gain is what the
+    // input misses by chance.
+    StaticMesh soup;
+    Test_AppendSoup(&soup, 5000, 3000 * (uint32_t) testFuzzScale, 33);
+    Reorder(soup, 2.5f);
+
+    Fetch(sphere);
+    Fetch(shuffled);
+    Fetch(soup);
+}
@@ -0,0 +1,154 @@
+#include "tests.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <glm/geometric.hpp>
+
+#include "../mesh_tangents.hpp"
+#include "test_meshes.hpp"
+
+// Every tangent is a unit vector in its vertex's normal plane with a sign of
+// exactly one, and every other attribute of every corner is left as it was.
+static void Frames(const StaticMesh& before, const StaticMesh& after) {
+    bool unit = true, same = true;
+    for (const GlStaticMeshVert& v : after.vertices) {
+        glm::vec3 t { v.tang };
+        unit &= fabsf(glm::length(t) - 1.0f) < 1e-5f && fabsf(glm::dot(t, v.norm)) < 1e-5f && fabsf(v.tang.w) == 1.0f;
+    }
+    for (size_t s = 0; s < before.submeshes.size(); ++s) {
+        const StaticSubmesh& in = before.submeshes[s];
+        const StaticSubmesh& out = after.submeshes[s];
+        for (GLuint i = 0; i < in.numIndices; ++i) {
+            GlStaticMeshVert a = before.vertices[in.baseVertex + before.indices[in.firstIndex + i]];
+            GlStaticMeshVert b = after.vertices[out.baseVertex + after.indices[out.firstIndex + i]];
+            a.tang = b.tang = glm::vec4 { 0.0f };
+            same &= memcmp(&a, &b, sizeof(a)) == 0;
+        }
+    }
+    TEST_CHECK(unit);
+    TEST_CHECK(same);
+}
+
+// Tangents of a sphere whose u runs along the longitude, backwards on the
+// half with s below segments / 2 when mirrored, against the analytic frame:
+// the direction of increasing u, with the sign that makes the rebuilt
+// bitangent point along increasing v. Poles have no u direction and are left
+// to Frames.
+static void Sphere(uint32_t rings, uint32_t segments, bool mirrored) {
+    StaticMesh mesh;
+    Test_AppendSphere(&mesh, glm::vec3 { 1.0f, 2.0f, 3.0f }, 2.0f, rings, segments);
+    std::vector<glm::vec4> analytic(mesh.vertices.size());
+    for (size_t v = 0; v < mesh.vertices.size(); ++v) {
+        GlStaticMeshVert& vert = mesh.vertices[v];
+        analytic[v] = vert.tang;
+        vert.tang = glm::vec4 { 0.0f };
+        if (mirrored) vert.coord.x = fabsf(vert.coord.x - 0.5f);
+    }
+    StaticMesh before = mesh;
+    GenerateStaticMeshTangents(&mesh);
+    Frames(before, mesh);
+
+    // Only the vertices on the mirror line see both windings, one per ring
+    // between the poles.
+    TEST_CHECK(mesh.vertices.size() == before.vertices.size() + (mirrored ? rings - 1 : 0));
+
+    // Inside a strip, rows of equal width on both sides keep the averaged
+    // direction along the longitude up to float rounding. On the u seam and
+    // the mirror line every triangle lies on one side, and their edges along
+    // a ring turn the direction by up to half a segment's angle.
+    float worst = 0.0f, worstEdge = 0.0f;
+    bool sign = true;
+    for (size_t t = 0; t < mesh.indices.size() / 3; ++t) {
+        // Which half the triangle lies on, from its corners' segments.
+        uint32_t hi = 0;
+        for (int k = 0; k < 3; ++k) hi = std::max(hi, before.indices[t * 3 + k] % (segments + 1));
+        bool backwards = mirrored && hi <= segments / 2;
+        for (int k = 0; k < 3; ++k) {
+            GLuint in = before.indices[t * 3 + k];
+            uint32_t r = in / (segments + 1), s = in % (segments + 1);
+            if (r == 0 || r == rings) continue;
+            glm::vec4 want = analytic[in] * (backwards ? -1.0f : 1.0f);
+            glm::vec4 got = mesh.vertices[mesh.indices[t * 3 + k]].tang;
+            bool edge = s == 0 || s == segments || (mirrored && s == segments / 2);
+            float& w = edge ? worstEdge : worst;
+            w = std::max(w, glm::length(glm::vec3 { got } - glm::vec3 { want }));
+            sign &= got.w == want.w;
+        }
+    }
+    TEST_CHECK(worst < 1e-4f);
+    TEST_CHECK(worstEdge < 2.0f * sinf(3.14159265f / 2.0f / segments) + 1e-4f);
+    TEST_CHECK(sign);
+}
+
+// A flat n by n grid whose u is mirrored about its middle column, as
+// symmetric models lay out their halves: the middle column is split once
+// per vertex, and every triangle then reads exactly +x or -x from all three
+// corners, with the sign that keeps the bitangent along +y.
+static void MirroredGrid(uint32_t n) {
+    StaticMesh mesh;
+    StaticSubmesh sub {};
+    for (uint32_t y = 0; y <= n; ++y) {
+        for (uint32_t x = 0; x <= n; ++x) {
+            GlStaticMeshVert v {};
+            v.pos = glm::vec3 { (float) x, (float) y, 0.0f };
+            v.norm = glm::vec3 { 0.0f, 0.0f, 1.0f };
+            v.coord = glm::vec2 { fabsf((float) x - 0.5f * n) / n, (float) y / n };
+            mesh.vertices.push_back(v);
+        }
+    }
+    for (uint32_t y = 0; y < n; ++y) {
+        for (uint32_t x = 0; x < n; ++x) {
+            GLuint a = y * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+            mesh.indices.insert(mesh.indices.end(), { a, b, c, b, d, c });
+        }
+    }
+    sub.numVertices = (GLuint) mesh.vertices.size();
+    sub.numIndices = (GLuint) mesh.indices.size();
+    mesh.submeshes.push_back(sub);
+
+    StaticMesh before = mesh;
+    GenerateStaticMeshTangents(&mesh);
+    Frames(before, mesh);
+    TEST_CHECK(mesh.vertices.size() == before.vertices.size() + n + 1);
+
+    bool exact = true;
+    for (size_t t = 0; t < mesh.indices.size() / 3; ++t) {
+        // Column of the triangle's cell: both triangles of a cell start at
+        // or next to its lower-left corner.
+        uint32_t x = before.indices[t * 3] % (n + 1) - (t % 2);
+        glm::vec4 want = x < n / 2 ? glm::vec4 { -1.0f, 0.0f, 0.0f, -1.0f } : glm::vec4 { 1.0f, 0.0f, 0.0f, 1.0f };
+        for (int k = 0; k < 3; ++k) exact &= mesh.vertices[mesh.indices[t * 3 + k]].tang == want;
+    }
+    TEST_CHECK(exact);
+}
+
+// Vertices whose triangles have no uv extent or no area get no direction
+// from them, and unreferenced ones none at all; all still come out with
+// some unit tangent in their normal plane.
+static void Degenerate() {
+    StaticMesh mesh;
+    Test_AppendSoup(&mesh, 60, 40, 61);
+    for (size_t v = 0; v < mesh.vertices.size(); ++v) {
+        GlStaticMeshVert& vert = mesh.vertices[v];
+        vert.tang = glm::vec4 { 0.0f };
+        if (v < 30) vert.coord = glm::vec2 { 0.25f };
+        if (v % 3 == 0) vert.pos = glm::vec3 { 1.0f };
+    }
+    mesh.indices.insert(mesh.indices.end(), { 0, 1, 2, 3, 6, 9 });
+    mesh.submeshes[0].numIndices += 6;
+    StaticMesh before = mesh;
+    GenerateStaticMeshTangents(&mesh);
+    Frames(before, mesh);
+}
+
+void Test_MeshTangents() {
+    Sphere(16, 32, false);
+    Sphere(64, 128, false);
+    Sphere(16, 32, true);
+    Sphere(64, 128, true);
+    MirroredGrid(8);
+    MirroredGrid(64);
+    Degenerate();
+}
@@ -0,0 +1,175 @@
+#include "tests.hpp"
+
+#include <string.h>
+#include <vector>
+
+#include "../mesh_weld.hpp"
+#include "test_meshes.hpp"
+
+static bool SameVert(const GlStaticMeshVert& a, const GlStaticMeshVert& b) {
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// Each submesh of mesh with every index given a vertex of its own, as an
+// importer hands over unindexed triangles.
+static StaticMesh Explode(const StaticMesh& mesh) {
+    StaticMesh out;
+    for (const StaticSubmesh& sub : mesh.submeshes) {
+        StaticSubmesh chunk { (GLint) out.vertices.size(), sub.numIndices, (GLuint) out.indices.size(), sub.numIndices, sub.material };
+        for (GLuint i = 0; i < sub.numIndices; ++i) {
+            out.vertices.push_back(mesh.vertices[sub.baseVertex + mesh.indices[sub.firstIndex + i]]);
+            out.indices.push_back(i);
+        }
+        out.submeshes.push_back(chunk);
+    }
+    return out;
+}
+
+// Welding an exploded mesh brings back one vertex per distinct input
+// vertex, in order of first use, and every index still finds the vertex it
+// had.
+static void WeldExploded(const StaticMesh& mesh) {
+    StaticMesh exploded = Explode(mesh);
+    StaticMesh welded = exploded;
+    WeldStaticMesh(&welded, WELD_EPSILON);
+    if (!TEST_CHECK(welded.submeshes.size() == exploded.submeshes.size())) return;
+
+    GLint next = 0;
+    for (size_t s = 0; s < welded.submeshes.size(); ++s) {
+        const StaticSubmesh& in = exploded.submeshes[s];
+        const StaticSubmesh& out = welded.submeshes[s];
+        TEST_CHECK(out.baseVertex == next);
+        TEST_CHECK(out.firstIndex == in.firstIndex && out.numIndices == in.numIndices && out.material == in.material);
+        next += (GLint) out.numVertices;
+
+        std::vector<GLuint> firstUse;
+        std::vector<bool> seen(mesh.submeshes[s].numVertices);
+        for (GLuint i = 0; i < in.numIndices; ++i) {
+            GLuint v = mesh.indices[mesh.submeshes[s].firstIndex + i];
+            if (!seen[v]) firstUse.push_back(v);
+            seen[v] = true;
+        }
+        if (!TEST_CHECK(out.numVertices == firstUse.size())) continue;
+
+        bool order = true, remapped = true;
+        for (size_t v = 0; v < firstUse.size(); ++v) {
+            order &= SameVert(welded.vertices[out.baseVertex + v], mesh.vertices[mesh.submeshes[s].baseVertex + firstUse[v]]);
+        }
+        for (GLuint i = 0; i < in.numIndices; ++i) {
+            GLuint v = welded.indices[out.firstIndex + i];
+            remapped &= v < out.numVertices
+                     && SameVert(welded.vertices[out.baseVertex + v], exploded.vertices[in.baseVertex + i]);
+        }
+        TEST_CHECK(order);
+        TEST_CHECK(remapped);
+    }
+    TEST_CHECK(welded.vertices.size() == (size_t) next);
+}
+
+// Vertices one grid step apart in any single component stay apart, and
+// ones a third of a step off a grid point merge into it. Two anchors fix
+// the range of every component to [0, 1], so a step is WELD_EPSILON.
+static void OneStepApart() {
+    std::vector<GlStaticMeshVert> verts;
+    auto make = [](float value) {
+        GlStaticMeshVert v {};
+        v.pos = glm::vec3 { value };
+        v.norm = glm::vec3 { value };
+        v.coord = glm::vec2 { value };
+        return v;
+    };
+    auto component = [](GlStaticMeshVert& v, int c) -> float& {
+        return c < 3 ? v.pos[c] : c < 6 ? v.norm[c - 3] : v.coord[c - 6];
+    };
+    verts.push_back(make(0.0f));
+    verts.push_back(make(1.0f));
+    verts.push_back(make(0.5f));
+    for (int c = 0; c < 8; ++c) {
+        GlStaticMeshVert apart = make(0.5f), near = make(0.5f);
+        component(apart, c) += WELD_EPSILON;
+        component(near, c) -= WELD_EPSILON / 3.0f;
+        verts.push_back(apart);
+        verts.push_back(near);
+    }
+    std::vector<GLuint> indices(verts.size());
+    for (GLuint i = 0; i < indices.size(); ++i) indices[i] = i;
+
+    std::vector<GlStaticMeshVert> original = verts;
+    size_t count = WeldVertices(verts.data(), verts.size(), indices.data(), indices.size(), WELD_EPSILON);
+    TEST_CHECK(count == 3 + 8);
+    for (int c = 0; c < 8; ++c) {
+        TEST_CHECK(indices[3 + 2 * c] == (GLuint) (3 + c));
+        TEST_CHECK(SameVert(verts[3 + c], original[3 + 2 * c]));
+        TEST_CHECK(indices[4 + 2 * c] == 2);
+    }
+}
+
+// Chunks of a split submesh stay within 16-bit indices and, walked in
+// order, draw exactly the triangles of the submesh, lightmap coordinates
+// included; a submesh that already fits stays one chunk.
+static void Split() {
+    StaticMesh mesh;
+    Test_AppendSoup(&mesh, 200000, 150000 * (uint32_t) testFuzzScale, 21);
+    Test_AppendSphere(&mesh, glm::vec3 { 0.0f }, 1.0f, 300, 300);
+    Test_AppendSoup(&mesh, 100, 50, 22);
+    for (const GlStaticMeshVert& v : mesh.vertices) mesh.lightmapCoords.push_back(glm::vec2 { v.pos.x, v.coord.y });
+    TEST_CHECK(StaticMeshIndexType(mesh) == GL_UNSIGNED_INT);
+
+    StaticMesh split = mesh;
+    SplitStaticMesh(&split);
+    TEST_CHECK(StaticMeshIndexType(split) == GL_UNSIGNED_SHORT);
+    if (!TEST_CHECK(split.lightmapCoords.size() == split.vertices.size())) return;
+
+    size_t c = 0;
+    GLuint nextIndex = 0;
+    GLint nextVertex = 0;
+    for (size_t s = 0; s < mesh.submeshes.size(); ++s) {
+        const StaticSubmesh& sub = mesh.submeshes[s];
+        GLuint i = 0;
+        bool same = true, inRange = true, chunked = true;
+        for (; c < split.submeshes.size() && i < sub.numIndices && split.submeshes[c].material == sub.material; ++c) {
+            const StaticSubmesh& chunk = split.submeshes[c];
+            chunked &= chunk.baseVertex == nextVertex && chunk.firstIndex == nextIndex && chunk.numIndices % 3 == 0;
+            chunked &= chunk.numVertices > 0 && chunk.numVertices <= MAX_SHORT_INDEXED_VERTICES;
+            nextVertex += (GLint) chunk.numVertices;
+            nextIndex += chunk.numIndices;
+            for (GLuint k = 0; k < chunk.numIndices && i < sub.numIndices; ++k, ++i) {
+                GLuint v = split.indices[chunk.firstIndex + k];
+                GLuint w = sub.baseVertex + mesh.indices[sub.firstIndex + i];
+                inRange &= v < chunk.numVertices;
+                if (v >= chunk.numVertices) continue;
+                same &= SameVert(split.vertices[chunk.baseVertex + v], mesh.vertices[w]);
+                same &= split.lightmapCoords[chunk.baseVertex + v] == mesh.lightmapCoords[w];
+            }
+        }
+        TEST_CHECK(i == sub.numIndices);
+        TEST_CHECK(chunked);
+        TEST_CHECK(inRange);
+        TEST_CHECK(same);
+    }
+    TEST_CHECK(c == split.submeshes.size());
+    TEST_CHECK(split.vertices.size() == (size_t) nextVertex);
+    TEST_CHECK(split.indices.size() == nextIndex);
+
+    const StaticSubmesh& last = split.submeshes.back();
+    TEST_CHECK(last.numVertices <= 100 && last.numIndices == 150);
+    TEST_CHECK(split.submeshes.size() > 4);
+}
+
+void Test_MeshWeld() {
+    // Far from the origin the grid still spans just the mesh, where an
+    // absolute one would overflow its 32-bit cells.
+    StaticMesh far;
+    Test_AppendSphere(&far, glm::vec3 { 5e4f, -3e5f, 2e3f }, 100.0f, 128, 256);
+    Test_AppendSoup(&far, 3000, 2000, 20);
+    const StaticSubmesh& soup = far.submeshes[1];
+    for (GLuint v = 0; v < soup.numVertices; ++v) far.vertices[soup.baseVertex + v].pos += glm::vec3 { -3e5f, 5e4f, 0.0f };
+    WeldExploded(far);
+
+    StaticMesh near;
+    Test_AppendSphere(&near, glm::vec3 { 0.0f }, 1.0f, 16, 32);
+    WeldExploded(near);
+
+    OneStepApart();
+    Split();
+}
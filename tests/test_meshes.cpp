@@ -0,0 +1,64 @@
+#include "test_meshes.hpp"
+
+#include <math.h>
+#include <random>
+#include <glm/geometric.hpp>
+
+static const float PI = 3.14159265358979f;
+
+void Test_AppendSphere(StaticMesh* mesh, glm::vec3 center, float radius, uint32_t rings, uint32_t segments) {
+    StaticSubmesh sub {};
+    sub.baseVertex = (GLint) mesh->vertices.size();
+    sub.firstIndex = (GLuint) mesh->indices.size();
+    sub.material = (GLuint) mesh->submeshes.size();
+    for (uint32_t r = 0; r <= rings; ++r) {
+        // The poles and the seam's copies land on exactly the same point.
+        float theta = PI * r / rings;
+        float st = r == 0 || r == rings ? 0.0f : sinf(theta), ct = r == 0 ? 1.0f : r == rings ? -1.0f : cosf(theta);
+        for (uint32_t s = 0; s <= segments; ++s) {
+            float phi = 2.0f * PI * (s % segments) / segments;
+            glm::vec3 n { st * cosf(phi), ct, st * sinf(phi) };
+            GlStaticMeshVert v {};
+            v.pos = center + n * radius;
+            v.norm = n;
+            v.tang = glm::vec4 { -sinf(phi), 0.0f, cosf(phi), 1.0f };
+            v.coord = glm::vec2 { (float) s / segments, (float) r / rings };
+            mesh->vertices.push_back(v);
+        }
+    }
+    for (uint32_t r = 0; r < rings; ++r) {
+        for (uint32_t s = 0; s < segments; ++s) {
+            GLuint a = r * (segments + 1) + s, b = a + 1, c = a + segments + 1, d = c + 1;
+            if (r > 0) mesh->indices.insert(mesh->indices.end(), { a, b, c });
+            if (r + 1 < rings) mesh->indices.insert(mesh->indices.end(), { b, d, c });
+        }
+    }
+    sub.numVertices = (GLuint) mesh->vertices.size() - sub.baseVertex;
+    sub.numIndices = (GLuint) mesh->indices.size() - sub.firstIndex;
+    mesh->submeshes.push_back(sub);
+}
+
+void Test_AppendSoup(StaticMesh* mesh, uint32_t numverts, uint32_t numtris, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    StaticSubmesh sub {};
+    sub.baseVertex = (GLint) mesh->vertices.size();
+    sub.firstIndex = (GLuint) mesh->indices.size();
+    sub.material = (GLuint) mesh->submeshes.size();
+    for (uint32_t i = 0; i < numverts; ++i) {
+        GlStaticMeshVert v {};
+        v.pos = glm::vec3 { unit(rng), unit(rng), unit(rng) } * 10.0f;
+        v.norm = glm::normalize(glm::vec3 { unit(rng), unit(rng), unit(rng) } + glm::vec3 { 0.0f, 0.0f, 1e-3f });
+        glm::vec3 t = glm::normalize(glm::cross(v.norm, fabsf(v.norm.y) < 0.9f ? glm::vec3 { 0, 1, 0 } : glm::vec3 { 1, 0, 0 }));
+        v.tang = glm::vec4 { t, rng() & 1 ? 1.0f : -1.0f };
+        v.coord = glm::vec2 { unit(rng), unit(rng) } * 4.0f;
+        mesh->vertices.push_back(v);
+    }
+    for (uint32_t t = 0; t < numtris; ++t) {
+        GLuint a = rng() % numverts, b = rng() % numverts, c = rng() % numverts;
+        mesh->indices.insert(mesh->indices.end(), { a, b, c });
+    }
+    sub.numVertices = numverts;
+    sub.numIndices = numtris * 3;
+    mesh->submeshes.push_back(sub);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include <glm/vec3.hpp>
+
+#include "../static_mesh.hpp"
+
+// Synthetic meshes for the tests, each appended to mesh as a submesh of its
+// own with material set to its submesh index.
+
+// A UV sphere with full vertex frames, the u seam and the poles duplicated
+// at exactly the same positions: smooth, closed, locally ordered input like
+// an optimized import.
+void Test_AppendSphere(StaticMesh* mesh, glm::vec3 center, float radius, uint32_t rings, uint32_t segments);
+
+// Random vertices joined by random triangles: no locality at all.
+void Test_AppendSoup(StaticMesh* mesh, uint32_t numverts, uint32_t numtris, uint32_t seed);
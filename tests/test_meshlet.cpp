@@ -0,0 +1,145 @@
+#include "tests.hpp"
+
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../meshlet.hpp"
+#include "test_meshes.hpp"
+
+// Meshlets tile every submesh's index range in order, within both limits,
+// and their spheres hold all of their vertices.
+static void Limits(const StaticMesh& mesh, const std::vector<Meshlet>& meshlets) {
+    size_t m = 0;
+    std::vector<GLuint> distinct;
+    for (size_t s = 0; s < mesh.submeshes.size(); ++s) {
+        const StaticSubmesh& sub = mesh.submeshes[s];
+        GLuint next = sub.firstIndex;
+        for (; m < meshlets.size() && meshlets[m].submesh == s; ++m) {
+            const Meshlet& meshlet = meshlets[m];
+            TEST_CHECK(meshlet.firstIndex == next);
+            TEST_CHECK(meshlet.baseVertex == sub.baseVertex);
+            TEST_CHECK(meshlet.numIndices > 0 && meshlet.numIndices % 3 == 0);
+            TEST_CHECK(meshlet.numIndices / 3 <= MESHLET_MAX_TRIANGLES);
+            next = meshlet.firstIndex + meshlet.numIndices;
+
+            const GLuint* indices = mesh.indices.data() + meshlet.firstIndex;
+            distinct.assign(indices, indices + meshlet.numIndices);
+            std::sort(distinct.begin(), distinct.end());
+            TEST_CHECK(std::unique(distinct.begin(), distinct.end()) - distinct.begin() <= (ptrdiff_t) MESHLET_MAX_VERTICES);
+
+            bool inside = true;
+            for (GLuint v : distinct) {
+                glm::vec3 p = mesh.vertices[sub.baseVertex + v].pos;
+                inside &= glm::length(p - meshlet.center) <= meshlet.radius * (1.0f + 1e-5f) + 1e-6f;
+            }
+            TEST_CHECK(inside);
+        }
+        TEST_CHECK(next == sub.firstIndex + sub.numIndices);
+    }
+    TEST_CHECK(m == meshlets.size());
+}
+
+// Whether every triangle of meshlet with area faces away from eye, or
+// points exactly edge-on; the cone test must never claim more than that.
+static bool AllBackfacing(const StaticMesh& mesh, const Meshlet& meshlet, glm::vec3 eye) {
+    const GLuint* indices = mesh.indices.data() + meshlet.firstIndex;
+    const GlStaticMeshVert* verts = mesh.vertices.data() + meshlet.baseVertex;
+    for (GLuint i = 0; i < meshlet.numIndices; i += 3) {
+        glm::vec3 a = verts[indices[i]].pos, b = verts[indices[i + 1]].pos, c = verts[indices[i + 2]].pos;
+        glm::vec3 n = glm::cross(b - a, c - a);
+        if (glm::dot(n, n) == 0.0f) continue;
+        if (glm::dot(glm::normalize(n), glm::normalize(eye - a)) > 1e-4f) return false;
+    }
+    return true;
+}
+
+// Whether every vertex of meshlet lies outside one clip plane of mvp.
+static bool AllOutside(const StaticMesh& mesh, const Meshlet& meshlet, const glm::mat4& mvp) {
+    const GLuint* indices = mesh.indices.data() + meshlet.firstIndex;
+    const GlStaticMeshVert* verts = mesh.vertices.data() + meshlet.baseVertex;
+    for (int plane = 0; plane < 6; ++plane) {
+        bool outside = true;
+        for (GLuint i = 0; i < meshlet.numIndices && outside; ++i) {
+            glm::vec4 clip = mvp * glm::vec4 { verts[indices[i]].pos, 1.0f };
+            float d = plane & 1 ? clip.w - clip[plane / 2] : clip.w + clip[plane / 2];
+            outside = d < 1e-4f * fabsf(clip.w);
+        }
+        if (outside) return true;
+    }
+    return false;
+}
+
+// From random eyes around and inside the mesh: culling only ever removes
+// meshlets the brute-force tests agree are invisible, the draw list covers
+// exactly the rest, and a convex mesh seen from outside loses a fair share
+// of its back to the cone test.
+static void Culling(const StaticMesh& mesh, const std::vector<Meshlet>& meshlets, float reach, float minBackfacing) {
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    glm::mat4 model = glm::translate(glm::mat4 { 1.0f }, glm::vec3 { 3.0f, -1.0f, 2.0f });
+    size_t backfacing = 0, truthBackfacing = 0;
+    for (int view = 0; view < 64; ++view) {
+        glm::vec3 eye { unit(rng), unit(rng), unit(rng) };
+        eye *= reach * (view < 8 ? 0.3f : 1.0f) / std::max(glm::length(eye), 1e-3f);
+        glm::vec3 target { unit(rng), unit(rng), unit(rng) };
+        glm::vec3 worldEye = glm::vec3 { model * glm::vec4 { eye, 1.0f } };
+        glm::vec3 worldTarget = glm::vec3 { model * glm::vec4 { target, 1.0f } };
+        glm::mat4 modelview = glm::lookAt(worldEye, worldTarget, glm::vec3 { 0, 1, 0 }) * model;
+        glm::mat4 mvp = glm::perspective(0.9f, 16.0f / 9.0f, 0.05f, 100.0f) * modelview;
+        MeshletView mv = MakeMeshletView(mvp, modelview);
+        TEST_CHECK(glm::length(mv.eye - eye) < 1e-3f * std::max(1.0f, reach));
+
+        size_t drawnIndices = 0;
+        for (const Meshlet& m : meshlets) {
+            bool outside = Meshlet_IsOutside(m, mv), back = !outside && Meshlet_IsBackfacing(m, mv);
+            if (outside) TEST_CHECK(AllOutside(mesh, m, mvp));
+            if (Meshlet_IsBackfacing(m, mv)) TEST_CHECK(AllBackfacing(mesh, m, eye));
+            if (!outside && !back) drawnIndices += m.numIndices;
+            if (view >= 8) {
+                backfacing += Meshlet_IsBackfacing(m, mv);
+                truthBackfacing += AllBackfacing(mesh, m, eye);
+            }
+        }
+
+        MeshletDrawList list;
+        CullMeshlets(&list, meshlets.data(), meshlets.size(), mv, sizeof(GLuint));
+        TEST_CHECK(list.visible + list.backfacing + list.outside == meshlets.size());
+        size_t listed = 0;
+        for (GLsizei count : list.counts) listed += (size_t) count;
+        TEST_CHECK(listed == drawnIndices);
+        TEST_CHECK(list.offsets.size() == list.counts.size() && list.baseVertices.size() == list.counts.size());
+    }
+    TEST_CHECK(backfacing >= minBackfacing * truthBackfacing);
+}
+
+void Test_Meshlet() {
+    // Vertex-limited: a sphere, with a second one so meshlets restart per
+    // submesh.
+    StaticMesh spheres;
+    Test_AppendSphere(&spheres, glm::vec3 { 0.0f }, 1.0f, 48, 64);
+    Test_AppendSphere(&spheres, glm::vec3 { 0.2f, 0.1f, 0.0f }, 0.5f, 9, 13);
+    std::vector<Meshlet> meshlets;
+    BuildMeshlets(&meshlets, spheres);
+    Limits(spheres, meshlets);
+    Culling(spheres, meshlets, 4.0f, 0.35f);
+
+    // Triangle-limited: many triangles over few vertices.
+    StaticMesh dense;
+    Test_AppendSoup(&dense, 24, 2000, 7);
+    meshlets.clear();
+    BuildMeshlets(&meshlets, dense);
+    Limits(dense, meshlets);
+    TEST_CHECK(meshlets.size() == (2000 + MESHLET_MAX_TRIANGLES - 1) / MESHLET_MAX_TRIANGLES);
+
+    // Neither limit binds for long: random triangles over many vertices.
+    StaticMesh soup;
+    Test_AppendSoup(&soup, 5000, 3000, 8);
+    meshlets.clear();
+    BuildMeshlets(&meshlets, soup);
+    Limits(soup, meshlets);
+    Culling(soup, meshlets, 30.0f, 0.0f);
+}
@@ -0,0 +1,247 @@
+#include "tests.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../offset_allocator.hpp"
+
+// Ten equal allocations fill the space exactly, the last one through the
+// bin below its rounded-up size, and freeing them all leaves one range.
+static void ExactFill() {
+    OffsetAllocator alloc;
+    OffsetAllocator_Init(&alloc, 1000, 16);
+    std::vector<uint32_t> nodes;
+    for (uint32_t i = 0; i < 10; ++i) {
+        OffsetAllocation a = OffsetAllocator_Alloc(&alloc, 100);
+        if (!TEST_CHECK(a.node != OFFSET_ALLOC_NONE)) return;
+        TEST_CHECK(a.offset == i * 100);
+        nodes.push_back(a.node);
+    }
+    TEST_CHECK(alloc.freeStorage == 0);
+    TEST_CHECK(OffsetAllocator_Alloc(&alloc, 1).node == OFFSET_ALLOC_NONE);
+    TEST_CHECK(OffsetAllocator_Validate(alloc));
+
+    // Out of order, so frees merge on either side.
+    for (uint32_t i : { 3, 1, 2, 0, 9, 5, 7, 6, 8, 4 }) OffsetAllocator_Free(&alloc, nodes[i]);
+    OffsetAllocatorStats stats = OffsetAllocator_Stats(alloc);
+    TEST_CHECK(stats.numAllocs == 0);
+    TEST_CHECK(stats.numFreeRanges == 1);
+    TEST_CHECK(stats.largestFree == 1000);
+    TEST_CHECK(OffsetAllocator_Validate(alloc));
+
+    OffsetAllocation whole = OffsetAllocator_Alloc(&alloc, 1000);
+    TEST_CHECK(whole.node != OFFSET_ALLOC_NONE && whole.offset == 0);
+    TEST_CHECK(OffsetAllocator_Alloc(&alloc, 0).node == OFFSET_ALLOC_NONE);
+}
+
+// A second free of the same node is refused and changes nothing.
+static void DoubleFree() {
+    OffsetAllocator alloc;
+    OffsetAllocator_Init(&alloc, 256, 8);
+    OffsetAllocation a = OffsetAllocator_Alloc(&alloc, 64);
+    OffsetAllocation b = OffsetAllocator_Alloc(&alloc, 64);
+    TEST_CHECK(OffsetAllocator_Free(&alloc, a.node));
+    TEST_CHECK(!OffsetAllocator_Free(&alloc, a.node));
+    TEST_CHECK(alloc.numAllocs == 1);
+    TEST_CHECK(alloc.freeStorage == 192);
+    TEST_CHECK(OffsetAllocator_Validate(alloc));
+
+    TEST_CHECK(OffsetAllocator_Free(&alloc, b.node));
+    TEST_CHECK(!OffsetAllocator_Free(&alloc, b.node));
+    TEST_CHECK(alloc.numAllocs == 0);
+    TEST_CHECK(alloc.freeStorage == 256);
+    TEST_CHECK(OffsetAllocator_Validate(alloc));
+}
+
+// Allocations stop at maxAllocs whatever space is left, and resume after a
+// free.
+static void MaxAllocs() {
+    OffsetAllocator alloc;
+    OffsetAllocator_Init(&alloc, 1000, 4);
+    std::vector<uint32_t> nodes;
+    for (int i = 0; i < 4; ++i) {
+        OffsetAllocation a = OffsetAllocator_Alloc(&alloc, 10);
+        TEST_CHECK(a.node != OFFSET_ALLOC_NONE);
+        nodes.push_back(a.node);
+    }
+    TEST_CHECK(OffsetAllocator_Alloc(&alloc, 10).node == OFFSET_ALLOC_NONE);
+    TEST_CHECK(OffsetAllocator_Validate(alloc));
+    OffsetAllocator_Free(&alloc, nodes[1]);
+    TEST_CHECK(OffsetAllocator_Alloc(&alloc, 10).node != OFFSET_ALLOC_NONE);
+    TEST_CHECK(OffsetAllocator_Alloc(&alloc, 10).node == OFFSET_ALLOC_NONE);
+    TEST_CHECK(OffsetAllocator_Validate(alloc));
+}
+
+// The largest space allowed, 2^31 - 1: sizes in the top bins, offsets near
+// the end and requests past it.
+static void LargestSpace() {
+    const uint32_t SPACE = 0x7fffffff;
+    OffsetAllocator alloc;
+    OffsetAllocator_Init(&alloc, SPACE, 8);
+
+    OffsetAllocation whole = OffsetAllocator_Alloc(&alloc, SPACE);
+    TEST_CHECK(whole.node != OFFSET_ALLOC_NONE && whole.offset == 0);
+    TEST_CHECK(alloc.freeStorage == 0);
+    OffsetAllocator_Free(&alloc, whole.node);
+
+    TEST_CHECK(OffsetAllocator_Alloc(&alloc, 0x80000000u).node == OFFSET_ALLOC_NONE);
+    TEST_CHECK(OffsetAllocator_Alloc(&alloc, 0xffffffffu).node == OFFSET_ALLOC_NONE);
+
+    OffsetAllocation low = OffsetAllocator_Alloc(&alloc, 1u << 30);
+    OffsetAllocation high = OffsetAllocator_Alloc(&alloc, (1u << 30) - 2);
+    OffsetAllocation last = OffsetAllocator_Alloc(&alloc, 1);
+    TEST_CHECK(low.node != OFFSET_ALLOC_NONE && low.offset == 0);
+    TEST_CHECK(high.node != OFFSET_ALLOC_NONE && high.offset == 1u << 30);
+    TEST_CHECK(last.node != OFFSET_ALLOC_NONE && last.offset == SPACE - 1);
+    TEST_CHECK(alloc.freeStorage == 0);
+    TEST_CHECK(OffsetAllocator_Validate(alloc));
+
+    OffsetAllocator_Free(&alloc, high.node);
+    OffsetAllocatorStats stats = OffsetAllocator_Stats(alloc);
+    TEST_CHECK(stats.largestFree == (1u << 30) - 2);
+    TEST_CHECK(stats.largestAlloc <= stats.largestFree);
+    TEST_CHECK(OffsetAllocator_Alloc(&alloc, stats.largestAlloc).node != OFFSET_ALLOC_NONE);
+    TEST_CHECK(OffsetAllocator_Validate(alloc));
+}
+
+// Compacting a fragmented allocator packs the live ranges from 0 in their
+// old order, keeps handles and sizes, lists only real moves, each downwards
+// and in ascending order, and leaves one free range at the end.
+static void Compact() {
+    const uint32_t SPACE = 1 << 16;
+    OffsetAllocator alloc;
+    OffsetAllocator_Init(&alloc, SPACE, 256);
+    std::mt19937 rng(5);
+    std::vector<uint32_t> live;
+    for (int i = 0; i < 200; ++i) {
+        OffsetAllocation a = OffsetAllocator_Alloc(&alloc, 1 + rng() % 300);
+        if (a.node != OFFSET_ALLOC_NONE) live.push_back(a.node);
+    }
+    for (size_t i = 0; i < live.size(); i += 2) OffsetAllocator_Free(&alloc, live[i]);
+    std::vector<uint32_t> kept;
+    for (size_t i = 1; i < live.size(); i += 2) kept.push_back(live[i]);
+    TEST_CHECK(OffsetAllocator_Stats(alloc).fragmentation > 0.0f);
+
+    // Each unit tagged with its owner, so replaying the moves must carry
+    // every range whole to its new offset.
+    std::vector<uint32_t> owner(SPACE, 0), sizes;
+    std::sort(kept.begin(), kept.end(), [&](uint32_t a, uint32_t b) {
+        return OffsetAllocator_Offset(alloc, a) < OffsetAllocator_Offset(alloc, b);
+    });
+    for (uint32_t node : kept) {
+        uint32_t offset = OffsetAllocator_Offset(alloc, node);
+        sizes.push_back(OffsetAllocator_Size(alloc, node));
+        std::fill(owner.begin() + offset, owner.begin() + offset + sizes.back(), node + 1);
+    }
+
+    std::vector<OffsetAllocMove> moves;
+    OffsetAllocator_Compact(&alloc, &moves);
+    TEST_CHECK(OffsetAllocator_Validate(alloc));
+    uint32_t lastFrom = 0;
+    for (const OffsetAllocMove& m : moves) {
+        TEST_CHECK(m.to < m.from);
+        TEST_CHECK(m.from >= lastFrom);
+        TEST_CHECK(OffsetAllocator_Offset(alloc, m.node) == m.to);
+        lastFrom = m.from;
+        memmove(&owner[m.to], &owner[m.from], m.size * sizeof(uint32_t));
+    }
+
+    uint32_t cursor = 0;
+    for (size_t i = 0; i < kept.size(); ++i) {
+        uint32_t node = kept[i];
+        TEST_CHECK(OffsetAllocator_Offset(alloc, node) == cursor);
+        TEST_CHECK(OffsetAllocator_Size(alloc, node) == sizes[i]);
+        bool whole = true;
+        for (uint32_t u = cursor; u < cursor + sizes[i]; ++u) whole &= owner[u] == node + 1;
+        TEST_CHECK(whole);
+        cursor += sizes[i];
+    }
+    OffsetAllocatorStats stats = OffsetAllocator_Stats(alloc);
+    TEST_CHECK(stats.numAllocs == kept.size());
+    TEST_CHECK(stats.usedStorage == cursor);
+    TEST_CHECK(stats.numFreeRanges == 1);
+    TEST_CHECK(stats.largestFree == SPACE - cursor);
+    TEST_CHECK(stats.fragmentation == 0.0f);
+
+    // Compacting what is already compact moves nothing.
+    OffsetAllocator_Compact(&alloc, &moves);
+    TEST_CHECK(moves.empty());
+    TEST_CHECK(OffsetAllocator_Validate(alloc));
+}
+
+// Mostly small sizes with a long tail, like meshes: log-uniform up to max.
+static uint32_t RandomSize(std::mt19937& rng, uint32_t max) {
+    std::uniform_real_distribution<float> dist(0.0f, logf((float) max));
+    return std::max<uint32_t>(1, (uint32_t) expf(dist(rng)));
+}
+
+// Random allocs, frees and compactions checked against a shadow copy of
+// which node owns each unit, so any overlap, lost range or bad move shows
+// up as a unit owned by the wrong node; validated as it goes.
+static void Fuzz(uint32_t seed, size_t ops) {
+    const uint32_t SPACE = 1 << 20, MAX_ALLOCS = 1 << 12, MAX_SIZE = 1 << 13;
+    std::mt19937 rng(seed);
+    OffsetAllocator alloc;
+    OffsetAllocator_Init(&alloc, SPACE, MAX_ALLOCS);
+    std::vector<uint32_t> owner(SPACE, 0), live;
+    std::vector<OffsetAllocMove> moves;
+    for (size_t op = 0; op < ops; ++op) {
+        if (live.empty() || rng() % 100 < 55) {
+            uint32_t size = RandomSize(rng, MAX_SIZE);
+            uint32_t largest = OffsetAllocator_Stats(alloc).largestAlloc;
+            OffsetAllocation a = OffsetAllocator_Alloc(&alloc, size);
+            if (a.node == OFFSET_ALLOC_NONE) {
+                if (!TEST_CHECK(size > largest || live.size() == MAX_ALLOCS)) return;
+                continue;
+            }
+            bool clear = true;
+            for (uint32_t u = a.offset; u < a.offset + size; ++u) {
+                clear &= owner[u] == 0;
+                owner[u] = a.node + 1;
+            }
+            if (!TEST_CHECK(clear && a.offset + size <= SPACE)) return;
+            live.push_back(a.node);
+        } else {
+            size_t k = rng() % live.size();
+            uint32_t node = live[k];
+            uint32_t offset = OffsetAllocator_Offset(alloc, node), size = OffsetAllocator_Size(alloc, node);
+            bool owned = true;
+            for (uint32_t u = offset; u < offset + size; ++u) {
+                owned &= owner[u] == node + 1;
+                owner[u] = 0;
+            }
+            if (!TEST_CHECK(owned)) return;
+            OffsetAllocator_Free(&alloc, node);
+            live[k] = live.back();
+            live.pop_back();
+        }
+        if (op % 997 == 0 && !TEST_CHECK(OffsetAllocator_Validate(alloc))) return;
+        if (op % 20011 == 20010) {
+            OffsetAllocator_Compact(&alloc, &moves);
+            for (const OffsetAllocMove& m : moves) memmove(&owner[m.to], &owner[m.from], m.size * sizeof(uint32_t));
+            uint32_t end = alloc.size - alloc.freeStorage;
+            std::fill(owner.begin() + end, owner.end(), 0);
+            bool packed = true;
+            for (uint32_t node : live) {
+                uint32_t offset = OffsetAllocator_Offset(alloc, node), size = OffsetAllocator_Size(alloc, node);
+                packed &= offset + size <= end;
+                for (uint32_t u = offset; u < offset + size && packed; ++u) packed &= owner[u] == node + 1;
+            }
+            if (!TEST_CHECK(packed) || !TEST_CHECK(OffsetAllocator_Validate(alloc))) return;
+        }
+    }
+    TEST_CHECK(alloc.numAllocs == live.size());
+    TEST_CHECK(OffsetAllocator_Validate(alloc));
+}
+
+void Test_OffsetAllocator() {
+    ExactFill();
+    DoubleFree();
+    MaxAllocs();
+    LargestSpace();
+    Compact();
+    for (uint32_t seed = 1; seed <= 4; ++seed) Fuzz(seed, 100000 * testFuzzScale);
+}
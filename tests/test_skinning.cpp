@@ -0,0 +1,273 @@
+#include "tests.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "../skinning.hpp"
+
+// Largest difference between a and b relative to the magnitude of b, so one
+// tolerance covers positions far from the origin and unit vectors alike.
+static float MaxError(const float* a, const float* b, size_t count) {
+    float maxerr = 0.0f;
+    for (size_t i = 0; i < count; ++i) maxerr = std::max(maxerr, fabsf(a[i] - b[i]) / (1.0f + fabsf(b[i])));
+    return maxerr;
+}
+
+static float MaxError(const glm::mat4& a, const glm::mat4& b) {
+    return MaxError(&a[0][0], &b[0][0], 16);
+}
+
+static glm::quat RandomRotation(std::mt19937& rng) {
+    std::normal_distribution<float> normal;
+    return glm::normalize(glm::quat { normal(rng), normal(rng), normal(rng), normal(rng) });
+}
+
+static void SetJoint(JointPose4* pose, size_t j, glm::vec3 t, glm::quat r, glm::vec3 s) {
+    JointPose4& g = pose[j / 4];
+    size_t l = j % 4;
+    g.tx[l] = t.x; g.ty[l] = t.y; g.tz[l] = t.z;
+    g.rx[l] = r.x; g.ry[l] = r.y; g.rz[l] = r.z; g.rw[l] = r.w;
+    g.sx[l] = s.x; g.sy[l] = s.y; g.sz[l] = s.z;
+}
+
+// Padding joints past the skeleton are identity.
+static void ResetPose(JointPose4* pose, size_t numJoints) {
+    for (size_t j = 0; j < JointGroups(numJoints) * 4; ++j) SetJoint(pose, j, glm::vec3 { 0.0f }, glm::quat { 1, 0, 0, 0 }, glm::vec3 { 1.0f });
+}
+
+static void RandomPose(JointPose4* pose, size_t numJoints, std::mt19937& rng) {
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    ResetPose(pose, numJoints);
+    for (size_t j = 0; j < numJoints; ++j) {
+        glm::vec3 s = glm::vec3 { 1.0f } + 0.2f * glm::vec3 { unit(rng), unit(rng), unit(rng) };
+        SetJoint(pose, j, glm::vec3 { unit(rng), unit(rng), unit(rng) }, RandomRotation(rng), s);
+    }
+}
+
+// Global transforms of pose built the obvious way, with glm.
+static void ReferenceGlobals(glm::mat4* globals, const Skeleton& skel, const JointPose4* pose) {
+    for (size_t j = 0; j < skel.parents.size(); ++j) {
+        const JointPose4& g = pose[j / 4];
+        size_t l = j % 4;
+        glm::mat4 local = glm::translate(glm::mat4 { 1.0f }, glm::vec3 { g.tx[l], g.ty[l], g.tz[l] })
+                        * glm::mat4_cast(glm::quat { g.rw[l], g.rx[l], g.ry[l], g.rz[l] })
+                        * glm::scale(glm::mat4 { 1.0f }, glm::vec3 { g.sx[l], g.sy[l], g.sz[l] });
+        int32_t parent = skel.parents[j];
+        globals[j] = parent < 0 ? local : globals[parent] * local;
+    }
+}
+
+// A tree of numJoints joints, which is not a multiple of four so the last
+// group has padding, random vertices with one to four influences, and one
+// clip whose rotation keys include repeats, sign flips and near-opposite
+// neighbours, the cases a slerp gets wrong first.
+static void MakeTestSkeletalMesh(SkeletalMesh* mesh, size_t numJoints, size_t numVerts, size_t numFrames) {
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    size_t groups = JointGroups(numJoints);
+
+    Skeleton& skel = mesh->skeleton;
+    skel.parents.resize(numJoints);
+    skel.names.resize(numJoints);
+    for (size_t j = 0; j < numJoints; ++j) skel.parents[j] = j == 0 ? -1 : (int32_t) ((j - 1) / 2);
+    skel.bindPose.resize(groups);
+    RandomPose(skel.bindPose.data(), numJoints, rng);
+    skel.inverseBinds.resize(numJoints);
+    ReferenceGlobals(skel.inverseBinds.data(), skel, skel.bindPose.data());
+    for (glm::mat4& m : skel.inverseBinds) m = glm::inverse(m);
+
+    SkeletalAnimation anim;
+    anim.name = "test";
+    anim.numFrames = numFrames;
+    anim.duration = (float) (numFrames - 1) / SKIN_SAMPLE_RATE;
+    anim.frames.resize(numFrames * groups);
+    for (size_t f = 0; f < numFrames; ++f) {
+        JointPose4* frame = &anim.frames[f * groups];
+        RandomPose(frame, numJoints, rng);
+        if (f == 0) continue;
+        const JointPose4* prev = frame - groups;
+        for (size_t j = 0; j < numJoints; ++j) {
+            const JointPose4& p = prev[j / 4];
+            JointPose4& g = frame[j / 4];
+            size_t l = j % 4;
+            glm::quat q { p.rw[l], p.rx[l], p.ry[l], p.rz[l] };
+            switch ((f + j) % 5) {
+            case 0: break;
+            case 1: q = -q; break;
+            case 2: q = glm::normalize(q * glm::angleAxis(1e-3f, glm::vec3 { 0, 0, 1 })); break;
+            case 3: q = glm::normalize(q * glm::angleAxis(3.1f, glm::vec3 { 1, 0, 0 })); break;
+            default: continue;
+            }
+            g.rx[l] = q.x; g.ry[l] = q.y; g.rz[l] = q.z; g.rw[l] = q.w;
+        }
+    }
+    mesh->animations.push_back(anim);
+
+    mesh->mesh.vertices.resize(numVerts);
+    mesh->skin.resize(numVerts);
+    for (size_t i = 0; i < numVerts; ++i) {
+        GlStaticMeshVert& v = mesh->mesh.vertices[i];
+        v.pos = glm::vec3 { unit(rng), unit(rng), unit(rng) } * 3.0f;
+        v.norm = glm::normalize(glm::vec3 { unit(rng), unit(rng), unit(rng) } + glm::vec3 { 0.0f, 1e-3f, 0.0f });
+        glm::vec3 t = glm::normalize(glm::cross(v.norm, fabsf(v.norm.y) < 0.9f ? glm::vec3 { 0, 1, 0 } : glm::vec3 { 1, 0, 0 }));
+        v.tang = glm::vec4 { t, rng() & 1 ? 1.0f : -1.0f };
+        v.coord = glm::vec2 { unit(rng), unit(rng) };
+
+        SkinWeights& s = mesh->skin[i];
+        int influences = 1 + (int) (i % 4);
+        int left = 255;
+        for (int k = 0; k < 4; ++k) {
+            s.joints[k] = (uint8_t) (rng() % numJoints);
+            s.weights[k] = (uint8_t) (k + 1 == influences ? left : k < influences ? rng() % (left + 1) : 0);
+            left -= s.weights[k];
+        }
+    }
+}
+
+using SkinFn = void(GlStaticMeshVert*, const GlStaticMeshVert*, const SkinWeights*, const glm::mat4*, size_t, size_t);
+
+static void ExpectRigid(std::vector<GlStaticMeshVert>* expect, const GlStaticMeshVert* bind, size_t numVerts, const glm::mat4& m) {
+    expect->resize(numVerts);
+    for (size_t i = 0; i < numVerts; ++i) {
+        GlStaticMeshVert& e = (*expect)[i];
+        e = bind[i];
+        e.pos = glm::vec3 { m * glm::vec4 { bind[i].pos, 1.0f } };
+        e.norm = glm::normalize(glm::vec3 { m * glm::vec4 { bind[i].norm, 0.0f } });
+        e.tang = glm::vec4 { glm::normalize(glm::vec3 { m * glm::vec4 { glm::vec3 { bind[i].tang }, 0.0f } }), bind[i].tang.w };
+    }
+}
+
+static float MaxError(const std::vector<GlStaticMeshVert>& a, const std::vector<GlStaticMeshVert>& b) {
+    return MaxError(&a[0].pos.x, &b[0].pos.x, a.size() * sizeof(GlStaticMeshVert) / sizeof(float));
+}
+
+// The bind pose must resolve to identity skinning matrices, and any pose to
+// the matrices composed with glm.
+static void Palette(const SkeletalMesh& mesh) {
+    const Skeleton& skel = mesh.skeleton;
+    size_t numJoints = skel.parents.size();
+    std::vector<glm::mat4> palette(numJoints), globals(numJoints), expect(numJoints);
+    ComputeSkinPalette(palette.data(), globals.data(), skel, skel.bindPose.data());
+    float err = 0.0f;
+    for (const glm::mat4& m : palette) err = std::max(err, MaxError(m, glm::mat4 { 1.0f }));
+    TEST_CHECK(err < 1e-4f);
+
+    std::mt19937 rng(6);
+    std::vector<JointPose4> pose(JointGroups(numJoints));
+    err = 0.0f;
+    for (int i = 0; i < 100; ++i) {
+        RandomPose(pose.data(), numJoints, rng);
+        ComputeSkinPalette(palette.data(), globals.data(), skel, pose.data());
+        ReferenceGlobals(expect.data(), skel, pose.data());
+        for (size_t j = 0; j < numJoints; ++j) err = std::max(err, MaxError(palette[j], expect[j] * skel.inverseBinds[j]));
+    }
+    TEST_CHECK(err < 1e-4f);
+}
+
+// The SSE sampler with its polynomial slerp against the scalar one with
+// glm::slerp, at frames, between them, and out of range on both sides.
+static void Sampling(const SkeletalMesh& mesh) {
+    const SkeletalAnimation& anim = mesh.animations[0];
+    size_t numJoints = mesh.skeleton.parents.size(), groups = JointGroups(numJoints);
+    std::vector<JointPose4> fast(groups), ref(groups);
+    float err = 0.0f, unitErr = 0.0f, padErr = 0.0f;
+    for (int i = -500; i <= 3000; ++i) {
+        float time = anim.duration * (float) i / 1000.0f;
+        SampleAnimation(fast.data(), anim, numJoints, time);
+        SampleAnimationScalar(ref.data(), anim, numJoints, time);
+        err = std::max(err, MaxError(fast[0].tx, ref[0].tx, groups * sizeof(JointPose4) / sizeof(float)));
+        for (size_t j = 0; j < groups * 4; ++j) {
+            const JointPose4& g = fast[j / 4];
+            size_t l = j % 4;
+            glm::quat r { g.rw[l], g.rx[l], g.ry[l], g.rz[l] };
+            unitErr = std::max(unitErr, fabsf(glm::length(r) - 1.0f));
+            if (j >= numJoints) {
+                padErr = std::max({ padErr, fabsf(g.tx[l]) + fabsf(g.ty[l]) + fabsf(g.tz[l]), fabsf(r.w - 1.0f),
+                                    fabsf(g.sx[l] - 1.0f) + fabsf(g.sy[l] - 1.0f) + fabsf(g.sz[l] - 1.0f) });
+            }
+        }
+    }
+    // The polynomial is good to a few ulps of float; the rest is rounding in
+    // the two blends, worst between keys nearly half a turn apart.
+    TEST_CHECK(err < 5e-5f);
+    TEST_CHECK(unitErr < 1e-5f);
+    TEST_CHECK(padErr == 0.0f);
+}
+
+// Known poses: identity and rigid palettes, and an even blend of two
+// translations, with every path and on a range that leaves the vertices
+// outside it untouched.
+static void KnownPoses(const SkeletalMesh& mesh) {
+    const GlStaticMeshVert* bind = mesh.mesh.vertices.data();
+    size_t numVerts = mesh.mesh.vertices.size(), numJoints = mesh.skeleton.parents.size();
+    std::vector<GlStaticMeshVert> out(numVerts), expect;
+    std::vector<glm::mat4> palette(numJoints);
+    glm::mat4 rigid = glm::rotate(glm::translate(glm::mat4 { 1.0f }, glm::vec3 { 1.0f, -2.0f, 3.0f }), 0.7f, glm::normalize(glm::vec3 { 1.0f, 1.0f, 0.0f }));
+    for (SkinFn* fn : { SkinVertices, SkinVerticesScalar }) {
+        std::fill(palette.begin(), palette.end(), glm::mat4 { 1.0f });
+        fn(out.data(), bind, mesh.skin.data(), palette.data(), 0, numVerts);
+        TEST_CHECK(MaxError(out, mesh.mesh.vertices) < 1e-6f);
+
+        std::fill(palette.begin(), palette.end(), rigid);
+        fn(out.data(), bind, mesh.skin.data(), palette.data(), 0, numVerts);
+        ExpectRigid(&expect, bind, numVerts, rigid);
+        TEST_CHECK(MaxError(out, expect) < 1e-5f);
+
+        std::vector<SkinWeights> halves(numVerts, SkinWeights { { 0, 1, 0, 0 }, { 128, 127, 0, 0 } });
+        palette[0] = glm::translate(glm::mat4 { 1.0f }, glm::vec3 { 2.0f, 0.0f, -1.0f });
+        palette[1] = glm::translate(glm::mat4 { 1.0f }, glm::vec3 { 0.0f, 4.0f, 1.0f });
+        glm::vec3 offset = (128.0f * glm::vec3 { 2.0f, 0.0f, -1.0f } + 127.0f * glm::vec3 { 0.0f, 4.0f, 1.0f }) / 255.0f;
+        std::fill(out.begin(), out.end(), GlStaticMeshVert {});
+        fn(out.data(), bind, halves.data(), palette.data(), 3, numVerts - 5);
+        ExpectRigid(&expect, bind, numVerts, glm::translate(glm::mat4 { 1.0f }, offset));
+        std::fill(expect.begin(), expect.begin() + 3, GlStaticMeshVert {});
+        std::fill(expect.end() - 5, expect.end(), GlStaticMeshVert {});
+        TEST_CHECK(MaxError(out, expect) < 1e-5f);
+    }
+}
+
+// SkinVertices, AVX2 where the CPU has it, against the scalar reference on
+// sampled poses, one vertex at a time and in bulk.
+static void Paths(const SkeletalMesh& mesh) {
+    if (!SkinningUsesAvx2()) printf("  no AVX2 on this CPU: SkinVertices is the scalar path\n");
+    const SkeletalAnimation& anim = mesh.animations[0];
+    size_t numVerts = mesh.mesh.vertices.size(), numJoints = mesh.skeleton.parents.size();
+    std::vector<GlStaticMeshVert> fast(numVerts), ref(numVerts);
+    std::vector<glm::mat4> palettes(numJoints * 16);
+    std::vector<float> times(16);
+    for (size_t i = 0; i < times.size(); ++i) times[i] = anim.duration * (float) i / 13.0f;
+    AnimateInstances(palettes.data(), mesh, anim, times.data(), times.size());
+    float err = 0.0f;
+    for (size_t i = 0; i < times.size(); ++i) {
+        const glm::mat4* palette = palettes.data() + i * numJoints;
+        SkinVerticesScalar(ref.data(), mesh.mesh.vertices.data(), mesh.skin.data(), palette, 0, numVerts);
+        if (i % 2) {
+            SkinVertices(fast.data(), mesh.mesh.vertices.data(), mesh.skin.data(), palette, 0, numVerts);
+        } else {
+            for (size_t v = 0; v < numVerts; ++v) SkinVertices(fast.data(), mesh.mesh.vertices.data(), mesh.skin.data(), palette, v, v + 1);
+        }
+        err = std::max(err, MaxError(fast, ref));
+    }
+    TEST_CHECK(err < 1e-5f);
+
+    std::vector<GlStaticMeshVert> instances(numVerts * times.size());
+    SkinInstances(instances.data(), mesh, palettes.data(), times.size());
+    SkinVerticesScalar(ref.data(), mesh.mesh.vertices.data(), mesh.skin.data(), palettes.data() + 5 * numJoints, 0, numVerts);
+    std::vector<GlStaticMeshVert> fifth(instances.begin() + 5 * numVerts, instances.begin() + 6 * numVerts);
+    TEST_CHECK(MaxError(fifth, ref) < 1e-5f);
+}
+
+void Test_Skinning() {
+    SkeletalMesh mesh;
+    MakeTestSkeletalMesh(&mesh, 13, 1001, 31);
+    Palette(mesh);
+    Sampling(mesh);
+    KnownPoses(mesh);
+    Paths(mesh);
+}
@@ -0,0 +1,95 @@
+#include "tests.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <glm/geometric.hpp>
+
+#include "../vertex_compact.hpp"
+#include "test_meshes.hpp"
+
+// Vertices at the awkward spots of the encoding: normals on every axis and
+// on the octahedral fold at z == 0, tangents that are not orthogonal to
+// their normal or point along it, both handednesses, and uvs far from the
+// unit square.
+static void AppendEdgeCases(StaticMesh* mesh) {
+    const glm::vec3 normals[] = {
+        { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+        { 0.6f, 0.8f, 0.0f }, { -0.6f, 0.8f, 0.0f }, { 0.6f, -0.8f, -1e-7f }, { 0.3f, -0.3f, -0.9f },
+    };
+    const glm::vec4 tangents[] = {
+        { 1, 0, 0, 1 }, { 0, 1, 0, -1 }, { 0, 0, 1, 1 }, { 0.7f, 0.7f, 0.1f, -1 },
+    };
+    const glm::vec2 coords[] = {
+        { 0, 0 }, { 1, 1 }, { -3.5f, 100.25f }, { 1e-5f, -0.5f },
+    };
+    for (size_t i = 0; i < 40; ++i) {
+        GlStaticMeshVert v {};
+        v.pos = glm::vec3 { (float) i, -(float) (i % 7), 0.5f * (float) (i % 3) };
+        v.norm = glm::normalize(normals[i % 10]);
+        v.tang = tangents[i % 4];
+        v.coord = coords[i % 4];
+        mesh->vertices.push_back(v);
+    }
+}
+
+// Every vertex through the compact layout and back: the position within
+// half a quantization step of the bounds plus rounding, the uv within half
+// a half-float ulp, and the frame within the angles the bit widths allow.
+static void RoundTrip(const StaticMesh& mesh) {
+    const GlStaticMeshVert* verts = mesh.vertices.data();
+    size_t numverts = mesh.vertices.size();
+    CompactVertBounds bounds = ComputeCompactBounds(verts, numverts);
+    std::vector<GlCompactVert> packed(numverts);
+    std::vector<GlStaticMeshVert> unpacked(numverts);
+    PackCompactVerts(packed.data(), verts, numverts, bounds);
+    UnpackCompactVerts(unpacked.data(), packed.data(), numverts, bounds);
+
+    bool posOk = true, coordOk = true, same = true;
+    glm::vec3 step = bounds.scale / 65535.0f;
+    for (size_t i = 0; i < numverts; ++i) {
+        GlCompactVert one = PackCompactVert(verts[i], bounds);
+        same &= memcmp(&one, &packed[i], sizeof(one)) == 0;
+        glm::vec3 dp = glm::abs(unpacked[i].pos - verts[i].pos);
+        glm::vec3 slack = 0.5f * step + 1e-6f * (glm::abs(bounds.offset) + bounds.scale);
+        posOk &= dp.x <= slack.x && dp.y <= slack.y && dp.z <= slack.z;
+        for (int k = 0; k < 2; ++k) {
+            float c = verts[i].coord[k];
+            coordOk &= fabsf(unpacked[i].coord[k] - c) <= std::max(fabsf(c), 6.1e-5f) * (1.0f / 2048.0f);
+        }
+    }
+    TEST_CHECK(same);
+    TEST_CHECK(posOk);
+    TEST_CHECK(coordOk);
+
+    CompactVertError err = MeasureCompactError(verts, numverts, bounds);
+    // Best-of-four octahedral rounding at 10 bits keeps normals within about
+    // 0.16 degrees; the 11-bit tangent angle adds 0.09 on top of that.
+    TEST_CHECK(err.norm <= 0.2f);
+    TEST_CHECK(err.tang <= 0.25f);
+    TEST_CHECK(err.flips == 0);
+}
+
+void Test_VertexCompact() {
+    StaticMesh sphere;
+    Test_AppendSphere(&sphere, glm::vec3 { 1000.0f, -20.0f, 3.0f }, 50.0f, 64, 128);
+    RoundTrip(sphere);
+
+    StaticMesh soup;
+    Test_AppendSoup(&soup, 100000, 1, 9);
+    RoundTrip(soup);
+
+    StaticMesh edges;
+    AppendEdgeCases(&edges);
+    RoundTrip(edges);
+
+    // Flat in z and a single point: the zero extent must not divide by zero.
+    StaticMesh flat;
+    Test_AppendSoup(&flat, 50, 1, 10);
+    for (GlStaticMeshVert& v : flat.vertices) v.pos.z = 2.0f;
+    RoundTrip(flat);
+    flat.vertices.resize(1);
+    RoundTrip(flat);
+}
@@ -0,0 +1,71 @@
+#include "tests.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "../vertex_pull.hpp"
+#include "test_meshes.hpp"
+
+// Every vertex through the pulled layout and back: positions bit-exact and
+// stored once per distinct bit pattern, the uv within half a half-float ulp,
+// and normal and tangent within the angles snorm16 and snorm10 allow.
+static void RoundTrip(const StaticMesh& mesh) {
+    const GlStaticMeshVert* verts = mesh.vertices.data();
+    size_t numverts = mesh.vertices.size();
+    PulledVertices packed;
+    PackPulledVertices(&packed, verts, numverts);
+    TEST_CHECK(packed.verts.size() == numverts);
+
+    bool exact = true, shared = true, coordOk = true;
+    for (size_t i = 0; i < numverts; ++i) {
+        GlStaticMeshVert v = UnpackPulledVert(packed, i);
+        exact &= packed.verts[i].position < packed.positions.size() && memcmp(&v.pos, &verts[i].pos, sizeof(v.pos)) == 0;
+        for (int k = 0; k < 2; ++k) {
+            float c = verts[i].coord[k];
+            coordOk &= fabsf(v.coord[k] - c) <= std::max(fabsf(c), 6.1e-5f) * (1.0f / 2048.0f);
+        }
+    }
+    for (size_t i = 0; i + 1 < packed.positions.size(); ++i) {
+        shared &= memcmp(&packed.positions[i], &packed.positions[i + 1], sizeof(glm::vec3)) != 0;
+    }
+    std::vector<glm::vec3> distinct(packed.positions);
+    std::sort(distinct.begin(), distinct.end(), [](const glm::vec3& a, const glm::vec3& b) { return memcmp(&a, &b, sizeof(a)) < 0; });
+    shared &= std::adjacent_find(distinct.begin(), distinct.end(), [](const glm::vec3& a, const glm::vec3& b) {
+        return memcmp(&a, &b, sizeof(a)) == 0;
+    }) == distinct.end();
+    TEST_CHECK(exact);
+    TEST_CHECK(shared);
+    TEST_CHECK(coordOk);
+
+    CompactVertError err = MeasurePulledError(packed, verts, numverts);
+    TEST_CHECK(err.pos == 0.0f);
+    // snorm16 normals are finer than the float acos in the measurement,
+    // which bottoms out around 0.03 degrees.
+    TEST_CHECK(err.norm <= 0.05f);
+    TEST_CHECK(err.tang <= 0.15f);
+    TEST_CHECK(err.flips == 0);
+}
+
+void Test_VertexPull() {
+    // The top pole ring of a sphere is one position repeated with other uvs.
+    StaticMesh spheres;
+    Test_AppendSphere(&spheres, glm::vec3 { 0.0f }, 1.0f, 32, 48);
+    Test_AppendSphere(&spheres, glm::vec3 { 0.0f, 3.0f, 0.0f }, 2.0f, 16, 24);
+    RoundTrip(spheres);
+    PulledVertices packed;
+    PackPulledVertices(&packed, spheres.vertices.data(), spheres.vertices.size());
+    TEST_CHECK(packed.positions.size() <= spheres.vertices.size() - 48 - 24);
+
+    // Exact copies share, but -0 and +0 differ in their bits and do not.
+    StaticMesh soup;
+    Test_AppendSoup(&soup, 50000, 1, 11);
+    soup.vertices.insert(soup.vertices.end(), soup.vertices.begin(), soup.vertices.begin() + 1000);
+    soup.vertices[50000].pos.x = -0.0f;
+    soup.vertices[50001].pos = soup.vertices[50000].pos;
+    soup.vertices[50001].pos.x = 0.0f;
+    RoundTrip(soup);
+    PackPulledVertices(&packed, soup.vertices.data(), soup.vertices.size());
+    TEST_CHECK(packed.positions.size() == 50000 + 2);
+}
@@ -0,0 +1,70 @@
+#include "tests.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+// Usage: tests [--fuzz scale] [name...]
+// Runs every test, or those whose name contains one of the given names.
+
+size_t testFuzzScale = 1;
+
+static size_t numChecks, numFailures;
+
+bool Test_Check(bool ok, const char* expr, const char* file, int line) {
+    numChecks++;
+    if (!ok) {
+        numFailures++;
+        printf("  FAILED %s:%d: %s\n", file, line, expr);
+    }
+    return ok;
+}
+
+struct TestEntry {
+    const char* name;
+    void (*fn)();
+};
+
+static const TestEntry TESTS[] = {
+    { "impostor",         Test_Impostor },
+    { "lightmap_uv",      Test_LightmapUv },
+    { "mesh_bvh",         Test_MeshBvh },
+    { "mesh_codec",       Test_MeshCodec },
+    { "mesh_lod",         Test_MeshLod },
+    { "mesh_optimize",    Test_MeshOptimize },
+    { "mesh_tangents",    Test_MeshTangents },
+    { "mesh_weld",        Test_MeshWeld },
+    { "meshlet",          Test_Meshlet },
+    { "offset_allocator", Test_OffsetAllocator },
+    { "skinning",         Test_Skinning },
+    { "vertex_compact",   Test_VertexCompact },
+    { "vertex_pull",      Test_VertexPull },
+};
+
+int main(int argc, char** argv) {
+    std::vector<const char*> filters;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--fuzz") && i + 1 < argc) testFuzzScale = (size_t) atoll(argv[++i]);
+        else filters.push_back(argv[i]);
+    }
+
+    size_t ran = 0, failed = 0;
+    for (const TestEntry& test : TESTS) {
+        bool selected = filters.empty();
+        for (const char* f : filters) selected |= strstr(test.name, f) != nullptr;
+        if (!selected) continue;
+
+        size_t before = numFailures;
+        auto start = std::chrono::high_resolution_clock::now();
+        test.fn();
+        std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+        bool passed = numFailures == before;
+        printf("%s %s (%.1f ms)\n", passed ? "pass" : "FAIL", test.name, dur.count());
+        ran++;
+        failed += !passed;
+    }
+    printf("%zu tests, %zu failed; %zu checks, %zu failed\n", ran, failed, numChecks, numFailures);
+    return numFailures ? 1 : 0;
+}
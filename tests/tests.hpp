@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+
+// Headless checks of the CPU-side modules, run by the tests target. Each
+// Test_* function makes its checks through TEST_CHECK, which prints the
+// failing expression with its location and counts it, so one run reports
+// every failure; the target exits nonzero if there were any.
+
+#define TEST_CHECK(cond) Test_Check((cond), #cond, __FILE__, __LINE__)
+
+bool Test_Check(bool ok, const char* expr, const char* file, int line);
+
+// Multiplies the work of randomized tests; --fuzz N on the command line.
+extern size_t testFuzzScale;
+
+void Test_Impostor();
+void Test_LightmapUv();
+void Test_MeshBvh();
+void Test_MeshCodec();
+void Test_MeshLod();
+void Test_MeshOptimize();
+void Test_MeshTangents();
+void Test_MeshWeld();
+void Test_Meshlet();
+void Test_OffsetAllocator();
+void Test_Skinning();
+void Test_VertexCompact();
+void Test_VertexPull();
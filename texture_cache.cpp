@@ -0,0 +1,234 @@
+#include "texture_cache.hpp"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <glm/common.hpp>
+
+#include "cooked_file.hpp"
+#include "gl_cooked_texture.hpp"
+#include "mapped_file.hpp"
+#include "pack_file.hpp"
+#include "parallel.hpp"
+#include "stb_image.h"
+#include "texture_cook.hpp"
+
+// One per distinct path (or per in-memory request) not already cached.
+struct PendingTexture {
+    const TextureRequest* request;
+    CookedTexture         cooked;
+    bool                  isCooked;
+    MappedFile            file;
+    const uint8_t*        data;
+    size_t                size;
+    uint64_t              hash;
+    size_t                sameAs;       // earlier pending entry with the same contents
+    bool                  decode;
+    stbi_uc*              pixels;
+    int                   width, height;
+    GLuint                texture;
+};
+
+static const size_t NOT_PENDING = ~(size_t) 0;
+
+static void ReadPending(PendingTexture* p, const PackFile* pack) {
+    const TextureRequest& r = *p->request;
+    if (r.data) {
+        p->data = (const uint8_t*) r.data;
+        p->size = r.size;
+    } else {
+        std::string cookedPath = CookedTexture_PathFor(r.path.c_str());
+        std::string_view packed = PackFile_View(pack, cookedPath);
+        p->isCooked = (packed.data() && CookedTexture_OpenMemory(&p->cooked, packed.data(), packed.size()))
+                   || CookedTexture_Open(&p->cooked, cookedPath.c_str(), r.path.c_str());
+        if (p->isCooked) return;
+        std::string_view source = PackFile_View(pack, r.path);
+        if (source.data()) {
+            p->data = (const uint8_t*) source.data();
+            p->size = source.size();
+        } else if (MappedFile_Open(&p->file, r.path.c_str())) {
+            p->data = (const uint8_t*) p->file.data;
+            p->size = p->file.size;
+        } else {
+            printf("%s: cannot open texture\n", r.path.c_str());
+            return;
+        }
+    }
+    // Raw texels of different shapes can hash the same bytes.
+    p->hash = Cooked_HashBytes(p->data, p->size) ^ ((uint64_t) r.width << 32 | r.height);
+}
+
+static GLuint UploadRgba8(const uint8_t* pixels, int width, int height) {
+    GLsizei levels = 1;
+    while ((std::max(width, height) >> levels) > 0) levels++;
+    GLuint tex;
+    glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+    glTextureStorage2D(tex, levels, GL_SRGB8_ALPHA8, width, height);
+    glTextureSubImage2D(tex, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glGenerateTextureMipmap(tex);
+    glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return tex;
+}
+
+void TextureCache_Load(TextureCache* cache, GLuint* out, const TextureRequest* requests, size_t count) {
+    auto start = std::chrono::high_resolution_clock::now();
+    cache->requests += count;
+
+    std::vector<PendingTexture> pending;
+    std::vector<size_t> target(count, NOT_PENDING);
+    std::unordered_map<std::string, size_t> pendingByPath;
+    for (size_t i = 0; i < count; ++i) {
+        const TextureRequest& r = requests[i];
+        out[i] = 0;
+        if (!r.path.empty()) {
+            auto hit = cache->byPath.find(r.path);
+            if (hit != cache->byPath.end()) {
+                out[i] = hit->second;
+                continue;
+            }
+            auto queued = pendingByPath.find(r.path);
+            if (queued != pendingByPath.end()) {
+                target[i] = queued->second;
+                continue;
+            }
+            pendingByPath[r.path] = pending.size();
+        } else if (!r.data) {
+            continue;
+        }
+        target[i] = pending.size();
+        PendingTexture p {};
+        p.request = &r;
+        p.sameAs = NOT_PENDING;
+        pending.push_back(p);
+    }
+
+    ParallelFor(pending.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) ReadPending(&pending[i], cache->pack);
+    });
+
+    // Only the first of each set of identical contents gets decoded.
+    std::unordered_map<uint64_t, size_t> pendingByContent;
+    for (size_t i = 0; i < pending.size(); ++i) {
+        PendingTexture& p = pending[i];
+        if (p.isCooked || !p.data) continue;
+        auto known = cache->byContent.find(p.hash);
+        if (known != cache->byContent.end()) {
+            p.texture = known->second;
+            continue;
+        }
+        auto queued = pendingByContent.find(p.hash);
+        if (queued != pendingByContent.end()) {
+            p.sameAs = queued->second;
+            continue;
+        }
+        pendingByContent[p.hash] = i;
+        p.decode = true;
+    }
+
+    ParallelFor(pending.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            PendingTexture& p = pending[i];
+            if (!p.decode || p.request->width) continue;
+            int channels;
+            p.pixels = stbi_load_from_memory(p.data, (int) p.size, &p.width, &p.height, &channels, 4);
+        }
+    });
+
+    for (PendingTexture& p : pending) {
+        const TextureRequest& r = *p.request;
+        if (p.isCooked) {
+            p.texture = GL_CreateCookedTexture(p.cooked);
+            CookedTexture_Close(&p.cooked);
+            cache->cooked++;
+        } else if (p.decode && r.width) {
+            p.texture = UploadRgba8(p.data, (int) r.width, (int) r.height);
+            cache->decoded++;
+        } else if (p.decode && p.pixels) {
+            p.texture = UploadRgba8(p.pixels, p.width, p.height);
+            stbi_image_free(p.pixels);
+            cache->decoded++;
+        } else if (p.decode) {
+            printf("%s: cannot decode texture: %s\n", r.path.empty() ? "embedded" : r.path.c_str(), stbi_failure_reason());
+        } else if (p.sameAs != NOT_PENDING) {
+            p.texture = pending[p.sameAs].texture;
+        }
+        MappedFile_Close(&p.file);
+        if (!p.texture) continue;
+        if (p.isCooked || p.decode) cache->textures.push_back(p.texture);
+        if (!r.path.empty()) cache->byPath[r.path] = p.texture;
+        if (!p.isCooked) cache->byContent[p.hash] = p.texture;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (target[i] != NOT_PENDING) out[i] = pending[target[i]].texture;
+    }
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    cache->decodeMs += dur.count();
+}
+
+GLuint TextureCache_Flat(TextureCache* cache, glm::vec4 value) {
+    uint8_t texel[4];
+    for (int c = 0; c < 4; ++c) texel[c] = (uint8_t) (glm::clamp(value[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+    uint32_t key = (uint32_t) texel[0] | texel[1] << 8 | texel[2] << 16 | (uint32_t) texel[3] << 24;
+    auto hit = cache->flat.find(key);
+    if (hit != cache->flat.end()) return hit->second;
+
+    GLuint tex;
+    glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+    glTextureStorage2D(tex, 1, GL_RGBA8, 1, 1);
+    glTextureSubImage2D(tex, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+    cache->flat[key] = tex;
+    cache->textures.push_back(tex);
+    return tex;
+}
+
+void TextureCache_PrintStats(const TextureCache& cache) {
+    printf("texture cache: %zu requests, %zu textures (%zu cooked, %zu decoded, %zu flat) in %.2f ms\n",
+           cache.requests, cache.textures.size(), cache.cooked, cache.decoded, cache.flat.size(), cache.decodeMs);
+}
+
+void TextureCache_Destroy(TextureCache* cache) {
+    if (!cache->textures.empty()) glDeleteTextures((GLsizei) cache->textures.size(), cache->textures.data());
+    cache->byPath.clear();
+    cache->byContent.clear();
+    cache->flat.clear();
+    cache->textures.clear();
+}
+
+void LoadGlMaterials(std::vector<GlMaterial>* out, TextureCache* cache, const std::vector<MaterialDesc>& materials,
+                     const MaterialDesc& defaults) {
+    std::vector<TextureRequest> requests((materials.size() + 1) * MATERIAL_SLOTS);
+    for (size_t m = 0; m <= materials.size(); ++m) {
+        const MaterialDesc& desc = m < materials.size() ? materials[m] : defaults;
+        for (int slot = 0; slot < MATERIAL_SLOTS; ++slot) {
+            const MaterialTexture& t = desc.textures[slot];
+            TextureRequest& r = requests[m * MATERIAL_SLOTS + slot];
+            r.path = t.path;
+            if (!t.embedded.empty()) {
+                r.data = t.embedded.data();
+                r.size = t.embedded.size();
+                r.width = t.width;
+                r.height = t.height;
+            }
+        }
+    }
+    std::vector<GLuint> textures(requests.size());
+    TextureCache_Load(cache, textures.data(), requests.data(), requests.size());
+
+    out->resize(materials.size() + 1);
+    const GLuint* fallback = &textures[materials.size() * MATERIAL_SLOTS];
+    for (size_t m = 0; m < out->size(); ++m) {
+        for (int slot = 0; slot < MATERIAL_SLOTS; ++slot) {
+            GLuint tex = textures[m * MATERIAL_SLOTS + slot];
+            (*out)[m].textures[slot] = tex ? tex : fallback[slot];
+        }
+    }
+}
+
+void BindGlMaterial(const GlMaterial& material, GLuint firstUnit) {
+    for (int slot = 0; slot < MATERIAL_SLOTS; ++slot) {
+        glActiveTexture(GL_TEXTURE0 + firstUnit + slot);
+        glBindTexture(GL_TEXTURE_2D, material.textures[slot]);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/vec4.hpp>
+
+#include "material.hpp"
+
+struct PackFile;
+
+// Colour textures shared by every material and asset that uses them. Each
+// distinct texture is read, decoded and uploaded once: requests are matched
+// by path first, and then by a hash of what was read, so the same image
+// under two paths, or embedded in two assets, still ends up as one texture.
+//
+// Files come from the pack when it has them, cooked versions first, as in
+// main; anything not cooked is decoded with stb_image on all threads and
+// stored as GL_SRGB8_ALPHA8 with a full mip chain, like a cooked texture.
+struct TextureRequest {
+    std::string path;               // file to load; for data, an optional name
+    const void* data = nullptr;     // contents already in memory, read instead of path
+    size_t      size = 0;
+    uint32_t    width = 0, height = 0;  // set if data is raw RGBA8 rather than an image file
+};
+
+struct TextureCache {
+    const PackFile*                      pack = nullptr;
+    std::unordered_map<std::string, GLuint> byPath;
+    std::unordered_map<uint64_t, GLuint> byContent;
+    std::unordered_map<uint32_t, GLuint> flat;         // 1x1 textures by RGBA8 value
+    std::vector<GLuint>                  textures;     // everything created
+
+    size_t requests = 0, decoded = 0, cooked = 0;
+    double decodeMs = 0.0;
+};
+
+// Resolves requests[i] to out[i], 0 where it cannot be read or decoded.
+// Reading, hashing and decoding run on all threads; uploads stay on the
+// calling thread, which must own the GL context.
+void TextureCache_Load(TextureCache* cache, GLuint* out, const TextureRequest* requests, size_t count);
+
+// A 1x1 GL_RGBA8 texture holding value, which is stored as given rather
+// than as sRGB, for material factors standing in for a texture.
+GLuint TextureCache_Flat(TextureCache* cache, glm::vec4 value);
+
+void TextureCache_PrintStats(const TextureCache& cache);
+void TextureCache_Destroy(TextureCache* cache);
+
+struct GlMaterial {
+    GLuint textures[MATERIAL_SLOTS];
+};
+
+// One GlMaterial per entry of materials followed by one for defaults, all
+// loaded in a single TextureCache_Load. Slots a material leaves unset, or
+// whose texture fails to load, take the default's texture.
+void LoadGlMaterials(std::vector<GlMaterial>* out, TextureCache* cache, const std::vector<MaterialDesc>& materials,
+                     const MaterialDesc& defaults);
+
+// Binds the slots to texture units firstUnit + slot.
+void BindGlMaterial(const GlMaterial& material, GLuint firstUnit);
@@ -0,0 +1,223 @@
+#include "texture_cook.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <glm/vec4.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "gfx-boilerplate/image.hpp"
+#include "parallel.hpp"
+
+static constexpr size_t ROW_GRAIN = 16;
+
+// Blur applied at every environment level after downsampling, in texels of
+// that level, so level l approximates a lobe about 2^l times that wide.
+static constexpr float ENV_BLUR_SIGMA = 1.5f;
+
+struct FloatLevel {
+    uint32_t               width;
+    uint32_t               height;
+    std::vector<glm::vec4> texels;
+};
+
+static FloatLevel Downsample(const FloatLevel& src) {
+    FloatLevel dst;
+    dst.width = std::max(1u, src.width / 2);
+    dst.height = std::max(1u, src.height / 2);
+    dst.texels.resize((size_t) dst.width * dst.height);
+    ParallelFor(dst.height, ROW_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; ++y) {
+            const glm::vec4* row0 = &src.texels[std::min<size_t>(y * 2, src.height - 1) * src.width];
+            const glm::vec4* row1 = &src.texels[std::min<size_t>(y * 2 + 1, src.height - 1) * src.width];
+            for (size_t x = 0; x < dst.width; ++x) {
+                size_t x0 = std::min<size_t>(x * 2, src.width - 1);
+                size_t x1 = std::min<size_t>(x * 2 + 1, src.width - 1);
+                dst.texels[y * dst.width + x] = (row0[x0] + row0[x1] + row1[x0] + row1[x1]) * 0.25f;
+            }
+        }
+    });
+    return dst;
+}
+
+// Three passes of a sliding box approximate a Gaussian at a cost independent
+// of its width, which matters near the poles of an equirect map.
+static void BoxBlurRowWrapped(glm::vec4* row, glm::vec4* tmp, size_t width, size_t radius) {
+    radius = std::min(radius, (width - 1) / 2);
+    if (radius == 0) return;
+    float norm = 1.0f / (float) (radius * 2 + 1);
+    for (int pass = 0; pass < 3; ++pass) {
+        glm::vec4 sum { 0.0f };
+        for (size_t i = 0; i <= radius * 2; ++i) sum += row[(i + width - radius) % width];
+        for (size_t x = 0; x < width; ++x) {
+            tmp[x] = sum * norm;
+            sum += row[(x + radius + 1) % width] - row[(x + width - radius) % width];
+        }
+        std::copy(tmp, tmp + width, row);
+    }
+}
+
+static void BlurEnvironment(FloatLevel* level, float sigma) {
+    const float PI = 3.14159265f;
+    size_t width = level->width, height = level->height;
+
+    // Rows are circles of latitude: the same angle spans more texels towards
+    // the poles, so the horizontal kernel widens with 1 / cos(latitude).
+    ParallelFor(height, ROW_GRAIN, [&](size_t begin, size_t end) {
+        std::vector<glm::vec4> tmp(width);
+        for (size_t y = begin; y < end; ++y) {
+            float lat = PI * (((float) y + 0.5f) / (float) height - 0.5f);
+            float rowsigma = std::min(sigma / std::max(cosf(lat), 1e-4f), (float) width * 0.5f);
+            size_t radius = (size_t) lrintf((sqrtf(4.0f * rowsigma * rowsigma + 1.0f) - 1.0f) * 0.5f);
+            BoxBlurRowWrapped(&level->texels[y * width], tmp.data(), width, radius);
+        }
+    });
+
+    int radius = (int) ceilf(sigma * 3.0f);
+    std::vector<float> weights(radius * 2 + 1);
+    float total = 0.0f;
+    for (int i = -radius; i <= radius; ++i) {
+        weights[i + radius] = expf(-(float) (i * i) / (2.0f * sigma * sigma));
+        total += weights[i + radius];
+    }
+    for (float& w : weights) w /= total;
+
+    std::vector<glm::vec4> src = level->texels;
+    ParallelFor(height, ROW_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; ++y) {
+            glm::vec4* dst = &level->texels[y * width];
+            std::fill(dst, dst + width, glm::vec4 { 0.0f });
+            for (int i = -radius; i <= radius; ++i) {
+                size_t sy = (size_t) std::clamp<int64_t>((int64_t) y + i, 0, (int64_t) height - 1);
+                const glm::vec4* row = &src[sy * width];
+                float w = weights[i + radius];
+                for (size_t x = 0; x < width; ++x) dst[x] += row[x] * w;
+            }
+        }
+    });
+}
+
+static inline uint8_t LinearToSrgb8(float v) {
+    v = std::clamp(v, 0.0f, 1.0f);
+    float s = v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+    return (uint8_t) lrintf(s * 255.0f);
+}
+
+static void EncodeLevel(uint8_t* dst, const FloatLevel& level, CookedTextureFormat format) {
+    ParallelFor(level.height, ROW_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin * level.width; i < end * level.width; ++i) {
+            const glm::vec4& t = level.texels[i];
+            if (format == COOKED_TEXTURE_SRGB8_ALPHA8) {
+                uint8_t* out = dst + i * 4;
+                out[0] = LinearToSrgb8(t.r);
+                out[1] = LinearToSrgb8(t.g);
+                out[2] = LinearToSrgb8(t.b);
+                out[3] = (uint8_t) lrintf(std::clamp(t.a, 0.0f, 1.0f) * 255.0f);
+            } else {
+                uint16_t out[4];
+                for (int c = 0; c < 4; ++c) out[c] = glm::packHalf1x16(t[c]);
+                memcpy(dst + i * sizeof(out), out, sizeof(out));
+            }
+        }
+    });
+}
+
+std::string CookedTexture_PathFor(const char* sourcePath) {
+    return Cooked_PathFor(sourcePath, ".tex");
+}
+
+bool CookTexture(const char* sourcePath, const char* cookedPath, TextureCookKind kind) {
+    auto start = std::chrono::high_resolution_clock::now();
+    SourceStamp stamp;
+    if (!GetSourceStamp(sourcePath, &stamp)) return false;
+
+    // Decode exactly as the runtime does, so cooked and uncooked textures
+    // agree on row order and on the linearization of 8-bit sources.
+    Image image = Image_Load(sourcePath, 4, Image::F_F32);
+    if (!image.data || image.width <= 0 || image.height <= 0) {
+        printf("%s: could not decode\n", sourcePath);
+        return false;
+    }
+    FloatLevel level;
+    level.width = (uint32_t) image.width;
+    level.height = (uint32_t) image.height;
+    level.texels.resize((size_t) level.width * level.height);
+    memcpy(level.texels.data(), image.data, level.texels.size() * sizeof(glm::vec4));
+    Image_Free(image);
+
+    CookedTextureFormat format = kind == TEXTURE_COOK_ENVIRONMENT ? COOKED_TEXTURE_RGBA16F : COOKED_TEXTURE_SRGB8_ALPHA8;
+    size_t texelSize = format == COOKED_TEXTURE_RGBA16F ? 8 : 4;
+
+    std::vector<CookedTextureLevel> levels;
+    std::vector<uint8_t> data;
+    for (;;) {
+        CookedTextureLevel info { level.width, level.height, data.size(), (uint64_t) level.texels.size() * texelSize };
+        levels.push_back(info);
+        data.resize(data.size() + (size_t) info.size);
+        EncodeLevel(data.data() + info.offset, level, format);
+        if (level.width == 1 && level.height == 1) break;
+
+        level = Downsample(level);
+        if (kind == TEXTURE_COOK_ENVIRONMENT) BlurEnvironment(&level, ENV_BLUR_SIGMA);
+    }
+
+    CookedTextureInfo info { format, 0 };
+    const CookedPayload payloads[] = {
+        { COOKED_CHUNK_TEXTURE_INFO,   sizeof(CookedTextureInfo),  &info,          sizeof(info) },
+        { COOKED_CHUNK_TEXTURE_LEVELS, sizeof(CookedTextureLevel), levels.data(), levels.size() * sizeof(CookedTextureLevel) },
+        { COOKED_CHUNK_TEXTURE_DATA,   1,                          data.data(),   data.size() },
+    };
+    if (!Cooked_Write(cookedPath, COOKED_TEXTURE_MAGIC, COOKED_TEXTURE_VERSION, stamp, payloads, sizeof(payloads) / sizeof(payloads[0]))) {
+        return false;
+    }
+
+    std::chrono::duration<double, std::milli> dur = std::chrono::high_resolution_clock::now() - start;
+    printf("%s: %ux%u, %zu levels, %.1f MB cooked in %.2f ms\n", sourcePath, levels[0].width, levels[0].height, levels.size(),
+           data.size() / (1024.0 * 1024.0), dur.count());
+    return true;
+}
+
+static bool ParseCookedTexture(CookedTexture* texture, const void* data, size_t size) {
+    const CookedChunk* info = Cooked_FindChunk(data, size, COOKED_CHUNK_TEXTURE_INFO, sizeof(CookedTextureInfo));
+    const CookedChunk* levels = Cooked_FindChunk(data, size, COOKED_CHUNK_TEXTURE_LEVELS, sizeof(CookedTextureLevel));
+    const CookedChunk* texels = Cooked_FindChunk(data, size, COOKED_CHUNK_TEXTURE_DATA, 1);
+    if (!info || !levels || !texels || info->size != sizeof(CookedTextureInfo) || levels->size == 0) return false;
+
+    auto base = (const char*) data;
+    auto format = ((const CookedTextureInfo*) (base + info->offset))->format;
+    if (format != COOKED_TEXTURE_SRGB8_ALPHA8 && format != COOKED_TEXTURE_RGBA16F) return false;
+    texture->format = (CookedTextureFormat) format;
+    texture->levels = (const CookedTextureLevel*) (base + levels->offset);
+    texture->numLevels = (size_t) (levels->size / sizeof(CookedTextureLevel));
+    texture->data = (const uint8_t*) (base + texels->offset);
+    for (size_t i = 0; i < texture->numLevels; ++i) {
+        const CookedTextureLevel& level = texture->levels[i];
+        if (level.offset > texels->size || level.size > texels->size - level.offset) return false;
+    }
+    return true;
+}
+
+bool CookedTexture_Open(CookedTexture* texture, const char* path, const char* sourcePath) {
+    if (!Cooked_Open(&texture->file, path, COOKED_TEXTURE_MAGIC, COOKED_TEXTURE_VERSION, sourcePath)) return false;
+    if (!ParseCookedTexture(texture, texture->file.data, texture->file.size)) {
+        CookedTexture_Close(texture);
+        return false;
+    }
+    return true;
+}
+
+bool CookedTexture_OpenMemory(CookedTexture* texture, const void* data, size_t size) {
+    if (Cooked_Validate(data, size, COOKED_TEXTURE_MAGIC, COOKED_TEXTURE_VERSION) && ParseCookedTexture(texture, data, size)) return true;
+    CookedTexture_Close(texture);
+    return false;
+}
+
+void CookedTexture_Close(CookedTexture* texture) {
+    MappedFile_Close(&texture->file);
+    texture->levels = nullptr;
+    texture->numLevels = 0;
+    texture->data = nullptr;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "cooked_file.hpp"
+#include "mapped_file.hpp"
+
+// Cooked textures carry their whole mip chain, already in the format they are
+// stored in on the GPU, so loading one is a map and one upload per level.
+// Colour textures are RGBA8 holding sRGB-encoded values with mips averaged
+// in linear light; environments are RGBA16F with each level blurred a little
+// more than a plain downsample, so rough reflections can sample higher
+// levels without shimmering.
+
+static constexpr uint32_t COOKED_TEXTURE_MAGIC   = 0x54524250; // "PBRT"
+static constexpr uint32_t COOKED_TEXTURE_VERSION = 1;
+
+enum CookedTextureChunkId : uint32_t {
+    COOKED_CHUNK_TEXTURE_INFO   = 1,
+    COOKED_CHUNK_TEXTURE_LEVELS = 2,
+    COOKED_CHUNK_TEXTURE_DATA   = 3,
+};
+
+enum CookedTextureFormat : uint32_t {
+    COOKED_TEXTURE_SRGB8_ALPHA8 = 1,
+    COOKED_TEXTURE_RGBA16F      = 2,
+};
+
+enum TextureCookKind {
+    TEXTURE_COOK_COLOR,
+    TEXTURE_COOK_ENVIRONMENT,
+};
+
+struct CookedTextureInfo {
+    uint32_t format;
+    uint32_t reserved;
+};
+
+struct CookedTextureLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;        // into the data chunk
+    uint64_t size;
+};
+
+struct CookedTexture {
+    MappedFile                file;
+    CookedTextureFormat       format;
+    const CookedTextureLevel* levels;
+    size_t                    numLevels;
+    const uint8_t*            data;
+};
+
+// COOKED_DIR/<sourcePath>.tex
+std::string CookedTexture_PathFor(const char* sourcePath);
+
+// Decodes sourcePath, builds its full mip chain and writes it to cookedPath.
+bool CookTexture(const char* sourcePath, const char* cookedPath, TextureCookKind kind);
+
+bool CookedTexture_Open(CookedTexture* texture, const char* path, const char* sourcePath);
+// Views a cooked texture in memory owned by someone else, e.g. a pack entry,
+// which must outlive it.
+bool CookedTexture_OpenMemory(CookedTexture* texture, const void* data, size_t size);
+void CookedTexture_Close(CookedTexture* texture);
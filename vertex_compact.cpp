@@ -0,0 +1,158 @@
+#include "vertex_compact.hpp"
+
+#include <math.h>
+#include <algorithm>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "parallel.hpp"
+
+static const float PI = 3.14159265358979f;
+
+static inline float SignNotZero(float v) {
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+static inline uint32_t QuantizeUnorm(float v, uint32_t bits) {
+    float max = (float) ((1u << bits) - 1);
+    return (uint32_t) (std::min(std::max(v, 0.0f), 1.0f) * max + 0.5f);
+}
+
+static inline glm::vec3 DecodeOctahedral(uint32_t x, uint32_t y) {
+    glm::vec3 n { x / 1023.0f * 2.0f - 1.0f, y / 1023.0f * 2.0f - 1.0f, 0.0f };
+    n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+    if (n.z < 0.0f) {
+        float nx = n.x;
+        n.x = (1.0f - fabsf(n.y)) * SignNotZero(nx);
+        n.y = (1.0f - fabsf(nx)) * SignNotZero(n.y);
+    }
+    return glm::normalize(n);
+}
+
+// Picks whichever of the four surrounding grid points decodes closest to n,
+// which roughly halves the worst-case error of plain rounding.
+static inline void EncodeOctahedral(glm::vec3 n, uint32_t* qx, uint32_t* qy) {
+    float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    float px = l1 > 0.0f ? n.x / l1 : 0.0f;
+    float py = l1 > 0.0f ? n.y / l1 : 0.0f;
+    if (n.z < 0.0f) {
+        float ox = px;
+        px = (1.0f - fabsf(py)) * SignNotZero(ox);
+        py = (1.0f - fabsf(ox)) * SignNotZero(py);
+    }
+    float fx = std::min(std::max((px * 0.5f + 0.5f) * 1023.0f, 0.0f), 1023.0f);
+    float fy = std::min(std::max((py * 0.5f + 0.5f) * 1023.0f, 0.0f), 1023.0f);
+    float best = -2.0f;
+    for (int i = 0; i < 4; ++i) {
+        uint32_t cx = std::min((uint32_t) floorf(fx) + (i & 1), 1023u);
+        uint32_t cy = std::min((uint32_t) floorf(fy) + (i >> 1), 1023u);
+        float d = glm::dot(DecodeOctahedral(cx, cy), n);
+        if (d > best) {
+            best = d;
+            *qx = cx;
+            *qy = cy;
+        }
+    }
+}
+
+// Duff et al., "Building an Orthonormal Basis, Revisited". Continuous
+// everywhere except n.z == 0 crossings, which the shader reproduces exactly.
+static inline void TangentBasis(glm::vec3 n, glm::vec3* b1, glm::vec3* b2) {
+    float sign = SignNotZero(n.z);
+    float a = -1.0f / (sign + n.z);
+    float b = n.x * n.y * a;
+    *b1 = glm::vec3 { 1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x };
+    *b2 = glm::vec3 { b, sign + n.y * n.y * a, -n.y };
+}
+
+CompactVertBounds ComputeCompactBounds(const GlStaticMeshVert* verts, size_t numverts) {
+    glm::vec3 lo { INFINITY }, hi { -INFINITY };
+    for (size_t i = 0; i < numverts; ++i) {
+        lo = glm::min(lo, verts[i].pos);
+        hi = glm::max(hi, verts[i].pos);
+    }
+    if (numverts == 0) lo = hi = glm::vec3 { 0.0f };
+    return CompactVertBounds { lo, glm::max(hi - lo, glm::vec3 { 1e-20f }) };
+}
+
+GlCompactVert PackCompactVert(const GlStaticMeshVert& vert, const CompactVertBounds& bounds) {
+    GlCompactVert out {};
+    glm::vec3 rel = (vert.pos - bounds.offset) / bounds.scale;
+    out.pos[0] = (uint16_t) QuantizeUnorm(rel.x, 16);
+    out.pos[1] = (uint16_t) QuantizeUnorm(rel.y, 16);
+    out.pos[2] = (uint16_t) QuantizeUnorm(rel.z, 16);
+
+    uint32_t nx = 0, ny = 0;
+    EncodeOctahedral(glm::normalize(vert.norm), &nx, &ny);
+
+    // Measure the tangent against the normal the shader will reconstruct,
+    // not the original, so both sides agree on the basis.
+    glm::vec3 n = DecodeOctahedral(nx, ny);
+    glm::vec3 b1, b2;
+    TangentBasis(n, &b1, &b2);
+    glm::vec3 tang { vert.tang };
+    float angle = atan2f(glm::dot(tang, b2), glm::dot(tang, b1));
+    uint32_t qa = (uint32_t) floorf((angle + PI) / (2.0f * PI) * 2048.0f + 0.5f) & 2047u;
+    uint32_t flip = vert.tang.w < 0.0f ? 1u : 0u;
+    out.frame = nx | (ny << 10) | (qa << 20) | (flip << 31);
+
+    out.coord[0] = glm::packHalf1x16(vert.coord.x);
+    out.coord[1] = glm::packHalf1x16(vert.coord.y);
+    return out;
+}
+
+GlStaticMeshVert UnpackCompactVert(const GlCompactVert& vert, const CompactVertBounds& bounds) {
+    GlStaticMeshVert out;
+    glm::vec3 rel { vert.pos[0] / 65535.0f, vert.pos[1] / 65535.0f, vert.pos[2] / 65535.0f };
+    out.pos = bounds.offset + rel * bounds.scale;
+
+    out.norm = DecodeOctahedral(vert.frame & 1023u, (vert.frame >> 10) & 1023u);
+    glm::vec3 b1, b2;
+    TangentBasis(out.norm, &b1, &b2);
+    float angle = ((vert.frame >> 20) & 2047u) / 2048.0f * 2.0f * PI - PI;
+    out.tang = glm::vec4(b1 * cosf(angle) + b2 * sinf(angle), (vert.frame >> 31) ? -1.0f : 1.0f);
+
+    out.coord = glm::vec2 { glm::unpackHalf1x16(vert.coord[0]), glm::unpackHalf1x16(vert.coord[1]) };
+    return out;
+}
+
+void PackCompactVerts(GlCompactVert* dst, const GlStaticMeshVert* verts, size_t numverts, const CompactVertBounds& bounds) {
+    ParallelFor(numverts, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) dst[i] = PackCompactVert(verts[i], bounds);
+    });
+}
+
+void UnpackCompactVerts(GlStaticMeshVert* dst, const GlCompactVert* verts, size_t numverts, const CompactVertBounds& bounds) {
+    ParallelFor(numverts, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) dst[i] = UnpackCompactVert(verts[i], bounds);
+    });
+}
+
+static inline float AngleDegrees(glm::vec3 a, glm::vec3 b) {
+    float d = glm::dot(glm::normalize(a), glm::normalize(b));
+    return acosf(std::min(std::max(d, -1.0f), 1.0f)) * 180.0f / PI;
+}
+
+CompactVertError MeasureCompactError(const GlStaticMeshVert* verts, size_t numverts, const CompactVertBounds& bounds) {
+    CompactVertError err {};
+    for (size_t i = 0; i < numverts; ++i) {
+        const GlStaticMeshVert& src = verts[i];
+        GlStaticMeshVert rt = UnpackCompactVert(PackCompactVert(src, bounds), bounds);
+
+        glm::vec3 dp = glm::abs(rt.pos - src.pos);
+        err.pos = std::max(err.pos, std::max(dp.x, std::max(dp.y, dp.z)));
+        err.norm = std::max(err.norm, AngleDegrees(rt.norm, src.norm));
+
+        // Compare against the source tangent made orthogonal to the source
+        // normal, which is all the packed frame can represent.
+        glm::vec3 n = glm::normalize(src.norm);
+        glm::vec3 st { src.tang };
+        glm::vec3 t = st - n * glm::dot(n, st);
+        if (glm::dot(t, t) > 1e-12f) err.tang = std::max(err.tang, AngleDegrees(glm::vec3(rt.tang), t));
+        if ((rt.tang.w < 0.0f) != (src.tang.w < 0.0f)) err.flips++;
+
+        glm::vec2 dc = glm::abs(rt.coord - src.coord);
+        err.coord = std::max(err.coord, std::max(dc.x, dc.y));
+    }
+    return err;
+}
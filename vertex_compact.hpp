@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glm/vec3.hpp>
+
+#include "static_mesh.hpp"
+
+// 16-byte alternative to the 48-byte GlStaticMeshVert.
+//   pos    unorm16 xyz inside the mesh bounds (w is padding)
+//   frame  bits  0..9  octahedral normal x, unorm10
+//          bits 10..19 octahedral normal y, unorm10
+//          bits 20..30 tangent angle around the normal, unorm11 over [-pi, pi)
+//          bit  31     bitangent handedness, set when tang.w is negative
+//   coord  half-float uv
+// The tangent angle is measured in the basis returned by TangentBasis, which
+// vert.glsl mirrors when COMPACT_VERTS is defined.
+struct GlCompactVert {
+    uint16_t pos[4];
+    uint32_t frame;
+    uint16_t coord[2];
+};
+static_assert(sizeof(GlCompactVert) == 16, "GlCompactVert must stay tightly packed");
+
+// Dequantization for GlCompactVert::pos: pos = offset + unorm * scale.
+struct CompactVertBounds {
+    glm::vec3 offset;
+    glm::vec3 scale;
+};
+
+struct CompactVertError {
+    float pos;      // max absolute position error in mesh units
+    float norm;     // max normal error in degrees
+    float tang;     // max tangent error in degrees
+    float coord;    // max absolute uv error
+    size_t flips;   // vertices whose handedness did not survive
+};
+
+CompactVertBounds ComputeCompactBounds(const GlStaticMeshVert* verts, size_t numverts);
+GlCompactVert PackCompactVert(const GlStaticMeshVert& vert, const CompactVertBounds& bounds);
+GlStaticMeshVert UnpackCompactVert(const GlCompactVert& vert, const CompactVertBounds& bounds);
+void PackCompactVerts(GlCompactVert* dst, const GlStaticMeshVert* verts, size_t numverts, const CompactVertBounds& bounds);
+void UnpackCompactVerts(GlStaticMeshVert* dst, const GlCompactVert* verts, size_t numverts, const CompactVertBounds& bounds);
+
+// Round-trips every vertex through the compact layout and reports the worst
+// error against the fp32 source. Checked by the tests target rather than on
+// every upload.
+CompactVertError MeasureCompactError(const GlStaticMeshVert* verts, size_t numverts, const CompactVertBounds& bounds);
@@ -0,0 +1,200 @@
+#include "vertex_convert.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VERTEX_CONVERT_SSE 1
+#endif
+
+#include "parallel.hpp"
+
+static inline glm::vec3 LoadVec3(const float* stream, size_t i) {
+    return glm::vec3 { stream[i * 3 + 0], stream[i * 3 + 1], stream[i * 3 + 2] };
+}
+
+static inline glm::vec3 TransformPoint(const float (&m)[3][4], glm::vec3 v) {
+    return glm::vec3 {
+        m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z + m[0][3],
+        m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z + m[1][3],
+        m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z + m[2][3],
+    };
+}
+
+static inline glm::vec3 TransformDir(const float (&m)[3][3], glm::vec3 v) {
+    glm::vec3 r {
+        m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+        m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+        m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z,
+    };
+    float len = sqrtf(r.x * r.x + r.y * r.y + r.z * r.z);
+    return len > 0.0f ? r / len : r;
+}
+
+void ConvertVerticesScalar(GlStaticMeshVert* dst, const VertexStreams& src, const VertexTransform& xf, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        GlStaticMeshVert& v = dst[i];
+        v.pos = TransformPoint(xf.pos, LoadVec3(src.pos, i));
+        v.norm = src.norm ? TransformDir(xf.norms, LoadVec3(src.norm, i)) : glm::vec3(0.0f, 0.0f, 1.0f);
+        v.tang = glm::vec4(0.0f);
+        v.coord = src.coord ? glm::vec2(src.coord[i * 3 + 0], src.coord[i * 3 + 1]) : glm::vec2(0.0f);
+    }
+}
+
+#ifdef VERTEX_CONVERT_SSE
+
+// Four float3 vectors in SoA form; w holds whatever followed z in memory.
+struct Float3x4 {
+    __m128 x, y, z, w;
+};
+
+// Gathers stream[i..i+3] with one unaligned load each. Each load reads the
+// x of the following vector too, so the caller keeps i + 4 below count.
+static inline Float3x4 Gather4(const float* stream, size_t i) {
+    Float3x4 r {
+        _mm_loadu_ps(stream + i * 3 + 0),
+        _mm_loadu_ps(stream + i * 3 + 3),
+        _mm_loadu_ps(stream + i * 3 + 6),
+        _mm_loadu_ps(stream + i * 3 + 9),
+    };
+    _MM_TRANSPOSE4_PS(r.x, r.y, r.z, r.w);
+    return r;
+}
+
+static inline Float3x4 Transform4(const float (&m)[3][4], const Float3x4& v, bool translate) {
+    Float3x4 r;
+    __m128* out[3] = { &r.x, &r.y, &r.z };
+    for (int row = 0; row < 3; ++row) {
+        __m128 acc = _mm_mul_ps(_mm_set1_ps(m[row][0]), v.x);
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(m[row][1]), v.y));
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(m[row][2]), v.z));
+        if (translate) acc = _mm_add_ps(acc, _mm_set1_ps(m[row][3]));
+        *out[row] = acc;
+    }
+    r.w = _mm_setzero_ps();
+    return r;
+}
+
+static inline Float3x4 TransformDir4(const float (&m)[3][3], const Float3x4& v) {
+    const float rows[3][4] = {
+        { m[0][0], m[0][1], m[0][2], 0.0f },
+        { m[1][0], m[1][1], m[1][2], 0.0f },
+        { m[2][0], m[2][1], m[2][2], 0.0f },
+    };
+    Float3x4 r = Transform4(rows, v, false);
+    // Zero-length directions pass through unscaled, like the scalar path.
+    __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r.x, r.x), _mm_mul_ps(r.y, r.y)), _mm_mul_ps(r.z, r.z));
+    __m128 nonzero = _mm_cmpgt_ps(len2, _mm_setzero_ps());
+    __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(len2));
+    inv = _mm_or_ps(_mm_and_ps(nonzero, inv), _mm_andnot_ps(nonzero, _mm_set1_ps(1.0f)));
+    r.x = _mm_mul_ps(r.x, inv);
+    r.y = _mm_mul_ps(r.y, inv);
+    r.z = _mm_mul_ps(r.z, inv);
+    return r;
+}
+
+// Back to one xyz_ vector per lane.
+static inline void Scatter4(Float3x4 v, __m128 (&out)[4]) {
+    _MM_TRANSPOSE4_PS(v.x, v.y, v.z, v.w);
+    out[0] = v.x;
+    out[1] = v.y;
+    out[2] = v.z;
+    out[3] = v.w;
+}
+
+void ConvertVertices(GlStaticMeshVert* dst, const VertexStreams& src, const VertexTransform& xf, size_t begin, size_t end) {
+    static_assert(offsetof(GlStaticMeshVert, norm) == 12 && offsetof(GlStaticMeshVert, tang) == 24
+               && offsetof(GlStaticMeshVert, coord) == 40,
+                  "ConvertVertices relies on the attributes being packed back to back");
+
+    __m128 pos[4], norm[4];
+    const __m128 defnorm = _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f);
+
+    size_t i = begin;
+    for (; i + 4 <= end && i + 4 < src.count; i += 4) {
+        Scatter4(Transform4(xf.pos, Gather4(src.pos, i), true), pos);
+        if (src.norm) Scatter4(TransformDir4(xf.norms, Gather4(src.norm, i)), norm);
+
+        for (int k = 0; k < 4; ++k) {
+            // pos and norm are 16-byte stores that spill their w lane into
+            // the next attribute, which the following store overwrites.
+            float* out = &dst[i + k].pos.x;
+            _mm_storeu_ps(out + 0, pos[k]);
+            _mm_storeu_ps(out + 3, src.norm ? norm[k] : defnorm);
+            _mm_storeu_ps(out + 6, _mm_setzero_ps());
+            double uv = 0.0;
+            if (src.coord) memcpy(&uv, src.coord + (i + k) * 3, sizeof(uv));
+            _mm_store_sd((double*) (out + 10), _mm_set_sd(uv));
+        }
+    }
+    ConvertVerticesScalar(dst, src, xf, i, end);
+}
+
+#else
+
+void ConvertVertices(GlStaticMeshVert* dst, const VertexStreams& src, const VertexTransform& xf, size_t begin, size_t end) {
+    ConvertVerticesScalar(dst, src, xf, begin, end);
+}
+
+#endif
+
+typedef void ConvertFn(GlStaticMeshVert*, const VertexStreams&, const VertexTransform&, size_t, size_t);
+
+static double TimeConversion(ConvertFn* fn, GlStaticMeshVert* dst, const VertexStreams& src, const VertexTransform& xf, size_t grain) {
+    auto start = std::chrono::high_resolution_clock::now();
+    ParallelFor(src.count, grain, [&](size_t begin, size_t end) { fn(dst, src, xf, begin, end); });
+    std::chrono::duration<double> dur = std::chrono::high_resolution_clock::now() - start;
+    return dur.count();
+}
+
+void BenchmarkVertexConversion(size_t count) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> streams[3];
+    for (auto& s : streams) {
+        s.resize(count * 3);
+        for (float& f : s) f = dist(rng);
+    }
+    VertexStreams src { streams[0].data(), streams[1].data(), streams[2].data(), count };
+    VertexTransform xf {
+        { { 0.0f, -2.0f, 0.0f, 1.0f }, { 2.0f, 0.0f, 0.0f, 2.0f }, { 0.0f, 0.0f, 2.0f, 3.0f } },
+        { { 0.0f, -0.5f, 0.0f }, { 0.5f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.5f } },
+    };
+    std::vector<GlStaticMeshVert> ref(count), out(count);
+
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    struct Run {
+        const char* name;
+        ConvertFn*  fn;
+        size_t      grain;
+        size_t      cores;
+    };
+    const Run runs[] = {
+        { "scalar, 1 thread", ConvertVerticesScalar, count, 1 },
+        { "simd, 1 thread",   ConvertVertices,       count, 1 },
+        { "scalar, threaded", ConvertVerticesScalar, 1 << 14, threads },
+        { "simd, threaded",   ConvertVertices,       1 << 14, threads },
+    };
+    TimeConversion(ConvertVerticesScalar, ref.data(), src, xf, count);
+    printf("vertex conversion, %zu verts, %zu cores\n", count, threads);
+    for (const Run& run : runs) {
+        double best = 1e30;
+        for (int rep = 0; rep < 5; ++rep) best = std::min(best, TimeConversion(run.fn, out.data(), src, xf, run.grain));
+
+        float maxerr = 0.0f;
+        for (size_t i = 0; i < count; ++i) {
+            const float* a = &ref[i].pos.x;
+            const float* b = &out[i].pos.x;
+            for (size_t k = 0; k < sizeof(GlStaticMeshVert) / sizeof(float); ++k) maxerr = std::max(maxerr, fabsf(a[k] - b[k]));
+        }
+        double rate = count / best;
+        printf("  %-17s %8.2f ms  %8.1f Mverts/s  %8.1f Mverts/s/core  max diff %g\n",
+               run.name, best * 1e3, rate * 1e-6, rate * 1e-6 / run.cores, maxerr);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "static_mesh.hpp"
+
+// Source vertex streams of one mesh, as separate tightly packed float3
+// arrays the way Assimp stores them. Only pos is required; missing streams
+// convert to the same defaults the importer has always used. coord is read
+// as float3 and only its xy is kept. Tangents are not converted; they are
+// generated after welding and left zero here.
+struct VertexStreams {
+    const float* pos;
+    const float* norm;
+    const float* coord;
+    size_t       count;
+};
+
+// Row-major 3x4 position transform and the 3x3 inverse transpose of its
+// upper-left block for normals, which are renormalized after transform.
+struct VertexTransform {
+    float pos[3][4];
+    float norms[3][3];
+};
+
+// Transforms and interleaves src[begin, end) into dst[begin, end). dst only
+// has to be writable, so it can point into a mapped GL buffer. Uses SSE
+// transposes and overlapping 16-byte stores where available, with a scalar
+// path for the tail.
+void ConvertVertices(GlStaticMeshVert* dst, const VertexStreams& src, const VertexTransform& xf, size_t begin, size_t end);
+
+// Plain scalar reference for ConvertVertices.
+void ConvertVerticesScalar(GlStaticMeshVert* dst, const VertexStreams& src, const VertexTransform& xf, size_t begin, size_t end);
+
+// Converts a synthetic mesh of count vertices with the scalar and SSE paths,
+// single- and multi-threaded, and prints verts/s and verts/s/core.
+void BenchmarkVertexConversion(size_t count);
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <GL/glew.h>
+#include <glm/fwd.hpp>
+
+// Vertex formats described once, at compile time, as a list of attributes
+// of a vertex struct. The same description sets up the VAO with DSA calls
+// and writes the matching `layout (location = N) in ...` declarations for
+// vert.glsl, so a format change cannot leave the two disagreeing, and
+// VertexLayoutValid lets a static_assert catch a description that no longer
+// fits its struct.
+
+enum VertexAttribKind {
+    VA_FLOAT,       // float or half components, read as float
+    VA_NORMALIZED,  // integer components mapped to [0, 1] or [-1, 1]
+    VA_INTEGER,     // integer components read as int/uint (glVertexArrayAttribIFormat)
+};
+
+struct VertexAttrib {
+    GLuint           location;
+    GLint            components;
+    GLenum           type;
+    VertexAttribKind kind;
+    size_t           offset;
+    size_t           size;          // of the struct member, which may be padded past what is read
+    const char*      name;          // the vert.glsl input
+};
+
+template <size_t N>
+struct VertexLayout {
+    size_t       stride;
+    VertexAttrib attribs[N];
+};
+
+// Components and GL type of a vertex struct member, from its C++ type: one
+// of the scalars below, a glm vector of one, or a fixed array of one.
+template <typename T>
+struct VertexMemberType;
+
+template <GLint Components, GLenum Type>
+struct VertexMemberTypeOf {
+    static constexpr GLint  components = Components;
+    static constexpr GLenum type = Type;
+};
+
+template <> struct VertexMemberType<float>    : VertexMemberTypeOf<1, GL_FLOAT> {};
+template <> struct VertexMemberType<int8_t>   : VertexMemberTypeOf<1, GL_BYTE> {};
+template <> struct VertexMemberType<uint8_t>  : VertexMemberTypeOf<1, GL_UNSIGNED_BYTE> {};
+template <> struct VertexMemberType<int16_t>  : VertexMemberTypeOf<1, GL_SHORT> {};
+template <> struct VertexMemberType<uint16_t> : VertexMemberTypeOf<1, GL_UNSIGNED_SHORT> {};
+template <> struct VertexMemberType<int32_t>  : VertexMemberTypeOf<1, GL_INT> {};
+template <> struct VertexMemberType<uint32_t> : VertexMemberTypeOf<1, GL_UNSIGNED_INT> {};
+
+template <glm::length_t L, typename T, glm::qualifier Q>
+struct VertexMemberType<glm::vec<L, T, Q>> : VertexMemberTypeOf<(GLint) L, VertexMemberType<T>::type> {};
+
+template <typename T, size_t N>
+struct VertexMemberType<T[N]> : VertexMemberTypeOf<(GLint) N, VertexMemberType<T>::type> {
+    static_assert(VertexMemberType<T>::components == 1, "arrays of vectors are not vertex attributes");
+};
+
+// One attribute read from member of Vert, named in_<member> in vert.glsl,
+// with as many components of the same type as the member holds.
+#define VERTEX_ATTRIB(Vert, member, location, kind) \
+    VERTEX_ATTRIB_AS(Vert, member, location, VertexMemberType<decltype(Vert::member)>::components, \
+                     VertexMemberType<decltype(Vert::member)>::type, kind)
+
+// The same, read as something other than the member's own type: for
+// bit-packed members, and members with padding components that are not
+// read. VertexLayoutValid still checks that the read fits the member.
+#define VERTEX_ATTRIB_AS(Vert, member, location, components, type, kind) \
+    VertexAttrib { location, components, type, kind, offsetof(Vert, member), sizeof(Vert::member), "in_" #member }
+
+template <typename Vert, typename... Attribs>
+constexpr VertexLayout<sizeof...(Attribs)> MakeVertexLayout(Attribs... attribs) {
+    return VertexLayout<sizeof...(Attribs)> { sizeof(Vert), { attribs... } };
+}
+
+constexpr size_t VertexTypeSize(GLenum type) {
+    return type == GL_FLOAT || type == GL_INT || type == GL_UNSIGNED_INT ? 4
+         : type == GL_HALF_FLOAT || type == GL_SHORT || type == GL_UNSIGNED_SHORT ? 2
+         : type == GL_BYTE || type == GL_UNSIGNED_BYTE ? 1
+         : 0;
+}
+
+constexpr bool VertexTypeIsInteger(GLenum type) {
+    return type != GL_FLOAT && type != GL_HALF_FLOAT;
+}
+
+// Every attribute reads a known type, only from inside its own member,
+// which lies inside the vertex, with float kinds on float types and
+// integer kinds on integer types; no two attributes share a location, and
+// every location exists on every GL 4 implementation.
+template <size_t N>
+constexpr bool VertexLayoutValid(const VertexLayout<N>& layout) {
+    for (size_t i = 0; i < N; ++i) {
+        const VertexAttrib& a = layout.attribs[i];
+        size_t bytes = a.components * VertexTypeSize(a.type);
+        if (bytes == 0 || a.components < 1 || a.components > 4) return false;
+        if (bytes > a.size || a.offset + a.size > layout.stride) return false;
+        if ((a.kind == VA_FLOAT) == VertexTypeIsInteger(a.type)) return false;
+        if (a.location >= 16) return false;
+        for (size_t j = 0; j < i; ++j) {
+            if (layout.attribs[j].location == a.location) return false;
+        }
+    }
+    return true;
+}
+
+// Bytes of each vertex the layout actually reads; the rest is padding.
+template <size_t N>
+constexpr size_t VertexLayoutBytesRead(const VertexLayout<N>& layout) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < N; ++i) bytes += layout.attribs[i].components * VertexTypeSize(layout.attribs[i].type);
+    return bytes;
+}
+
+// Whether layout reads any of locations [first, first + count), which some
+// other stream of the same VAO owns.
+template <size_t N>
+constexpr bool VertexLayoutUsesLocations(const VertexLayout<N>& layout, GLuint first, GLuint count) {
+    for (size_t i = 0; i < N; ++i) {
+        if (layout.attribs[i].location >= first && layout.attribs[i].location < first + count) return true;
+    }
+    return false;
+}
+
+// Reads every attribute of layout from buffer through binding of vao.
+template <size_t N>
+void GL_SetupVertexLayout(GLuint vao, GLuint binding, GLuint buffer, const VertexLayout<N>& layout) {
+    for (const VertexAttrib& a : layout.attribs) {
+        glEnableVertexArrayAttrib(vao, a.location);
+        if (a.kind == VA_INTEGER) {
+            glVertexArrayAttribIFormat(vao, a.location, a.components, a.type, (GLuint) a.offset);
+        } else {
+            glVertexArrayAttribFormat(vao, a.location, a.components, a.type, a.kind == VA_NORMALIZED, (GLuint) a.offset);
+        }
+        glVertexArrayAttribBinding(vao, a.location, binding);
+    }
+    glVertexArrayVertexBuffer(vao, binding, buffer, 0, (GLsizei) layout.stride);
+}
+
+static inline const char* VertexAttribGlslType(const VertexAttrib& a) {
+    static const char* FLOATS[] = { "float", "vec2", "vec3", "vec4" };
+    static const char* INTS[] = { "int", "ivec2", "ivec3", "ivec4" };
+    static const char* UINTS[] = { "uint", "uvec2", "uvec3", "uvec4" };
+    bool isUnsigned = a.type == GL_UNSIGNED_BYTE || a.type == GL_UNSIGNED_SHORT || a.type == GL_UNSIGNED_INT;
+    const char** names = a.kind != VA_INTEGER ? FLOATS : isUnsigned ? UINTS : INTS;
+    return names[a.components - 1];
+}
+
+// The vert.glsl input declarations for layout, one per line.
+template <size_t N>
+std::string VertexLayoutGlsl(const VertexLayout<N>& layout) {
+    std::string glsl;
+    for (const VertexAttrib& a : layout.attribs) {
+        glsl += "layout (location = " + std::to_string(a.location) + ") in " + VertexAttribGlslType(a) + " " + a.name + ";\n";
+    }
+    return glsl;
+}
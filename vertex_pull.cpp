@@ -0,0 +1,122 @@
+#include "vertex_pull.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <glm/packing.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "parallel.hpp"
+
+static const float PI = 3.14159265358979f;
+
+struct PositionKey {
+    uint32_t bits[3];
+    bool operator==(const PositionKey& o) const { return memcmp(bits, o.bits, sizeof(bits)) == 0; }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& k) const {
+        // FNV-1a over the float bits.
+        uint64_t h = 14695981039346656037ull;
+        for (uint32_t v : k.bits) h = (h ^ v) * 1099511628211ull;
+        return (size_t) h;
+    }
+};
+
+static inline float SignNotZero(float v) {
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+// Same mapping as vertex_compact.cpp, but kept in [-1, 1] for snorm16.
+static inline glm::vec2 OctahedralFold(glm::vec3 n) {
+    float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    glm::vec2 p = l1 > 0.0f ? glm::vec2 { n.x / l1, n.y / l1 } : glm::vec2 { 0.0f };
+    if (n.z < 0.0f) p = glm::vec2 { (1.0f - fabsf(p.y)) * SignNotZero(p.x), (1.0f - fabsf(p.x)) * SignNotZero(p.y) };
+    return p;
+}
+
+// Must match decodeOctahedral16 in vert.glsl.
+static inline glm::vec3 OctahedralUnfold(glm::vec2 p) {
+    glm::vec3 n { p.x, p.y, 1.0f - fabsf(p.x) - fabsf(p.y) };
+    if (n.z < 0.0f) {
+        float nx = n.x;
+        n.x = (1.0f - fabsf(n.y)) * SignNotZero(nx);
+        n.y = (1.0f - fabsf(nx)) * SignNotZero(n.y);
+    }
+    return glm::normalize(n);
+}
+
+static GlPulledVert PackPulledVert(const GlStaticMeshVert& vert, uint32_t position) {
+    GlPulledVert out;
+    out.position = position;
+    out.normal = glm::packSnorm2x16(OctahedralFold(glm::normalize(vert.norm)));
+    glm::vec3 tang { vert.tang };
+    float len = glm::length(tang);
+    if (len > 0.0f) tang /= len;
+    out.tangent = glm::packSnorm3x10_1x2(glm::vec4 { tang, vert.tang.w < 0.0f ? -1.0f : 1.0f });
+    out.coord = glm::packHalf2x16(vert.coord);
+    return out;
+}
+
+void PackPulledVertices(PulledVertices* dst, const GlStaticMeshVert* verts, size_t numverts) {
+    dst->verts.resize(numverts);
+    dst->positions.clear();
+
+    // Sharing is exact: only bit-identical positions merge.
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> first;
+    first.reserve(numverts);
+    std::vector<uint32_t> position(numverts);
+    for (size_t i = 0; i < numverts; ++i) {
+        PositionKey key;
+        memcpy(key.bits, &verts[i].pos, sizeof(key.bits));
+        auto inserted = first.emplace(key, (uint32_t) dst->positions.size());
+        if (inserted.second) dst->positions.push_back(verts[i].pos);
+        position[i] = inserted.first->second;
+    }
+
+    ParallelFor(numverts, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) dst->verts[i] = PackPulledVert(verts[i], position[i]);
+    });
+}
+
+GlStaticMeshVert UnpackPulledVert(const PulledVertices& src, size_t index) {
+    const GlPulledVert& vert = src.verts[index];
+    GlStaticMeshVert out;
+    out.pos = src.positions[vert.position];
+    out.norm = OctahedralUnfold(glm::unpackSnorm2x16(vert.normal));
+    glm::vec4 tang = glm::unpackSnorm3x10_1x2(vert.tangent);
+    glm::vec3 t { tang };
+    float len = glm::length(t);
+    out.tang = glm::vec4 { len > 0.0f ? t / len : t, tang.w < 0.0f ? -1.0f : 1.0f };
+    out.coord = glm::unpackHalf2x16(vert.coord);
+    return out;
+}
+
+static inline float AngleDegrees(glm::vec3 a, glm::vec3 b) {
+    float d = glm::dot(glm::normalize(a), glm::normalize(b));
+    return acosf(std::min(std::max(d, -1.0f), 1.0f)) * 180.0f / PI;
+}
+
+CompactVertError MeasurePulledError(const PulledVertices& packed, const GlStaticMeshVert* verts, size_t numverts) {
+    CompactVertError err {};
+    for (size_t i = 0; i < numverts; ++i) {
+        const GlStaticMeshVert& src = verts[i];
+        GlStaticMeshVert rt = UnpackPulledVert(packed, i);
+
+        glm::vec3 dp = glm::abs(rt.pos - src.pos);
+        err.pos = std::max(err.pos, std::max(dp.x, std::max(dp.y, dp.z)));
+        err.norm = std::max(err.norm, AngleDegrees(rt.norm, src.norm));
+        glm::vec3 st { src.tang };
+        if (glm::dot(st, st) > 1e-12f) err.tang = std::max(err.tang, AngleDegrees(glm::vec3(rt.tang), st));
+        if ((rt.tang.w < 0.0f) != (src.tang.w < 0.0f)) err.flips++;
+
+        glm::vec2 dc = glm::abs(rt.coord - src.coord);
+        err.coord = std::max(err.coord, std::max(dc.x, dc.y));
+    }
+    return err;
+}
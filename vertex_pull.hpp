@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <glm/vec3.hpp>
+
+#include "static_mesh.hpp"
+#include "vertex_compact.hpp"
+
+// Vertex format of GlStaticMesh::F_PULLED, which has no vertex attributes:
+// the PULLED_VERTS variant of vert.glsl reads it out of one shader storage
+// buffer by gl_VertexID and decodes it itself. 16 bytes per vertex plus 12
+// per distinct position.
+//   position  index into the position stream, which holds every distinct
+//             float xyz once, so vertices split only by a normal or uv seam
+//             share it and keep their exact position
+//   normal    octahedral, snorm16 x and y (GLSL unpackSnorm2x16)
+//   tangent   snorm10 xyz, bitangent sign in the 2-bit w, in
+//             GL_INT_2_10_10_10_REV order
+//   coord     half-float uv (GLSL unpackHalf2x16)
+struct GlPulledVert {
+    uint32_t position;
+    uint32_t normal;
+    uint32_t tangent;
+    uint32_t coord;
+};
+static_assert(sizeof(GlPulledVert) == 16, "GlPulledVert must stay tightly packed");
+
+struct PulledVertices {
+    std::vector<GlPulledVert> verts;
+    std::vector<glm::vec3>    positions;
+};
+
+void PackPulledVertices(PulledVertices* dst, const GlStaticMeshVert* verts, size_t numverts);
+GlStaticMeshVert UnpackPulledVert(const PulledVertices& src, size_t index);
+
+// Round-trips every vertex and reports the worst error against the fp32
+// source, like MeasureCompactError, which the tests target checks.
+CompactVertError MeasurePulledError(const PulledVertices& packed, const GlStaticMeshVert* verts, size_t numverts);